@@ -0,0 +1,469 @@
+#include <GL/glew.h>
+#include "Avatar.h"
+#include "AvatarDescription.h"
+#include "FrameArena.h"
+#include "ImagePyramid.h"
+#include "PngWriter.h"
+#include "QoiWriter.h"
+#include "ReadbackQueue.h"
+#include "RenderContext.h"
+#include "RenderServer.h"
+#include "Resampler.h"
+#include "Shader.h"
+#include "SlotRegistry.h"
+#include "SoftwareAvatar.h"
+#include "SoftwareRasterizer.h"
+#include "SpriteCompositor.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Renders a list of avatar descriptions to one PNG each, spread over worker threads that
+// each own a headless GL context. Decoded images are shared through ImageStore, so every
+// file is read once no matter how many threads use it. Readback is pipelined: while one
+// avatar renders, earlier ones are copied back and encoded on the readback thread.
+// With --serve it stays up as a render daemon instead, see RenderServer.h.
+// --renderer cpu draws with SoftwareRasterizer and does not create any GL context;
+// --renderer composite stacks the body and sprite layers with SpriteCompositor, also GL-free.
+// --supersample N renders at N times the size and filters down with --filter (Lanczos by
+// default), which keeps small thumbnails free of stair-stepped edges; with the composite
+// renderer --filter also prefilters the downscaled item images.
+// --sizes 48x60,128x160,512x640 renders each avatar once at the largest size and writes
+// every size (name_WxH) from one ImagePyramid cascade instead of rendering once per size.
+//
+// Usage: AvatarBatch --input avatars.json [--out-dir thumbnails] [--size 256x320]
+//                    [--threads N] [--backend auto|egl|glfw] [--assets DIR]
+//                    [--readback-depth K] [--format png|qoi] [--level 0-9] [--encode-threads N]
+//                    [--renderer gl|cpu|composite] [--raster-threads N]
+//                    [--supersample N] [--filter lanczos|mitchell] [--sizes WxH,WxH,...]
+//        AvatarBatch --serve /tmp/avatars.sock [--size 256x320] [--threads N] [--max-batch N]
+//                    [--queue N] [--backend auto|egl|glfw] [--assets DIR] [--level 0-9]
+
+struct BatchOptions {
+    std::string inputPath;
+    std::string outputDir = "thumbnails";
+    std::string assetDir;
+    std::string socketPath; // Serve requests on this socket instead of rendering a list
+    int maxBatch = 8;
+    int queueCapacity = 256;
+    int width = 256;
+    int height = 320;
+    int threads = 0; // 0: one per hardware thread
+    int readbackDepth = 3; // Frames in flight per context
+    bool qoi = false;      // QOI instead of PNG, for intermediate frames
+    bool software = false; // SoftwareRasterizer instead of GL
+    bool composite = false; // SpriteCompositor instead of GL, software is set too
+    int rasterThreads = 1; // Tile or row threads per software renderer
+    int supersample = 1;   // Render at this multiple of the size and filter down
+    std::vector<ImagePyramid::Size> sizes; // Outputs per avatar; width x height is the largest
+    bool filterSet = false;
+    Resampler::Filter filter = Resampler::FILTER_LANCZOS3;
+    PngOptions png;
+    RenderContext::Backend backend = RenderContext::BACKEND_AUTO;
+
+    int getRenderWidth() const { return width * supersample; }
+    int getRenderHeight() const { return height * supersample; }
+};
+
+struct WorkerResult {
+    int rendered = 0;
+    int failed = 0;
+};
+
+bool parseArguments(int argc, char** argv, BatchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (value == nullptr) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        ++i;
+
+        if (std::strcmp(arg, "--input") == 0) {
+            options.inputPath = value;
+        }
+        else if (std::strcmp(arg, "--out-dir") == 0) {
+            options.outputDir = value;
+        }
+        else if (std::strcmp(arg, "--assets") == 0) {
+            options.assetDir = value;
+        }
+        else if (std::strcmp(arg, "--size") == 0) {
+            if (std::sscanf(value, "%dx%d", &options.width, &options.height) != 2 || options.width <= 0 || options.height <= 0) {
+                std::cerr << "Invalid size " << value << " (expected WIDTHxHEIGHT)" << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--threads") == 0) {
+            options.threads = std::atoi(value);
+            if (options.threads <= 0) {
+                std::cerr << "Invalid thread count " << value << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--serve") == 0) {
+            options.socketPath = value;
+        }
+        else if (std::strcmp(arg, "--max-batch") == 0) {
+            options.maxBatch = std::atoi(value);
+            if (options.maxBatch <= 0) {
+                std::cerr << "Invalid batch size " << value << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--queue") == 0) {
+            options.queueCapacity = std::atoi(value);
+            if (options.queueCapacity <= 0) {
+                std::cerr << "Invalid queue capacity " << value << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--readback-depth") == 0) {
+            options.readbackDepth = std::atoi(value);
+            if (options.readbackDepth <= 0) {
+                std::cerr << "Invalid readback depth " << value << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--format") == 0) {
+            if (std::strcmp(value, "png") != 0 && std::strcmp(value, "qoi") != 0) {
+                std::cerr << "Unknown format " << value << " (expected png or qoi)" << std::endl;
+                return false;
+            }
+            options.qoi = std::strcmp(value, "qoi") == 0;
+        }
+        else if (std::strcmp(arg, "--renderer") == 0) {
+            if (std::strcmp(value, "gl") != 0 && std::strcmp(value, "cpu") != 0 && std::strcmp(value, "composite") != 0) {
+                std::cerr << "Unknown renderer " << value << " (expected gl, cpu or composite)" << std::endl;
+                return false;
+            }
+            options.composite = std::strcmp(value, "composite") == 0;
+            options.software = options.composite || std::strcmp(value, "cpu") == 0;
+        }
+        else if (std::strcmp(arg, "--raster-threads") == 0) {
+            options.rasterThreads = std::atoi(value);
+            if (options.rasterThreads <= 0) {
+                std::cerr << "Invalid raster thread count " << value << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--supersample") == 0) {
+            options.supersample = std::atoi(value);
+            if (options.supersample <= 0 || options.supersample > 8) {
+                std::cerr << "Invalid supersampling factor " << value << " (expected 1-8)" << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--sizes") == 0) {
+            if (!ImagePyramid::parseSizes(value, options.sizes)) {
+                std::cerr << "Invalid size list " << value << " (expected WIDTHxHEIGHT,WIDTHxHEIGHT,...)" << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--filter") == 0) {
+            if (!Resampler::parseFilter(value, options.filter)) {
+                std::cerr << "Unknown filter " << value << " (expected lanczos or mitchell)" << std::endl;
+                return false;
+            }
+            options.filterSet = true;
+        }
+        else if (std::strcmp(arg, "--level") == 0) {
+            options.png.level = std::atoi(value);
+            if (options.png.level < 0 || options.png.level > 9) {
+                std::cerr << "Invalid compression level " << value << " (expected 0-9)" << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--encode-threads") == 0) {
+            options.png.threads = std::atoi(value);
+            if (options.png.threads <= 0) {
+                std::cerr << "Invalid encode thread count " << value << std::endl;
+                return false;
+            }
+        }
+        else if (std::strcmp(arg, "--backend") == 0) {
+            if (!RenderContext::parseBackend(value, options.backend)) {
+                std::cerr << "Unknown backend " << value << " (expected auto, egl or glfw)" << std::endl;
+                return false;
+            }
+        }
+        else {
+            std::cerr << "Unknown argument " << arg << std::endl;
+            return false;
+        }
+    }
+    if (options.inputPath.empty() && options.socketPath.empty()) {
+        std::cerr << "Usage: AvatarBatch --input avatars.json [--out-dir DIR] [--size WxH] [--threads N] [--backend auto|egl|glfw] [--assets DIR]"
+                  << " [--readback-depth K] [--format png|qoi] [--level 0-9] [--encode-threads N] [--renderer gl|cpu|composite] [--raster-threads N]"
+                  << " [--supersample N] [--filter lanczos|mitchell] [--sizes WxH,WxH,...]" << std::endl
+                  << "       AvatarBatch --serve SOCKET [--size WxH] [--threads N] [--max-batch N] [--queue N] [--backend auto|egl|glfw]"
+                  << " [--assets DIR] [--level 0-9]" << std::endl;
+        return false;
+    }
+
+    // The render covers the largest width and height; other sizes are filtered from it
+    if (options.sizes.empty()) {
+        options.sizes.push_back({ options.width, options.height });
+    }
+    else {
+        options.width = 0;
+        options.height = 0;
+        for (const ImagePyramid::Size& size : options.sizes) {
+            options.width = std::max(options.width, size.width);
+            options.height = std::max(options.height, size.height);
+        }
+    }
+    return true;
+}
+
+// Daemon mode: everything stays loaded and requests arrive over the socket
+int serve(const BatchOptions& options) {
+    SlotRegistry slotRegistry;
+    if (!slotRegistry.load("avatar_options.json")) return -1;
+
+    ServerOptions server;
+    server.socketPath = options.socketPath;
+    server.width = options.width;
+    server.height = options.height;
+    server.workers = options.threads > 0 ? options.threads : 1;
+    server.maxBatch = options.maxBatch;
+    server.queueCapacity = options.queueCapacity;
+    server.backend = options.backend;
+    server.png = options.png;
+
+    RenderServer renderServer(server, slotRegistry);
+    return renderServer.run() ? 0 : -1;
+}
+
+// Writes every requested size of one render. Sizes other than the render's (all of them
+// when supersampling) come from one cascade in pyramid; with several sizes the file names
+// get a _WxH suffix.
+bool writeImage(const BatchOptions& options, ImagePyramid& pyramid, const std::string& name,
+                const unsigned char* pixels, int width, int height, ptrdiff_t stride) {
+    pyramid.build(pixels, width, height, stride, options.sizes, options.filter);
+
+    bool written = true;
+    for (const ImagePyramid::Size& size : options.sizes) {
+        const ImagePyramid::Level* level = pyramid.find(size.width, size.height);
+        std::string fileName = name;
+        if (options.sizes.size() > 1) {
+            fileName += "_" + std::to_string(size.width) + "x" + std::to_string(size.height);
+        }
+        std::filesystem::path outputPath = std::filesystem::path(options.outputDir) / (fileName + (options.qoi ? ".qoi" : ".png"));
+        written = (options.qoi
+            ? QoiWriter::write(outputPath.string(), level->pixels, level->width, level->height, level->stride)
+            : PngWriter::write(outputPath.string(), level->pixels, level->width, level->height, level->stride, options.png)) && written;
+    }
+    return written;
+}
+
+// Pulls avatar indices from next until the list is exhausted
+void renderWorker(RenderContext& context, const SlotRegistry& slots, const std::vector<AvatarDescription>& avatars,
+                  std::atomic<size_t>& next, const BatchOptions& options, WorkerResult& result) {
+    if (!context.makeCurrent()) {
+        std::cerr << "Worker could not make its context current" << std::endl;
+        return;
+    }
+
+    {
+        Shader avatarShader("vertex.vert", "fragment.frag");
+        Shader hairShader("hairVertex.vert", "hairFragment.frag");
+        avatarShader.setUniformBlockBinding("AvatarColors", Avatar::COLOR_BLOCK_BINDING);
+
+        // One Avatar per context; its texture cache keeps every item uploaded once per thread
+        Avatar avatar(slots);
+
+        // Encoding runs on the readback thread, straight from the mapped pack buffer.
+        // result and pyramid are only touched there until the queue is destroyed.
+        ImagePyramid pyramid;
+        ReadbackQueue readback;
+        readback.create(options.getRenderWidth(), options.getRenderHeight(), options.readbackDepth, [&](const ReadbackImage& image) {
+            if (writeImage(options, pyramid, avatars[image.id].name, image.pixels, image.width, image.height, image.stride)) {
+                ++result.rendered;
+            }
+            else {
+                ++result.failed;
+            }
+        });
+
+        for (size_t i = next++; i < avatars.size(); i = next++) {
+            avatars[i].applyTo(avatar);
+
+            context.getFramebuffer().bind();
+            glClearColor(0.0f, 0.0f, 0.0f, 0.0f); // Transparent background
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            avatar.draw(avatarShader, hairShader, (float)options.getRenderWidth(), (float)options.getRenderHeight(), 1.0f);
+            avatar.drawSlots(hairShader);
+            readback.submit(context.getFramebuffer().getID(), i);
+            FrameArena::forThread().reset();
+        }
+        readback.destroy();
+    }
+    context.releaseCurrent();
+}
+
+// Same loop without GL: draws on the CPU and encodes on this thread
+void softwareWorker(const SlotRegistry& slots, const std::vector<AvatarDescription>& avatars,
+                    std::atomic<size_t>& next, const BatchOptions& options, WorkerResult& result) {
+    SoftwareRasterizer target;
+    if (!target.create(options.getRenderWidth(), options.getRenderHeight(), options.rasterThreads)) return;
+    SoftwareAvatar avatar(slots);
+    ImagePyramid pyramid;
+
+    for (size_t i = next++; i < avatars.size(); i = next++) {
+        avatars[i].applyTo(avatar);
+
+        target.clear();
+        avatar.draw(target);
+        avatar.drawSlots(target);
+        target.flush();
+        if (writeImage(options, pyramid, avatars[i].name, target.getPixels(), target.getWidth(), target.getHeight(), target.getStride())) {
+            ++result.rendered;
+        }
+        else {
+            ++result.failed;
+        }
+    }
+}
+
+// Thumbnails from layers: the body image and scaled sprites, composed row by row
+void compositeWorker(const SlotRegistry& slots, const std::vector<AvatarDescription>& avatars,
+                     std::atomic<size_t>& next, const BatchOptions& options, WorkerResult& result) {
+    SpriteCompositor target;
+    if (!target.create(options.getRenderWidth(), options.getRenderHeight(), options.rasterThreads)) return;
+    if (options.filterSet) {
+        target.setResampling(options.filter);
+    }
+    SoftwareAvatar avatar(slots);
+    ImagePyramid pyramid;
+
+    for (size_t i = next++; i < avatars.size(); i = next++) {
+        avatars[i].applyTo(avatar);
+
+        target.clear();
+        avatar.addLayers(target);
+        target.flush();
+        if (writeImage(options, pyramid, avatars[i].name, target.getPixels(), target.getWidth(), target.getHeight(), target.getStride())) {
+            ++result.rendered;
+        }
+        else {
+            ++result.failed;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    BatchOptions options;
+    if (!parseArguments(argc, argv, options)) return -1;
+
+    // Shaders and item paths are relative to the asset folder, the input and output to the caller
+    std::error_code error;
+    if (!options.socketPath.empty()) {
+        options.socketPath = std::filesystem::absolute(options.socketPath, error).string();
+        if (!options.assetDir.empty()) {
+            std::filesystem::current_path(options.assetDir, error);
+            if (error) {
+                std::cerr << "Cannot enter asset folder " << options.assetDir << ": " << error.message() << std::endl;
+                return -1;
+            }
+        }
+        return serve(options);
+    }
+    options.inputPath = std::filesystem::absolute(options.inputPath, error).string();
+    options.outputDir = std::filesystem::absolute(options.outputDir, error).string();
+    std::filesystem::create_directories(options.outputDir, error);
+    if (error) {
+        std::cerr << "Cannot create " << options.outputDir << ": " << error.message() << std::endl;
+        return -1;
+    }
+    if (!options.assetDir.empty()) {
+        std::filesystem::current_path(options.assetDir, error);
+        if (error) {
+            std::cerr << "Cannot enter asset folder " << options.assetDir << ": " << error.message() << std::endl;
+            return -1;
+        }
+    }
+
+    SlotRegistry slotRegistry;
+    if (!slotRegistry.load("avatar_options.json")) return -1;
+
+    std::vector<AvatarDescription> avatars;
+    if (!AvatarDescription::loadList(options.inputPath, slotRegistry, avatars)) return -1;
+    if (avatars.empty()) {
+        std::cout << "No avatars in " << options.inputPath << std::endl;
+        return 0;
+    }
+
+    int threadCount = options.threads > 0 ? options.threads : (int)std::max(1u, std::thread::hardware_concurrency());
+    threadCount = std::min(threadCount, (int)avatars.size());
+
+    // Contexts are created on the main thread (GLFW requires it) and handed to the workers
+    std::vector<std::unique_ptr<RenderContext>> contexts;
+    for (int i = 0; i < threadCount && !options.software; ++i) {
+        std::unique_ptr<RenderContext> context(new RenderContext());
+        if (!context->create(options.backend, options.getRenderWidth(), options.getRenderHeight())) break;
+        context->releaseCurrent();
+        contexts.push_back(std::move(context));
+    }
+    if (!options.software && contexts.empty()) {
+        std::cerr << "Failed to create any render context" << std::endl;
+        return -1;
+    }
+    if (!options.software && (int)contexts.size() < threadCount) {
+        std::cerr << "Only " << contexts.size() << " of " << threadCount << " render contexts could be created" << std::endl;
+    }
+    size_t workerCount = options.software ? (size_t)threadCount : contexts.size();
+
+    std::atomic<size_t> next(0);
+    std::vector<WorkerResult> results(workerCount);
+    std::vector<std::thread> workers;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < workerCount; ++i) {
+        if (options.software) {
+            workers.emplace_back(options.composite ? compositeWorker : softwareWorker, std::cref(slotRegistry), std::cref(avatars),
+                                 std::ref(next), std::cref(options), std::ref(results[i]));
+        }
+        else {
+            workers.emplace_back(renderWorker, std::ref(*contexts[i]), std::cref(slotRegistry), std::cref(avatars),
+                                 std::ref(next), std::cref(options), std::ref(results[i]));
+        }
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int rendered = 0;
+    int failed = 0;
+    for (const WorkerResult& result : results) {
+        rendered += result.rendered;
+        failed += result.failed;
+    }
+
+    std::cout << "Rendered " << rendered << " avatars (" << options.width << "x" << options.height;
+    if (options.sizes.size() > 1) {
+        std::cout << ", " << options.sizes.size() << " sizes";
+    }
+    std::cout << ") in "
+              << seconds << " s: " << (seconds > 0.0 ? rendered / seconds : 0.0) << " avatars/s on "
+              << workerCount << " threads (" << (options.composite ? "composite" : options.software ? "cpu" : RenderContext::getBackendName(contexts[0]->getBackend())) << ")" << std::endl;
+    if (failed > 0) {
+        std::cerr << failed << " avatars could not be written" << std::endl;
+    }
+
+    // Contexts are destroyed where they were created
+    for (auto& context : contexts) {
+        context->destroy();
+    }
+    return (failed > 0 || rendered < (int)avatars.size()) ? 1 : 0;
+}
@@ -0,0 +1,429 @@
+#include <GL/glew.h>
+#include "RenderServer.h"
+#include "Avatar.h"
+#include "FrameArena.h"
+#include "Framebuffer.h"
+#include "Json.h"
+#include "ReadbackQueue.h"
+#include "Shader.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <list>
+#include <map>
+#include <thread>
+
+#ifndef _WIN32
+#include <csignal>
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    const uint32_t MAX_REQUEST_BYTES = 64 * 1024;
+
+    enum ResponseStatus {
+        STATUS_OK = 0,
+        STATUS_BAD_REQUEST = 1,
+        STATUS_BUSY = 2,
+        STATUS_RENDER_FAILED = 3
+    };
+
+    RenderResponse makeResponse(unsigned char status, const std::string& message) {
+        RenderResponse response;
+        response.status = status;
+        response.payload.assign(message.begin(), message.end());
+        return response;
+    }
+
+    std::atomic<bool> stopRequested(false);
+}
+
+RequestQueue::RequestQueue(size_t capacity) : capacity(capacity), closed(false) {}
+
+bool RequestQueue::tryPush(const std::shared_ptr<RenderRequest>& request) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed || requests.size() >= capacity) return false;
+        requests.push_back(request);
+    }
+    available.notify_one();
+    return true;
+}
+
+bool RequestQueue::popBatch(size_t maxCount, std::vector<std::shared_ptr<RenderRequest>>& out) {
+    out.clear();
+    std::unique_lock<std::mutex> lock(mutex);
+    available.wait(lock, [this] { return closed || !requests.empty(); });
+    while (!requests.empty() && out.size() < maxCount) {
+        out.push_back(requests.front());
+        requests.pop_front();
+    }
+    return !out.empty();
+}
+
+bool RequestQueue::isEmpty() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return requests.empty();
+}
+
+size_t RequestQueue::getSize() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return requests.size();
+}
+
+void RequestQueue::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+    available.notify_all();
+}
+
+LatencyStats::LatencyStats() : next(0), completed(0), rejected(0) {
+    samples.reserve(WINDOW);
+}
+
+void LatencyStats::record(double milliseconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (samples.size() < WINDOW) {
+        samples.push_back(milliseconds);
+    }
+    else {
+        samples[next] = milliseconds;
+    }
+    next = (next + 1) % WINDOW;
+    ++completed;
+}
+
+void LatencyStats::recordRejected() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++rejected;
+}
+
+std::string LatencyStats::toJson(size_t queueSize) {
+    std::vector<double> sorted;
+    uint64_t completedCount;
+    uint64_t rejectedCount;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sorted = samples;
+        completedCount = completed;
+        rejectedCount = rejected;
+    }
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&sorted](double p) {
+        if (sorted.empty()) return 0.0;
+        return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+    };
+
+    char text[256];
+    std::snprintf(text, sizeof(text),
+                  "{\"completed\": %llu, \"rejected\": %llu, \"queued\": %zu, \"p50_ms\": %.2f, \"p99_ms\": %.2f, \"max_ms\": %.2f}",
+                  (unsigned long long)completedCount, (unsigned long long)rejectedCount, queueSize,
+                  percentile(0.5), percentile(0.99), sorted.empty() ? 0.0 : sorted.back());
+    return text;
+}
+
+RenderServer::RenderServer(const ServerOptions& options, const SlotRegistry& slots)
+    : options(options), slots(slots), queue(options.queueCapacity) {}
+
+// Renders each batch side by side into one atlas: a tile per request, one readback per
+// batch. Encoding and answering happen on the readback thread while the next batch draws.
+void RenderServer::renderWorker(RenderContext& context) {
+    if (!context.makeCurrent()) {
+        std::cerr << "Render worker could not make its context current" << std::endl;
+        return;
+    }
+
+    {
+        Shader avatarShader("vertex.vert", "fragment.frag");
+        Shader hairShader("hairVertex.vert", "hairFragment.frag");
+        avatarShader.setUniformBlockBinding("AvatarColors", Avatar::COLOR_BLOCK_BINDING);
+        Avatar avatar(slots);
+
+        const int atlasWidth = options.width * options.maxBatch;
+        Framebuffer atlas;
+        bool created = atlas.create(atlasWidth, options.height);
+
+        // Requests of each batch in flight, by batch id; shared with the readback thread
+        std::mutex batchMutex;
+        std::map<uint64_t, std::vector<std::shared_ptr<RenderRequest>>> inFlight;
+
+        ReadbackQueue readback;
+        created = created && readback.create(atlasWidth, options.height, 2, [&](const ReadbackImage& image) {
+            std::vector<std::shared_ptr<RenderRequest>> batch;
+            {
+                std::lock_guard<std::mutex> lock(batchMutex);
+                auto found = inFlight.find(image.id);
+                batch.swap(found->second);
+                inFlight.erase(found);
+            }
+            for (size_t i = 0; i < batch.size(); ++i) {
+                RenderResponse response;
+                response.status = STATUS_OK;
+                const unsigned char* tile = image.pixels + i * options.width * 4;
+                PngWriter::encode(tile, options.width, options.height, image.stride, options.png, response.payload);
+                stats.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - batch[i]->received).count());
+                batch[i]->response.set_value(std::move(response));
+            }
+        });
+
+        std::vector<std::shared_ptr<RenderRequest>> batch;
+        uint64_t batchId = 0;
+        if (!created) {
+            // Keep answering so clients are not left waiting on a worker that cannot render
+            std::cerr << "Cannot create a " << atlasWidth << "x" << options.height << " batch target" << std::endl;
+            while (queue.popBatch(options.maxBatch, batch)) {
+                for (auto& request : batch) {
+                    request->response.set_value(makeResponse(STATUS_RENDER_FAILED, "render target unavailable"));
+                }
+            }
+        }
+        while (created && queue.popBatch(options.maxBatch, batch)) {
+            atlas.bind();
+            glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            for (size_t i = 0; i < batch.size(); ++i) {
+                glViewport((GLint)i * options.width, 0, options.width, options.height);
+                batch[i]->description.applyTo(avatar);
+                avatar.draw(avatarShader, hairShader, (float)options.width, (float)options.height, 1.0f);
+                avatar.drawSlots(hairShader);
+            }
+            {
+                std::lock_guard<std::mutex> lock(batchMutex);
+                inFlight[batchId].swap(batch);
+            }
+            readback.submit(atlas.getID(), batchId++);
+            FrameArena::forThread().reset();
+
+            // Nothing waiting: finish the batch now instead of holding it for the next one
+            if (queue.isEmpty()) {
+                readback.flush();
+            }
+            else {
+                readback.poll();
+            }
+        }
+        readback.destroy();
+        atlas.destroy();
+    }
+    context.releaseCurrent();
+}
+
+RenderResponse RenderServer::handleRequest(const std::string& body) {
+    JsonValue request;
+    std::string error;
+    if (!JsonValue::parse(body, request, error)) {
+        return makeResponse(STATUS_BAD_REQUEST, error);
+    }
+    if (!request.isObject()) {
+        return makeResponse(STATUS_BAD_REQUEST, "request must be an object");
+    }
+    const JsonValue* wantStats = request.find("stats");
+    if (wantStats != nullptr && wantStats->asBool()) {
+        return makeResponse(STATUS_OK, stats.toJson(queue.getSize()));
+    }
+
+    std::shared_ptr<RenderRequest> render(new RenderRequest());
+    render->received = std::chrono::steady_clock::now();
+    if (!AvatarDescription::fromJson(request, slots, "avatar", render->description, error)) {
+        return makeResponse(STATUS_BAD_REQUEST, error);
+    }
+
+    std::future<RenderResponse> response = render->response.get_future();
+    if (!queue.tryPush(render)) {
+        stats.recordRejected();
+        return makeResponse(STATUS_BUSY, "queue full");
+    }
+    return response.get();
+}
+
+#ifndef _WIN32
+
+namespace {
+    void onStopSignal(int) {
+        stopRequested = true;
+    }
+
+    bool readFully(int socket, void* data, size_t size) {
+        unsigned char* bytes = (unsigned char*)data;
+        while (size > 0) {
+            ssize_t count = recv(socket, bytes, size, 0);
+            if (count < 0 && errno == EINTR) continue;
+            if (count <= 0) return false;
+            bytes += count;
+            size -= (size_t)count;
+        }
+        return true;
+    }
+
+    bool writeFully(int socket, const void* data, size_t size) {
+        const unsigned char* bytes = (const unsigned char*)data;
+        while (size > 0) {
+            ssize_t count = send(socket, bytes, size, MSG_NOSIGNAL);
+            if (count < 0 && errno == EINTR) continue;
+            if (count <= 0) return false;
+            bytes += count;
+            size -= (size_t)count;
+        }
+        return true;
+    }
+
+    bool writeResponse(int socket, const RenderResponse& response) {
+        uint32_t length = (uint32_t)response.payload.size();
+        unsigned char header[5] = { response.status, (unsigned char)(length >> 24), (unsigned char)(length >> 16),
+                                    (unsigned char)(length >> 8), (unsigned char)length };
+        return writeFully(socket, header, sizeof(header)) && writeFully(socket, response.payload.data(), response.payload.size());
+    }
+}
+
+void RenderServer::handleConnection(int socket) {
+    for (;;) {
+        unsigned char header[4];
+        if (!readFully(socket, header, sizeof(header))) break;
+        uint32_t length = ((uint32_t)header[0] << 24) | ((uint32_t)header[1] << 16) | ((uint32_t)header[2] << 8) | header[3];
+        if (length > MAX_REQUEST_BYTES) {
+            // The stream cannot be resynchronized, answer and drop the connection
+            writeResponse(socket, makeResponse(STATUS_BAD_REQUEST, "request too large"));
+            break;
+        }
+
+        std::string body(length, '\0');
+        if (!readFully(socket, &body[0], length)) break;
+        if (!writeResponse(socket, handleRequest(body))) break;
+    }
+}
+
+bool RenderServer::run() {
+    if (options.socketPath.size() >= sizeof(sockaddr_un::sun_path)) {
+        std::cerr << "Socket path too long: " << options.socketPath << std::endl;
+        return false;
+    }
+
+    // Contexts are created on the main thread (GLFW requires it) and handed to the workers
+    std::vector<std::unique_ptr<RenderContext>> contexts;
+    for (int i = 0; i < options.workers; ++i) {
+        std::unique_ptr<RenderContext> context(new RenderContext());
+        if (!context->create(options.backend, options.width, options.height)) break;
+        context->releaseCurrent();
+        contexts.push_back(std::move(context));
+    }
+    if (contexts.empty()) {
+        std::cerr << "Failed to create any render context" << std::endl;
+        return false;
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    std::copy(options.socketPath.begin(), options.socketPath.end(), address.sun_path);
+    unlink(options.socketPath.c_str()); // Left behind by a previous run
+    if (listener < 0 || bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 128) != 0) {
+        std::perror(("Cannot listen on " + options.socketPath).c_str());
+        if (listener >= 0) close(listener);
+        for (auto& context : contexts) {
+            context->destroy();
+        }
+        return false;
+    }
+
+    stopRequested = false;
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::vector<std::thread> workers;
+    for (auto& context : contexts) {
+        workers.emplace_back(&RenderServer::renderWorker, this, std::ref(*context));
+    }
+    std::cout << "Serving " << options.width << "x" << options.height << " avatars on " << options.socketPath << " ("
+              << contexts.size() << " render threads, " << RenderContext::getBackendName(contexts[0]->getBackend()) << ")" << std::endl;
+
+    // One thread per connection; a connection blocks on its own request, so clients
+    // get concurrency by opening several
+    struct Connection {
+        int socket;
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> done;
+    };
+    std::list<Connection> connections;
+    auto lastReport = std::chrono::steady_clock::now();
+
+    while (!stopRequested) {
+        pollfd waiting = { listener, POLLIN, 0 };
+        int ready = poll(&waiting, 1, 200);
+
+        for (auto it = connections.begin(); it != connections.end();) {
+            if (*it->done) {
+                it->thread.join();
+                close(it->socket);
+                it = connections.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastReport > std::chrono::seconds(10)) {
+            std::cout << stats.toJson(queue.getSize()) << std::endl;
+            lastReport = now;
+        }
+
+        if (ready <= 0) continue;
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0) continue;
+        if ((int)connections.size() >= options.maxConnections) {
+            writeResponse(client, makeResponse(STATUS_BUSY, "too many connections"));
+            close(client);
+            continue;
+        }
+
+        Connection connection;
+        connection.socket = client;
+        connection.done = std::make_shared<std::atomic<bool>>(false);
+        std::shared_ptr<std::atomic<bool>> done = connection.done;
+        connection.thread = std::thread([this, client, done] {
+            handleConnection(client);
+            *done = true;
+        });
+        connections.push_back(std::move(connection));
+    }
+
+    std::cout << "Shutting down" << std::endl;
+    close(listener);
+    unlink(options.socketPath.c_str());
+
+    // Queued requests are still rendered and answered before the connections are cut
+    queue.close();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    for (Connection& connection : connections) {
+        shutdown(connection.socket, SHUT_RDWR);
+        connection.thread.join();
+        close(connection.socket);
+    }
+    std::cout << stats.toJson(0) << std::endl;
+
+    for (auto& context : contexts) {
+        context->destroy();
+    }
+    return true;
+}
+
+#else
+
+void RenderServer::handleConnection(int) {}
+
+bool RenderServer::run() {
+    std::cerr << "The render server needs Unix domain sockets and is not available on this platform" << std::endl;
+    return false;
+}
+
+#endif
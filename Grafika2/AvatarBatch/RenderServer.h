@@ -0,0 +1,108 @@
+#ifndef RENDER_SERVER_H
+#define RENDER_SERVER_H
+
+#include "AvatarDescription.h"
+#include "PngWriter.h"
+#include "RenderContext.h"
+#include "SlotRegistry.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Long-running render service on a Unix domain socket. Contexts, shader programs, textures
+// and geometry stay warm between requests; concurrent requests are coalesced into one GPU
+// pass over a tile atlas with a single readback.
+//
+// Protocol, one request at a time per connection (open several connections for concurrency):
+//   request:  uint32 length (big-endian) + JSON, either one avatar description in the
+//             AvatarBatch input format or {"stats": true}
+//   response: uint8 status + uint32 length (big-endian) + payload
+//             0 = PNG bytes (stats: JSON text), 1 = malformed request,
+//             2 = busy, queue full (retry later), 3 = render failed
+struct ServerOptions {
+    std::string socketPath;
+    int width = 256;
+    int height = 320;
+    int workers = 1;            // Render threads, each with its own context
+    int maxBatch = 8;           // Avatars per GPU pass
+    int queueCapacity = 256;    // Queued requests before new ones are refused
+    int maxConnections = 128;
+    RenderContext::Backend backend = RenderContext::BACKEND_AUTO;
+    PngOptions png;
+};
+
+struct RenderResponse {
+    unsigned char status;
+    std::vector<unsigned char> payload;
+};
+
+struct RenderRequest {
+    AvatarDescription description;
+    std::chrono::steady_clock::time_point received;
+    std::promise<RenderResponse> response;
+};
+
+// Bounded FIFO shared by the connection threads (producers) and render workers (consumers)
+class RequestQueue {
+public:
+    RequestQueue(size_t capacity);
+
+    // Refuses instead of blocking when full, so callers can answer "busy" right away
+    bool tryPush(const std::shared_ptr<RenderRequest>& request);
+    // Waits for at least one request, then takes up to maxCount; false once closed and drained
+    bool popBatch(size_t maxCount, std::vector<std::shared_ptr<RenderRequest>>& out);
+    bool isEmpty();
+    size_t getSize();
+    void close();
+
+private:
+    size_t capacity;
+    std::deque<std::shared_ptr<RenderRequest>> requests;
+    std::mutex mutex;
+    std::condition_variable available;
+    bool closed;
+};
+
+// Per-request latency (receipt to response ready) over a sliding window
+class LatencyStats {
+public:
+    LatencyStats();
+
+    void record(double milliseconds);
+    void recordRejected();
+    std::string toJson(size_t queueSize);
+
+private:
+    static const size_t WINDOW = 8192;
+    std::mutex mutex;
+    std::vector<double> samples;
+    size_t next;
+    uint64_t completed;
+    uint64_t rejected;
+};
+
+class RenderServer {
+public:
+    RenderServer(const ServerOptions& options, const SlotRegistry& slots);
+
+    // Serves until SIGINT or SIGTERM. Returns false if the socket or contexts cannot be set up.
+    bool run();
+
+private:
+    void renderWorker(RenderContext& context);
+    void handleConnection(int socket);
+    RenderResponse handleRequest(const std::string& body);
+
+    const ServerOptions& options;
+    const SlotRegistry& slots;
+    RequestQueue queue;
+    LatencyStats stats;
+};
+
+#endif
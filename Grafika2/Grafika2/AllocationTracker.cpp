@@ -0,0 +1,70 @@
+#include "AllocationTracker.h"
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#ifdef AVATAR_TRACK_ALLOCATIONS
+
+namespace {
+    // Per-thread so render threads never contend on a shared counter
+    thread_local long long threadAllocations = 0;
+}
+
+void* operator new(std::size_t size) {
+    ++threadAllocations;
+    if (size == 0) size = 1;
+    if (void* ptr = std::malloc(size)) return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+long long AllocationTracker::getThreadAllocationCount() {
+    return threadAllocations;
+}
+
+#else
+
+long long AllocationTracker::getThreadAllocationCount() {
+    return 0;
+}
+
+#endif
+
+AllocationTracker::AllocationTracker(int warmupFrames)
+    : warmupFrames(warmupFrames), frameIndex(0), frameStartCount(0) {
+}
+
+void AllocationTracker::beginFrame() {
+    frameStartCount = getThreadAllocationCount();
+}
+
+void AllocationTracker::endFrame() {
+#ifdef AVATAR_TRACK_ALLOCATIONS
+    long long allocations = getThreadAllocationCount() - frameStartCount;
+    if (frameIndex >= warmupFrames && allocations != 0) {
+        std::cerr << "Frame " << frameIndex << " made " << allocations << " heap allocations" << std::endl;
+        assert(allocations == 0 && "heap allocation in frame after warm-up");
+    }
+#endif
+    ++frameIndex;
+}
@@ -0,0 +1,22 @@
+#ifndef ALLOCATION_TRACKER_H
+#define ALLOCATION_TRACKER_H
+
+// Counts global operator new calls made by the current thread between beginFrame() and
+// endFrame(), and asserts that none happen once the warm-up frames are over.
+// Only active when AVATAR_TRACK_ALLOCATIONS is defined (Debug configurations).
+class AllocationTracker {
+public:
+    explicit AllocationTracker(int warmupFrames);
+
+    void beginFrame();
+    void endFrame();
+
+    static long long getThreadAllocationCount();
+
+private:
+    int warmupFrames;
+    int frameIndex;
+    long long frameStartCount;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#include "AlphaMask.h"
+#include <algorithm>
+
+AlphaMask::AlphaMask() : width(0), height(0), wordsPerRow(0) {
+}
+
+void AlphaMask::build(const unsigned char* pixels, int imageWidth, int imageHeight, int channels, int maxSize, unsigned char threshold) {
+    const int block = std::max(1, (std::max(imageWidth, imageHeight) + maxSize - 1) / maxSize);
+    width = (imageWidth + block - 1) / block;
+    height = (imageHeight + block - 1) / block;
+    wordsPerRow = (width + 63) / 64;
+    bits.assign((size_t)wordsPerRow * height, 0);
+    if (channels != 4 && channels != 2) {
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                bits[(size_t)y * wordsPerRow + x / 64] |= 1ull << (x % 64);
+            }
+        }
+        return;
+    }
+
+    // Opaque texels counted per mask column, one band of block rows at a time
+    std::vector<int> counts(width);
+    for (int y = 0; y < height; ++y) {
+        std::fill(counts.begin(), counts.end(), 0);
+        const int rowEnd = std::min(imageHeight, (y + 1) * block);
+        for (int row = y * block; row < rowEnd; ++row) {
+            const unsigned char* alpha = pixels + ((size_t)row * imageWidth) * channels + channels - 1;
+            for (int x = 0; x < imageWidth; ++x) {
+                if (alpha[(size_t)x * channels] >= threshold) ++counts[x / block];
+            }
+        }
+        for (int x = 0; x < width; ++x) {
+            // Blocks on the right and top edges may be partial
+            const int texels = (std::min(imageWidth, (x + 1) * block) - x * block) * (rowEnd - y * block);
+            if (counts[x] * 2 >= texels) bits[(size_t)y * wordsPerRow + x / 64] |= 1ull << (x % 64);
+        }
+    }
+}
+
+bool AlphaMask::test(float u, float v) const {
+    if (bits.empty() || !(u >= 0.0f && u < 1.0f && v >= 0.0f && v < 1.0f)) return false;
+    const int x = std::min(width - 1, (int)(u * width));
+    const int y = std::min(height - 1, (int)(v * height));
+    return (bits[(size_t)y * wordsPerRow + x / 64] >> (x % 64)) & 1;
+}
+
+int AlphaMask::getWidth() const {
+    return width;
+}
+
+int AlphaMask::getHeight() const {
+    return height;
+}
+
+size_t AlphaMask::getBytes() const {
+    return bits.size() * sizeof(uint64_t);
+}
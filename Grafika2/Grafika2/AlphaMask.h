@@ -0,0 +1,34 @@
+#ifndef ALPHA_MASK_H
+#define ALPHA_MASK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Where an image is opaque, one bit per texel at reduced resolution, for hit testing without
+// reading anything back from the GPU. Each mask texel covers a square block of image texels
+// and is set when at least half of them are opaque enough. Rows are packed into 64-bit words
+// and run bottom-up like DecodedImage, so texture coordinates index the mask directly.
+class AlphaMask {
+public:
+    AlphaMask();
+
+    // Images without an alpha channel are opaque everywhere. Blocks are chosen so neither side
+    // of the mask exceeds maxSize.
+    void build(const unsigned char* pixels, int width, int height, int channels, int maxSize = 128, unsigned char threshold = 128);
+
+    // Texture coordinates (0..1, v upwards); false outside the image
+    bool test(float u, float v) const;
+
+    int getWidth() const;
+    int getHeight() const;
+    size_t getBytes() const;
+
+private:
+    int width;
+    int height;
+    int wordsPerRow;
+    std::vector<uint64_t> bits;
+};
+
+#endif
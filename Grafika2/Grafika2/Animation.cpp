@@ -0,0 +1,284 @@
+#include "Animation.h"
+#include "Scene.h"
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ANIMATION_SSE2
+#include <emmintrin.h>
+#endif
+
+static const float NEVER = std::numeric_limits<float>::infinity();
+
+Animation::Animation(Scene& scene, double stepSeconds)
+    : scene(scene), stepSeconds(stepSeconds), stepCount(0), accumulator(0.0), laneCount(0), stride(0), nextSwap(0) {
+    std::fill(keyedLanes, keyedLanes + CHANNEL_COUNT, 0);
+}
+
+void Animation::clear() {
+    stepCount = 0;
+    accumulator = 0.0;
+    laneCount = 0;
+    stride = 0;
+    segmentStart.clear();
+    segmentEnd.clear();
+    segmentBase.clear();
+    segmentSlope.clear();
+    previous.clear();
+    current.clear();
+    output.clear();
+    channelMasks.clear();
+    std::fill(keyedLanes, keyedLanes + CHANNEL_COUNT, 0);
+    tracks.clear();
+    laneAvatars.clear();
+    avatarLanes.clear();
+    swaps.clear();
+    nextSwap = 0;
+}
+
+int Animation::getLane(int avatar) {
+    if ((int)avatarLanes.size() <= avatar) avatarLanes.resize(avatar + 1, -1);
+    if (avatarLanes[avatar] >= 0) return avatarLanes[avatar];
+
+    if (laneCount == stride) {
+        // Rows are widened together; spare lanes hold a segment that never ends, so a step
+        // never stops at them
+        const int wider = std::max(4, stride * 2);
+        auto widen = [&](std::vector<float>& rows, float spare) {
+            std::vector<float> widened((size_t)CHANNEL_COUNT * wider, spare);
+            for (int channel = 0; channel < CHANNEL_COUNT; ++channel) {
+                std::copy(rows.begin() + (size_t)channel * stride, rows.begin() + (size_t)channel * stride + laneCount,
+                          widened.begin() + (size_t)channel * wider);
+            }
+            rows.swap(widened);
+        };
+        widen(segmentStart, 0.0f);
+        widen(segmentEnd, NEVER);
+        widen(segmentBase, 0.0f);
+        widen(segmentSlope, 0.0f);
+        widen(previous, 0.0f);
+        widen(current, 0.0f);
+        widen(output, 0.0f);
+        stride = wider;
+    }
+    const int lane = laneCount++;
+    laneAvatars.push_back(avatar);
+    channelMasks.push_back(0);
+    tracks.resize((size_t)laneCount * CHANNEL_COUNT);
+    avatarLanes[avatar] = lane;
+    return lane;
+}
+
+void Animation::seek(int lane, int channel, float time) {
+    const std::vector<Key>& keys = tracks[(size_t)lane * CHANNEL_COUNT + channel];
+    const size_t index = (size_t)channel * stride + lane;
+    auto next = std::upper_bound(keys.begin(), keys.end(), time, [](float t, const Key& key) { return t < key.time; });
+    if (next == keys.begin()) {
+        // Held at the first key until the clock gets there
+        segmentStart[index] = next->time;
+        segmentEnd[index] = next->time;
+        segmentBase[index] = next->value;
+        segmentSlope[index] = 0.0f;
+        return;
+    }
+    const Key& from = *(next - 1);
+    segmentStart[index] = from.time;
+    segmentBase[index] = from.value;
+    if (next == keys.end()) {
+        segmentEnd[index] = NEVER;
+        segmentSlope[index] = 0.0f;
+    }
+    else {
+        segmentEnd[index] = next->time;
+        segmentSlope[index] = (next->value - from.value) / (next->time - from.time);
+    }
+}
+
+float Animation::sample(int lane, int channel, float time) const {
+    // As step(): the time into the segment, clamped to it
+    const size_t index = (size_t)channel * stride + lane;
+    const float start = segmentStart[index];
+    const float into = std::min(std::max(time - start, 0.0f), segmentEnd[index] - start);
+    return segmentBase[index] + into * segmentSlope[index];
+}
+
+void Animation::addKey(int avatar, int channel, double time, float value) {
+    if (avatar < 0 || avatar >= scene.getAvatarCount() || channel < 0 || channel >= CHANNEL_COUNT) {
+        std::cerr << "Animation: no channel " << channel << " of avatar " << avatar << std::endl;
+        return;
+    }
+    const int lane = getLane(avatar);
+    std::vector<Key>& keys = tracks[(size_t)lane * CHANNEL_COUNT + channel];
+    const Key key = { (float)time, value };
+    auto at = std::lower_bound(keys.begin(), keys.end(), key.time, [](const Key& k, float t) { return k.time < t; });
+    if (at != keys.end() && at->time == key.time) *at = key;
+    else keys.insert(at, key);
+    if ((channelMasks[lane] & (1u << channel)) == 0) {
+        channelMasks[lane] |= 1u << channel;
+        ++keyedLanes[channel];
+    }
+
+    // The new key counts from now on, without easing in from the old value
+    const float now = (float)getTime();
+    seek(lane, channel, now);
+    const size_t index = (size_t)channel * stride + lane;
+    current[index] = sample(lane, channel, now);
+    previous[index] = current[index];
+}
+
+void Animation::addColorKey(int avatar, Avatar::AvatarColor color, double time, float r, float g, float b) {
+    const int first = CHANNEL_FIRST_COLOR + color * 3;
+    addKey(avatar, first, time, r);
+    addKey(avatar, first + 1, time, g);
+    addKey(avatar, first + 2, time, b);
+}
+
+void Animation::addSlotSwap(int avatar, int slot, double time, GLuint texture) {
+    if (avatar < 0 || avatar >= scene.getAvatarCount() || slot < 0 || slot >= scene.getSlots().getSlotCount()) {
+        std::cerr << "Animation: no slot " << slot << " on avatar " << avatar << std::endl;
+        return;
+    }
+    // Swaps already passed are behind nextSwap; one added for an earlier time happens next
+    const SlotSwap swap = { (float)time, avatar, slot, texture };
+    auto at = std::upper_bound(swaps.begin() + nextSwap, swaps.end(), swap.time,
+                               [](float t, const SlotSwap& s) { return t < s.time; });
+    swaps.insert(at, swap);
+}
+
+int Animation::update(double seconds) {
+    accumulator += seconds;
+    int steps = 0;
+    while (accumulator >= stepSeconds) {
+        if (steps == MAX_STEPS) {
+            accumulator = 0.0;
+            break;
+        }
+        step();
+        accumulator -= stepSeconds;
+        ++steps;
+    }
+    return steps;
+}
+
+void Animation::step() {
+    ++stepCount;
+    const float time = (float)getTime();
+    for (; nextSwap < swaps.size() && swaps[nextSwap].time <= time; ++nextSwap) {
+        const SlotSwap& swap = swaps[nextSwap];
+        SceneAvatar& avatar = scene.getAvatar(swap.avatar);
+        if (swap.texture != 0) avatar.applySlot(swap.slot, swap.texture);
+        else avatar.clearSlot(swap.slot);
+    }
+    if (laneCount == 0) return;
+
+    // Rows are only filled up to the lanes in use, and rows of channels nobody keys stay 0
+    previous.swap(current);
+    const int lanes = (laneCount + 3) & ~3;
+#ifdef ANIMATION_SSE2
+    const __m128 now = _mm_set1_ps(time);
+    const __m128 zero = _mm_setzero_ps();
+#endif
+    for (int channel = 0; channel < CHANNEL_COUNT; ++channel) {
+        if (keyedLanes[channel] == 0) continue;
+        const size_t row = (size_t)channel * stride;
+        const float* start = &segmentStart[row];
+        const float* end = &segmentEnd[row];
+        const float* base = &segmentBase[row];
+        const float* slope = &segmentSlope[row];
+        float* value = &current[row];
+        for (int lane = 0; lane < lanes; lane += 4) {
+            // value = base + slope * (time - start), the time clamped to the segment
+#ifdef ANIMATION_SSE2
+            const __m128 s = _mm_loadu_ps(start + lane);
+            const __m128 e = _mm_loadu_ps(end + lane);
+            const __m128 into = _mm_min_ps(_mm_max_ps(_mm_sub_ps(now, s), zero), _mm_sub_ps(e, s));
+            _mm_storeu_ps(value + lane, _mm_add_ps(_mm_loadu_ps(base + lane), _mm_mul_ps(into, _mm_loadu_ps(slope + lane))));
+            int expired = _mm_movemask_ps(_mm_cmpge_ps(now, e));
+#else
+            int expired = 0;
+            for (int i = 0; i < 4; ++i) {
+                const float into = std::min(std::max(time - start[lane + i], 0.0f), end[lane + i] - start[lane + i]);
+                value[lane + i] = base[lane + i] + into * slope[lane + i];
+                if (time >= end[lane + i]) expired |= 1 << i;
+            }
+#endif
+            // Lanes past their segment's end move on to the next one
+            for (int i = 0; expired != 0; ++i, expired >>= 1) {
+                if ((expired & 1) == 0) continue;
+                seek(lane + i, channel, time);
+                value[lane + i] = sample(lane + i, channel, time);
+            }
+        }
+    }
+}
+
+void Animation::apply() {
+    if (laneCount == 0) return;
+
+    // Between the last two steps, a row at a time
+    const float alpha = getAlpha();
+    const int lanes = (laneCount + 3) & ~3;
+#ifdef ANIMATION_SSE2
+    const __m128 weight = _mm_set1_ps(alpha);
+#endif
+    for (int channel = 0; channel < CHANNEL_COUNT; ++channel) {
+        if (keyedLanes[channel] == 0) continue;
+        const float* from = &previous[(size_t)channel * stride];
+        const float* to = &current[(size_t)channel * stride];
+        float* value = &output[(size_t)channel * stride];
+#ifdef ANIMATION_SSE2
+        for (int lane = 0; lane < lanes; lane += 4) {
+            const __m128 f = _mm_loadu_ps(from + lane);
+            _mm_storeu_ps(value + lane, _mm_add_ps(f, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(to + lane), f), weight)));
+        }
+#else
+        for (int lane = 0; lane < lanes; ++lane) {
+            value[lane] = from[lane] + (to[lane] - from[lane]) * alpha;
+        }
+#endif
+    }
+
+    const uint32_t poseChannels = (1u << CHANNEL_FIRST_COLOR) - 1;
+    for (int lane = 0; lane < laneCount; ++lane) {
+        SceneAvatar& avatar = scene.getAvatar(laneAvatars[lane]);
+        const uint32_t mask = channelMasks[lane];
+        if ((mask & poseChannels) != 0) {
+            // Channels follow the joints' order
+            float pose[AvatarGeometry::JOINT_COUNT];
+            bool changed = false;
+            for (int joint = 0; joint < AvatarGeometry::JOINT_COUNT; ++joint) {
+                pose[joint] = (mask & (1u << joint)) != 0 ? output[(size_t)joint * stride + lane] : avatar.pose[joint];
+                changed = changed || pose[joint] != avatar.pose[joint];
+            }
+            if (changed) {
+                avatar.setPose(pose[AvatarGeometry::JOINT_LEFT_ARM], pose[AvatarGeometry::JOINT_RIGHT_ARM],
+                               pose[AvatarGeometry::JOINT_HEAD]);
+            }
+        }
+        for (int color = 0; color < Avatar::COLOR_COUNT; ++color) {
+            const int first = CHANNEL_FIRST_COLOR + color * 3;
+            if ((mask & (7u << first)) == 0) continue;
+            float rgb[3];
+            bool changed = false;
+            for (int component = 0; component < 3; ++component) {
+                const int channel = first + component;
+                rgb[component] = (mask & (1u << channel)) != 0 ? output[(size_t)channel * stride + lane] : avatar.colors[color][component];
+                changed = changed || rgb[component] != avatar.colors[color][component];
+            }
+            if (changed) avatar.setColor((Avatar::AvatarColor)color, rgb[0], rgb[1], rgb[2]);
+        }
+    }
+}
+
+double Animation::getTime() const {
+    return stepCount * stepSeconds;
+}
+
+float Animation::getAlpha() const {
+    return (float)(accumulator / stepSeconds);
+}
+
+int Animation::getAnimatedCount() const {
+    return laneCount;
+}
@@ -0,0 +1,102 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include "Avatar.h"
+#include <GL/glew.h>
+#include <cstdint>
+#include <vector>
+
+class Scene;
+
+// Keyframed motion for the avatars of a Scene. Each animated avatar has channels (its joint
+// angles and the components of its palette), each a list of keys interpolated linearly, and
+// slot swaps that happen at given times. The clock runs in fixed steps: update() takes the
+// wall time that passed and takes as many steps as it covers, and apply() writes the state
+// between the last two steps to the scene, so motion is smooth at any frame rate and the
+// same at every one.
+// Channels are kept as structure of arrays: a row per channel with a lane per animated
+// avatar, each lane holding the segment between the two keys around the clock as a start,
+// end, base value and slope. A step evaluates the rows of channels that have keys four
+// lanes at a time (SSE2 where available) and only goes back to the keys of a lane whose
+// segment has run out.
+// Scene::clear() invalidates the animation; clear() it too.
+class Animation {
+public:
+    enum Channel {
+        CHANNEL_LEFT_ARM,       // Joint angles as in SceneAvatar::setPose
+        CHANNEL_RIGHT_ARM,
+        CHANNEL_HEAD_TILT,
+        CHANNEL_FIRST_COLOR,    // Followed by red, green and blue of each Avatar::AvatarColor
+        CHANNEL_COUNT = CHANNEL_FIRST_COLOR + Avatar::COLOR_COUNT * 3
+    };
+    // Steps one update() takes at most; the rest of a longer stall is dropped, so the
+    // animation pauses instead of hurrying to catch up
+    static const int MAX_STEPS = 8;
+
+    Animation(Scene& scene, double stepSeconds = 1.0 / 60.0);
+
+    // channel takes value at time (seconds on the animation's clock); a key at the time of
+    // another replaces it. Before its first key a channel holds that key's value, after its
+    // last the last one's. Channels without keys are left as the scene has them.
+    void addKey(int avatar, int channel, double time, float value);
+    void addColorKey(int avatar, Avatar::AvatarColor color, double time, float r, float g, float b);
+    // Puts texture in slot at time, 0 clearing the slot, as SceneAvatar::applySlot and
+    // clearSlot. Swaps are not interpolated: one happens on the first step at or past time.
+    void addSlotSwap(int avatar, int slot, double time, GLuint texture);
+    // Forgets every key and swap and sets the clock back to 0
+    void clear();
+
+    // Advances the clock by seconds of wall time; returns the steps taken
+    int update(double seconds);
+    // Writes the channels, interpolated between the last two steps, to the scene; values that
+    // did not change are not written
+    void apply();
+
+    double getTime() const;     // Of the last step
+    // How far the wall time is from the last step towards the next, in [0, 1)
+    float getAlpha() const;
+    int getAnimatedCount() const;
+
+private:
+    struct Key {
+        float time;
+        float value;
+    };
+
+    struct SlotSwap {
+        float time;
+        int avatar;
+        int slot;
+        GLuint texture;
+    };
+
+    int getLane(int avatar);
+    // Points the lane's segment of channel at the keys around time
+    void seek(int lane, int channel, float time);
+    float sample(int lane, int channel, float time) const;
+    void step();
+
+    Scene& scene;
+    double stepSeconds;
+    int64_t stepCount;
+    double accumulator;         // Wall time past the last step
+
+    // Rows of stride floats per channel; stride is a multiple of 4, doubled when lanes run out
+    int laneCount;
+    int stride;
+    std::vector<float> segmentStart, segmentEnd, segmentBase, segmentSlope;
+    std::vector<float> previous, current, output;
+    std::vector<uint32_t> channelMasks;     // Per lane, the channels that have keys
+    int keyedLanes[CHANNEL_COUNT];          // Per channel, the lanes that have keys
+    std::vector<std::vector<Key>> tracks;   // Per lane and channel, sorted by time
+    std::vector<int> laneAvatars;
+    std::vector<int> avatarLanes;           // -1 for avatars without keys
+
+    std::vector<SlotSwap> swaps;            // Sorted by time
+    size_t nextSwap;
+
+    Animation(const Animation&) = delete;
+    Animation& operator=(const Animation&) = delete;
+};
+
+#endif
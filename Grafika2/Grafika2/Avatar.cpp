@@ -1,54 +1,98 @@
 #include "Avatar.h"
 #include <GL/glew.h>
+#include <algorithm>
 #include <cmath>
 #include <iostream>
-#include "stb_image.h"
+#include <vector>
+#include "ImageStore.h"
+#include "AvatarGeometry.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
-Avatar::Avatar() {
+Avatar::Avatar(const SlotRegistry& slots) : slots(slots), headLevel(0) {
+    setupGeometry();
+
+    glGenBuffers(1, &colorBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, colorBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, COLOR_COUNT * 4 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // Per avatar rather than static: texture names belong to the GL context the avatar lives in
+    leftHandTexture = loadTextureCached("hands/leva.png");
+    rightHandTexture = loadTextureCached("hands/desna.png");
+
+    resetToDefaults();
+}
+
+void Avatar::resetToDefaults() {
     // Default values
-    skinColor[0] = 1.0f; skinColor[1] = 0.8f; skinColor[2] = 0.6f; // Skin color
-    eyeColor[0] = 0.0f; eyeColor[1] = 0.0f; eyeColor[2] = 0.0f;    // Eye color
-    hairColor[0] = 0.0f; hairColor[1] = 0.0f; hairColor[2] = 0.0f; // Hair color
+    for (int color = 0; color < COLOR_COUNT; ++color) {
+        setColor((AvatarColor)color, DEFAULT_COLORS[color][0], DEFAULT_COLORS[color][1], DEFAULT_COLORS[color][2]);
+    }
     hairStyle = "Short";
     outfitStyle = "Casual";
-    outfitColor[0] = 0.0f; outfitColor[1] = 0.0f; outfitColor[2] = 1.0f; // Outfit color
-    mouthTexture = 0;
-    noseTexture = 0;
-    eyeTexture = 0;
-    dressTexture = 0;
-    tshirtTexture = 0;
-    pantsTexture = 0;
+
+    occupiedSlots = 0;
+    for (int i = 0; i < SlotRegistry::MAX_SLOTS; ++i) {
+        slotTextures[i] = 0;
+    }
+
+    for (int slot = 0; slot < slots.getSlotCount(); ++slot) {
+        const std::string& defaultItem = slots.getSlot(slot).defaultItem;
+        if (!defaultItem.empty()) {
+            applySlot(slot, loadTextureCached(defaultItem));
+        }
+    }
+}
+
+Avatar::~Avatar() {
+    glDeleteBuffers(1, &bodyVBO);
+    glDeleteVertexArrays(1, &bodyVAO);
+    glDeleteBuffers(1, &spriteVBO);
+    glDeleteVertexArrays(1, &spriteVAO);
+    glDeleteBuffers(1, &colorBuffer);
+    for (const auto& entry : textureCache) {
+        glDeleteTextures(1, &entry.second);
+    }
 }
 
 void Avatar::draw(Shader& shader, Shader& hairShader, float windowWidth, float windowHeight, float scrollOffset) {
-    glPushMatrix();
-    float avatarWidth = 1.0f * scrollOffset;
-    float avatarHeight = 1.5f * scrollOffset; 
-    float scaleX = avatarWidth / windowWidth;
-    float scaleY = avatarHeight / windowHeight;
-    glScalef(scaleX, scaleY, 1.0f);
-
-    float offsetX = windowWidth / 2.0f;
-    float offsetY = windowHeight / 2.0f;
-    glTranslatef(offsetX, offsetY, 0.0f);
-
-    shader.setVec3("skinColor", skinColor[0], skinColor[1], skinColor[2]);
-    shader.setVec3("eyeColor", eyeColor[0], eyeColor[1], eyeColor[2]);
-    shader.setVec3("hairColor", hairColor[0], hairColor[1], hairColor[2]);
-    shader.setVec3("outfitColor", outfitColor[0], outfitColor[1], outfitColor[2]);
-
-    float faceColor[] = { 1.0, 0.8, 0.6 };
-    float skinColor[] = { 1.2, 0.8, 0.5 };
-    drawNeck(shader, skinColor);
-    drawHead(shader, faceColor);
-    drawTorso(shader, skinColor);
-    drawHands(shader,hairShader, skinColor);
-    drawLegs(shader, skinColor);
-    glPopMatrix();
+    // The zoom itself is the shaders' viewTransform; here it only picks how finely the head is
+    // tessellated, from its radius in pixels on a windowWidth x windowHeight target
+    const float headRadius = std::max(AvatarGeometry::HEAD_A * windowWidth, AvatarGeometry::HEAD_B * windowHeight) * 0.5f * scrollOffset;
+    headLevel = AvatarGeometry::tessellationLevel(headRadius, AvatarGeometry::HEAD_VERTICES, AvatarGeometry::HEAD_LEVEL_COUNT);
+
+    // Colors live in this avatar's uniform block, the mesh itself is shared and never rebuilt
+    if (colorsDirty) {
+        uploadColors();
+    }
+    glBindBufferBase(GL_UNIFORM_BUFFER, COLOR_BLOCK_BINDING, colorBuffer);
+
+    drawNeck(shader);
+    drawHead(shader);
+    drawTorso(shader);
+    drawHands(shader, hairShader);
+    drawLegs(shader);
+}
+
+
+void Avatar::uploadColors() {
+    // std140: one vec4 per palette entry, in AvatarColor order
+    const float* sources[COLOR_COUNT] = { skinColor, faceColor, eyeColor, hairColor, outfitColor };
+    float palette[COLOR_COUNT * 4];
+    for (int i = 0; i < COLOR_COUNT; ++i) {
+        palette[i * 4] = sources[i][0];
+        palette[i * 4 + 1] = sources[i][1];
+        palette[i * 4 + 2] = sources[i][2];
+        palette[i * 4 + 3] = 1.0f;
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, colorBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(palette), palette);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    colorsDirty = false;
 }
 
 
@@ -68,15 +112,15 @@ GLuint Avatar::loadTexture(const char* filepath) {
     GLuint textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrChannels;
-    stbi_set_flip_vertically_on_load(true); // Flip the texture vertically
-    unsigned char* data = stbi_load(filepath, &width, &height, &nrChannels, 0);
+    // Decoded once per process (already flipped vertically), every GL context only uploads it
+    const DecodedImage* image = ImageStore::shared().get(filepath);
 
-    if (data) {
-        GLenum format = (nrChannels == 4) ? GL_RGBA : GL_RGB;
+    if (image) {
+        GLenum format = (image->channels == 4) ? GL_RGBA : GL_RGB;
 
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image->width, image->height, 0, format, GL_UNSIGNED_BYTE, image->pixels.data());
         glGenerateMipmap(GL_TEXTURE_2D);
 
         // Texture parameters
@@ -84,549 +128,134 @@ GLuint Avatar::loadTexture(const char* filepath) {
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        textureMasks[textureID] = &image->mask;
     }
     else {
         std::cerr << "Failed to load texture: " << filepath << std::endl;
     }
 
-    stbi_image_free(data);
     return textureID;
 }
 
 
-void Avatar::drawHead(Shader& shader, float color[]) {
-    const float a = 0.15f;  // Adjusted width (x-axis)
-    const float b = 0.24f;  // Adjusted height (y-axis)
-    const int numVertices = 200; // Number of vertices for the ellipse
-
-    float* vertices = new float[numVertices * 6]; // 2D positions + RGBA colors
-
-    for (int i = 0; i < numVertices; ++i) {
-        float angle = 2.0f * M_PI * i / numVertices;
-        float x = a * cos(angle);
-        float y = b * sin(angle);
-
-        // Center the head at (0, 0) with some space around it (e.g., Y = 0.5 for positioning)
-        vertices[i * 6] = x;
-        vertices[i * 6 + 1] = y + 0.5f; // Centered on Y = 0.5 (adjust for more space if needed)
-        vertices[i * 6 + 2] = color[0]; // R (Red)
-        vertices[i * 6 + 3] = color[1]; // G (Green)
-        vertices[i * 6 + 4] = color[2]; // B (Blue)
-        vertices[i * 6 + 5] = 1.0f; // A (Alpha)
-    }
-
-    unsigned int VAO, VBO;
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+void Avatar::setupGeometry() {
+    using namespace AvatarGeometry;
 
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, numVertices * 6 * sizeof(float), vertices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    // Body: position only (8 bytes per vertex), the color comes from the AvatarColors uniform block
+    glGenVertexArrays(1, &bodyVAO);
+    glGenBuffers(1, &bodyVBO);
+    glBindVertexArray(bodyVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, bodyVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(BODY_VERTICES), BODY_VERTICES.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(2 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    glUseProgram(shader.getID());
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLE_FAN, 0, numVertices);
-    glBindVertexArray(0);
-    glUseProgram(0);
-
-    delete[] vertices;
-    glDeleteBuffers(1, &VBO);
-    glDeleteVertexArrays(1, &VAO);
-}
-
-void Avatar::drawNeck(Shader& shader, float color[]) {
-    const float width = 0.15f;   // Adjusted width of the neck
-    const float height = 0.25f;  // Adjusted height of the neck
-
-    // Base Y position for the neck should align below the head
-    float neckBaseY = 0.2f;  // Adjusted to create more space between head and neck
-
-    float vertices[] = {
-        // X, Y, R, G, B, A
-        -width / 2.0f, neckBaseY, color[0], color[1], color[2], 2.0f, // Left bottom
-         width / 2.0f, neckBaseY, color[0], color[1], color[2], 2.0f, // Right bottom
-         width / 2.0f, neckBaseY + height, color[0], color[1], color[2], 2.0f, // Right top
-        -width / 2.0f, neckBaseY + height, color[0], color[1], color[2], 2.0f  // Left top
-    };
-
-    unsigned int indices[] = {
-        0, 1, 2, // First triangle
-        2, 3, 0  // Second triangle
-    };
-
-    unsigned int VAO, VBO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
-
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(2 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    glUseProgram(shader.getID());
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    glDeleteVertexArrays(1, &VAO);
-}
-void Avatar::drawTorso(Shader& shader, float color[]) {
-    // Adjusted dimensions for a smaller torso to fit space for the legs
-    float vertices[] = {
-        // Upper part (shoulders)
-        -0.2f, 0.22f, color[0], color[1], color[2], 1.0f, // Left shoulder
-         0.2f, 0.22f, color[0], color[1], color[2], 1.0f, // Right shoulder
-
-         // Waist (reduced height)
-         -0.15f, -0.3f, color[0], color[1], color[2], 1.0f, // Left waist
-          0.15f, -0.3f, color[0], color[1], color[2], 1.0f, // Right waist
-
-          // Lower part (bottom, reduced height)
-          -0.2f, -0.5f, color[0], color[1], color[2], 1.0f, // Left bottom
-           0.2f, -0.5f, color[0], color[1], color[2], 1.0f, // Right bottom
-    };
-
-    unsigned int indices[] = {
-        // Upper part (shoulders to waist)
-        0, 1, 2,
-        2, 1, 3,
-
-        // Waist to bottom
-        2, 3, 4,
-        4, 3, 5,
-    };
-
-    unsigned int VAO, VBO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
-
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(2 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    glUseProgram(shader.getID());
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, sizeof(indices) / sizeof(unsigned int), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    glDeleteVertexArrays(1, &VAO);
-}
-
-
-
-void drawRectangle(Shader& shader, float* vertices, unsigned int* indices, int numIndices) {
-    unsigned int VAO, VBO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
-
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, 4 * 6 * sizeof(float), vertices, GL_STATIC_DRAW);
-
-    glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+    // Sprites: positions + texture coordinates, the fixed hand quads followed by one quad per slot anchor
+    std::vector<float> sprites(SPRITE_VERTICES.begin(), SPRITE_VERTICES.end());
+    sprites.resize(SPRITE_VERTICES.size() + slots.getSlotCount() * SPRITE_FLOATS_PER_QUAD);
+    for (int slot = 0; slot < slots.getSlotCount(); ++slot) {
+        writeSpriteQuad(slots.getSlot(slot).anchor, &sprites[SPRITE_VERTICES.size() + slot * SPRITE_FLOATS_PER_QUAD]);
+    }
 
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glGenVertexArrays(1, &spriteVAO);
+    glGenBuffers(1, &spriteVBO);
+    glBindVertexArray(spriteVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, spriteVBO);
+    glBufferData(GL_ARRAY_BUFFER, sprites.size() * sizeof(float), sprites.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0); // Position
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(2 * sizeof(float)));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float))); // Texture coordinates
     glEnableVertexAttribArray(1);
 
-    glUseProgram(shader.getID());
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
-
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    glDeleteVertexArrays(1, &VAO);
 }
 
-void drawCircle(Shader& shader, float centerX, float centerY, float radius, float eyeColor[3]) {
-    const int numVertices = 100;
-    float* vertices = new float[numVertices * 6];
-    for (int i = 0; i < numVertices; ++i) {
-        float angle = 2.0f * M_PI * i / numVertices;
-        float x = centerX + radius * cos(angle);
-        float y = centerY + radius * sin(angle);
-
-        vertices[i * 6] = x;
-        vertices[i * 6 + 1] = y;
-        vertices[i * 6 + 2] = eyeColor[0]; // R
-        vertices[i * 6 + 3] = eyeColor[1]; // G
-        vertices[i * 6 + 4] = eyeColor[2]; // B
-        vertices[i * 6 + 5] = 1.0f; // A
-    }
-
-    unsigned int VAO, VBO;
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
-
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, numVertices * 6 * sizeof(float), vertices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(2 * sizeof(float)));
-    glEnableVertexAttribArray(1);
 
+void Avatar::drawBodyPart(Shader& shader, const AvatarGeometry::MeshRange& range, AvatarColor color) {
     glUseProgram(shader.getID());
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLE_FAN, 0, numVertices);
+    shader.setInt("colorIndex", color);
+    glBindVertexArray(bodyVAO);
+    glDrawArrays(range.fan ? GL_TRIANGLE_FAN : GL_TRIANGLES, range.first, range.count);
     glBindVertexArray(0);
-
-    glDeleteBuffers(1, &VBO);
-    glDeleteVertexArrays(1, &VAO);
-    delete[] vertices;
 }
 
 
-
-void Avatar::drawLeftHand(Shader& shader, float leftArmEndX, float leftArmEndY) {
-
-    static GLuint mouthTexture = 0;
-
-    // Load the mouth texture only once
-    if (mouthTexture == 0) {
-        mouthTexture = loadTexture("hands/leva.png");
-    }
-
-
+void Avatar::drawSprite(Shader& shader, GLuint texture, int firstVertex) {
     // Enable blending for transparency
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    // Vertices for a textured quad at the mouth position
-    float eyesWidth = 0.18f;  // Adjust width of the mouth
-    float eyesHeight = 0.22f; // Adjust height of the mouth
-
-    float vertices[] = {
-        // Positions         // Texture Coords
-        leftArmEndX+0.07- eyesWidth / 2, leftArmEndY-0.09 - eyesHeight / 2, 0.0f, 0.0f, // Bottom-left
-        leftArmEndX+0.07 + eyesWidth / 2, leftArmEndY-0.09 - eyesHeight / 2, 1.0f, 0.0f, // Bottom-right
-        leftArmEndX+0.07 + eyesWidth / 2, leftArmEndY-0.09 + eyesHeight / 2, 1.0f, 1.0f, // Top-right
-        leftArmEndX+0.07 - eyesWidth / 2, leftArmEndY-0.09 + eyesHeight / 2, 0.0f, 1.0f  // Top-left
-    };
-
-    unsigned int indices[] = {
-        0, 1, 2, // First triangle
-        0, 2, 3  // Second triangle
-    };
-
-    unsigned int VAO, VBO, EBO;
-
-    // Generate and bind VAO
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
-
-    // Generate and bind VBO
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    // Generate and bind EBO
-    glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    // Define vertex attributes
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0); // Position
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float))); // Texture coordinates
-    glEnableVertexAttribArray(1);
-
-    // Use the shader program and set up texture
     shader.use();
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, mouthTexture);
+    glBindTexture(GL_TEXTURE_2D, texture);
     shader.setInt("texture1", 0);
 
-    // Draw the textured quad
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(spriteVAO);
+    glDrawArrays(GL_TRIANGLES, firstVertex, AvatarGeometry::SPRITE_VERTICES_PER_QUAD);
 
-    // Cleanup
     glBindVertexArray(0);
     glBindTexture(GL_TEXTURE_2D, 0);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    glDeleteVertexArrays(1, &VAO);
-};
-
-
-void Avatar::drawRightHand(Shader& shader, float rightArmEndX, float rightArmEndY) {
-
-    static GLuint mouthTexture = 0;
-
-    // Load the mouth texture only once
-    if (mouthTexture == 0) {
-        mouthTexture = loadTexture("hands/desna.png");
-    }
-
-
-    // Enable blending for transparency
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    // Vertices for a textured quad at the mouth position
-    float eyesWidth = 0.18f;  // Adjust width of the mouth
-    float eyesHeight = 0.22f; // Adjust height of the mouth
-
-    float vertices[] = {
-        // Positions         // Texture Coords
-        rightArmEndX - 0.07 - eyesWidth / 2, rightArmEndY - 0.09 - eyesHeight / 2, 0.0f, 0.0f, // Bottom-left
-        rightArmEndX - 0.07 + eyesWidth / 2, rightArmEndY - 0.09 - eyesHeight / 2, 1.0f, 0.0f, // Bottom-right
-        rightArmEndX - 0.07 + eyesWidth / 2, rightArmEndY - 0.09 + eyesHeight / 2, 1.0f, 1.0f, // Top-right
-        rightArmEndX - 0.07 - eyesWidth / 2, rightArmEndY - 0.09 + eyesHeight / 2, 0.0f, 1.0f  // Top-left
-    };
-
-    unsigned int indices[] = {
-        0, 1, 2, // First triangle
-        0, 2, 3  // Second triangle
-    };
-
-    unsigned int VAO, VBO, EBO;
-
-    // Generate and bind VAO
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
-
-    // Generate and bind VBO
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+}
 
-    // Generate and bind EBO
-    glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
-    // Define vertex attributes
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0); // Position
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float))); // Texture coordinates
-    glEnableVertexAttribArray(1);
+void Avatar::drawHead(Shader& shader) {
+    drawBodyPart(shader, AvatarGeometry::HEAD_LEVELS[headLevel], COLOR_FACE);
+    glUseProgram(0);
+}
 
-    // Use the shader program and set up texture
-    shader.use();
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, mouthTexture);
-    shader.setInt("texture1", 0);
+void Avatar::drawNeck(Shader& shader) {
+    drawBodyPart(shader, AvatarGeometry::NECK, COLOR_SKIN);
+}
 
-    // Draw the textured quad
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+void Avatar::drawTorso(Shader& shader) {
+    drawBodyPart(shader, AvatarGeometry::TORSO, COLOR_SKIN);
+}
 
-    // Cleanup
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    glDeleteVertexArrays(1, &VAO);
 
+void Avatar::drawLeftHand(Shader& shader) {
+    drawSprite(shader, leftHandTexture, AvatarGeometry::spriteFirstVertex(AvatarGeometry::SPRITE_LEFT_HAND));
 };
 
 
-void Avatar::drawHands(Shader& shader, Shader& hairShader, float color[]) {
-    float shoulderY = 0.2f; // Shoulders' y-coordinate
-    float armLength = 0.6f; // Length of the arm
-    float armWidth = 0.1f;  // Width of the arm
-
-    // Left arm
-    float leftShoulderX = -0.2f; // X-coordinate for left shoulder
-    float leftArmEndX = leftShoulderX - armLength * cos(M_PI / 2.8f); // 30 degrees
-    float leftArmEndY = shoulderY - armLength * sin(M_PI / 2.8f);
-
-    float leftArmVertices[] = {
-        leftShoulderX, shoulderY, color[0], color[1], color[2], 1.0f, // Shoulder top
-        leftShoulderX + armWidth, shoulderY, color[0], color[1], color[2], 1.0f, // Shoulder bottom
-        leftArmEndX + armWidth, leftArmEndY,color[0], color[1], color[2], 1.0f, // Hand top
-        leftArmEndX, leftArmEndY, color[0], color[1], color[2], 1.0f // Hand bottom
-    };
-
-    unsigned int indices[] = { 0, 1, 2, 2, 3, 0 };
-
-    drawRectangle(shader, leftArmVertices, indices, 6);
-
-    // Right arm (mirrored along Y-axis)
-    float rightShoulderX = 0.2f;
-    float rightArmEndX = rightShoulderX + armLength * cos(M_PI / 2.8f);
-    float rightArmEndY = shoulderY - armLength * sin(M_PI / 2.8f);
-
-    float rightArmVertices[] = {
-        rightShoulderX, shoulderY,color[0], color[1], color[2], 1.0f,
-        rightShoulderX - armWidth, shoulderY, color[0], color[1], color[2], 1.0f,
-        rightArmEndX - armWidth, rightArmEndY, color[0], color[1], color[2], 1.0f,
-        rightArmEndX, rightArmEndY, color[0], color[1], color[2], 1.0f
-    };
-
-    drawRectangle(shader, rightArmVertices, indices, 6);
-
-    // Draw hands as circles
-
-    rightArmEndX = rightShoulderX + armLength * cos(M_PI / 2.8f);
-    rightArmEndY = shoulderY - armLength * sin(M_PI / 2.8f);
-    leftArmEndX = leftShoulderX - armLength * cos(M_PI / 2.8f); // 30 degrees
-    leftArmEndY = shoulderY - armLength * sin(M_PI / 2.8f);
-
+void Avatar::drawRightHand(Shader& shader) {
+    drawSprite(shader, rightHandTexture, AvatarGeometry::spriteFirstVertex(AvatarGeometry::SPRITE_RIGHT_HAND));
+};
 
-    //drawCircle(shader, leftArmEndX, leftArmEndY, 0.06f,color);
-    //drawCircle(shader, rightArmEndX, rightArmEndY, 0.06f, color);
-    
-    drawLeftHand(hairShader, leftArmEndX, leftArmEndY);
-    drawRightHand(hairShader, rightArmEndX, rightArmEndY);
 
+void Avatar::drawHands(Shader& shader, Shader& hairShader) {
+    // Arm endpoints are computed at compile time in AvatarGeometry
+    drawBodyPart(shader, AvatarGeometry::LEFT_ARM, COLOR_SKIN);
+    drawBodyPart(shader, AvatarGeometry::RIGHT_ARM, COLOR_SKIN);
 
+    drawLeftHand(hairShader);
+    drawRightHand(hairShader);
 }
 
 
 
-void Avatar::drawLegs(Shader& shader, float color[]) {
-    float torsoBottomY = -0.5f; // Bottom of the torso
-    float legLength = 0.5f;     // Length of each leg
-    float legWidth = 0.15f;     // Width of each leg
-    float legGap = 0.1f;        // Gap between the legs
-
-    // Left leg
-    float leftLegX = -legWidth - legGap / 2.0f;
-    float leftLegY = torsoBottomY - legLength;
-
-    float leftLegVertices[] = {
-        leftLegX, torsoBottomY, color[0], color[1], color[2], 1.0f, // Top left
-        leftLegX + legWidth, torsoBottomY, color[0], color[1], color[2], 1.0f, // Top right
-        leftLegX + legWidth, leftLegY,color[0], color[1], color[2], 1.0f, // Bottom right
-        leftLegX, leftLegY,color[0], color[1], color[2], 1.0f // Bottom left
-    };
-
-    unsigned int indices[] = { 0, 1, 2, 2, 3, 0 };
-
-    drawRectangle(shader, leftLegVertices, indices, 6);
-
-    // Right leg
-    float rightLegX = legGap / 2.0f;
-    float rightLegY = leftLegY;
-
-    float rightLegVertices[] = {
-        rightLegX, torsoBottomY,color[0], color[1], color[2], 1.0f,
-        rightLegX + legWidth, torsoBottomY,color[0], color[1], color[2], 1.0f,
-        rightLegX + legWidth, rightLegY,color[0], color[1], color[2], 1.0f,
-        rightLegX, rightLegY,color[0], color[1], color[2], 1.0f
-    };
-
-    drawRectangle(shader, rightLegVertices, indices, 6);
+void Avatar::drawLegs(Shader& shader) {
+    drawBodyPart(shader, AvatarGeometry::LEFT_LEG, COLOR_SKIN);
+    drawBodyPart(shader, AvatarGeometry::RIGHT_LEG, COLOR_SKIN);
 }
 
 
 
-void Avatar::drawFace(Shader& shader) {
-    float eyeColor[] = { 0.01f,0.01f,0.01f };
-    drawMouth(shader);
-    drawEyes(shader);
-    drawNose(shader);
-    drawHair(shader);
-}
-
+void Avatar::drawSlots(Shader& textureShader) {
+    const int firstSlotVertex = AvatarGeometry::SPRITE_COUNT * AvatarGeometry::SPRITE_VERTICES_PER_QUAD;
 
-void Avatar::drawEyes(Shader& shader) {
-    if (eyeTexture == 0) {
-        eyeTexture = loadTexture("Eyes/eyes1.png");
+    for (int slot : slots.getDrawOrder()) {
+        if ((occupiedSlots & (1u << slot)) == 0) continue;
+        drawSprite(textureShader, slotTextures[slot], firstSlotVertex + slot * AvatarGeometry::SPRITE_VERTICES_PER_QUAD);
     }
-
-
-    // Enable blending for transparency
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    // Vertices for a textured quad at the mouth position
-    float eyesWidth = 0.26f;  // Adjust width of the mouth
-    float eyesHeight = 0.12f; // Adjust height of the mouth
-    float eyesCenterX = 0.0f; // Center X position of the mouth
-    float eyesCenterY = 0.52f; // Center Y position of the mouth
-
-    float vertices[] = {
-        // Positions         // Texture Coords
-        eyesCenterX - eyesWidth / 2, eyesCenterY - eyesHeight / 2, 0.0f, 0.0f, // Bottom-left
-        eyesCenterX + eyesWidth / 2, eyesCenterY - eyesHeight / 2, 1.0f, 0.0f, // Bottom-right
-        eyesCenterX + eyesWidth / 2, eyesCenterY + eyesHeight / 2, 1.0f, 1.0f, // Top-right
-        eyesCenterX - eyesWidth / 2, eyesCenterY + eyesHeight / 2, 0.0f, 1.0f  // Top-left
-    };
-
-    unsigned int indices[] = {
-        0, 1, 2, // First triangle
-        0, 2, 3  // Second triangle
-    };
-
-    unsigned int VAO, VBO, EBO;
-
-    // Generate and bind VAO
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
-
-    // Generate and bind VBO
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    // Generate and bind EBO
-    glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    // Define vertex attributes
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0); // Position
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float))); // Texture coordinates
-    glEnableVertexAttribArray(1);
-
-    // Use the shader program and set up texture
-    shader.use();
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, eyeTexture);
-    shader.setInt("texture1", 0);
-
-    // Draw the textured quad
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-    // Cleanup
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    glDeleteVertexArrays(1, &VAO);
+    glDisable(GL_BLEND);
 }
 
+
 void Avatar::drawEyebrow(Shader& shader, float startX, float startY, float length, float lineWidth) {
     float vertices[] = {
-        startX, startY, 0.0f, 0.0f, 0.0f, 1.0f, // Start point (black color)
-        startX + length, startY, 0.0f, 0.0f, 0.0f, 1.0f  // End point (black color)
+        startX, startY,          // Start point
+        startX + length, startY  // End point
     };
 
     // Set the line width for the eyebrow thickness
@@ -640,12 +269,12 @@ void Avatar::drawEyebrow(Shader& shader, float startX, float startY, float lengt
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(2 * sizeof(float)));
-    glEnableVertexAttribArray(1);
 
+    // Eyebrows use the hair color
     glUseProgram(shader.getID());
+    shader.setInt("colorIndex", COLOR_HAIR);
     glBindVertexArray(VAO);
     glDrawArrays(GL_LINES, 0, 2);
 
@@ -655,436 +284,27 @@ void Avatar::drawEyebrow(Shader& shader, float startX, float startY, float lengt
 }
 
 
-void Avatar::drawNose(Shader& shader) {
-    if (noseTexture == 0) {
-        noseTexture = loadTexture("Nose/nose3.png");
-    }
-
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    // Vertices for a textured quad at the mouth position
-    float mouthWidth = 0.08f;  // Adjust width of the mouth
-    float mouthHeight = 0.12f; // Adjust height of the mouth
-    float mouthCenterX = 0.0f; // Center X position of the mouth
-    float mouthCenterY = 0.44f; // Center Y position of the mouth
-
-    float vertices[] = {
-        // Positions         // Texture Coords
-        mouthCenterX - mouthWidth / 2, mouthCenterY - mouthHeight / 2, 0.0f, 0.0f, // Bottom-left
-        mouthCenterX + mouthWidth / 2, mouthCenterY - mouthHeight / 2, 1.0f, 0.0f, // Bottom-right
-        mouthCenterX + mouthWidth / 2, mouthCenterY + mouthHeight / 2, 1.0f, 1.0f, // Top-right
-        mouthCenterX - mouthWidth / 2, mouthCenterY + mouthHeight / 2, 0.0f, 1.0f  // Top-left
-    };
-
-    unsigned int indices[] = {
-        0, 1, 2, // First triangle
-        0, 2, 3  // Second triangle
-    };
-
-    unsigned int VAO, VBO, EBO;
-
-    // Generate and bind VAO
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
-
-    // Generate and bind VBO
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    // Generate and bind EBO
-    glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    // Define vertex attributes
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0); // Position
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float))); // Texture coordinates
-    glEnableVertexAttribArray(1);
-
-    // Use the shader program and set up texture
-    shader.use();
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, noseTexture);
-    shader.setInt("texture1", 0);
-
-    // Draw the textured quad
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-    // Cleanup
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    glDeleteVertexArrays(1, &VAO);
-}
-
-
-void Avatar::drawMouth(Shader& shader) {
-    if(mouthTexture == 0){
-        mouthTexture = loadTexture("Lips/lips1.png"); // Load texture every time
-    }
-
-    // Enable blending for transparency
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    // Vertices for a textured quad at the mouth position
-    float mouthWidth = 0.13f;  // Adjust width of the mouth
-    float mouthHeight = 0.06f; // Adjust height of the mouth
-    float mouthCenterX = 0.0f; // Center X position of the mouth
-    float mouthCenterY = 0.34f; // Center Y position of the mouth
-
-    float vertices[] = {
-        // Positions         // Texture Coords
-        mouthCenterX - mouthWidth / 2, mouthCenterY - mouthHeight / 2, 0.0f, 0.0f, // Bottom-left
-        mouthCenterX + mouthWidth / 2, mouthCenterY - mouthHeight / 2, 1.0f, 0.0f, // Bottom-right
-        mouthCenterX + mouthWidth / 2, mouthCenterY + mouthHeight / 2, 1.0f, 1.0f, // Top-right
-        mouthCenterX - mouthWidth / 2, mouthCenterY + mouthHeight / 2, 0.0f, 1.0f  // Top-left
-    };
-
-    unsigned int indices[] = {
-        0, 1, 2, // First triangle
-        0, 2, 3  // Second triangle
-    };
-
-    unsigned int VAO, VBO, EBO;
-
-    // Generate and bind VAO
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
-
-    // Generate and bind VBO
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    // Generate and bind EBO
-    glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    // Define vertex attributes
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0); // Position
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float))); // Texture coordinates
-    glEnableVertexAttribArray(1);
-
-    // Use the shader program and set up texture
-    shader.use();
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, mouthTexture);
-    shader.setInt("texture1", 0);
-
-    // Draw the textured quad
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-    // Cleanup
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    glDeleteVertexArrays(1, &VAO);
-}
-
-
-
-
-
-
-void Avatar::drawHair(Shader& shader) {
-    static GLuint hairTexture = 0;
-    if (hairTexture == 0) {
-        hairTexture = loadTexture("hair/hair13.png");
-    }
-
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    float hairWidth = 0.8f; 
-    float hairHeight = 0.9f;
-    float hairCenterX = 0.0f;
-    float hairCenterY = 0.35f;
-
-    float vertices[] = {
-        hairCenterX - hairWidth / 2, hairCenterY - hairHeight / 2, 0.0f, 0.0f,
-        hairCenterX + hairWidth / 2, hairCenterY - hairHeight / 2, 1.0f, 0.0f,
-        hairCenterX + hairWidth / 2, hairCenterY + hairHeight / 2, 1.0f, 1.0f,
-        hairCenterX - hairWidth / 2, hairCenterY + hairHeight / 2, 0.0f, 1.0f
-    };
-
-    unsigned int indices[] = {
-        0, 1, 2, // First triangle
-        0, 2, 3  // Second triangle
-    };
-
-    unsigned int VAO, VBO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-
-    glBindVertexArray(VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    shader.use();
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, hairTexture);
-    shader.setInt("texture1", 0);
-
-    // Draw the hair
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-    // Cleanup
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    glDeleteVertexArrays(1, &VAO);
-
-    glDisable(GL_BLEND);
-}
-
-
-void Avatar::drawTshirt(Shader& avatarShader, Shader& textureShader, float color[], std::string texture) {
-    if (texture != "") {
-        if (tshirtTexture == 0) {
-            tshirtTexture = loadTexture("T-shirts/shirt.png");
-        }
-
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-        float hairWidth = 1.0f;
-        float hairHeight = 0.7f;
-        float hairCenterX = 0.0f;
-        float hairCenterY = -0.08f;
-
-        float vertices[] = {
-            hairCenterX - hairWidth / 2, hairCenterY - hairHeight / 2, 0.0f, 0.0f,
-            hairCenterX + hairWidth / 2, hairCenterY - hairHeight / 2, 1.0f, 0.0f,
-            hairCenterX + hairWidth / 2, hairCenterY + hairHeight / 2, 1.0f, 1.0f,
-            hairCenterX - hairWidth / 2, hairCenterY + hairHeight / 2, 0.0f, 1.0f
-        };
-
-        unsigned int indices[] = {
-            0, 1, 2, // First triangle
-            0, 2, 3  // Second triangle
-        };
-
-        unsigned int VAO, VBO, EBO;
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-        // Vertex attributes for positions and texture coordinates
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-
-        // Use the hair shader and bind the hair texture
-        textureShader.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, tshirtTexture);
-        textureShader.setInt("texture1", 0);
-
-        // Draw the hair
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-        // Cleanup
-        glBindVertexArray(0);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glDeleteBuffers(1, &VBO);
-        glDeleteBuffers(1, &EBO);
-        glDeleteVertexArrays(1, &VAO);
-
-        glDisable(GL_BLEND);
-    }
-    else {
-        drawTorso(avatarShader, color);
-    }
-    
-};
-
-
-void Avatar::drawPants(Shader& avatarShader, Shader& textureShader, float color[], std::string texture) {
-    if (texture != "") {
-        if (pantsTexture == 0) {
-            pantsTexture = loadTexture("Pants/brownpants.png");
-        }
-
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-        float hairWidth = 0.53f;
-        float hairHeight = 0.9f;
-        float hairCenterX = -0.03f;
-        float hairCenterY = -0.8f;
-
-        float vertices[] = {
-            hairCenterX - hairWidth / 2, hairCenterY - hairHeight / 2, 0.0f, 0.0f,
-            hairCenterX + hairWidth / 2, hairCenterY - hairHeight / 2, 1.0f, 0.0f,
-            hairCenterX + hairWidth / 2, hairCenterY + hairHeight / 2, 1.0f, 1.0f,
-            hairCenterX - hairWidth / 2, hairCenterY + hairHeight / 2, 0.0f, 1.0f
-        };
-
-        unsigned int indices[] = {
-            0, 1, 2, // First triangle
-            0, 2, 3  // Second triangle
-        };
-
-        unsigned int VAO, VBO, EBO;
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-        // Vertex attributes for positions and texture coordinates
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-
-        // Use the hair shader and bind the hair texture
-        textureShader.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, pantsTexture);
-        textureShader.setInt("texture1", 0);
-
-        // Draw the hair
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-        // Cleanup
-        glBindVertexArray(0);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glDeleteBuffers(1, &VBO);
-        glDeleteBuffers(1, &EBO);
-        glDeleteVertexArrays(1, &VAO);
-
-        glDisable(GL_BLEND);
-    }
-    else {
-        drawTorso(avatarShader, color);
-    }
-};
-
-
-void Avatar::drawSkirt(Shader& avatarShader, Shader& textureShader, float color[], std::string texture) {
-};
-
-
-void Avatar::drawDress(Shader& avatarShader, Shader& textureShader, float color[], std::string texture) {
-    if (texture != "") {
-        if (dressTexture == 0) {
-            dressTexture = loadTexture("Dresses/dress1.png");
-        }
-
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-        float hairWidth = 0.5f;
-        float hairHeight = 0.9f;
-        float hairCenterX = -0.01f;
-        float hairCenterY = -0.23f;
-
-        float vertices[] = {
-            hairCenterX - hairWidth / 2, hairCenterY - hairHeight / 2, 0.0f, 0.0f,
-            hairCenterX + hairWidth / 2, hairCenterY - hairHeight / 2, 1.0f, 0.0f,
-            hairCenterX + hairWidth / 2, hairCenterY + hairHeight / 2, 1.0f, 1.0f,
-            hairCenterX - hairWidth / 2, hairCenterY + hairHeight / 2, 0.0f, 1.0f
-        };
-
-        unsigned int indices[] = {
-            0, 1, 2, // First triangle
-            0, 2, 3  // Second triangle
-        };
-
-        unsigned int VAO, VBO, EBO;
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-        // Vertex attributes for positions and texture coordinates
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-
-        // Use the hair shader and bind the hair texture
-        textureShader.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, dressTexture);
-        textureShader.setInt("texture1", 0);
-
-        // Draw the hair
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-        // Cleanup
-        glBindVertexArray(0);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glDeleteBuffers(1, &VBO);
-        glDeleteBuffers(1, &EBO);
-        glDeleteVertexArrays(1, &VAO);
-
-        glDisable(GL_BLEND);
-    }
-    else {
-        drawTorso(avatarShader, color);
-    }
-};
-
-
-
 // Podesi boju koe avatara
 void Avatar::setSkinColor(float r, float g, float b) {
     skinColor[0] = r;
     skinColor[1] = g;
     skinColor[2] = b;
+    colorsDirty = true;
+}
+
+void Avatar::setColor(AvatarColor color, float r, float g, float b) {
+    float* target[COLOR_COUNT] = { skinColor, faceColor, eyeColor, hairColor, outfitColor };
+    target[color][0] = r;
+    target[color][1] = g;
+    target[color][2] = b;
+    colorsDirty = true;
+}
+
+void Avatar::setFaceColor(float r, float g, float b) {
+    faceColor[0] = r;
+    faceColor[1] = g;
+    faceColor[2] = b;
+    colorsDirty = true;
 }
 
 // Podesi boju oiju avatara
@@ -1092,6 +312,7 @@ void Avatar::setEyeColor(float r, float g, float b) {
     eyeColor[0] = r;
     eyeColor[1] = g;
     eyeColor[2] = b;
+    colorsDirty = true;
 }
 
 // Podesi boju kose avatara
@@ -1099,6 +320,7 @@ void Avatar::setHairColor(float r, float g, float b) {
     hairColor[0] = r;
     hairColor[1] = g;
     hairColor[2] = b;
+    colorsDirty = true;
 }
 
 // Podesi stil kose avatara
@@ -1116,29 +338,39 @@ void Avatar::setOutfitColor(float r, float g, float b) {
     outfitColor[0] = r;
     outfitColor[1] = g;
     outfitColor[2] = b;
+    colorsDirty = true;
 }
 
 
-void Avatar::setMouthTexture(GLuint textureID) {
-    mouthTexture = textureID;
+void Avatar::applySlot(int slot, GLuint textureID) {
+    // Conflicting slots (e.g. a dress vs. a t-shirt) are cleared by the precomputed mask
+    occupiedSlots = slots.apply(occupiedSlots, slot);
+    slotTextures[slot] = textureID;
 }
 
-void Avatar::setEyeTexture(GLuint textureID) {
-    eyeTexture = textureID;
+void Avatar::clearSlot(int slot) {
+    occupiedSlots &= ~(1u << slot);
 }
 
-void Avatar::setNoseTexture(GLuint textureID) {
-    noseTexture = textureID;
+uint32_t Avatar::getOccupiedSlots() const {
+    return occupiedSlots;
 }
 
-void Avatar::setDressTexture(GLuint textureID) {
-    dressTexture = textureID;
+GLuint Avatar::getSlotTexture(int slot) const {
+    return slotTextures[slot];
 }
 
-void Avatar::setTshirtTexture(GLuint textureID) {
-    tshirtTexture = textureID;
+void Avatar::restoreSlot(int slot, GLuint textureID, uint32_t occupied) {
+    slotTextures[slot] = textureID;
+    occupiedSlots = occupied;
 }
 
-void Avatar::setPantsTexture(GLuint textureID) {
-    pantsTexture = textureID;
-}
\ No newline at end of file
+int Avatar::pickSlot(float x, float y) const {
+    const AlphaMask* masks[SlotRegistry::MAX_SLOTS] = {};
+    for (int slot = 0; slot < slots.getSlotCount(); ++slot) {
+        if ((occupiedSlots & (1u << slot)) == 0) continue;
+        auto found = textureMasks.find(slotTextures[slot]);
+        if (found != textureMasks.end()) masks[slot] = found->second;
+    }
+    return slots.pickSlot(occupiedSlots, masks, x, y);
+}
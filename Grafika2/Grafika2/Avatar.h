@@ -3,28 +3,59 @@
 #define AVATAR_H
 
 #include "Shader.h"
+#include "AvatarGeometry.h"
+#include "SlotRegistry.h"
+#include <cstdint>
 #include <string>
 #include <unordered_map>
 
 class Avatar {
+public:
+    // Entries of the AvatarColors uniform block read by fragment.frag
+    enum AvatarColor { COLOR_SKIN, COLOR_FACE, COLOR_EYE, COLOR_HAIR, COLOR_OUTFIT, COLOR_COUNT };
+    static const GLuint COLOR_BLOCK_BINDING = 0;
+    // Palette after resetToDefaults(), in AvatarColor order
+    static constexpr float DEFAULT_COLORS[COLOR_COUNT][3] = {
+        { 1.2f, 0.8f, 0.5f },   // Skin (neck, torso, arms, legs)
+        { 1.0f, 0.8f, 0.6f },   // Face
+        { 0.0f, 0.0f, 0.0f },   // Eyes
+        { 0.0f, 0.0f, 0.0f },   // Hair
+        { 0.0f, 0.0f, 1.0f }    // Outfit
+    };
+
 private:
     float skinColor[3];
+    float faceColor[3];
     float eyeColor[3];
     float hairColor[3];
     std::string hairStyle;
     std::string outfitStyle;
     float outfitColor[3];
     std::unordered_map<std::string, GLuint> textureCache;
-    GLuint mouthTexture;
-    GLuint eyeTexture;
-    GLuint noseTexture;
-    GLuint dressTexture;
-    GLuint tshirtTexture;
-    GLuint pantsTexture;
+    std::unordered_map<GLuint, const AlphaMask*> textureMasks;  // Coverage of each loaded texture, owned by ImageStore
+    const SlotRegistry& slots;
+    GLuint slotTextures[SlotRegistry::MAX_SLOTS];
+    uint32_t occupiedSlots;
+    GLuint bodyVAO, bodyVBO;
+    GLuint spriteVAO, spriteVBO;
+    GLuint colorBuffer;
+    bool colorsDirty;
+    GLuint leftHandTexture, rightHandTexture;
+    int headLevel;          // In AvatarGeometry::HEAD_LEVELS, chosen by draw() for the head's size on screen
+
+    void setupGeometry();
+    void drawBodyPart(Shader& shader, const AvatarGeometry::MeshRange& range, AvatarColor color);
+    void uploadColors();
+    void drawSprite(Shader& shader, GLuint texture, int firstVertex);
 
 public:
-    Avatar();
+    Avatar(const SlotRegistry& slots);
+    ~Avatar();
+    // Default colors and default wardrobe items, so one Avatar can render many descriptions
+    void resetToDefaults();
+    void setColor(AvatarColor color, float r, float g, float b);
     void setSkinColor(float r, float g, float b);
+    void setFaceColor(float r, float g, float b);
     void setEyeColor(float r, float g, float b);
     void setHairColor(float r, float g, float b);
     void setHairStyle(const std::string& style);
@@ -32,31 +63,26 @@ public:
     void setOutfitColor(float r, float g, float b);
 
     void draw(Shader& shader, Shader& hairShader, float windowWidth, float windowHeight, float scrollOffset);
-    void drawHead(Shader& shader, float color[]);
-    void drawFace(Shader& shader);
-    void drawEyes(Shader& shader);
-    void drawMouth(Shader& shader);
-    void drawNose(Shader& shader);
+    void drawHead(Shader& shader);
+    void drawSlots(Shader& textureShader);
     void drawEyebrow(Shader& shader, float x, float y, float radius, float lineWidth);
-    void drawHair(Shader& shader);
-    void drawNeck(Shader& shader, float color[]);
-    void drawTorso(Shader& shader, float color[]);
-    void drawHands(Shader& shader, Shader& hairShader, float color[]);
-    void drawLegs(Shader& shader, float color[]);
-    void drawTshirt(Shader& avatarShader, Shader& textureShader, float color[], std::string texture);
-    void drawPants(Shader& avatarShader, Shader& textureShader, float color[], std::string texture);
-    void drawSkirt(Shader& avatarShader, Shader& textureShader, float color[], std::string texture);
-    void drawDress(Shader& avatarShader, Shader& textureShader, float color[], std::string texture);
-    void drawLeftHand(Shader& shader, float leftArmEndX, float leftArmEndY);
-    void drawRightHand(Shader& shader, float rightArmEndX, float rightArmEndY);
+    void drawNeck(Shader& shader);
+    void drawTorso(Shader& shader);
+    void drawHands(Shader& shader, Shader& hairShader);
+    void drawLegs(Shader& shader);
+    void drawLeftHand(Shader& shader);
+    void drawRightHand(Shader& shader);
     GLuint loadTexture(const char* filepath);
     GLuint loadTextureCached(const std::string& filepath);
-    void setMouthTexture(GLuint textureID);
-    void setEyeTexture(GLuint textureID);
-    void setNoseTexture(GLuint textureID);
-    void setDressTexture(GLuint textureID);
-    void setTshirtTexture(GLuint textureID);
-    void setPantsTexture(GLuint textureID);
+    void applySlot(int slot, GLuint textureID);
+    void clearSlot(int slot);
+    uint32_t getOccupiedSlots() const;
+    GLuint getSlotTexture(int slot) const;
+    // Puts texture in slot and sets the occupancy exactly as given, conflicts included, to
+    // bring back an earlier outfit
+    void restoreSlot(int slot, GLuint textureID, uint32_t occupied);
+    // Worn item under (x, y) in the avatar's NDC space, topmost layer first; -1 if none
+    int pickSlot(float x, float y) const;
 
 };
 
@@ -0,0 +1,116 @@
+#include "AvatarDescription.h"
+#include "Json.h"
+#include "Scene.h"
+#include "SoftwareAvatar.h"
+#include <iostream>
+
+namespace {
+    const char* COLOR_KEYS[Avatar::COLOR_COUNT] = { "skin", "face", "eye", "hair", "outfit" };
+}
+
+AvatarDescription::AvatarDescription() : colorMask(0) {
+    for (auto& color : colors) {
+        color[0] = color[1] = color[2] = 0.0f;
+    }
+}
+
+bool AvatarDescription::loadList(const std::string& path, const SlotRegistry& slots, std::vector<AvatarDescription>& out) {
+    JsonValue document;
+    std::string error;
+    if (!JsonValue::parseFile(path, document, error)) {
+        std::cerr << "Failed to read " << path << ": " << error << std::endl;
+        return false;
+    }
+
+    const JsonValue* avatars = document.find("avatars");
+    if (avatars == nullptr || !avatars->isArray()) {
+        std::cerr << path << ": missing \"avatars\" array" << std::endl;
+        return false;
+    }
+
+    out.clear();
+    out.reserve(avatars->size());
+    for (size_t i = 0; i < avatars->size(); ++i) {
+        AvatarDescription description;
+        if (!fromJson((*avatars)[i], slots, "avatar_" + std::to_string(i), description, error)) {
+            std::cerr << path << ": " << error << std::endl;
+            return false;
+        }
+        out.push_back(description);
+    }
+    return true;
+}
+
+bool AvatarDescription::fromJson(const JsonValue& entry, const SlotRegistry& slots, const std::string& defaultName,
+                                 AvatarDescription& out, std::string& error) {
+    out = AvatarDescription();
+    if (!entry.isObject()) {
+        error = "avatar description must be an object";
+        return false;
+    }
+
+    const JsonValue* name = entry.find("name");
+    out.name = (name && !name->asString().empty()) ? name->asString() : defaultName;
+    if (out.name.find_first_of("/\\") != std::string::npos) {
+        error = "avatar name " + out.name + " must not contain path separators";
+        return false;
+    }
+
+    for (int color = 0; color < Avatar::COLOR_COUNT; ++color) {
+        const JsonValue* rgb = entry.find(COLOR_KEYS[color]);
+        if (rgb == nullptr) continue;
+        if (!rgb->isArray() || rgb->size() != 3) {
+            error = out.name + "." + COLOR_KEYS[color] + " must be [r, g, b]";
+            return false;
+        }
+        for (int c = 0; c < 3; ++c) {
+            out.colors[color][c] = (float)(*rgb)[c].asNumber();
+        }
+        out.colorMask |= 1u << color;
+    }
+
+    const JsonValue* items = entry.find("slots");
+    if (items != nullptr) {
+        for (const auto& member : items->getMembers()) {
+            int slot = slots.findSlot(member.first);
+            if (slot < 0) {
+                error = out.name + " uses unknown slot \"" + member.first + "\"";
+                return false;
+            }
+            out.items.push_back({ slot, member.second.asString() });
+        }
+    }
+    return true;
+}
+
+// Avatar, SoftwareAvatar and SceneAvatar share the setter interface
+template <typename Target>
+static void applyDescription(const AvatarDescription& description, Target& avatar) {
+    avatar.resetToDefaults();
+    for (int color = 0; color < Avatar::COLOR_COUNT; ++color) {
+        if (description.colorMask & (1u << color)) {
+            const float* rgb = description.colors[color];
+            avatar.setColor((Avatar::AvatarColor)color, rgb[0], rgb[1], rgb[2]);
+        }
+    }
+    for (const SlotItem& item : description.items) {
+        if (item.item.empty()) {
+            avatar.clearSlot(item.slot);
+        }
+        else {
+            avatar.applySlot(item.slot, avatar.loadTextureCached(item.item));
+        }
+    }
+}
+
+void AvatarDescription::applyTo(Avatar& avatar) const {
+    applyDescription(*this, avatar);
+}
+
+void AvatarDescription::applyTo(SoftwareAvatar& avatar) const {
+    applyDescription(*this, avatar);
+}
+
+void AvatarDescription::applyTo(SceneAvatar& avatar) const {
+    applyDescription(*this, avatar);
+}
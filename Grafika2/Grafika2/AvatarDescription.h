@@ -0,0 +1,44 @@
+#ifndef AVATAR_DESCRIPTION_H
+#define AVATAR_DESCRIPTION_H
+
+#include "Avatar.h"
+#include "SlotRegistry.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JsonValue;
+class SceneAvatar;
+class SoftwareAvatar;
+
+// An item to put in a wardrobe slot; an empty item clears the slot
+struct SlotItem {
+    int slot;
+    std::string item;
+};
+
+// One avatar of a batch: colors and wardrobe items that differ from the defaults.
+// Read from JSON such as
+//   { "avatars": [ { "name": "anna", "skin": [0.9, 0.7, 0.5], "eye": [0.2, 0.4, 0.8],
+//                    "slots": { "Dresses": "Dresses/dress2.png", "Nose": null } } ] }
+// Color keys are skin, face, eye, hair and outfit; slot names come from the SlotRegistry.
+struct AvatarDescription {
+    std::string name;
+    uint32_t colorMask;                        // Bit per Avatar::AvatarColor that is set
+    float colors[Avatar::COLOR_COUNT][3];
+    std::vector<SlotItem> items;               // Applied in file order, conflicts clear earlier slots
+
+    AvatarDescription();
+
+    static bool loadList(const std::string& path, const SlotRegistry& slots, std::vector<AvatarDescription>& out);
+    // One description object; defaultName is used when it has no "name"
+    static bool fromJson(const JsonValue& entry, const SlotRegistry& slots, const std::string& defaultName,
+                         AvatarDescription& out, std::string& error);
+
+    // Resets the avatar to its defaults, then applies this description
+    void applyTo(Avatar& avatar) const;
+    void applyTo(SoftwareAvatar& avatar) const;
+    void applyTo(SceneAvatar& avatar) const;
+};
+
+#endif
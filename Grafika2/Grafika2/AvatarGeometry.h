@@ -0,0 +1,257 @@
+#ifndef AVATAR_GEOMETRY_H
+#define AVATAR_GEOMETRY_H
+
+#include <array>
+
+// The avatar rig as compile-time data. Every proportion lives here, and the vertex tables
+// below are evaluated by the compiler, so drawing never runs trig and the buffers are
+// uploaded once. Coordinates are in the avatar's NDC space, as the draw functions use them.
+namespace AvatarGeometry {
+
+    constexpr double PI = 3.14159265358979323846;
+
+    // std::sin/std::cos are not constexpr in C++17; Taylor series after reducing to [-pi, pi]
+    constexpr double constSin(double x) {
+        while (x > PI) x -= 2.0 * PI;
+        while (x < -PI) x += 2.0 * PI;
+        double term = x;
+        double sum = x;
+        for (int n = 1; n < 12; ++n) {
+            term *= -x * x / ((2.0 * n) * (2.0 * n + 1.0));
+            sum += term;
+        }
+        return sum;
+    }
+
+    constexpr double constCos(double x) {
+        return constSin(x + PI / 2.0);
+    }
+
+    struct Vec2 {
+        float x;
+        float y;
+    };
+
+    struct Rect {
+        float centerX;
+        float centerY;
+        float width;
+        float height;
+    };
+
+    struct MeshRange {
+        int first;
+        int count;
+        bool fan;
+    };
+
+    // Head
+    constexpr float HEAD_A = 0.15f;         // Half width (x-axis)
+    constexpr float HEAD_B = 0.24f;         // Half height (y-axis)
+    constexpr float HEAD_CENTER_Y = 0.5f;
+    constexpr int HEAD_VERTICES = 200;
+    // Full head plus coarser ones for small on-screen sizes, each with every other vertex
+    // of the one before
+    constexpr int HEAD_LEVEL_COUNT = 4;
+
+    // Neck
+    constexpr float NECK_WIDTH = 0.15f;
+    constexpr float NECK_HEIGHT = 0.25f;
+    constexpr float NECK_BASE_Y = 0.2f;
+
+    // Arms
+    constexpr float SHOULDER_Y = 0.2f;
+    constexpr float ARM_LENGTH = 0.6f;
+    constexpr float ARM_WIDTH = 0.1f;
+    constexpr float ARM_ANGLE = (float)(PI / 2.8);
+    constexpr float LEFT_SHOULDER_X = -0.2f;
+    constexpr float RIGHT_SHOULDER_X = 0.2f;
+    constexpr Vec2 LEFT_ARM_END = {
+        (float)(LEFT_SHOULDER_X - ARM_LENGTH * constCos(ARM_ANGLE)),
+        (float)(SHOULDER_Y - ARM_LENGTH * constSin(ARM_ANGLE))
+    };
+    constexpr Vec2 RIGHT_ARM_END = {
+        (float)(RIGHT_SHOULDER_X + ARM_LENGTH * constCos(ARM_ANGLE)),
+        (float)(SHOULDER_Y - ARM_LENGTH * constSin(ARM_ANGLE))
+    };
+
+    // Legs
+    constexpr float TORSO_BOTTOM_Y = -0.5f;
+    constexpr float LEG_LENGTH = 0.5f;
+    constexpr float LEG_WIDTH = 0.15f;
+    constexpr float LEG_GAP = 0.1f;
+
+    // Joints of the rig. A pose gives each an angle: the arms' below the horizontal, as
+    // ARM_ANGLE in the rest pose, and the head's tilt counterclockwise from upright. Arms
+    // (hands included) turn about the middle of their shoulder edge, the head and the items
+    // that follow it about the top of the neck.
+    enum Joint { JOINT_LEFT_ARM, JOINT_RIGHT_ARM, JOINT_HEAD, JOINT_COUNT };
+    constexpr float REST_POSE[JOINT_COUNT] = { ARM_ANGLE, ARM_ANGLE, 0.0f };
+    constexpr Vec2 JOINT_PIVOTS[JOINT_COUNT] = {
+        { LEFT_SHOULDER_X + ARM_WIDTH / 2.0f, SHOULDER_Y },
+        { RIGHT_SHOULDER_X - ARM_WIDTH / 2.0f, SHOULDER_Y },
+        { 0.0f, NECK_BASE_Y + NECK_HEIGHT }
+    };
+
+    // Counterclockwise rotation about the joint's pivot that takes its part from the rest
+    // pose to angle. The left arm points down-left, so it turns the other way round.
+    constexpr float jointRotation(Joint joint, float angle) {
+        return joint == JOINT_LEFT_ARM ? angle - ARM_ANGLE : (joint == JOINT_RIGHT_ARM ? ARM_ANGLE - angle : angle);
+    }
+
+    // Pixels a coarser outline may stray from the full one
+    constexpr float TESSELLATION_TOLERANCE = 0.25f;
+
+    // Coarsest of levelCount halvings of a closed outline of vertices points that stays within
+    // TESSELLATION_TOLERANCE of it at radiusPixels (the larger semi-axis of an ellipse). A
+    // chord of an n-gon strays r (1 - cos(pi / n)), about r pi^2 / 2n^2, from its circle.
+    constexpr int tessellationLevel(float radiusPixels, int vertices, int levelCount) {
+        int level = 0;
+        while (level + 1 < levelCount && vertices % (2 << level) == 0) {
+            const double n = (double)(vertices >> (level + 1));
+            if (radiusPixels * PI * PI / (2.0 * n * n) > TESSELLATION_TOLERANCE) break;
+            ++level;
+        }
+        return level;
+    }
+
+    // Hands follow the arm endpoints; wardrobe slot anchors come from avatar_options.json
+    constexpr Rect LEFT_HAND_RECT = { LEFT_ARM_END.x + 0.07f, LEFT_ARM_END.y - 0.09f, 0.18f, 0.22f };
+    constexpr Rect RIGHT_HAND_RECT = { RIGHT_ARM_END.x - 0.07f, RIGHT_ARM_END.y - 0.09f, 0.18f, 0.22f };
+
+    template <int N>
+    constexpr std::array<float, N * 2> makeUnitCircle() {
+        std::array<float, N * 2> points{};
+        for (int i = 0; i < N; ++i) {
+            double angle = 2.0 * PI * i / N;
+            points[i * 2] = (float)constCos(angle);
+            points[i * 2 + 1] = (float)constSin(angle);
+        }
+        return points;
+    }
+
+    constexpr std::array<float, HEAD_VERTICES * 2> UNIT_ELLIPSE = makeUnitCircle<HEAD_VERTICES>();
+
+    // Body mesh: position-only vertices, color comes from the draw call
+    constexpr MeshRange NECK = { 0, 6, false };
+    constexpr MeshRange HEAD = { NECK.first + NECK.count, HEAD_VERTICES, true };
+    constexpr MeshRange TORSO = { HEAD.first + HEAD.count, 12, false };
+    constexpr MeshRange LEFT_ARM = { TORSO.first + TORSO.count, 6, false };
+    constexpr MeshRange RIGHT_ARM = { LEFT_ARM.first + LEFT_ARM.count, 6, false };
+    constexpr MeshRange LEFT_LEG = { RIGHT_ARM.first + RIGHT_ARM.count, 6, false };
+    constexpr MeshRange RIGHT_LEG = { LEFT_LEG.first + LEFT_LEG.count, 6, false };
+    // Coarser heads follow the body, so the default pose stays one contiguous range
+    constexpr MeshRange HEAD_LEVELS[HEAD_LEVEL_COUNT] = {
+        HEAD,
+        { RIGHT_LEG.first + RIGHT_LEG.count, HEAD_VERTICES / 2, true },
+        { RIGHT_LEG.first + RIGHT_LEG.count + HEAD_VERTICES / 2, HEAD_VERTICES / 4, true },
+        { RIGHT_LEG.first + RIGHT_LEG.count + HEAD_VERTICES / 2 + HEAD_VERTICES / 4, HEAD_VERTICES / 8, true }
+    };
+    constexpr int BODY_VERTEX_COUNT = HEAD_LEVELS[HEAD_LEVEL_COUNT - 1].first + HEAD_LEVELS[HEAD_LEVEL_COUNT - 1].count;
+
+    struct BodyBuilder {
+        std::array<float, BODY_VERTEX_COUNT * 2> data{};
+        int count = 0;
+
+        constexpr void add(float x, float y) {
+            data[count * 2] = x;
+            data[count * 2 + 1] = y;
+            ++count;
+        }
+
+        // Quad corners in drawing order, split as (0, 1, 2) (2, 3, 0)
+        constexpr void addQuad(Vec2 a, Vec2 b, Vec2 c, Vec2 d) {
+            add(a.x, a.y); add(b.x, b.y); add(c.x, c.y);
+            add(c.x, c.y); add(d.x, d.y); add(a.x, a.y);
+        }
+    };
+
+    constexpr std::array<float, BODY_VERTEX_COUNT * 2> buildBody() {
+        BodyBuilder body;
+
+        body.addQuad({ -NECK_WIDTH / 2.0f, NECK_BASE_Y }, { NECK_WIDTH / 2.0f, NECK_BASE_Y },
+                     { NECK_WIDTH / 2.0f, NECK_BASE_Y + NECK_HEIGHT }, { -NECK_WIDTH / 2.0f, NECK_BASE_Y + NECK_HEIGHT });
+
+        for (int i = 0; i < HEAD_VERTICES; ++i) {
+            body.add(HEAD_A * UNIT_ELLIPSE[i * 2], HEAD_B * UNIT_ELLIPSE[i * 2 + 1] + HEAD_CENTER_Y);
+        }
+
+        // Torso: shoulders -> waist -> bottom
+        const Vec2 torso[] = {
+            { -0.2f, 0.22f }, { 0.2f, 0.22f },
+            { -0.15f, -0.3f }, { 0.15f, -0.3f },
+            { -0.2f, -0.5f }, { 0.2f, -0.5f }
+        };
+        const int torsoIndices[] = { 0, 1, 2, 2, 1, 3, 2, 3, 4, 4, 3, 5 };
+        for (int index : torsoIndices) {
+            body.add(torso[index].x, torso[index].y);
+        }
+
+        body.addQuad({ LEFT_SHOULDER_X, SHOULDER_Y }, { LEFT_SHOULDER_X + ARM_WIDTH, SHOULDER_Y },
+                     { LEFT_ARM_END.x + ARM_WIDTH, LEFT_ARM_END.y }, LEFT_ARM_END);
+        body.addQuad({ RIGHT_SHOULDER_X, SHOULDER_Y }, { RIGHT_SHOULDER_X - ARM_WIDTH, SHOULDER_Y },
+                     { RIGHT_ARM_END.x - ARM_WIDTH, RIGHT_ARM_END.y }, RIGHT_ARM_END);
+
+        const float leftLegX = -LEG_WIDTH - LEG_GAP / 2.0f;
+        const float rightLegX = LEG_GAP / 2.0f;
+        const float legBottomY = TORSO_BOTTOM_Y - LEG_LENGTH;
+        body.addQuad({ leftLegX, TORSO_BOTTOM_Y }, { leftLegX + LEG_WIDTH, TORSO_BOTTOM_Y },
+                     { leftLegX + LEG_WIDTH, legBottomY }, { leftLegX, legBottomY });
+        body.addQuad({ rightLegX, TORSO_BOTTOM_Y }, { rightLegX + LEG_WIDTH, TORSO_BOTTOM_Y },
+                     { rightLegX + LEG_WIDTH, legBottomY }, { rightLegX, legBottomY });
+
+        for (int level = 1; level < HEAD_LEVEL_COUNT; ++level) {
+            for (int i = 0; i < HEAD_VERTICES; i += 1 << level) {
+                body.add(HEAD_A * UNIT_ELLIPSE[i * 2], HEAD_B * UNIT_ELLIPSE[i * 2 + 1] + HEAD_CENTER_Y);
+            }
+        }
+
+        return body.data;
+    }
+
+    constexpr std::array<float, BODY_VERTEX_COUNT * 2> BODY_VERTICES = buildBody();
+
+    // Sprite mesh: one textured quad (two triangles, x/y/u/v) per layer, in this order
+    enum SpriteQuad {
+        SPRITE_LEFT_HAND,
+        SPRITE_RIGHT_HAND,
+        SPRITE_COUNT
+    };
+
+    constexpr int SPRITE_VERTICES_PER_QUAD = 6;
+    constexpr int SPRITE_FLOATS_PER_QUAD = SPRITE_VERTICES_PER_QUAD * 4;
+
+    // Writes the quad for rect into out; also used at runtime for the config-driven slots
+    constexpr void writeSpriteQuad(const Rect& rect, float* out) {
+        // Bottom-left, bottom-right, top-right, top-right, top-left, bottom-left
+        const float corners[6][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 1, 1 }, { 0, 1 }, { 0, 0 } };
+        int n = 0;
+        for (const auto& corner : corners) {
+            out[n++] = rect.centerX + (corner[0] - 0.5f) * rect.width;
+            out[n++] = rect.centerY + (corner[1] - 0.5f) * rect.height;
+            out[n++] = corner[0];
+            out[n++] = corner[1];
+        }
+    }
+
+    constexpr std::array<float, SPRITE_COUNT * SPRITE_FLOATS_PER_QUAD> buildSprites() {
+        std::array<float, SPRITE_COUNT * SPRITE_FLOATS_PER_QUAD> data{};
+        const Rect rects[SPRITE_COUNT] = { LEFT_HAND_RECT, RIGHT_HAND_RECT };
+        for (int i = 0; i < SPRITE_COUNT; ++i) {
+            float quad[SPRITE_FLOATS_PER_QUAD] = {};
+            writeSpriteQuad(rects[i], quad);
+            for (int k = 0; k < SPRITE_FLOATS_PER_QUAD; ++k) {
+                data[i * SPRITE_FLOATS_PER_QUAD + k] = quad[k];
+            }
+        }
+        return data;
+    }
+
+    constexpr std::array<float, SPRITE_COUNT * SPRITE_FLOATS_PER_QUAD> SPRITE_VERTICES = buildSprites();
+
+    constexpr int spriteFirstVertex(SpriteQuad quad) {
+        return quad * SPRITE_VERTICES_PER_QUAD;
+    }
+}
+
+#endif
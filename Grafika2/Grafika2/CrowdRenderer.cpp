@@ -0,0 +1,349 @@
+#include "CrowdRenderer.h"
+#include "AvatarGeometry.h"
+#include "ImageStore.h"
+#include "Resampler.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+    // Sprite layers of one avatar in the instance record
+    enum { LAYER_LEFT_HAND, LAYER_RIGHT_HAND, LAYER_FIRST_SLOT, LAYER_COUNT = LAYER_FIRST_SLOT + SlotRegistry::MAX_SLOTS };
+
+    // One avatar in the instance buffer, 140 bytes
+    struct Instance {
+        float transform[4];
+        float depth;
+        float rotations[AvatarGeometry::JOINT_COUNT + 1][2];  // (cosine, sine) per joint, then the identity
+        unsigned char colors[Avatar::COLOR_COUNT][4];
+        uint16_t layers[LAYER_COUNT];
+    };
+
+    enum Attribute {
+        ATTRIBUTE_POSITION,
+        ATTRIBUTE_TEX_COORD,
+        ATTRIBUTE_TRANSFORM,
+        ATTRIBUTE_DEPTH,
+        ATTRIBUTE_COLOR,
+        ATTRIBUTE_LAYER,
+        ATTRIBUTE_ROTATION
+    };
+
+    // Rotation entry of parts that do not turn
+    constexpr int NO_JOINT = AvatarGeometry::JOINT_COUNT;
+
+    // The rig's 200-vertex head dominates a crowd frame (four fifths on llvmpipe). 48 segments
+    // stay within a third of a pixel of the ellipse up to heads 300 pixels wide.
+    constexpr int CROWD_HEAD_VERTICES = 48;
+    constexpr std::array<float, CROWD_HEAD_VERTICES * 2> UNIT_HEAD = AvatarGeometry::makeUnitCircle<CROWD_HEAD_VERTICES>();
+
+    // Palette entries are clamped by the RGBA8 target anyway
+    unsigned char toByte(float value) {
+        return (unsigned char)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+}
+
+CrowdRenderer::CrowdRenderer(Scene& scene, int layerSize)
+    : scene(scene), shader("crowdVertex.vert", "crowdFragment.frag"), layerSize(layerSize),
+      instanceCapacity(0), textureArray(0), arrayTextureCount(0), instanceCount(0), wornSlots(0), posedJoints(0) {
+    stats = { 0, 0 };
+    transformLocation = glGetUniformLocation(shader.getID(), "viewTransform");
+    texturedLocation = glGetUniformLocation(shader.getID(), "textured");
+    pivotLocation = glGetUniformLocation(shader.getID(), "pivot");
+    layerScalesLocation = glGetUniformLocation(shader.getID(), "layerScales");
+    shader.use();
+    shader.setInt("items", 0);
+    glUseProgram(0);
+
+    float head[CROWD_HEAD_VERTICES * 2];
+    for (int i = 0; i < CROWD_HEAD_VERTICES; ++i) {
+        head[i * 2] = AvatarGeometry::HEAD_A * UNIT_HEAD[i * 2];
+        head[i * 2 + 1] = AvatarGeometry::HEAD_B * UNIT_HEAD[i * 2 + 1] + AvatarGeometry::HEAD_CENTER_Y;
+    }
+    glGenBuffers(1, &headVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, headVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(head), head, GL_STATIC_DRAW);
+
+    glGenBuffers(1, &instanceBuffer);
+    glGenVertexArrays(1, &bodyVAO);
+    glGenVertexArrays(1, &headVAO);
+    glGenVertexArrays(1, &spriteVAO);
+    bindInstanceAttributes(bodyVAO, scene.bodyVBO, false);
+    bindInstanceAttributes(headVAO, headVBO, false);
+    bindInstanceAttributes(spriteVAO, scene.spriteVBO, true);
+}
+
+CrowdRenderer::~CrowdRenderer() {
+    glDeleteVertexArrays(1, &bodyVAO);
+    glDeleteVertexArrays(1, &headVAO);
+    glDeleteVertexArrays(1, &spriteVAO);
+    glDeleteBuffers(1, &headVBO);
+    glDeleteBuffers(1, &instanceBuffer);
+    if (textureArray != 0) glDeleteTextures(1, &textureArray);
+}
+
+void CrowdRenderer::bindInstanceAttributes(GLuint vao, GLuint vertexBuffer, bool sprite) {
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    if (sprite) {
+        glVertexAttribPointer(ATTRIBUTE_POSITION, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+        glVertexAttribPointer(ATTRIBUTE_TEX_COORD, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+        glEnableVertexAttribArray(ATTRIBUTE_TEX_COORD);
+    }
+    else {
+        glVertexAttribPointer(ATTRIBUTE_POSITION, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    }
+    glEnableVertexAttribArray(ATTRIBUTE_POSITION);
+
+    // Advancing once per avatar; the color or layer and the rotation pointers are aimed at one
+    // entry per draw
+    const Attribute perInstance[] = {
+        ATTRIBUTE_TRANSFORM, ATTRIBUTE_DEPTH, ATTRIBUTE_ROTATION, sprite ? ATTRIBUTE_LAYER : ATTRIBUTE_COLOR
+    };
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glVertexAttribPointer(ATTRIBUTE_TRANSFORM, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, transform));
+    glVertexAttribPointer(ATTRIBUTE_DEPTH, 1, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, depth));
+    glVertexAttribPointer(ATTRIBUTE_ROTATION, 2, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                          (void*)(offsetof(Instance, rotations) + NO_JOINT * 2 * sizeof(float)));
+    if (sprite) {
+        glVertexAttribIPointer(ATTRIBUTE_LAYER, 1, GL_UNSIGNED_SHORT, sizeof(Instance), (void*)offsetof(Instance, layers));
+    }
+    else {
+        glVertexAttribPointer(ATTRIBUTE_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance), (void*)offsetof(Instance, colors));
+    }
+    for (Attribute attribute : perInstance) {
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribDivisor(attribute, 1);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void CrowdRenderer::updateTextureArray() {
+    const std::unordered_map<std::string, GLuint>& entries = scene.getTextures().getEntries();
+    if (textureArray != 0 && entries.size() == arrayTextureCount) return;
+    arrayTextureCount = entries.size();
+
+    // Sorted by path so layer numbers do not depend on hash order
+    std::vector<std::pair<std::string, GLuint>> sorted;
+    for (const auto& entry : entries) {
+        if (entry.second != 0) sorted.push_back(entry);
+    }
+    std::sort(sorted.begin(), sorted.end());
+    if ((int)sorted.size() > MAX_LAYERS) {
+        std::cerr << "Crowd rendering supports " << MAX_LAYERS << " item images, " << sorted.size() - MAX_LAYERS
+                  << " will not be drawn" << std::endl;
+        sorted.resize(MAX_LAYERS);
+    }
+    layers.clear();
+    std::vector<float> scales(sorted.size() * 2, 1.0f);
+
+    if (textureArray == 0) glGenTextures(1, &textureArray);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, layerSize, layerSize, std::max<GLsizei>(1, (GLsizei)sorted.size()), 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    std::vector<unsigned char> rgba;
+    std::vector<unsigned char> layer((size_t)layerSize * layerSize * 4);
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        const DecodedImage* image = ImageStore::shared().get(sorted[i].first);
+        if (image == nullptr) continue;
+        const unsigned char* pixels = image->pixels.data();
+        if (image->channels != 4) {
+            // RGB items get an opaque alpha channel
+            rgba.resize((size_t)image->width * image->height * 4);
+            for (size_t p = 0; p < (size_t)image->width * image->height; ++p) {
+                std::memcpy(&rgba[p * 4], &image->pixels[p * image->channels], 3);
+                rgba[p * 4 + 3] = 255;
+            }
+            pixels = rgba.data();
+        }
+        // Stretching to the square would make mip selection blur the long side of wide items
+        // (lips, eyes); the item fills the lower-left part instead and the rest stays empty
+        int width = layerSize, height = layerSize;
+        if (image->width >= image->height) {
+            height = std::max(1, (int)((long long)layerSize * image->height / image->width));
+        }
+        else {
+            width = std::max(1, (int)((long long)layerSize * image->width / image->height));
+        }
+        std::fill(layer.begin(), layer.end(), 0);
+        Resampler::resize(pixels, image->width, image->height, 0, layer.data(), width, height, (ptrdiff_t)layerSize * 4,
+                          Resampler::FILTER_MITCHELL, false);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)i, layerSize, layerSize, 1, GL_RGBA, GL_UNSIGNED_BYTE, layer.data());
+        layers[sorted[i].second] = (uint16_t)i;
+        scales[i * 2] = (float)width / layerSize;
+        scales[i * 2 + 1] = (float)height / layerSize;
+    }
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    if (!scales.empty()) {
+        shader.use();
+        glUniform2fv(layerScalesLocation, (GLsizei)sorted.size(), scales.data());
+        glUseProgram(0);
+    }
+}
+
+uint16_t CrowdRenderer::findLayer(GLuint texture) const {
+    auto found = layers.find(texture);
+    return found != layers.end() ? found->second : NO_LAYER;
+}
+
+void CrowdRenderer::updateInstances() {
+    order.clear();
+    for (int i = 0; i < scene.getAvatarCount(); ++i) {
+        if (scene.getAvatar(i).visible) order.push_back(i);
+    }
+    // Back to front inside every instanced draw, so blended edges mostly land on what is behind
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return scene.getAvatar(a).depth < scene.getAvatar(b).depth;
+    });
+    instanceCount = (int)order.size();
+    int depthLevels = 0;
+    for (int i = 0; i < instanceCount; ++i) {
+        if (i == 0 || scene.getAvatar(order[i]).depth != scene.getAvatar(order[i - 1]).depth) ++depthLevels;
+    }
+
+    const uint16_t leftHand = findLayer(scene.leftHandTexture);
+    const uint16_t rightHand = findLayer(scene.rightHandTexture);
+    instances.resize((size_t)instanceCount * sizeof(Instance));
+    Instance* out = (Instance*)instances.data();
+    wornSlots = 0;
+    posedJoints = 0;
+    int level = -1;
+    for (int i = 0; i < instanceCount; ++i) {
+        const SceneAvatar& avatar = scene.getAvatar(order[i]);
+        if (i == 0 || avatar.depth != scene.getAvatar(order[i - 1]).depth) ++level;
+
+        Instance& instance = out[i];
+        std::memcpy(instance.transform, avatar.transform, sizeof(instance.transform));
+        // Highest scene depth is nearest: smallest NDC z
+        instance.depth = 1.0f - (2.0f * level + 1.0f) / depthLevels;
+        for (int joint = 0; joint <= NO_JOINT; ++joint) {
+            instance.rotations[joint][0] = 1.0f;
+            instance.rotations[joint][1] = 0.0f;
+            if (joint == NO_JOINT || avatar.pose[joint] == AvatarGeometry::REST_POSE[joint]) continue;
+            const float rotation = AvatarGeometry::jointRotation((AvatarGeometry::Joint)joint, avatar.pose[joint]);
+            instance.rotations[joint][0] = std::cos(rotation);
+            instance.rotations[joint][1] = std::sin(rotation);
+            posedJoints |= 1u << joint;
+        }
+        for (int color = 0; color < Avatar::COLOR_COUNT; ++color) {
+            instance.colors[color][0] = toByte(avatar.colors[color][0]);
+            instance.colors[color][1] = toByte(avatar.colors[color][1]);
+            instance.colors[color][2] = toByte(avatar.colors[color][2]);
+            instance.colors[color][3] = 255;
+        }
+        instance.layers[LAYER_LEFT_HAND] = leftHand;
+        instance.layers[LAYER_RIGHT_HAND] = rightHand;
+        for (int slot = 0; slot < SlotRegistry::MAX_SLOTS; ++slot) {
+            bool worn = (avatar.occupiedSlots & (1u << slot)) != 0;
+            instance.layers[LAYER_FIRST_SLOT + slot] = worn ? findLayer(avatar.slotTextures[slot]) : NO_LAYER;
+        }
+        wornSlots |= avatar.occupiedSlots;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    const GLsizeiptr size = (GLsizeiptr)instances.size();
+    if (size > instanceCapacity) {
+        instanceCapacity = std::max(size, instanceCapacity * 2);
+        glBufferData(GL_ARRAY_BUFFER, instanceCapacity, nullptr, GL_STREAM_DRAW);
+    }
+    if (size > 0) {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, instances.data());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void CrowdRenderer::draw(const float* viewTransform) {
+    using namespace AvatarGeometry;
+    static const float identity[4] = { 1.0f, 1.0f, 0.0f, 0.0f };
+    if (viewTransform == nullptr) viewTransform = identity;
+    stats = { 0, 0 };
+
+    updateTextureArray();
+    updateInstances();
+    stats.instances = instanceCount;
+    if (instanceCount == 0) return;
+
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LEQUAL);     // Layers of one avatar share its depth and paint in order
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    shader.use();
+    glUniform4fv(transformLocation, 1, viewTransform);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+    // Parts of a joint no avatar has posed use the identity with a zero pivot, so crowds in
+    // the rest pose draw bit for bit as without posing
+    auto setJoint = [&](int joint) {
+        if (joint != NO_JOINT && (posedJoints & (1u << joint)) == 0) joint = NO_JOINT;
+        if (joint != NO_JOINT) glUniform2f(pivotLocation, JOINT_PIVOTS[joint].x, JOINT_PIVOTS[joint].y);
+        else glUniform2f(pivotLocation, 0.0f, 0.0f);
+        glVertexAttribPointer(ATTRIBUTE_ROTATION, 2, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                              (void*)(offsetof(Instance, rotations) + joint * 2 * sizeof(float)));
+    };
+    auto drawBody = [&](GLuint vao, const MeshRange& range, Avatar::AvatarColor color, int joint) {
+        glBindVertexArray(vao);
+        glUniform1i(texturedLocation, 0);
+        glVertexAttribPointer(ATTRIBUTE_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance),
+                              (void*)(offsetof(Instance, colors) + color * 4));
+        setJoint(joint);
+        glDrawArraysInstanced(range.fan ? GL_TRIANGLE_FAN : GL_TRIANGLES, range.first, range.count, instanceCount);
+        ++stats.drawCalls;
+    };
+    auto drawSprite = [&](int layer, int firstVertex, int joint) {
+        glBindVertexArray(spriteVAO);
+        glUniform1i(texturedLocation, 1);
+        glVertexAttribIPointer(ATTRIBUTE_LAYER, 1, GL_UNSIGNED_SHORT, sizeof(Instance),
+                               (void*)(offsetof(Instance, layers) + layer * sizeof(uint16_t)));
+        setJoint(joint);
+        glDrawArraysInstanced(GL_TRIANGLES, firstVertex, SPRITE_VERTICES_PER_QUAD, instanceCount);
+        ++stats.drawCalls;
+    };
+
+    // Scene::draw order, one call per layer for all avatars
+    drawBody(bodyVAO, NECK, Avatar::COLOR_SKIN, NO_JOINT);
+    drawBody(headVAO, { 0, CROWD_HEAD_VERTICES, true }, Avatar::COLOR_FACE, JOINT_HEAD);
+    if ((posedJoints & ((1u << JOINT_LEFT_ARM) | (1u << JOINT_RIGHT_ARM))) != 0) {
+        // Posed arms turn apart from the torso, so the merged range splits in three
+        drawBody(bodyVAO, TORSO, Avatar::COLOR_SKIN, NO_JOINT);
+        drawBody(bodyVAO, LEFT_ARM, Avatar::COLOR_SKIN, JOINT_LEFT_ARM);
+        drawBody(bodyVAO, RIGHT_ARM, Avatar::COLOR_SKIN, JOINT_RIGHT_ARM);
+    }
+    else {
+        drawBody(bodyVAO, { TORSO.first, RIGHT_ARM.first + RIGHT_ARM.count - TORSO.first, false }, Avatar::COLOR_SKIN, NO_JOINT);
+    }
+    drawSprite(LAYER_LEFT_HAND, spriteFirstVertex(SPRITE_LEFT_HAND), JOINT_LEFT_ARM);
+    drawSprite(LAYER_RIGHT_HAND, spriteFirstVertex(SPRITE_RIGHT_HAND), JOINT_RIGHT_ARM);
+    drawBody(bodyVAO, { LEFT_LEG.first, RIGHT_LEG.first + RIGHT_LEG.count - LEFT_LEG.first, false }, Avatar::COLOR_SKIN, NO_JOINT);
+    for (int slot : scene.getSlots().getDrawOrder()) {
+        if ((wornSlots & (1u << slot)) == 0) continue;
+        drawSprite(LAYER_FIRST_SLOT + slot, (SPRITE_COUNT + slot) * SPRITE_VERTICES_PER_QUAD,
+                   scene.getSlots().getSlot(slot).followsHead ? JOINT_HEAD : NO_JOINT);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glUseProgram(0);
+    glDisable(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+}
+
+const CrowdRenderer::DrawStats& CrowdRenderer::getStats() const {
+    return stats;
+}
@@ -0,0 +1,73 @@
+#ifndef CROWD_RENDERER_H
+#define CROWD_RENDERER_H
+
+#include "Scene.h"
+#include "Shader.h"
+#include <GL/glew.h>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Instanced drawing of a Scene for crowds of thousands. Every avatar becomes one record of
+// an instance buffer: transform, depth, palette as RGBA8 and a texture array layer per
+// sprite (hands, then slots). Each avatar layer is then a single instanced draw for the
+// whole crowd, about a dozen draws whatever the avatar count; the per-layer color or
+// texture layer is picked by moving one attribute pointer inside the instance record. The
+// head is a 48-segment ellipse of its own instead of the rig's 200 vertices.
+// Poses are drawn as by Scene::draw: the record holds each joint's rotation, aimed at the
+// same way, and once any avatar has posed arms the torso and arms take three draws.
+//
+// Item images are resampled into one mipmapped texture array of layerSize squares, keeping
+// their aspect ratio (the filled part of each layer is a uniform), so the crowd is slightly
+// softer than Scene::draw at close range. Layers of different avatars
+// are no longer painted in avatar order: avatars get a depth value from their Scene depth
+// and the depth test keeps nearer ones in front, so the target needs a depth buffer,
+// cleared before draw().
+class CrowdRenderer {
+public:
+    // Counters of the last draw()
+    struct DrawStats {
+        int drawCalls;
+        int instances;
+    };
+
+    CrowdRenderer(Scene& scene, int layerSize = 256);
+    ~CrowdRenderer();
+
+    // Draws every visible avatar of the scene; viewTransform as for Scene::draw
+    void draw(const float* viewTransform = nullptr);
+    const DrawStats& getStats() const;
+
+private:
+    static const uint16_t NO_LAYER = 0xFFFF;
+    static const int MAX_LAYERS = 128;  // Size of layerScales in crowdVertex.vert
+
+    void updateTextureArray();
+    void updateInstances();
+    void bindInstanceAttributes(GLuint vao, GLuint vertexBuffer, bool sprite);
+    uint16_t findLayer(GLuint texture) const;
+
+    Scene& scene;
+    Shader shader;
+    int layerSize;
+    GLint transformLocation, texturedLocation, layerScalesLocation, pivotLocation;
+    DrawStats stats;
+
+    GLuint bodyVAO, headVAO, spriteVAO; // Vertex buffers plus the instance attributes
+    GLuint headVBO;
+    GLuint instanceBuffer;
+    GLsizeiptr instanceCapacity;    // Bytes
+    GLuint textureArray;
+    size_t arrayTextureCount;       // Registry size the array was built for
+    std::unordered_map<GLuint, uint16_t> layers;
+    std::vector<unsigned char> instances;
+    std::vector<int> order;
+    int instanceCount;
+    uint32_t wornSlots;             // Slots worn by at least one avatar
+    uint32_t posedJoints;           // Joints out of the rest pose on at least one avatar
+
+    CrowdRenderer(const CrowdRenderer&) = delete;
+    CrowdRenderer& operator=(const CrowdRenderer&) = delete;
+};
+
+#endif
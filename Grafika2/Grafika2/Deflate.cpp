@@ -0,0 +1,309 @@
+#include "Deflate.h"
+#include <cstdint>
+#include <cstring>
+
+namespace {
+    const int MIN_MATCH = 3;
+    const int MAX_MATCH = 258;
+    const int WINDOW_SIZE = 32768;
+    const int HASH_BITS = 15;
+
+    const int LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const int LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                   3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    const int DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                    8193, 12289, 16385, 24577 };
+    const int DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                     7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    struct LevelSettings {
+        int maxChain;     // Candidates checked per position
+        int niceLength;   // Stop searching once a match is this long
+        bool lazy;        // Try one position later before taking a match
+        bool insertAll;   // Hash every position inside matches, not only their start
+    };
+
+    const LevelSettings LEVELS[10] = {
+        { 0, 0, false, false },
+        { 4, 16, false, false },
+        { 8, 32, false, true },
+        { 16, 64, false, true },
+        { 16, 128, true, true },
+        { 32, 128, true, true },
+        { 64, 258, true, true },
+        { 128, 258, true, true },
+        { 512, 258, true, true },
+        { 4096, 258, true, true }
+    };
+
+    unsigned int reverseBits(unsigned int code, int length) {
+        unsigned int reversed = 0;
+        for (int i = 0; i < length; ++i) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        return reversed;
+    }
+
+    // Fixed Huffman code (RFC 1951, 3.2.6), bit-reversed because deflate writes codes MSB first
+    struct FixedCodes {
+        unsigned short literalCode[288];
+        unsigned char literalLength[288];
+        unsigned short distanceCode[30];
+        unsigned char lengthSymbol[MAX_MATCH + 1];
+        unsigned char distanceSymbol[512];   // [d - 1] below 257, [256 + ((d - 1) >> 7)] above
+
+        FixedCodes() {
+            for (int symbol = 0; symbol < 288; ++symbol) {
+                unsigned int code;
+                int length;
+                if (symbol < 144) { code = 0x30 + symbol; length = 8; }
+                else if (symbol < 256) { code = 0x190 + (symbol - 144); length = 9; }
+                else if (symbol < 280) { code = symbol - 256; length = 7; }
+                else { code = 0xC0 + (symbol - 280); length = 8; }
+                literalCode[symbol] = (unsigned short)reverseBits(code, length);
+                literalLength[symbol] = (unsigned char)length;
+            }
+            for (int symbol = 0; symbol < 30; ++symbol) {
+                distanceCode[symbol] = (unsigned short)reverseBits(symbol, 5);
+            }
+            for (int symbol = 0; symbol < 29; ++symbol) {
+                int end = symbol + 1 < 29 ? LENGTH_BASE[symbol + 1] : MAX_MATCH + 1;
+                for (int length = LENGTH_BASE[symbol]; length < end; ++length) {
+                    lengthSymbol[length] = (unsigned char)symbol;
+                }
+            }
+            lengthSymbol[MAX_MATCH] = 28;
+            for (int symbol = 0; symbol < 30; ++symbol) {
+                int end = symbol + 1 < 30 ? DISTANCE_BASE[symbol + 1] : WINDOW_SIZE + 1;
+                for (int distance = DISTANCE_BASE[symbol]; distance < end; ++distance) {
+                    if (distance <= 256) distanceSymbol[distance - 1] = (unsigned char)symbol;
+                    else distanceSymbol[256 + ((distance - 1) >> 7)] = (unsigned char)symbol;
+                }
+            }
+        }
+    };
+
+    const FixedCodes& fixedCodes() {
+        static const FixedCodes codes;
+        return codes;
+    }
+
+    class BitWriter {
+    public:
+        BitWriter(std::vector<unsigned char>& out) : out(out), bits(0), count(0) {}
+
+        void put(unsigned int value, int length) {
+            bits |= (uint64_t)value << count;
+            count += length;
+            while (count >= 8) {
+                out.push_back((unsigned char)bits);
+                bits >>= 8;
+                count -= 8;
+            }
+        }
+
+        void alignToByte() {
+            if (count > 0) {
+                out.push_back((unsigned char)bits);
+                bits = 0;
+                count = 0;
+            }
+        }
+
+    private:
+        std::vector<unsigned char>& out;
+        uint64_t bits;
+        int count;
+    };
+
+    void writeStored(const unsigned char* data, size_t size, bool final, std::vector<unsigned char>& out) {
+        size_t offset = 0;
+        do {
+            size_t block = size - offset;
+            if (block > 65535) block = 65535;
+            bool last = offset + block == size;
+            out.push_back((last && final) ? 1 : 0);
+            out.push_back((unsigned char)block);
+            out.push_back((unsigned char)(block >> 8));
+            out.push_back((unsigned char)~block);
+            out.push_back((unsigned char)(~block >> 8));
+            out.insert(out.end(), data + offset, data + offset + block);
+            offset += block;
+        } while (offset < size);
+    }
+
+    class Compressor {
+    public:
+        Compressor(const unsigned char* data, size_t size, const LevelSettings& settings, BitWriter& writer)
+            : data(data), size(size), settings(settings), writer(writer), codes(fixedCodes()),
+              head(1 << HASH_BITS, -1), previous(WINDOW_SIZE, -1), nextInsert(0) {
+        }
+
+        void run() {
+            size_t pos = 0;
+            int length = 0, distance = 0;
+            findMatch(pos, length, distance);
+
+            while (pos < size) {
+                if (length < MIN_MATCH) {
+                    writeLiteral(data[pos]);
+                    ++pos;
+                    findMatch(pos, length, distance);
+                    continue;
+                }
+
+                if (settings.lazy && length < settings.niceLength && pos + 1 < size) {
+                    int nextLength, nextDistance;
+                    findMatch(pos + 1, nextLength, nextDistance);
+                    if (nextLength > length) {
+                        // A longer match starts one byte later: emit this byte on its own
+                        writeLiteral(data[pos]);
+                        ++pos;
+                        length = nextLength;
+                        distance = nextDistance;
+                        continue;
+                    }
+                }
+
+                writeMatch(length, distance);
+                pos += length;
+                if (!settings.insertAll && nextInsert < pos) {
+                    nextInsert = pos;
+                }
+                findMatch(pos, length, distance);
+            }
+        }
+
+    private:
+        const unsigned char* data;
+        size_t size;
+        const LevelSettings& settings;
+        BitWriter& writer;
+        const FixedCodes& codes;
+        std::vector<int> head;
+        std::vector<int> previous;
+        size_t nextInsert;
+
+        unsigned int hashAt(size_t pos) const {
+            uint32_t value = data[pos] | (data[pos + 1] << 8) | (data[pos + 2] << 16);
+            return (value * 2654435761u) >> (32 - HASH_BITS);
+        }
+
+        // Adds every position before end to the hash chains
+        void insertUpTo(size_t end) {
+            if (end + MIN_MATCH > size) end = size >= (size_t)MIN_MATCH ? size - MIN_MATCH + 1 : 0;
+            for (; nextInsert < end; ++nextInsert) {
+                unsigned int hash = hashAt(nextInsert);
+                previous[nextInsert & (WINDOW_SIZE - 1)] = head[hash];
+                head[hash] = (int)nextInsert;
+            }
+        }
+
+        void findMatch(size_t pos, int& bestLength, int& bestDistance) {
+            bestLength = 0;
+            bestDistance = 0;
+            insertUpTo(pos);
+            if (pos + MIN_MATCH > size) return;
+
+            int maxLength = (int)(size - pos < (size_t)MAX_MATCH ? size - pos : MAX_MATCH);
+            const unsigned char* current = data + pos;
+            int candidate = head[hashAt(pos)];
+            int chain = settings.maxChain;
+            while (candidate >= 0 && chain-- > 0 && pos - candidate <= (size_t)WINDOW_SIZE) {
+                const unsigned char* match = data + candidate;
+                // Cheap reject: a longer match has to agree at the current best length
+                if (match[bestLength] == current[bestLength] && match[0] == current[0]) {
+                    int length = 0;
+                    while (length < maxLength && match[length] == current[length]) ++length;
+                    if (length > bestLength) {
+                        bestLength = length;
+                        bestDistance = (int)(pos - candidate);
+                        if (length >= settings.niceLength || length == maxLength) break;
+                    }
+                }
+                int next = previous[candidate & (WINDOW_SIZE - 1)];
+                if (next >= candidate) break; // Slot was overwritten by a newer position
+                candidate = next;
+            }
+            insertUpTo(pos + 1);
+        }
+
+        void writeLiteral(unsigned char value) {
+            writer.put(codes.literalCode[value], codes.literalLength[value]);
+        }
+
+        void writeMatch(int length, int distance) {
+            int lengthSymbol = codes.lengthSymbol[length];
+            int symbol = 257 + lengthSymbol;
+            writer.put(codes.literalCode[symbol], codes.literalLength[symbol]);
+            if (LENGTH_EXTRA[lengthSymbol] > 0) {
+                writer.put(length - LENGTH_BASE[lengthSymbol], LENGTH_EXTRA[lengthSymbol]);
+            }
+
+            int distanceSymbol = distance <= 256 ? codes.distanceSymbol[distance - 1] : codes.distanceSymbol[256 + ((distance - 1) >> 7)];
+            writer.put(codes.distanceCode[distanceSymbol], 5);
+            if (DISTANCE_EXTRA[distanceSymbol] > 0) {
+                writer.put(distance - DISTANCE_BASE[distanceSymbol], DISTANCE_EXTRA[distanceSymbol]);
+            }
+        }
+    };
+}
+
+void Deflate::compress(const unsigned char* data, size_t size, int level, bool final, std::vector<unsigned char>& out) {
+    if (level < 0) level = 0;
+    if (level > 9) level = 9;
+    if (level == 0) {
+        // Stored blocks end byte aligned, a non-final piece needs no extra flush
+        writeStored(data, size, final, out);
+        return;
+    }
+
+    BitWriter writer(out);
+    writer.put(final ? 1 : 0, 1);
+    writer.put(1, 2); // Fixed Huffman block
+    Compressor compressor(data, size, LEVELS[level], writer);
+    compressor.run();
+    writer.put(fixedCodes().literalCode[256], fixedCodes().literalLength[256]); // End of block
+
+    if (!final) {
+        // Sync flush: an empty stored block realigns the stream to a byte boundary
+        writer.put(0, 3);
+        writer.alignToByte();
+        out.push_back(0x00);
+        out.push_back(0x00);
+        out.push_back(0xFF);
+        out.push_back(0xFF);
+    }
+    writer.alignToByte();
+}
+
+unsigned int Deflate::adler32(const unsigned char* data, size_t length, unsigned int adler) {
+    unsigned int a = adler & 0xFFFF;
+    unsigned int b = adler >> 16;
+    while (length > 0) {
+        // 5552 bytes is the most that can be summed before the 32-bit sums can overflow
+        size_t block = length < 5552 ? length : 5552;
+        length -= block;
+        while (block-- > 0) {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+unsigned int Deflate::adler32Combine(unsigned int adlerA, unsigned int adlerB, size_t lengthB) {
+    const uint64_t BASE = 65521;
+    uint64_t remainder = lengthB % BASE;
+    uint64_t sum1 = adlerA & 0xFFFF;
+    uint64_t sum2 = (remainder * sum1) % BASE;
+    sum1 += (adlerB & 0xFFFF) + BASE - 1;
+    sum2 += (adlerA >> 16) + (adlerB >> 16) + BASE - remainder;
+    sum1 %= BASE;
+    sum2 %= BASE;
+    return (unsigned int)((sum2 << 16) | sum1);
+}
@@ -0,0 +1,23 @@
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+#include <cstddef>
+#include <vector>
+
+// Small deflate (RFC 1951) compressor for the image encoders, so exports need no zlib.
+// Level 0 writes stored blocks; levels 1-9 use LZ77 with hash chains of growing length
+// (lazy matching from level 4) and the fixed Huffman code.
+//
+// Streams can be built in pieces: a piece compressed with final = false ends on a byte
+// boundary after a sync flush, so independently compressed pieces can be concatenated
+// into one valid stream. The image encoders compress strips in parallel this way.
+class Deflate {
+public:
+    static void compress(const unsigned char* data, size_t size, int level, bool final, std::vector<unsigned char>& out);
+
+    static unsigned int adler32(const unsigned char* data, size_t length, unsigned int adler = 1);
+    // Adler-32 of A followed by B, from the checksums of A and B and the length of B
+    static unsigned int adler32Combine(unsigned int adlerA, unsigned int adlerB, size_t lengthB);
+};
+
+#endif
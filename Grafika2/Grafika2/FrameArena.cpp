@@ -0,0 +1,57 @@
+#include "FrameArena.h"
+#include <new>
+
+FrameArena::FrameArena(size_t capacity)
+    : buffer(static_cast<unsigned char*>(::operator new(capacity))),
+      capacity(capacity), offset(0), overflowBytes(0) {
+}
+
+FrameArena::~FrameArena() {
+    reset();
+    ::operator delete(buffer);
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment) {
+    size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+    if (aligned + size <= capacity) {
+        offset = aligned + size;
+        return buffer + aligned;
+    }
+
+    // Out of space: serve this frame from the heap and grow the arena on reset,
+    // so only the warm-up frames ever take this path
+    void* block = ::operator new(size);
+    overflowBlocks.push_back(block);
+    overflowBytes += size + alignment;
+    return block;
+}
+
+void FrameArena::reset() {
+    for (void* block : overflowBlocks) {
+        ::operator delete(block);
+    }
+    overflowBlocks.clear();
+
+    if (overflowBytes > 0) {
+        size_t newCapacity = capacity + overflowBytes;
+        if (newCapacity < capacity * 2) newCapacity = capacity * 2;
+        ::operator delete(buffer);
+        buffer = static_cast<unsigned char*>(::operator new(newCapacity));
+        capacity = newCapacity;
+        overflowBytes = 0;
+    }
+    offset = 0;
+}
+
+size_t FrameArena::getUsed() {
+    return offset;
+}
+
+size_t FrameArena::getCapacity() {
+    return capacity;
+}
+
+FrameArena& FrameArena::forThread() {
+    thread_local FrameArena arena(256 * 1024);
+    return arena;
+}
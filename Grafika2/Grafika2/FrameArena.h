@@ -0,0 +1,39 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+// Linear allocator for data that only lives until the end of the current frame
+// (transient vertices, draw command lists). Allocation is a pointer bump and reset()
+// releases everything at once. Each thread gets its own arena, so there is no locking.
+class FrameArena {
+public:
+    explicit FrameArena(size_t capacity);
+    ~FrameArena();
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    void reset();
+
+    template <typename T>
+    T* allocateArray(size_t count) {
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    size_t getUsed();
+    size_t getCapacity();
+
+    static FrameArena& forThread();
+
+private:
+    unsigned char* buffer;
+    size_t capacity;
+    size_t offset;
+    size_t overflowBytes;
+    std::vector<void*> overflowBlocks;
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+};
+
+#endif
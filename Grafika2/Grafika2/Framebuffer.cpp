@@ -0,0 +1,110 @@
+#include "Framebuffer.h"
+#include <algorithm>
+#include <iostream>
+
+Framebuffer::Framebuffer()
+    : fbo(0), colorTexture(0), depthBuffer(0), width(0), height(0) {
+}
+
+Framebuffer::~Framebuffer() {
+    destroy();
+}
+
+bool Framebuffer::create(int w, int h) {
+    destroy();
+    width = w;
+    height = h;
+
+    glGenTextures(1, &colorTexture);
+    glBindTexture(GL_TEXTURE_2D, colorTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Framebuffer incomplete (" << width << "x" << height << "): 0x" << std::hex << status << std::dec << std::endl;
+        destroy();
+        return false;
+    }
+    return true;
+}
+
+void Framebuffer::destroy() {
+    if (fbo != 0) glDeleteFramebuffers(1, &fbo);
+    if (depthBuffer != 0) glDeleteRenderbuffers(1, &depthBuffer);
+    if (colorTexture != 0) glDeleteTextures(1, &colorTexture);
+    fbo = 0;
+    depthBuffer = 0;
+    colorTexture = 0;
+    width = 0;
+    height = 0;
+}
+
+void Framebuffer::bind() {
+    bindViewport(width, height);
+}
+
+// Binds the target but only renders into the lower-left viewportWidth x viewportHeight region,
+// so the storage can stay allocated at its maximum size while the used area changes.
+void Framebuffer::bindViewport(int viewportWidth, int viewportHeight) {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, viewportWidth, viewportHeight);
+}
+
+void Framebuffer::blitTo(GLuint targetFramebuffer, int srcWidth, int srcHeight, int dstWidth, int dstHeight, GLenum filter) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFramebuffer);
+    glBlitFramebuffer(0, 0, srcWidth, srcHeight, 0, 0, dstWidth, dstHeight, GL_COLOR_BUFFER_BIT, filter);
+    glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+}
+
+GLuint Framebuffer::getID() {
+    return fbo;
+}
+
+GLuint Framebuffer::getColorTexture() {
+    return colorTexture;
+}
+
+int Framebuffer::getWidth() {
+    return width;
+}
+
+int Framebuffer::getHeight() {
+    return height;
+}
+
+void Framebuffer::readPixels(std::vector<unsigned char>& rgba) {
+    const size_t rowSize = (size_t)width * 4;
+    rgba.resize(rowSize * height);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+
+    // GL rows start at the bottom
+    std::vector<unsigned char> row(rowSize);
+    for (int y = 0; y < height / 2; ++y) {
+        unsigned char* top = rgba.data() + y * rowSize;
+        unsigned char* bottom = rgba.data() + (height - 1 - y) * rowSize;
+        std::copy(top, top + rowSize, row.data());
+        std::copy(bottom, bottom + rowSize, top);
+        std::copy(row.data(), row.data() + rowSize, bottom);
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <GL/glew.h>
+#include <vector>
+
+// Offscreen color target (RGBA8 texture + depth/stencil renderbuffer).
+class Framebuffer {
+public:
+    Framebuffer();
+    ~Framebuffer();
+
+    bool create(int width, int height);
+    void destroy();
+    void bind();
+    void bindViewport(int viewportWidth, int viewportHeight);
+    void blitTo(GLuint targetFramebuffer, int srcWidth, int srcHeight, int dstWidth, int dstHeight, GLenum filter);
+    // Reads the whole color target as RGBA8, first row at the top (image order)
+    void readPixels(std::vector<unsigned char>& rgba);
+
+    GLuint getID();
+    GLuint getColorTexture();
+    int getWidth();
+    int getHeight();
+
+private:
+    GLuint fbo;
+    GLuint colorTexture;
+    GLuint depthBuffer;
+    int width;
+    int height;
+
+    Framebuffer(const Framebuffer&) = delete;
+    Framebuffer& operator=(const Framebuffer&) = delete;
+};
+
+#endif
@@ -0,0 +1,73 @@
+#include "ImagePyramid.h"
+#include <algorithm>
+#include <cstdio>
+
+void ImagePyramid::build(const unsigned char* pixels, int width, int height, ptrdiff_t stride, const std::vector<Size>& sizes,
+                         Resampler::Filter filter, int threads) {
+    if (stride == 0) stride = (ptrdiff_t)width * 4;
+    levels.clear();
+
+    // Largest first, so every level can come from the one made before it
+    std::vector<Size> order(sizes);
+    std::sort(order.begin(), order.end(), [](const Size& a, const Size& b) {
+        return (long long)a.width * a.height > (long long)b.width * b.height;
+    });
+    storage.resize(order.size());
+    levels.reserve(order.size());
+
+    Level source = { width, height, pixels, stride };
+    for (size_t i = 0; i < order.size(); ++i) {
+        const Size& size = order[i];
+        if (size.width > width || size.height > height || find(size.width, size.height) != nullptr) continue;
+        if (size.width == width && size.height == height) {
+            levels.push_back(source);
+            continue;
+        }
+
+        // Smallest level so far that still covers this size in both directions
+        const Level* from = &source;
+        for (const Level& level : levels) {
+            if (level.width >= size.width && level.height >= size.height &&
+                (long long)level.width * level.height < (long long)from->width * from->height) {
+                from = &level;
+            }
+        }
+
+        std::vector<unsigned char>& buffer = storage[i];
+        buffer.resize((size_t)size.width * size.height * 4);
+        Resampler::resize(from->pixels, from->width, from->height, from->stride,
+                          buffer.data(), size.width, size.height, 0, filter, false, threads);
+        levels.push_back({ size.width, size.height, buffer.data(), (ptrdiff_t)size.width * 4 });
+    }
+}
+
+const ImagePyramid::Level* ImagePyramid::find(int width, int height) const {
+    for (const Level& level : levels) {
+        if (level.width == width && level.height == height) return &level;
+    }
+    return nullptr;
+}
+
+const std::vector<ImagePyramid::Level>& ImagePyramid::getLevels() const {
+    return levels;
+}
+
+bool ImagePyramid::parseSizes(const char* text, std::vector<Size>& sizes) {
+    sizes.clear();
+    while (*text != '\0') {
+        Size size;
+        int consumed = 0;
+        if (std::sscanf(text, "%dx%d%n", &size.width, &size.height, &consumed) != 2 || size.width <= 0 || size.height <= 0) {
+            return false;
+        }
+        sizes.push_back(size);
+        text += consumed;
+        if (*text == ',') {
+            ++text;
+        }
+        else if (*text != '\0') {
+            return false;
+        }
+    }
+    return !sizes.empty();
+}
@@ -0,0 +1,46 @@
+#ifndef IMAGE_PYRAMID_H
+#define IMAGE_PYRAMID_H
+
+#include "Resampler.h"
+#include <cstddef>
+#include <vector>
+
+// Several sizes of one rendered image, made with a single downsample cascade: every size
+// is filtered from the smallest one already made that covers it, largest first, so each
+// step only reduces a few times. A size equal to the source is the source itself.
+//
+// Built once per image and kept per thread; the storage is reused between builds, so the
+// same pyramid can feed several outputs (files, encodings) without filtering twice.
+class ImagePyramid {
+public:
+    struct Size {
+        int width;
+        int height;
+    };
+
+    // pixels and stride as in Resampler (negative strides read bottom-up buffers); a
+    // level that points at the source is valid only as long as the source is
+    struct Level {
+        int width;
+        int height;
+        const unsigned char* pixels;
+        ptrdiff_t stride;
+    };
+
+    // Sizes larger than the source in either direction are skipped
+    void build(const unsigned char* pixels, int width, int height, ptrdiff_t stride, const std::vector<Size>& sizes,
+               Resampler::Filter filter, int threads = 1);
+
+    // Level of exactly this size, or null if it was not built
+    const Level* find(int width, int height) const;
+    const std::vector<Level>& getLevels() const;
+
+    // "48x60,128x160" into sizes; false on malformed input
+    static bool parseSizes(const char* text, std::vector<Size>& sizes);
+
+private:
+    std::vector<Level> levels;
+    std::vector<std::vector<unsigned char>> storage;
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include "ImageStore.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <iostream>
+
+int DecodedImage::getLevelCount() const {
+    return 1 + (int)levels.size();
+}
+
+int DecodedImage::getLevelWidth(int level) const {
+    return std::max(1, width >> level);
+}
+
+int DecodedImage::getLevelHeight(int level) const {
+    return std::max(1, height >> level);
+}
+
+const unsigned char* DecodedImage::getLevelPixels(int level) const {
+    return level == 0 ? pixels.data() : levels[level - 1].data();
+}
+
+// Taps of a box filter from sourceSize texels down to size: target texel x averages the
+// source span [x * ratio, (x + 1) * ratio), each texel weighted by how much of it is inside.
+// The ratio is 2 for even sizes and up to 3 for odd ones, so a span touches at most 4 texels.
+static const int MAX_TAPS = 4;
+
+static void boxTaps(int sourceSize, int size, std::vector<int>& first, std::vector<float>& weights) {
+    first.assign(size, 0);
+    weights.assign((size_t)size * MAX_TAPS, 0.0f);
+    const double ratio = (double)sourceSize / size;
+    for (int x = 0; x < size; ++x) {
+        const double begin = x * ratio;
+        const double end = (x + 1) * ratio;
+        first[x] = (int)begin;
+        for (int tap = 0; tap < MAX_TAPS; ++tap) {
+            const int texel = first[x] + tap;
+            const double overlap = std::min(end, texel + 1.0) - std::max(begin, (double)texel);
+            if (texel < sourceSize && overlap > 0.0) weights[(size_t)x * MAX_TAPS + tap] = (float)(overlap / ratio);
+        }
+    }
+}
+
+static void buildLevels(DecodedImage& image) {
+    const int channels = image.channels;
+    std::vector<int> firstX, firstY;
+    std::vector<float> weightsX, weightsY;
+    std::vector<float> rows;
+    for (int level = 1; image.getLevelWidth(level - 1) > 1 || image.getLevelHeight(level - 1) > 1; ++level) {
+        const int sourceWidth = image.getLevelWidth(level - 1);
+        const int sourceHeight = image.getLevelHeight(level - 1);
+        const int width = image.getLevelWidth(level);
+        const int height = image.getLevelHeight(level);
+        const unsigned char* source = image.getLevelPixels(level - 1);
+        boxTaps(sourceWidth, width, firstX, weightsX);
+        boxTaps(sourceHeight, height, firstY, weightsY);
+
+        // Across first, every source row
+        rows.assign((size_t)width * sourceHeight * channels, 0.0f);
+        for (int y = 0; y < sourceHeight; ++y) {
+            const unsigned char* in = source + (size_t)y * sourceWidth * channels;
+            float* out = &rows[(size_t)y * width * channels];
+            for (int x = 0; x < width; ++x) {
+                for (int tap = 0; tap < MAX_TAPS; ++tap) {
+                    const float weight = weightsX[(size_t)x * MAX_TAPS + tap];
+                    if (weight == 0.0f) continue;
+                    const unsigned char* texel = in + (size_t)(firstX[x] + tap) * channels;
+                    for (int c = 0; c < channels; ++c) out[x * channels + c] += weight * texel[c];
+                }
+            }
+        }
+        // Then down
+        std::vector<unsigned char> pixels((size_t)width * height * channels);
+        const size_t rowFloats = (size_t)width * channels;
+        for (int y = 0; y < height; ++y) {
+            unsigned char* out = &pixels[y * rowFloats];
+            for (size_t i = 0; i < rowFloats; ++i) {
+                float sum = 0.0f;
+                for (int tap = 0; tap < MAX_TAPS; ++tap) {
+                    const float weight = weightsY[(size_t)y * MAX_TAPS + tap];
+                    if (weight != 0.0f) sum += weight * rows[(firstY[y] + tap) * rowFloats + i];
+                }
+                out[i] = (unsigned char)std::min(255.0f, sum + 0.5f);
+            }
+        }
+        image.levels.push_back(std::move(pixels));
+    }
+}
+
+ImageStore& ImageStore::shared() {
+    static ImageStore store;
+    return store;
+}
+
+const DecodedImage* ImageStore::get(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = images.find(path);
+        if (found != images.end()) return found->second.get();
+    }
+
+    // Decode outside the lock so threads asking for different files don't wait on each other
+    std::unique_ptr<DecodedImage> image;
+    int width, height, channels;
+    stbi_set_flip_vertically_on_load_thread(true);
+    unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 0);
+    if (data) {
+        image.reset(new DecodedImage());
+        image->width = width;
+        image->height = height;
+        image->channels = channels;
+        image->pixels.assign(data, data + (size_t)width * height * channels);
+        stbi_image_free(data);
+        image->mask.build(image->pixels.data(), width, height, channels);
+        buildLevels(*image);
+    }
+    else {
+        std::cerr << "Failed to load image: " << path << std::endl;
+    }
+
+    // Two threads may have decoded the same file; the first one stored wins.
+    // Failures are cached too so a missing file is reported once.
+    std::lock_guard<std::mutex> lock(mutex);
+    auto inserted = images.emplace(path, std::move(image));
+    return inserted.first->second.get();
+}
+
+void ImageStore::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    images.clear();
+}
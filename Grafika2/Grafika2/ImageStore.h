@@ -0,0 +1,46 @@
+#ifndef IMAGE_STORE_H
+#define IMAGE_STORE_H
+
+#include "AlphaMask.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Decoded image, rows bottom-up as glTexImage2D expects
+struct DecodedImage {
+    int width;
+    int height;
+    int channels;
+    std::vector<unsigned char> pixels;
+    // Mip levels from 1 down to 1x1, sized as GL sizes them (half the level before, rounded
+    // down, at least 1), each texel the average of its exact footprint in the level before,
+    // so odd sizes do not drift. A texture can be uploaded from any level down.
+    std::vector<std::vector<unsigned char>> levels;
+    AlphaMask mask;     // Built with the decode, for picking the layers drawn from this image
+
+    int getLevelCount() const;
+    int getLevelWidth(int level) const;
+    int getLevelHeight(int level) const;
+    const unsigned char* getLevelPixels(int level) const;
+};
+
+// Process-wide cache of decoded image files. Each file is decoded once and then only read,
+// so render threads with separate GL contexts share the pixels and only upload them.
+class ImageStore {
+public:
+    static ImageStore& shared();
+
+    // Decodes path on first use, nullptr if it cannot be read. Safe to call from any thread;
+    // returned images stay valid until clear().
+    const DecodedImage* get(const std::string& path);
+
+    void clear();
+
+private:
+    std::mutex mutex;
+    std::unordered_map<std::string, std::unique_ptr<DecodedImage>> images;
+};
+
+#endif
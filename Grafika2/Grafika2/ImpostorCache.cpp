@@ -0,0 +1,264 @@
+#include "ImpostorCache.h"
+#include "AvatarGeometry.h"
+#include "Scene.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+bool ImpostorCache::Look::operator==(const Look& other) const {
+    return std::memcmp(colors, other.colors, sizeof(colors)) == 0 && std::memcmp(textures, other.textures, sizeof(textures)) == 0;
+}
+
+ImpostorCache::ImpostorCache(Scene& scene, int maxSize, int requestedCellSize, int atlasSize)
+    : scene(scene), maxSize(maxSize), cellSize(1), drawIndex(0), atlas(0), framebuffer(0), quadVAO(0), quadVBO(0) {
+    stats = { 0, 0, 0, 0 };
+    while (cellSize < requestedCellSize) cellSize *= 2;
+    cellsPerRow = std::max(1, atlasSize / cellSize);
+    atlasSize = cellsPerRow * cellSize;
+    cellCount = cellsPerRow * cellsPerRow;
+    cellData.resize(cellCount);
+
+    // Mip levels stop at 8x8 cells; below that an avatar is a smudge anyway
+    int levels = 0;
+    while ((cellSize >> levels) > 8) ++levels;
+    glGenTextures(1, &atlas);
+    glBindTexture(GL_TEXTURE_2D, atlas);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasSize, atlasSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    GLint previous = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlas, 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, previous);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Impostor atlas incomplete (" << atlasSize << "x" << atlasSize << "): 0x" << std::hex << status << std::dec
+                  << ", drawing every avatar in full" << std::endl;
+        this->maxSize = 0;
+    }
+
+    // The quad of a cell covers the avatar's bounds, like the cell it was rendered to; items
+    // such as the pants reach past the avatar's NDC square
+    using namespace AvatarGeometry;
+    const SpatialIndex::Bounds& bounds = scene.localBounds;
+    const Rect area = { (bounds.minX + bounds.maxX) * 0.5f, (bounds.minY + bounds.maxY) * 0.5f,
+                        bounds.maxX - bounds.minX, bounds.maxY - bounds.minY };
+    std::vector<float> quads((size_t)cellCount * SPRITE_FLOATS_PER_QUAD);
+    for (int cell = 0; cell < cellCount; ++cell) {
+        float* quad = &quads[(size_t)cell * SPRITE_FLOATS_PER_QUAD];
+        writeSpriteQuad(area, quad);
+        const float x = (float)(cell % cellsPerRow) / cellsPerRow;
+        const float y = (float)(cell / cellsPerRow) / cellsPerRow;
+        for (int vertex = 0; vertex < SPRITE_VERTICES_PER_QUAD; ++vertex) {
+            quad[vertex * 4 + 2] = x + quad[vertex * 4 + 2] / cellsPerRow;
+            quad[vertex * 4 + 3] = y + quad[vertex * 4 + 3] / cellsPerRow;
+        }
+    }
+    glGenVertexArrays(1, &quadVAO);
+    glGenBuffers(1, &quadVBO);
+    glBindVertexArray(quadVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, quads.size() * sizeof(float), quads.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+ImpostorCache::~ImpostorCache() {
+    glDeleteVertexArrays(1, &quadVAO);
+    glDeleteBuffers(1, &quadVBO);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &atlas);
+}
+
+void ImpostorCache::setMaxSize(int pixels) {
+    maxSize = pixels;
+}
+
+int ImpostorCache::getMaxSize() const {
+    return maxSize;
+}
+
+void ImpostorCache::clear() {
+    recent.clear();
+    lookup.clear();
+    avatarStates.clear();
+}
+
+const ImpostorCache::Stats& ImpostorCache::getStats() const {
+    return stats;
+}
+
+int ImpostorCache::getCell(int avatar) const {
+    return avatar < (int)avatarCells.size() ? avatarCells[avatar] : -1;
+}
+
+GLuint ImpostorCache::getTexture() const {
+    return atlas;
+}
+
+GLuint ImpostorCache::getVAO() const {
+    return quadVAO;
+}
+
+void ImpostorCache::buildLook(int index, Look& look) const {
+    const SceneAvatar& avatar = scene.avatars[index];
+    std::memcpy(look.colors, avatar.colors, sizeof(look.colors));
+    for (int slot = 0; slot < SlotRegistry::MAX_SLOTS; ++slot) {
+        look.textures[slot] = (avatar.occupiedSlots & (1u << slot)) != 0 ? avatar.slotTextures[slot] : 0;
+    }
+    // FNV-1a over the bytes compared by operator==
+    uint64_t hash = 14695981039346656037ull;
+    const unsigned char* bytes = (const unsigned char*)look.colors;
+    for (size_t i = 0; i < sizeof(look.colors); ++i) hash = (hash ^ bytes[i]) * 1099511628211ull;
+    bytes = (const unsigned char*)look.textures;
+    for (size_t i = 0; i < sizeof(look.textures); ++i) hash = (hash ^ bytes[i]) * 1099511628211ull;
+    look.hash = (size_t)hash;
+}
+
+int ImpostorCache::find(const Look& look) {
+    auto found = lookup.find(look);
+    if (found == lookup.end()) return -1;
+    Cell& cell = cellData[found->second];
+    cell.lastUsed = drawIndex;
+    recent.splice(recent.begin(), recent, cell.position);
+    return found->second;
+}
+
+int ImpostorCache::acquire(const Look& look, bool& created) {
+    created = false;
+    int index = find(look);
+    if (index >= 0) return index;
+
+    // Cells are handed out in order until the atlas is full, then the least recently used is
+    // taken over unless this draw needs it too
+    index = (int)recent.size();
+    if (index == cellCount) {
+        index = recent.back();
+        if (cellData[index].lastUsed == drawIndex) return -1;
+        lookup.erase(cellData[index].look);
+        recent.pop_back();
+        ++stats.evicted;
+    }
+    Cell& cell = cellData[index];
+    cell.look = look;
+    cell.lastUsed = drawIndex;
+    recent.push_front(index);
+    cell.position = recent.begin();
+    lookup[look] = index;
+    created = true;
+    return index;
+}
+
+void ImpostorCache::render(int avatar, int cell) {
+    const int x = (cell % cellsPerRow) * cellSize;
+    const int y = (cell / cellsPerRow) * cellSize;
+    glViewport(x, y, cellSize, cellSize);
+    glScissor(x, y, cellSize, cellSize);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // Layers come out of appendItems in drawing order, one avatar needs no sort. The
+    // avatar's bounds fill the cell.
+    scene.items.clear();
+    scene.appendItems(avatar);
+    const SpatialIndex::Bounds& bounds = scene.localBounds;
+    const float width = bounds.maxX - bounds.minX;
+    const float height = bounds.maxY - bounds.minY;
+    const float toCell[4] = { 2.0f / width, 2.0f / height, -(bounds.minX + bounds.maxX) / width, -(bounds.minY + bounds.maxY) / height };
+    scene.drawItems(toCell, true);
+    ++stats.rendered;
+}
+
+void ImpostorCache::update(const float* viewTransform, const std::vector<int>& candidates) {
+    ++drawIndex;
+    stats = { 0, 0, 0, 0 };
+    const int count = scene.getAvatarCount();
+    avatarCells.assign(count, -1);
+    if (maxSize <= 0) return;
+    if ((int)avatarStates.size() < count) {
+        AvatarState unknown = {};
+        unknown.revision = ~0u;
+        avatarStates.resize(count, unknown);
+    }
+
+    // The avatar's NDC space spans the viewport at scale 1, in whichever framebuffer is bound;
+    // its bounds, which the cell holds, are measured in that space
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    const SpatialIndex::Bounds& bounds = scene.localBounds;
+    const float boundsWidth = (bounds.maxX - bounds.minX) * 0.5f;
+    const float boundsHeight = (bounds.maxY - bounds.minY) * 0.5f;
+    missing.clear();
+    for (int i : candidates) {
+        const SceneAvatar& avatar = scene.avatars[i];
+        const float width = std::fabs(avatar.transform[0] * viewTransform[0]) * viewport[2] * boundsWidth;
+        const float height = std::fabs(avatar.transform[1] * viewTransform[1]) * viewport[3] * boundsHeight;
+        if (width > maxSize || height > maxSize) continue;
+        // A pose changes from frame to frame when animated; a cell per pose would only churn
+        if (avatar.isPosed()) continue;
+
+        AvatarState& state = avatarStates[i];
+        if (state.revision != avatar.revision) {
+            buildLook(i, state.look);
+            state.revision = avatar.revision;
+        }
+        avatarCells[i] = find(state.look);
+        if (avatarCells[i] < 0) missing.push_back(i);
+    }
+    // Cells are only handed out once every hit of this draw is marked as used, so a new look
+    // never evicts one that is needed further down the list
+    size_t created = 0;
+    for (int i : missing) {
+        bool fresh;
+        avatarCells[i] = acquire(avatarStates[i].look, fresh);
+        if (fresh) missing[created++] = i;
+    }
+    missing.resize(created);
+    for (int cell : avatarCells) {
+        if (cell >= 0) ++stats.impostors;
+    }
+    stats.cellsInUse = (int)recent.size();
+    if (missing.empty()) return;
+
+    GLint previousFramebuffer = 0;
+    GLint scissorBox[4];
+    GLfloat clearColor[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_SCISSOR_BOX, scissorBox);
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+    const GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+
+    // A cell is rendered once per look, so its items get every level the cell needs right away
+    for (int i : missing) {
+        scene.requestLevels(i, cellSize * 0.5f / boundsWidth, cellSize * 0.5f / boundsHeight);
+    }
+    scene.textures->streamAll();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glEnable(GL_SCISSOR_TEST);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    for (int i : missing) {
+        render(i, avatarCells[i]);
+    }
+    glBindTexture(GL_TEXTURE_2D, atlas);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    glScissor(scissorBox[0], scissorBox[1], scissorBox[2], scissorBox[3]);
+    if (!scissor) glDisable(GL_SCISSOR_TEST);
+}
@@ -0,0 +1,112 @@
+#ifndef IMPOSTOR_CACHE_H
+#define IMPOSTOR_CACHE_H
+
+#include "Avatar.h"
+#include "SlotRegistry.h"
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+class Scene;
+
+// Pre-rendered avatars for Scene::draw. An avatar whose bounds cover at most maxSize pixels
+// on the target is drawn as one quad from a shared atlas instead of its dozen layers. Each
+// distinct look (palette plus worn item images) is rendered once into a square cell of the
+// atlas with premultiplied alpha and mipmapped, and reused by every avatar that looks the
+// same. The cache is keyed by the look itself, so changing a color or slot of an avatar
+// moves it to another cell on the next draw; cells nobody used recently are recycled
+// (least recently used first). If every cell is needed by the current draw, the remaining
+// small avatars are drawn in full, and so are avatars out of their rest pose.
+class ImpostorCache {
+public:
+    // Counters of the last update()
+    struct Stats {
+        int impostors;      // Avatars drawn from the atlas
+        int rendered;       // Cells rendered (first use or changed look)
+        int evicted;        // Cells taken over from another look
+        int cellsInUse;
+    };
+
+    // cellSize is rounded up to a power of two, so mip levels never mix neighbouring cells
+    ImpostorCache(Scene& scene, int maxSize = 64, int cellSize = 128, int atlasSize = 2048);
+    ~ImpostorCache();
+
+    // Avatars whose bounds are at most this many pixels wide and tall use the atlas; 0 turns
+    // impostors off
+    void setMaxSize(int pixels);
+    int getMaxSize() const;
+    // Forgets every cell, for example after the scene's textures were reloaded
+    void clear();
+    const Stats& getStats() const;
+
+private:
+    friend class Scene;
+
+    // Everything that changes how an avatar looks in its own space
+    struct Look {
+        float colors[Avatar::COLOR_COUNT][3];
+        GLuint textures[SlotRegistry::MAX_SLOTS];   // 0 for slots not worn
+        size_t hash;
+
+        bool operator==(const Look& other) const;
+    };
+
+    struct LookHash {
+        size_t operator()(const Look& look) const {
+            return look.hash;
+        }
+    };
+
+    struct AvatarState {
+        uint32_t revision;  // SceneAvatar::revision the look was built from
+        Look look;
+    };
+
+    struct Cell {
+        Look look;
+        uint64_t lastUsed;  // Draw the cell was last used in
+        std::list<int>::iterator position;
+    };
+
+    // Called by Scene::draw once palettes are uploaded, with the visible avatars in view:
+    // picks those drawn as impostors and renders the cells they are missing; getCell() then
+    // answers per avatar.
+    void update(const float* viewTransform, const std::vector<int>& candidates);
+    int getCell(int avatar) const;
+    GLuint getTexture() const;
+    GLuint getVAO() const;
+
+    // Cell holding look, marked as used by this draw; -1 if there is none
+    int find(const Look& look);
+    // Cell holding look, -1 if the atlas is full of looks this draw uses; created means the
+    // cell is new to the look and has to be rendered
+    int acquire(const Look& look, bool& created);
+    void render(int avatar, int cell);
+    void buildLook(int avatar, Look& look) const;
+
+    Scene& scene;
+    int maxSize;
+    int cellSize;
+    int cellsPerRow;
+    int cellCount;
+    Stats stats;
+    uint64_t drawIndex;
+
+    GLuint atlas;
+    GLuint framebuffer;
+    GLuint quadVAO, quadVBO;    // One sprite quad per cell, texture coordinates on the cell
+    std::vector<Cell> cellData;
+    std::list<int> recent;      // Cells in use, most recently used first
+    std::unordered_map<Look, int, LookHash> lookup;
+    std::vector<AvatarState> avatarStates;
+    std::vector<int> avatarCells;   // Per avatar: cell for this draw, -1 when drawn in full
+    std::vector<int> missing;       // Avatars whose look has no cell yet
+
+    ImpostorCache(const ImpostorCache&) = delete;
+    ImpostorCache& operator=(const ImpostorCache&) = delete;
+};
+
+#endif
@@ -0,0 +1,292 @@
+#include "Json.h"
+#include <charconv>
+#include <fstream>
+#include <sstream>
+
+class JsonParser {
+public:
+    JsonParser(const std::string& text) : text(text), pos(0), depth(0) {}
+
+    bool parseDocument(JsonValue& out, std::string& error) {
+        if (!parseValue(out)) {
+            error = message;
+            return false;
+        }
+        skipWhitespace();
+        if (pos != text.size()) {
+            error = "unexpected trailing data at offset " + std::to_string(pos);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    const std::string& text;
+    size_t pos;
+    int depth;      // Arrays and objects open around pos
+    std::string message;
+
+    bool fail(const char* what) {
+        message = std::string(what) + " at offset " + std::to_string(pos);
+        return false;
+    }
+
+    void skipWhitespace() {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r')) {
+            ++pos;
+        }
+        // Tolerate a UTF-8 byte order mark, Visual Studio adds one when saving
+        if (pos == 0 && text.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+            pos = 3;
+            skipWhitespace();
+        }
+    }
+
+    bool matchLiteral(const char* literal) {
+        size_t length = std::char_traits<char>::length(literal);
+        if (text.compare(pos, length, literal) != 0) return false;
+        pos += length;
+        return true;
+    }
+
+    bool parseValue(JsonValue& out) {
+        skipWhitespace();
+        if (pos >= text.size()) return fail("unexpected end of input");
+
+        char c = text[pos];
+        if (c == '{' || c == '[') {
+            if (depth == JsonValue::MAX_DEPTH) return fail("nesting too deep");
+            ++depth;
+            const bool parsed = c == '{' ? parseObject(out) : parseArray(out);
+            --depth;
+            return parsed;
+        }
+        if (c == '"') {
+            out.type = JsonValue::String;
+            return parseString(out.stringValue);
+        }
+        if (matchLiteral("true")) {
+            out.type = JsonValue::Bool;
+            out.boolValue = true;
+            return true;
+        }
+        if (matchLiteral("false")) {
+            out.type = JsonValue::Bool;
+            out.boolValue = false;
+            return true;
+        }
+        if (matchLiteral("null")) {
+            out.type = JsonValue::Null;
+            return true;
+        }
+        return parseNumber(out);
+    }
+
+    bool isDigit(size_t at) const {
+        return at < text.size() && text[at] >= '0' && text[at] <= '9';
+    }
+
+    bool parseNumber(JsonValue& out) {
+        // -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?, so nan, inf, hex and a leading +
+        // are rejected instead of taken by the conversion
+        const size_t start = pos;
+        size_t end = pos;
+        if (end < text.size() && text[end] == '-') ++end;
+        if (!isDigit(end)) return fail("invalid value");
+        if (text[end] == '0') ++end;
+        else while (isDigit(end)) ++end;
+        if (end < text.size() && text[end] == '.') {
+            if (!isDigit(++end)) return fail("invalid number");
+            while (isDigit(end)) ++end;
+        }
+        if (end < text.size() && (text[end] == 'e' || text[end] == 'E')) {
+            ++end;
+            if (end < text.size() && (text[end] == '+' || text[end] == '-')) ++end;
+            if (!isDigit(end)) return fail("invalid number");
+            while (isDigit(end)) ++end;
+        }
+
+        // from_chars ignores the locale, unlike strtod
+        double value = 0.0;
+        const std::from_chars_result result = std::from_chars(text.data() + start, text.data() + end, value);
+        if (result.ec == std::errc::result_out_of_range) return fail("number out of range");
+        if (result.ec != std::errc() || result.ptr != text.data() + end) return fail("invalid number");
+        pos = end;
+        out.type = JsonValue::Number;
+        out.numberValue = value;
+        return true;
+    }
+
+    bool parseString(std::string& out) {
+        ++pos; // Opening quote
+        while (pos < text.size() && text[pos] != '"') {
+            char c = text[pos++];
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (pos >= text.size()) break;
+            char escaped = text[pos++];
+            switch (escaped) {
+            case 'n': out += '\n'; break;
+            case 't': out += '\t'; break;
+            case 'r': out += '\r'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'u': {
+                if (pos + 4 > text.size()) return fail("truncated \\u escape");
+                unsigned long code = 0;
+                for (size_t end = pos + 4; pos < end; ++pos) {
+                    const char digit = text[pos];
+                    int nibble;
+                    if (digit >= '0' && digit <= '9') nibble = digit - '0';
+                    else if (digit >= 'a' && digit <= 'f') nibble = digit - 'a' + 10;
+                    else if (digit >= 'A' && digit <= 'F') nibble = digit - 'A' + 10;
+                    else return fail("invalid \\u escape");
+                    code = code << 4 | nibble;
+                }
+                // Basic multilingual plane only, encoded as UTF-8
+                if (code < 0x80) {
+                    out += (char)code;
+                }
+                else if (code < 0x800) {
+                    out += (char)(0xC0 | (code >> 6));
+                    out += (char)(0x80 | (code & 0x3F));
+                }
+                else {
+                    out += (char)(0xE0 | (code >> 12));
+                    out += (char)(0x80 | ((code >> 6) & 0x3F));
+                    out += (char)(0x80 | (code & 0x3F));
+                }
+                break;
+            }
+            default: out += escaped; break;
+            }
+        }
+        if (pos >= text.size()) return fail("unterminated string");
+        ++pos; // Closing quote
+        return true;
+    }
+
+    bool parseArray(JsonValue& out) {
+        out.type = JsonValue::Array;
+        ++pos;
+        skipWhitespace();
+        if (pos < text.size() && text[pos] == ']') {
+            ++pos;
+            return true;
+        }
+        while (true) {
+            out.items.emplace_back();
+            if (!parseValue(out.items.back())) return false;
+            skipWhitespace();
+            if (pos < text.size() && text[pos] == ',') {
+                ++pos;
+                continue;
+            }
+            if (pos < text.size() && text[pos] == ']') {
+                ++pos;
+                return true;
+            }
+            return fail("expected ',' or ']'");
+        }
+    }
+
+    bool parseObject(JsonValue& out) {
+        out.type = JsonValue::Object;
+        ++pos;
+        skipWhitespace();
+        if (pos < text.size() && text[pos] == '}') {
+            ++pos;
+            return true;
+        }
+        while (true) {
+            skipWhitespace();
+            if (pos >= text.size() || text[pos] != '"') return fail("expected object key");
+            std::string key;
+            if (!parseString(key)) return false;
+            skipWhitespace();
+            if (pos >= text.size() || text[pos] != ':') return fail("expected ':'");
+            ++pos;
+            out.members.emplace_back(key, JsonValue());
+            if (!parseValue(out.members.back().second)) return false;
+            skipWhitespace();
+            if (pos < text.size() && text[pos] == ',') {
+                ++pos;
+                continue;
+            }
+            if (pos < text.size() && text[pos] == '}') {
+                ++pos;
+                return true;
+            }
+            return fail("expected ',' or '}'");
+        }
+    }
+};
+
+JsonValue::JsonValue() : type(Null), boolValue(false), numberValue(0.0) {
+}
+
+bool JsonValue::parse(const std::string& text, JsonValue& out, std::string& error) {
+    out = JsonValue();
+    JsonParser parser(text);
+    return parser.parseDocument(out, error);
+}
+
+bool JsonValue::parseFile(const std::string& path, JsonValue& out, std::string& error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return parse(buffer.str(), out, error);
+}
+
+JsonValue::Type JsonValue::getType() const {
+    return type;
+}
+
+bool JsonValue::isArray() const {
+    return type == Array;
+}
+
+bool JsonValue::isObject() const {
+    return type == Object;
+}
+
+bool JsonValue::asBool(bool fallback) const {
+    return type == Bool ? boolValue : fallback;
+}
+
+double JsonValue::asNumber(double fallback) const {
+    return type == Number ? numberValue : fallback;
+}
+
+const std::string& JsonValue::asString() const {
+    return stringValue;
+}
+
+size_t JsonValue::size() const {
+    return type == Array ? items.size() : members.size();
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const {
+    return items[index];
+}
+
+const JsonValue* JsonValue::find(const char* key) const {
+    for (const auto& member : members) {
+        if (member.first == key) return &member.second;
+    }
+    return nullptr;
+}
+
+const std::vector<JsonValue>& JsonValue::getItems() const {
+    return items;
+}
+
+const std::vector<std::pair<std::string, JsonValue>>& JsonValue::getMembers() const {
+    return members;
+}
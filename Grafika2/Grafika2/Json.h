@@ -0,0 +1,48 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal JSON reader for the config files (objects, arrays, strings, numbers, booleans, null).
+class JsonValue {
+public:
+    enum Type { Null, Bool, Number, String, Array, Object };
+
+    // Arrays and objects nested deeper than this fail to parse, so hostile input (the render
+    // server parses requests from its socket) cannot exhaust the stack
+    static const int MAX_DEPTH = 64;
+
+    JsonValue();
+
+    static bool parse(const std::string& text, JsonValue& out, std::string& error);
+    static bool parseFile(const std::string& path, JsonValue& out, std::string& error);
+
+    Type getType() const;
+    bool isArray() const;
+    bool isObject() const;
+
+    bool asBool(bool fallback = false) const;
+    double asNumber(double fallback = 0.0) const;
+    const std::string& asString() const;
+
+    size_t size() const;
+    const JsonValue& operator[](size_t index) const;
+    const JsonValue* find(const char* key) const;
+
+    const std::vector<JsonValue>& getItems() const;
+    const std::vector<std::pair<std::string, JsonValue>>& getMembers() const;
+
+private:
+    Type type;
+    bool boolValue;
+    double numberValue;
+    std::string stringValue;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    friend class JsonParser;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "MappedFile.h"
+#include <iostream>
+
+#if defined(_WIN32)
+#define MAPPED_FILE_WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : data(nullptr), size(0), opened(false), fileHandle(nullptr), mappingHandle(nullptr) {
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+#ifdef MAPPED_FILE_WIN32
+    // Shared for writing, so the file can be appended to while it is mapped
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        std::cerr << "Failed to read the size of " << path << std::endl;
+        return false;
+    }
+    size = (size_t)fileSize.QuadPart;
+    fileHandle = file;
+    opened = true;
+    if (size == 0) return true;     // Empty files cannot be mapped, and need not be
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (view == nullptr) {
+        if (mapping != nullptr) CloseHandle(mapping);
+        close();
+        std::cerr << "Failed to map " << path << std::endl;
+        return false;
+    }
+    mappingHandle = mapping;
+    data = (const unsigned char*)view;
+#else
+    const int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    struct stat status;
+    if (fstat(file, &status) != 0) {
+        ::close(file);
+        std::cerr << "Failed to read the size of " << path << std::endl;
+        return false;
+    }
+    size = (size_t)status.st_size;
+    if (size > 0) {
+        void* view = mmap(nullptr, size, PROT_READ, MAP_SHARED, file, 0);
+        if (view == MAP_FAILED) {
+            ::close(file);
+            size = 0;
+            std::cerr << "Failed to map " << path << std::endl;
+            return false;
+        }
+        data = (const unsigned char*)view;
+    }
+    // The mapping keeps the file alive on its own
+    ::close(file);
+    opened = true;
+#endif
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef MAPPED_FILE_WIN32
+    if (data != nullptr) UnmapViewOfFile(data);
+    if (mappingHandle != nullptr) CloseHandle((HANDLE)mappingHandle);
+    if (fileHandle != nullptr) CloseHandle((HANDLE)fileHandle);
+#else
+    if (data != nullptr) munmap((void*)data, size);
+#endif
+    data = nullptr;
+    size = 0;
+    opened = false;
+    fileHandle = nullptr;
+    mappingHandle = nullptr;
+}
+
+bool MappedFile::isOpen() const {
+    return opened;
+}
+
+const unsigned char* MappedFile::getData() const {
+    return data;
+}
+
+size_t MappedFile::getSize() const {
+    return size;
+}
@@ -0,0 +1,33 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// A whole file mapped read-only into memory. Opening costs the same however large the file
+// is: pages are only read from disk when first touched. The file stays writable by others
+// (appending to it is fine); open() again to see what was appended.
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const;
+
+    const unsigned char* getData() const;
+    size_t getSize() const;
+
+private:
+    const unsigned char* data;
+    size_t size;
+    bool opened;
+    void* fileHandle;       // HANDLEs on Windows, unused elsewhere
+    void* mappingHandle;
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+
+#endif
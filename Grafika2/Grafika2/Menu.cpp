@@ -1,28 +1,33 @@
 #include "menu.h"
 #include <iostream>
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include <algorithm>
 #include <filesystem>
 
-Menu::Menu(Shader& shader, Shader& textureShader, Avatar& avatar)
-    : shader(shader), textureShader(textureShader), avatar(avatar), selectedOption(-1) {
-    menuOptions = { "Eyes", "Lips", "Nose", "T-shirts", "Pants", "Dresses" };
+Menu::Menu(Shader& shader, Shader& textureShader, Avatar& avatar, const SlotRegistry& slots)
+    : shader(shader), textureShader(textureShader), avatar(avatar), slots(slots), selectedOption(-1) {
     setupMenuVertices();
+
+    // Button images never change, load them once instead of every frame
+    for (int slot : slots.getMenuSlots()) {
+        buttonTextures.push_back(avatar.loadTexture(slots.getSlot(slot).button.c_str()));
+    }
 }
 
 Menu::~Menu() {
     glDeleteVertexArrays(1, &menuVAO);
     glDeleteBuffers(1, &menuVBO);
+    glDeleteTextures((GLsizei)buttonTextures.size(), buttonTextures.data());
 }
 
 void Menu::setupMenuVertices() {
+    // Panel positions only, the color is set as flatColor when drawing
     float vertices[] = {
-         0.5f,  1.0f, 0.0f,  0.0f, 0.0f, 0.0f,
-         0.5f,  -1.0f, 0.0f,  0.0f, 0.0f, 0.0f,
-         1.0f,  -1.0f, 0.0f,  0.0f, 0.0f, 0.0f,
-         0.5f,  1.0f, 0.0f,  0.0f, 0.0f, 0.0f,
-         1.0f,  -1.0f, 0.0f,  0.0f, 0.0f, 0.0f,
-         1.0f,  1.0f, 0.0f,  0.0f, 0.0f, 0.0f
+         0.5f,  1.0f,
+         0.5f,  -1.0f,
+         1.0f,  -1.0f,
+         0.5f,  1.0f,
+         1.0f,  -1.0f,
+         1.0f,  1.0f
     };
 
     glGenVertexArrays(1, &menuVAO);
@@ -33,25 +38,19 @@ void Menu::setupMenuVertices() {
     glBindBuffer(GL_ARRAY_BUFFER, menuVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 }
 
-void Menu::renderButton(float x, float y, float width, float height, bool isSelected, std::string selectedOption) {
+void Menu::renderButton(float x, float y, float width, float height, bool isSelected, GLuint buttonTexture) {
     float color[3] = { 0.8f, 0.8f, 0.8f };
     if (isSelected) {
         color[0] = 0.5f;
     }
 
-    GLuint mouthTexture = 0;
-    mouthTexture = avatar.loadTexture(("Buttons/" + selectedOption + ".png").c_str());
-
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
@@ -95,7 +94,7 @@ void Menu::renderButton(float x, float y, float width, float height, bool isSele
     // Use the shader program and set up texture
     textureShader.use();
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, mouthTexture);
+    glBindTexture(GL_TEXTURE_2D, buttonTexture);
     textureShader.setInt("texture1", 0);
 
     // Draw the textured quad
@@ -108,60 +107,74 @@ void Menu::renderButton(float x, float y, float width, float height, bool isSele
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
     glDeleteVertexArrays(1, &VAO);
-
-
-    glDeleteTextures(1, &mouthTexture); // Properly clean up texture
 }
 
-void Menu::handleMouseClick(double mouseX, double mouseY, int windowWidth, int windowHeight) {
+void Menu::handleMouseClick(double mouseX, double mouseY, int windowWidth, int windowHeight, float zoom) {
     float xNDC = (2.0f * mouseX) / windowWidth - 1.0f;
     float yNDC = 1.0f - (2.0f * mouseY) / windowHeight;
 
     float buttonWidth = 0.4f;
     float buttonHeight = 0.1f;
 
-    for (int i = 0; i < menuOptions.size(); ++i) {
+    const std::vector<int>& menuSlots = slots.getMenuSlots();
+    for (int i = 0; i < menuSlots.size(); ++i) {
         float x = -0.8f;
         float y = 0.8f - i * 0.2f;
 
         if (xNDC >= x && xNDC <= x + buttonWidth &&
             yNDC >= y && yNDC <= y + buttonHeight) {
-            selectedOption = i;
-            std::cout << "Clicked on " << menuOptions[i] << std::endl;
-
-            std::string nextFile = getNextFile(menuOptions[i]);
-            if (!nextFile.empty()) {
-                GLuint textureID = avatar.loadTexture(nextFile.c_str());
-                if (menuOptions[i] == "Lips") {
-                    avatar.setMouthTexture(textureID);
-                    avatar.drawMouth(shader);
-                }
-                else if (menuOptions[i] == "Eyes") {
-                    avatar.setEyeTexture(textureID);
-                }
-                else if (menuOptions[i] == "Nose") {
-                    avatar.setNoseTexture(textureID);
-                }
-                else if (menuOptions[i] == "Dresses") {
-                    avatar.setTshirtTexture(0);
-                    avatar.setPantsTexture(0);
-                    avatar.setDressTexture(textureID);
-                }
-                else if (menuOptions[i] == "T-shirts") {
-                    avatar.setDressTexture(0);
-                    avatar.setTshirtTexture(textureID);
-                }
-                else if (menuOptions[i] == "Pants") {
-                    avatar.setDressTexture(0);
-                    avatar.setPantsTexture(textureID);
-                }
-            }
-            else {
-                std::cout << "No more files in folder: " << menuOptions[i] << std::endl;
-            }
-            break;
+            nextItem(menuSlots[i]);
+            return;
         }
     }
+
+    // Not on a button: the avatar fills the window, so its NDC space is the window's
+    int slot = avatar.pickSlot(xNDC / zoom, yNDC / zoom);
+    if (slot >= 0) {
+        nextItem(slot);
+    }
+}
+
+void Menu::nextItem(int slotIndex) {
+    const std::vector<int>& menuSlots = slots.getMenuSlots();
+    auto button = std::find(menuSlots.begin(), menuSlots.end(), slotIndex);
+    selectedOption = button != menuSlots.end() ? (int)(button - menuSlots.begin()) : -1;
+    const SlotDefinition& slot = slots.getSlot(slotIndex);
+    std::cout << "Clicked on " << slot.name << std::endl;
+
+    std::string nextFile = getNextFile(slot.folder);
+    if (!nextFile.empty()) {
+        // Exclusivity (dress vs. t-shirt/pants) is handled by the slot's conflict mask
+        OutfitEdit edit = { slotIndex, avatar.getSlotTexture(slotIndex), 0, avatar.getOccupiedSlots(), 0 };
+        avatar.applySlot(slotIndex, avatar.loadTextureCached(nextFile));
+        edit.textureAfter = avatar.getSlotTexture(slotIndex);
+        edit.occupiedAfter = avatar.getOccupiedSlots();
+        undoSteps.push_back(edit);
+        if ((int)undoSteps.size() > MAX_UNDO_STEPS) undoSteps.pop_front();
+        redoSteps.clear();
+    }
+    else {
+        std::cout << "No more files in folder: " << slot.folder << std::endl;
+    }
+}
+
+
+bool Menu::undo() {
+    if (undoSteps.empty()) return false;
+    const OutfitEdit& edit = undoSteps.back();
+    avatar.restoreSlot(edit.slot, edit.textureBefore, edit.occupiedBefore);
+    redoSteps.push_back(edit);
+    undoSteps.pop_back();
+    return true;
+}
+
+bool Menu::redo() {
+    if (redoSteps.empty()) return false;
+    const OutfitEdit& edit = redoSteps.back();
+    avatar.restoreSlot(edit.slot, edit.textureAfter, edit.occupiedAfter);
+    undoSteps.push_back(edit);
+    redoSteps.pop_back();
+    return true;
 }
 
 
@@ -221,12 +234,14 @@ void Menu::renderImagesInLipsContainer(const std::string& folderPath) {
 
 void Menu::render(float x, float y, float width, float height) {
     shader.use();
+    shader.setInt("colorIndex", -1);
+    shader.setVec3("flatColor", 0.0f, 0.0f, 0.0f);
     glBindVertexArray(menuVAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
     glBindVertexArray(0);
 
-    for (int i = 0; i < menuOptions.size(); ++i) {
+    for (int i = 0; i < buttonTextures.size(); ++i) {
         bool isSelected = (i == selectedOption);
-        renderButton(x, y - i * 0.2f, width, height, isSelected, menuOptions[i]);
+        renderButton(x, y - i * 0.2f, width, height, isSelected, buttonTextures[i]);
     }
 }
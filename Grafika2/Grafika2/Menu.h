@@ -1,34 +1,54 @@
 #ifndef MENU_H
 #define MENU_H
 
+#include <deque>
 #include <vector>
 #include <string>
 #include "Shader.h"
 #include "Avatar.h"
+#include "SlotRegistry.h"
 #include <unordered_map>
 
 class Menu {
 public:
-    Menu(Shader& avatarShader, Shader& textureShader, Avatar& avatar);
+    Menu(Shader& avatarShader, Shader& textureShader, Avatar& avatar, const SlotRegistry& slots);
     ~Menu();
 
     void render(float x, float y, float width, float height);
-    void handleMouseClick(double mouseX, double mouseY, int windowWidth, int windowHeight);
+    // Buttons cycle their slot's items; clicking a worn item on the avatar does the same.
+    // zoom is the avatar view's, which the buttons do not follow.
+    void handleMouseClick(double mouseX, double mouseY, int windowWidth, int windowHeight, float zoom = 1.0f);
+    // Takes back or repeats item changes made through the menu, one click at a time. The
+    // last MAX_UNDO_STEPS changes are kept, the oldest being forgotten first.
+    static const int MAX_UNDO_STEPS = 256;
+    bool undo();
+    bool redo();
 
 private:
+    // One item change: a slot's texture and the whole occupancy, since conflicts clear slots
+    struct OutfitEdit {
+        int slot;
+        GLuint textureBefore, textureAfter;
+        uint32_t occupiedBefore, occupiedAfter;
+    };
+
     Shader& shader;
     Shader& textureShader;
     Avatar& avatar;
-    std::vector<std::string> menuOptions;
+    const SlotRegistry& slots;
     int selectedOption;
     std::unordered_map<std::string, int> buttonFileIndices;
+    std::vector<GLuint> buttonTextures;
+    std::deque<OutfitEdit> undoSteps;
+    std::vector<OutfitEdit> redoSteps;
 
     GLuint menuVAO, menuVBO;
 
     void setupMenuVertices();
-    void renderButton(float x, float y, float width, float height, bool isSelected, std::string selectedOption);
+    void renderButton(float x, float y, float width, float height, bool isSelected, GLuint buttonTexture);
     void renderImagesInLipsContainer(const std::string& folderPath);
     std::string getNextFile(const std::string& folderPath);
+    void nextItem(int slot);
 };
 
 #endif
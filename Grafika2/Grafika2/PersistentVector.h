@@ -0,0 +1,115 @@
+#ifndef PERSISTENT_VECTOR_H
+#define PERSISTENT_VECTOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+
+// An immutable array as a trie of 16-way nodes. set() and push_back() return a new vector
+// that copies only the nodes on the path to the changed element and shares the rest with
+// the original, so keeping every version costs memory in proportion to the changes. Copies
+// are a pointer and two integers. diff() finds the elements two versions may disagree on
+// without looking into the subtrees they share.
+template <typename T>
+class PersistentVector {
+public:
+    static const int BITS = 4;
+    static const size_t WIDTH = (size_t)1 << BITS;
+
+    PersistentVector() : count(0), shift(0) {}
+
+    size_t size() const {
+        return count;
+    }
+
+    const T& get(size_t index) const {
+        const Node* node = root.get();
+        for (int level = shift; level > 0; level -= BITS) {
+            node = static_cast<const Branch*>(node)->children[(index >> level) & (WIDTH - 1)].get();
+        }
+        return static_cast<const Leaf*>(node)->values[index & (WIDTH - 1)];
+    }
+
+    PersistentVector set(size_t index, const T& value) const {
+        PersistentVector result(*this);
+        result.root = assign(root.get(), shift, index, value);
+        return result;
+    }
+
+    PersistentVector push_back(const T& value) const {
+        PersistentVector result(*this);
+        if (root && count == (WIDTH << shift)) {
+            // Full: the old root becomes the first child of a new one
+            std::shared_ptr<Branch> branch = std::make_shared<Branch>();
+            branch->children[0] = root;
+            result.root = branch;
+            result.shift += BITS;
+        }
+        result.root = assign(result.root.get(), result.shift, count, value);
+        ++result.count;
+        return result;
+    }
+
+    // Calls visit(index) for each index below the larger size where the two vectors are not
+    // known to hold the same element. Whole shared subtrees are skipped; within a changed
+    // leaf every index is visited.
+    template <typename Visit>
+    void diff(const PersistentVector& other, Visit visit) const {
+        const size_t total = std::max(count, other.count);
+        if (shift != other.shift) {
+            for (size_t i = 0; i < total; ++i) visit(i);
+            return;
+        }
+        diffNodes(root.get(), other.root.get(), shift, 0, total, visit);
+    }
+
+    // Bytes one set() allocates at this size, allocator overhead aside
+    size_t getPathBytes() const {
+        return (size_t)(shift / BITS) * sizeof(Branch) + sizeof(Leaf);
+    }
+
+private:
+    struct Node {
+    };
+
+    struct Branch : Node {
+        std::shared_ptr<const Node> children[WIDTH];
+    };
+
+    struct Leaf : Node {
+        T values[WIDTH];
+    };
+
+    // Copy of node (or a new node where there was none) with index set to value below it
+    static std::shared_ptr<const Node> assign(const Node* node, int level, size_t index, const T& value) {
+        if (level == 0) {
+            std::shared_ptr<Leaf> leaf = node != nullptr ? std::make_shared<Leaf>(*static_cast<const Leaf*>(node)) : std::make_shared<Leaf>();
+            leaf->values[index & (WIDTH - 1)] = value;
+            return leaf;
+        }
+        std::shared_ptr<Branch> branch = node != nullptr ? std::make_shared<Branch>(*static_cast<const Branch*>(node)) : std::make_shared<Branch>();
+        std::shared_ptr<const Node>& child = branch->children[(index >> level) & (WIDTH - 1)];
+        child = assign(child.get(), level - BITS, index, value);
+        return branch;
+    }
+
+    template <typename Visit>
+    static void diffNodes(const Node* a, const Node* b, int level, size_t base, size_t total, Visit& visit) {
+        if (a == b || base >= total) return;
+        if (level == 0) {
+            for (size_t i = base; i < std::min(base + WIDTH, total); ++i) visit(i);
+            return;
+        }
+        for (size_t k = 0; k < WIDTH; ++k) {
+            const Node* childA = a != nullptr ? static_cast<const Branch*>(a)->children[k].get() : nullptr;
+            const Node* childB = b != nullptr ? static_cast<const Branch*>(b)->children[k].get() : nullptr;
+            diffNodes(childA, childB, level - BITS, base + (k << level), total, visit);
+        }
+    }
+
+    std::shared_ptr<const Node> root;
+    size_t count;
+    int shift;      // Index bits below the root's children, BITS per level
+};
+
+#endif
@@ -0,0 +1,419 @@
+#include "PngWriter.h"
+#include "Deflate.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PNG_WRITER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+    enum PngFilter { FILTER_NONE, FILTER_SUB, FILTER_UP, FILTER_AVERAGE, FILTER_PAETH, FILTER_COUNT };
+
+    const int BYTES_PER_PIXEL = 4;
+
+    struct CrcTable {
+        unsigned int values[256];
+
+        CrcTable() {
+            for (unsigned int n = 0; n < 256; ++n) {
+                unsigned int c = n;
+                for (int k = 0; k < 8; ++k) {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                values[n] = c;
+            }
+        }
+    };
+
+    void putBigEndian(std::vector<unsigned char>& out, unsigned int value) {
+        out.push_back((unsigned char)(value >> 24));
+        out.push_back((unsigned char)(value >> 16));
+        out.push_back((unsigned char)(value >> 8));
+        out.push_back((unsigned char)value);
+    }
+
+    void putChunk(std::vector<unsigned char>& out, const char* type, const unsigned char* data, size_t length) {
+        putBigEndian(out, (unsigned int)length);
+        size_t typeStart = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data, data + length);
+        // CRC covers the chunk type and data
+        putBigEndian(out, PngWriter::crc32(out.data() + typeStart, length + 4));
+    }
+
+    unsigned char paethPredictor(int a, int b, int c) {
+        int pa = std::abs(b - c);
+        int pb = std::abs(a - c);
+        int pc = std::abs(a + b - 2 * c);
+        if (pa <= pb && pa <= pc) return (unsigned char)a;
+        if (pb <= pc) return (unsigned char)b;
+        return (unsigned char)c;
+    }
+
+    // Scalar filter for byte i; a, b and c are the left, up and upper-left bytes
+    unsigned char filterByte(int filter, int x, int a, int b, int c) {
+        switch (filter) {
+        case FILTER_SUB: return (unsigned char)(x - a);
+        case FILTER_UP: return (unsigned char)(x - b);
+        case FILTER_AVERAGE: return (unsigned char)(x - ((a + b) >> 1));
+        case FILTER_PAETH: return (unsigned char)(x - paethPredictor(a, b, c));
+        default: return (unsigned char)x;
+        }
+    }
+
+    // Residual bytes count as signed, so 0xFF costs 1 like 0x01
+    unsigned int byteCost(unsigned char value) {
+        return value < 128 ? value : 256 - value;
+    }
+
+#ifdef PNG_WRITER_SSE2
+    inline __m128i averageFloor(__m128i a, __m128i b) {
+        // _mm_avg_epu8 rounds up, PNG rounds down
+        __m128i roundUp = _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1));
+        return _mm_sub_epi8(_mm_avg_epu8(a, b), roundUp);
+    }
+
+    inline __m128i abs16(__m128i value) {
+        return _mm_max_epi16(value, _mm_sub_epi16(_mm_setzero_si128(), value));
+    }
+
+    inline __m128i paeth16(__m128i a, __m128i b, __m128i c) {
+        __m128i pa = abs16(_mm_sub_epi16(b, c));
+        __m128i pb = abs16(_mm_sub_epi16(a, c));
+        __m128i pc = abs16(_mm_add_epi16(_mm_sub_epi16(b, c), _mm_sub_epi16(a, c)));
+        __m128i notA = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+        __m128i useC = _mm_cmpgt_epi16(pb, pc);
+        __m128i bOrC = _mm_or_si128(_mm_and_si128(useC, c), _mm_andnot_si128(useC, b));
+        return _mm_or_si128(_mm_and_si128(notA, bOrC), _mm_andnot_si128(notA, a));
+    }
+
+    inline __m128i paethPredict(__m128i a, __m128i b, __m128i c) {
+        __m128i zero = _mm_setzero_si128();
+        __m128i low = paeth16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+        __m128i high = paeth16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+        return _mm_packus_epi16(low, high);
+    }
+
+    inline __m128i residual(int filter, __m128i x, __m128i a, __m128i b, __m128i c) {
+        switch (filter) {
+        case FILTER_SUB: return _mm_sub_epi8(x, a);
+        case FILTER_UP: return _mm_sub_epi8(x, b);
+        case FILTER_AVERAGE: return _mm_sub_epi8(x, averageFloor(a, b));
+        case FILTER_PAETH: return _mm_sub_epi8(x, paethPredict(a, b, c));
+        default: return x;
+        }
+    }
+
+    // Sum of |signed byte| into two 64-bit lanes
+    inline __m128i cost(__m128i value) {
+        __m128i magnitude = _mm_min_epu8(value, _mm_sub_epi8(_mm_setzero_si128(), value));
+        return _mm_sad_epu8(magnitude, _mm_setzero_si128());
+    }
+
+    // Loads the 16 bytes at offset i of row and their left neighbours, one pixel earlier
+    inline void loadNeighbours(const unsigned char* row, const unsigned char* prior, int i,
+                               __m128i& x, __m128i& a, __m128i& b, __m128i& c) {
+        x = _mm_loadu_si128((const __m128i*)(row + i));
+        b = _mm_loadu_si128((const __m128i*)(prior + i));
+        if (i == 0) {
+            // No pixel left of the first one, shift in zeros
+            a = _mm_slli_si128(x, BYTES_PER_PIXEL);
+            c = _mm_slli_si128(b, BYTES_PER_PIXEL);
+        }
+        else {
+            a = _mm_loadu_si128((const __m128i*)(row + i - BYTES_PER_PIXEL));
+            c = _mm_loadu_si128((const __m128i*)(prior + i - BYTES_PER_PIXEL));
+        }
+    }
+#endif
+
+    // Picks the filter with the smallest residual sum and writes filter byte + row to out.
+    // prior is the row above (all zeros for the first row).
+    void filterRow(const unsigned char* row, const unsigned char* prior, int rowBytes, unsigned char* out) {
+        unsigned int costs[FILTER_COUNT] = { 0, 0, 0, 0, 0 };
+        int i = 0;
+
+#ifdef PNG_WRITER_SSE2
+        __m128i sums[FILTER_COUNT];
+        for (int f = 0; f < FILTER_COUNT; ++f) sums[f] = _mm_setzero_si128();
+        for (; i + 16 <= rowBytes; i += 16) {
+            __m128i x, a, b, c;
+            loadNeighbours(row, prior, i, x, a, b, c);
+            for (int f = 0; f < FILTER_COUNT; ++f) {
+                sums[f] = _mm_add_epi64(sums[f], cost(residual(f, x, a, b, c)));
+            }
+        }
+        for (int f = 0; f < FILTER_COUNT; ++f) {
+            costs[f] = (unsigned int)(_mm_cvtsi128_si32(sums[f]) + _mm_cvtsi128_si32(_mm_srli_si128(sums[f], 8)));
+        }
+#endif
+        for (int k = i; k < rowBytes; ++k) {
+            int a = k >= BYTES_PER_PIXEL ? row[k - BYTES_PER_PIXEL] : 0;
+            int c = k >= BYTES_PER_PIXEL ? prior[k - BYTES_PER_PIXEL] : 0;
+            for (int f = 0; f < FILTER_COUNT; ++f) {
+                costs[f] += byteCost(filterByte(f, row[k], a, prior[k], c));
+            }
+        }
+        // Filter type None is scored by magnitude too, the usual heuristic
+        int best = FILTER_NONE;
+        for (int f = 1; f < FILTER_COUNT; ++f) {
+            if (costs[f] < costs[best]) best = f;
+        }
+
+        out[0] = (unsigned char)best;
+        unsigned char* filtered = out + 1;
+        i = 0;
+#ifdef PNG_WRITER_SSE2
+        for (; i + 16 <= rowBytes; i += 16) {
+            __m128i x, a, b, c;
+            loadNeighbours(row, prior, i, x, a, b, c);
+            _mm_storeu_si128((__m128i*)(filtered + i), residual(best, x, a, b, c));
+        }
+#endif
+        for (; i < rowBytes; ++i) {
+            int a = i >= BYTES_PER_PIXEL ? row[i - BYTES_PER_PIXEL] : 0;
+            int c = i >= BYTES_PER_PIXEL ? prior[i - BYTES_PER_PIXEL] : 0;
+            filtered[i] = filterByte(best, row[i], a, prior[i], c);
+        }
+    }
+
+    struct Strip {
+        int firstRow;
+        int rowCount;
+        std::vector<unsigned char> compressed;
+        unsigned int adler;
+        size_t rawSize;
+    };
+
+    // prior is the row above the first row of the strip
+    void encodeStrip(const unsigned char* rgba, int width, ptrdiff_t stride, const unsigned char* prior, int level, bool final,
+                     Strip& strip) {
+        const int rowBytes = width * BYTES_PER_PIXEL;
+        std::vector<unsigned char> raw((size_t)(rowBytes + 1) * strip.rowCount);
+        for (int r = 0; r < strip.rowCount; ++r) {
+            int y = strip.firstRow + r;
+            const unsigned char* row = rgba + y * stride;
+            unsigned char* out = raw.data() + (size_t)r * (rowBytes + 1);
+            if (level == 0) {
+                // Stored output gains nothing from filtering
+                out[0] = FILTER_NONE;
+                std::copy(row, row + rowBytes, out + 1);
+            }
+            else {
+                filterRow(row, r > 0 ? row - stride : prior, rowBytes, out);
+            }
+        }
+        strip.rawSize = raw.size();
+        strip.adler = Deflate::adler32(raw.data(), raw.size());
+        Deflate::compress(raw.data(), raw.size(), level, final, strip.compressed);
+    }
+
+    // Filters and deflates rows [0, height) in strips of at least 32 rows, a thread per strip
+    // except the first. prior is the row above row 0; only the last strip can be final.
+    void encodeStrips(const unsigned char* rgba, int width, int height, ptrdiff_t stride, const unsigned char* prior,
+                      int level, int threads, bool final, std::vector<Strip>& strips) {
+        int stripCount = threads < 1 ? 1 : threads;
+        if (stripCount > height / 32) stripCount = height / 32 > 0 ? height / 32 : 1;
+        strips.resize(stripCount);
+        for (int s = 0; s < stripCount; ++s) {
+            strips[s].firstRow = (int)((long long)height * s / stripCount);
+            strips[s].rowCount = (int)((long long)height * (s + 1) / stripCount) - strips[s].firstRow;
+            strips[s].compressed.clear();
+        }
+        auto stripPrior = [&](int s) { return s == 0 ? prior : rgba + (strips[s].firstRow - 1) * stride; };
+        std::vector<std::thread> workers;
+        for (int s = 1; s < stripCount; ++s) {
+            workers.emplace_back(encodeStrip, rgba, width, stride, stripPrior(s), level, final && s == stripCount - 1, std::ref(strips[s]));
+        }
+        encodeStrip(rgba, width, stride, prior, level, final && stripCount == 1, strips[0]);
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    int clampLevel(int level) {
+        return level < 0 ? 0 : (level > 9 ? 9 : level);
+    }
+
+    // zlib stream header, FLEVEL matches the level
+    void putZlibHeader(std::vector<unsigned char>& out, int level) {
+        static const unsigned char levelFlags[4] = { 0x01, 0x5E, 0x9C, 0xDA };
+        out.push_back(0x78);
+        out.push_back(levelFlags[level <= 1 ? 0 : (level <= 5 ? 1 : (level == 6 ? 2 : 3))]);
+    }
+
+    void putHeader(std::vector<unsigned char>& out, int width, int height) {
+        static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        out.assign(signature, signature + 8);
+
+        unsigned char header[13];
+        header[0] = (unsigned char)(width >> 24); header[1] = (unsigned char)(width >> 16);
+        header[2] = (unsigned char)(width >> 8);  header[3] = (unsigned char)width;
+        header[4] = (unsigned char)(height >> 24); header[5] = (unsigned char)(height >> 16);
+        header[6] = (unsigned char)(height >> 8);  header[7] = (unsigned char)height;
+        header[8] = 8;  // Bit depth
+        header[9] = 6;  // Color type: RGBA
+        header[10] = 0; // Compression
+        header[11] = 0; // Filter method
+        header[12] = 0; // No interlace
+        putChunk(out, "IHDR", header, sizeof(header));
+    }
+}
+
+unsigned int PngWriter::crc32(const unsigned char* data, size_t length, unsigned int crc) {
+    static const CrcTable table;
+    crc = ~crc;
+    for (size_t i = 0; i < length; ++i) {
+        crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void PngWriter::encode(const unsigned char* rgba, int width, int height, ptrdiff_t stride, const PngOptions& options,
+                       std::vector<unsigned char>& out) {
+    putHeader(out, width, height);
+
+    if (stride == 0) stride = (ptrdiff_t)width * BYTES_PER_PIXEL;
+    int level = clampLevel(options.level);
+    std::vector<unsigned char> zeroRow((size_t)width * BYTES_PER_PIXEL, 0);
+    std::vector<Strip> strips;
+    encodeStrips(rgba, width, height, stride, zeroRow.data(), level, options.threads, true, strips);
+
+    // zlib stream: header, the strips, Adler-32 of all raw data
+    std::vector<unsigned char> zlib;
+    size_t compressedSize = 0;
+    for (const Strip& strip : strips) compressedSize += strip.compressed.size();
+    zlib.reserve(compressedSize + 6);
+    putZlibHeader(zlib, level);
+    unsigned int adler = 1;
+    for (const Strip& strip : strips) {
+        zlib.insert(zlib.end(), strip.compressed.begin(), strip.compressed.end());
+        adler = Deflate::adler32Combine(adler, strip.adler, strip.rawSize);
+    }
+    putBigEndian(zlib, adler);
+
+    putChunk(out, "IDAT", zlib.data(), zlib.size());
+    putChunk(out, "IEND", nullptr, 0);
+}
+
+bool PngWriter::write(const std::string& path, const unsigned char* rgba, int width, int height, ptrdiff_t stride,
+                      const PngOptions& options) {
+    std::vector<unsigned char> png;
+    encode(rgba, width, height, stride, options, png);
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to open " << path << " for writing" << std::endl;
+        return false;
+    }
+    file.write((const char*)png.data(), png.size());
+    if (!file) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+PngStripWriter::PngStripWriter()
+    : width(0), height(0), rowsWritten(0), level(6), threads(1), adler(1), failed(false) {
+}
+
+PngStripWriter::~PngStripWriter() {
+    if (file.is_open()) {
+        close();
+    }
+}
+
+bool PngStripWriter::open(const std::string& path, int imageWidth, int imageHeight, const PngOptions& options) {
+    file.open(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to open " << path << " for writing" << std::endl;
+        return false;
+    }
+    this->path = path;
+    width = imageWidth;
+    height = imageHeight;
+    rowsWritten = 0;
+    level = clampLevel(options.level);
+    threads = options.threads;
+    adler = 1;
+    failed = false;
+    priorRow.assign((size_t)width * BYTES_PER_PIXEL, 0);
+
+    std::vector<unsigned char> header;
+    putHeader(header, width, height);
+    return writeBytes(header);
+}
+
+bool PngStripWriter::writeRows(const unsigned char* rgba, int rows, ptrdiff_t stride) {
+    if (!file.is_open() || failed) return false;
+    if (rows <= 0) return true;
+    if (rows > height - rowsWritten) {
+        std::cerr << "Too many rows for " << path << " (" << rowsWritten + rows << " of " << height << ")" << std::endl;
+        failed = true;
+        return false;
+    }
+    if (stride == 0) stride = (ptrdiff_t)width * BYTES_PER_PIXEL;
+
+    std::vector<Strip> strips;
+    encodeStrips(rgba, width, rows, stride, priorRow.data(), level, threads, false, strips);
+    // The first row of the next call is filtered against the last one of this
+    const unsigned char* last = rgba + (rows - 1) * stride;
+    std::copy(last, last + priorRow.size(), priorRow.begin());
+
+    // Every call is its own IDAT chunk; the decoder sees the chunks as one zlib stream
+    std::vector<unsigned char> zlib;
+    if (rowsWritten == 0) {
+        putZlibHeader(zlib, level);
+    }
+    for (const Strip& strip : strips) {
+        zlib.insert(zlib.end(), strip.compressed.begin(), strip.compressed.end());
+        adler = Deflate::adler32Combine(adler, strip.adler, strip.rawSize);
+    }
+    rowsWritten += rows;
+
+    std::vector<unsigned char> chunk;
+    putChunk(chunk, "IDAT", zlib.data(), zlib.size());
+    return writeBytes(chunk);
+}
+
+bool PngStripWriter::close() {
+    if (!file.is_open()) return false;
+    bool complete = !failed && rowsWritten == height;
+    if (complete) {
+        // An empty final block ends the deflate stream the pieces left open
+        std::vector<unsigned char> zlib;
+        Deflate::compress(nullptr, 0, level, true, zlib);
+        putBigEndian(zlib, adler);
+        std::vector<unsigned char> tail;
+        putChunk(tail, "IDAT", zlib.data(), zlib.size());
+        putChunk(tail, "IEND", nullptr, 0);
+        complete = writeBytes(tail);
+    }
+    else if (!failed) {
+        std::cerr << "Closed " << path << " after " << rowsWritten << " of " << height << " rows" << std::endl;
+    }
+    file.close();
+    priorRow.clear();
+    priorRow.shrink_to_fit();
+    return complete;
+}
+
+int PngStripWriter::getRowsWritten() const {
+    return rowsWritten;
+}
+
+bool PngStripWriter::writeBytes(const std::vector<unsigned char>& bytes) {
+    file.write((const char*)bytes.data(), bytes.size());
+    if (!file) {
+        std::cerr << "Failed to write " << path << std::endl;
+        failed = true;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef PNG_WRITER_H
+#define PNG_WRITER_H
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+struct PngOptions {
+    int level;     // 0 stores the rows unfiltered and uncompressed, 1-9 trade speed for size
+    int threads;   // Horizontal strips deflated in parallel; 1 encodes on the calling thread
+
+    PngOptions() : level(6), threads(1) {}
+};
+
+// Writes 8-bit RGBA images as PNG. Self-contained (no zlib, see Deflate). Each row gets the
+// filter with the smallest sum of absolute residuals, evaluated for all five filters in one
+// SSE2 pass. Strips are deflated independently and joined with sync flushes, so one image
+// can use several cores.
+class PngWriter {
+public:
+    // rgba points at the top row; row y starts at rgba + y * stride (0 means width * 4).
+    // A negative stride reads bottom-up buffers such as GL readbacks in place.
+    static bool write(const std::string& path, const unsigned char* rgba, int width, int height, ptrdiff_t stride = 0,
+                      const PngOptions& options = PngOptions());
+    static void encode(const unsigned char* rgba, int width, int height, ptrdiff_t stride, const PngOptions& options,
+                       std::vector<unsigned char>& out);
+
+    static unsigned int crc32(const unsigned char* data, size_t length, unsigned int crc = 0);
+};
+
+// Streams one PNG to disk a band of rows at a time, for images too large to hold in memory.
+// Each band is filtered against the last row of the one before, deflated in strips like
+// PngWriter::encode and written as its own IDAT chunk, so memory stays at one band.
+class PngStripWriter {
+public:
+    PngStripWriter();
+    ~PngStripWriter();
+
+    // Writes the header; the image is complete once height rows have been written
+    bool open(const std::string& path, int width, int height, const PngOptions& options = PngOptions());
+    // Next rows of the image, top to bottom; rgba and stride as in PngWriter::write
+    bool writeRows(const unsigned char* rgba, int rows, ptrdiff_t stride = 0);
+    // Ends the stream and closes the file; false if rows are missing or a write failed
+    bool close();
+
+    int getRowsWritten() const;
+
+private:
+    bool writeBytes(const std::vector<unsigned char>& bytes);
+
+    std::ofstream file;
+    std::string path;
+    int width;
+    int height;
+    int rowsWritten;
+    int level;
+    int threads;
+    unsigned int adler;     // Of all raw (filtered) bytes so far
+    bool failed;
+    std::vector<unsigned char> priorRow;
+
+    PngStripWriter(const PngStripWriter&) = delete;
+    PngStripWriter& operator=(const PngStripWriter&) = delete;
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include "QoiWriter.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    const unsigned char QOI_OP_INDEX = 0x00;
+    const unsigned char QOI_OP_DIFF = 0x40;
+    const unsigned char QOI_OP_LUMA = 0x80;
+    const unsigned char QOI_OP_RUN = 0xC0;
+    const unsigned char QOI_OP_RGB = 0xFE;
+    const unsigned char QOI_OP_RGBA = 0xFF;
+
+    void putBigEndian(unsigned char* out, unsigned int value) {
+        out[0] = (unsigned char)(value >> 24);
+        out[1] = (unsigned char)(value >> 16);
+        out[2] = (unsigned char)(value >> 8);
+        out[3] = (unsigned char)value;
+    }
+}
+
+void QoiWriter::encode(const unsigned char* rgba, int width, int height, ptrdiff_t stride, std::vector<unsigned char>& out) {
+    if (stride == 0) stride = (ptrdiff_t)width * 4;
+
+    // Worst case is 5 bytes per pixel (QOI_OP_RGBA), plus header and end marker
+    out.resize(14 + (size_t)width * height * 5 + 8);
+    unsigned char* bytes = out.data();
+    size_t n = 0;
+
+    std::memcpy(bytes, "qoif", 4);
+    putBigEndian(bytes + 4, (unsigned int)width);
+    putBigEndian(bytes + 8, (unsigned int)height);
+    bytes[12] = 4; // Channels
+    bytes[13] = 0; // sRGB with linear alpha
+    n = 14;
+
+    uint32_t index[64] = {};
+    uint32_t previous = 0xFF000000u; // r, g, b = 0, a = 255; pixels are read as little-endian RGBA words
+    int run = 0;
+
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* row = rgba + y * stride;
+        for (int x = 0; x < width; ++x) {
+            const unsigned char* p = row + x * 4;
+            uint32_t pixel = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+
+            if (pixel == previous) {
+                if (++run == 62) {
+                    bytes[n++] = QOI_OP_RUN | (run - 1);
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0) {
+                bytes[n++] = QOI_OP_RUN | (run - 1);
+                run = 0;
+            }
+
+            int hash = (p[0] * 3 + p[1] * 5 + p[2] * 7 + p[3] * 11) % 64;
+            if (index[hash] == pixel) {
+                bytes[n++] = QOI_OP_INDEX | hash;
+            }
+            else {
+                index[hash] = pixel;
+                unsigned char alpha = p[3];
+                if (alpha == (unsigned char)(previous >> 24)) {
+                    signed char dr = (signed char)(p[0] - (unsigned char)previous);
+                    signed char dg = (signed char)(p[1] - (unsigned char)(previous >> 8));
+                    signed char db = (signed char)(p[2] - (unsigned char)(previous >> 16));
+                    signed char drg = (signed char)(dr - dg);
+                    signed char dbg = (signed char)(db - dg);
+
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                        bytes[n++] = QOI_OP_DIFF | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2);
+                    }
+                    else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+                        bytes[n++] = QOI_OP_LUMA | (dg + 32);
+                        bytes[n++] = (unsigned char)(((drg + 8) << 4) | (dbg + 8));
+                    }
+                    else {
+                        bytes[n++] = QOI_OP_RGB;
+                        bytes[n++] = p[0];
+                        bytes[n++] = p[1];
+                        bytes[n++] = p[2];
+                    }
+                }
+                else {
+                    bytes[n++] = QOI_OP_RGBA;
+                    bytes[n++] = p[0];
+                    bytes[n++] = p[1];
+                    bytes[n++] = p[2];
+                    bytes[n++] = p[3];
+                }
+            }
+            previous = pixel;
+        }
+    }
+    if (run > 0) {
+        bytes[n++] = QOI_OP_RUN | (run - 1);
+    }
+
+    static const unsigned char endMarker[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    std::memcpy(bytes + n, endMarker, 8);
+    n += 8;
+    out.resize(n);
+}
+
+bool QoiWriter::write(const std::string& path, const unsigned char* rgba, int width, int height, ptrdiff_t stride) {
+    std::vector<unsigned char> qoi;
+    encode(rgba, width, height, stride, qoi);
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to open " << path << " for writing" << std::endl;
+        return false;
+    }
+    file.write((const char*)qoi.data(), qoi.size());
+    if (!file) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,18 @@
+#ifndef QOI_WRITER_H
+#define QOI_WRITER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Writes RGBA images in the QOI format (qoiformat.org): lossless, a single pass with no
+// entropy coding, many times faster than PNG. Meant for intermediate frames that are read
+// back by our own tools; use PngWriter for files that leave the pipeline.
+class QoiWriter {
+public:
+    // Same pixel layout as PngWriter: top row first, optional (negative) row stride
+    static bool write(const std::string& path, const unsigned char* rgba, int width, int height, ptrdiff_t stride = 0);
+    static void encode(const unsigned char* rgba, int width, int height, ptrdiff_t stride, std::vector<unsigned char>& out);
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include "ReadbackQueue.h"
+#include <iostream>
+
+ReadbackQueue::ReadbackQueue()
+    : width(0), height(0), head(0), tail(0), inFlight(0), stopping(false) {
+}
+
+ReadbackQueue::~ReadbackQueue() {
+    destroy();
+}
+
+bool ReadbackQueue::create(int w, int h, int depth, Consumer callback) {
+    destroy();
+    if (depth < 1) depth = 1;
+    width = w;
+    height = h;
+    consumer = callback;
+
+    slots.resize(depth);
+    for (Slot& slot : slots) {
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        // STREAM_READ: written by the GPU once, read back by the CPU once
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, nullptr, GL_STREAM_READ);
+        slot.fence = nullptr;
+        slot.state = SLOT_FREE;
+        slot.id = 0;
+        slot.mapped = nullptr;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    head = 0;
+    tail = 0;
+    inFlight = 0;
+
+    stopping = false;
+    worker = std::thread(&ReadbackQueue::workerLoop, this);
+    return glGetError() == GL_NO_ERROR;
+}
+
+void ReadbackQueue::destroy() {
+    if (slots.empty()) return;
+
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workReady.notify_all();
+    worker.join();
+
+    for (Slot& slot : slots) {
+        glDeleteBuffers(1, &slot.buffer);
+    }
+    slots.clear();
+}
+
+void ReadbackQueue::submit(GLuint framebuffer, uint64_t id) {
+    poll();
+    // Ring is full: the oldest frame has to finish before its buffer can be reused
+    while (inFlight == (int)slots.size()) {
+        retireOldest(true);
+    }
+
+    Slot& slot = slots[head];
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    // With a pack buffer bound this only queues the copy, the last argument is an offset
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.state = SLOT_PENDING;
+    slot.id = id;
+    head = (head + 1) % (int)slots.size();
+    ++inFlight;
+}
+
+void ReadbackQueue::poll() {
+    while (inFlight > 0 && retireOldest(false)) {
+    }
+}
+
+void ReadbackQueue::flush() {
+    while (inFlight > 0) {
+        retireOldest(true);
+    }
+}
+
+bool ReadbackQueue::retireOldest(bool wait) {
+    Slot& slot = slots[tail];
+    SlotState state;
+    {
+        // The worker moves slots from mapped to consumed
+        std::lock_guard<std::mutex> lock(mutex);
+        state = slot.state;
+    }
+
+    if (state == SLOT_PENDING) {
+        GLenum result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (wait && result == GL_TIMEOUT_EXPIRED) {
+            result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull); // 1 s
+        }
+        if (result == GL_TIMEOUT_EXPIRED) return false;
+        if (result == GL_WAIT_FAILED) {
+            std::cerr << "Readback fence wait failed" << std::endl;
+        }
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        slot.mapped = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)width * height * 4, GL_MAP_READ_BIT);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        slot.state = SLOT_MAPPED;
+        work.push_back(tail);
+        workReady.notify_one();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (slot.state == SLOT_MAPPED) {
+            if (!wait) return false;
+            workDone.wait(lock, [&slot] { return slot.state == SLOT_CONSUMED; });
+        }
+    }
+
+    // Consumed: the buffer can be unmapped and written again
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.mapped = nullptr;
+    slot.state = SLOT_FREE;
+    tail = (tail + 1) % (int)slots.size();
+    --inFlight;
+    return true;
+}
+
+void ReadbackQueue::workerLoop() {
+    while (true) {
+        int index;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workReady.wait(lock, [this] { return stopping || !work.empty(); });
+            if (work.empty()) return;
+            index = work.front();
+            work.pop_front();
+        }
+
+        // slots is not resized while the worker runs, and a mapped slot is not touched by the GL thread
+        const Slot& slot = slots[index];
+        if (slot.mapped != nullptr && consumer) {
+            ReadbackImage image;
+            image.stride = -(ptrdiff_t)width * 4;
+            image.pixels = slot.mapped + (size_t)(height - 1) * width * 4;
+            image.width = width;
+            image.height = height;
+            image.id = slot.id;
+            consumer(image);
+        }
+        else if (slot.mapped == nullptr) {
+            std::cerr << "Readback of frame " << slot.id << " could not be mapped" << std::endl;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slots[index].state = SLOT_CONSUMED;
+        }
+        workDone.notify_all();
+    }
+}
+
+int ReadbackQueue::getWidth() const {
+    return width;
+}
+
+int ReadbackQueue::getHeight() const {
+    return height;
+}
@@ -0,0 +1,86 @@
+#ifndef READBACK_QUEUE_H
+#define READBACK_QUEUE_H
+
+#include <GL/glew.h>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A finished frame as seen by the consumer. Pixels are RGBA8 and point straight into the
+// mapped pack buffer, so they are only valid during the callback. GL stores rows bottom-up:
+// pixels is the top row and stride is negative, walking rows with pixels + y * stride gives
+// image order without a copy.
+struct ReadbackImage {
+    const unsigned char* pixels;
+    int width;
+    int height;
+    ptrdiff_t stride;
+    uint64_t id;
+};
+
+// Asynchronous framebuffer readback. submit() starts a glReadPixels into one of a ring of
+// pixel pack buffers and fences it; frames finish while the next ones render. Completed
+// buffers are mapped on the GL thread and handed to the consumer on a worker thread, then
+// recycled. All methods except the consumer run on the thread that owns the GL context.
+class ReadbackQueue {
+public:
+    typedef std::function<void(const ReadbackImage&)> Consumer;
+
+    ReadbackQueue();
+    ~ReadbackQueue();
+
+    // depth is the number of frames that can be in flight
+    bool create(int width, int height, int depth, Consumer consumer);
+    // Flushes, stops the worker and deletes the buffers
+    void destroy();
+
+    // Reads the color attachment of framebuffer. Blocks only when all buffers are still busy.
+    void submit(GLuint framebuffer, uint64_t id);
+    // Hands finished frames to the worker and recycles consumed buffers, never blocks
+    void poll();
+    // Waits until every submitted frame has been consumed
+    void flush();
+
+    int getWidth() const;
+    int getHeight() const;
+
+private:
+    enum SlotState { SLOT_FREE, SLOT_PENDING, SLOT_MAPPED, SLOT_CONSUMED };
+
+    struct Slot {
+        GLuint buffer;
+        GLsync fence;
+        SlotState state;
+        uint64_t id;
+        const unsigned char* mapped;
+    };
+
+    // Advances the oldest slot; with wait it blocks for the GPU or the consumer
+    bool retireOldest(bool wait);
+    void workerLoop();
+
+    int width;
+    int height;
+    std::vector<Slot> slots;
+    int head;       // Next slot to write
+    int tail;       // Oldest slot in flight
+    int inFlight;
+    Consumer consumer;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable workReady;
+    std::condition_variable workDone;
+    std::deque<int> work;  // Mapped slots waiting for the consumer, in submission order
+    bool stopping;
+
+    ReadbackQueue(const ReadbackQueue&) = delete;
+    ReadbackQueue& operator=(const ReadbackQueue&) = delete;
+};
+
+#endif
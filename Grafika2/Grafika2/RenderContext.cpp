@@ -0,0 +1,213 @@
+#include "RenderContext.h"
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <iostream>
+
+// EGL ships with Mesa and the GPU drivers on Linux; Windows builds use the GLFW path
+#if defined(__linux__)
+#define RENDER_CONTEXT_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace {
+    // glfwInit/glfwTerminate are process-wide, count the hidden windows that need them.
+    // Contexts are created and destroyed on the main thread, as GLFW requires.
+    int glfwUsers = 0;
+    // The EGL display is shared by every context on it and eglTerminate would destroy them all
+    int eglUsers = 0;
+}
+
+RenderContext::RenderContext()
+    : backend(BACKEND_AUTO), eglDisplay(nullptr), eglContext(nullptr), window(nullptr) {
+}
+
+RenderContext::~RenderContext() {
+    destroy();
+}
+
+bool RenderContext::parseBackend(const std::string& name, Backend& out) {
+    if (name == "auto") out = BACKEND_AUTO;
+    else if (name == "egl") out = BACKEND_EGL;
+    else if (name == "glfw") out = BACKEND_GLFW;
+    else return false;
+    return true;
+}
+
+const char* RenderContext::getBackendName(Backend backend) {
+    switch (backend) {
+    case BACKEND_EGL: return "egl";
+    case BACKEND_GLFW: return "glfw";
+    default: return "auto";
+    }
+}
+
+bool RenderContext::isBackendAvailable(Backend backend) {
+#ifdef RENDER_CONTEXT_EGL
+    (void)backend;  // Both backends are built in
+    return true;
+#else
+    return backend != BACKEND_EGL;
+#endif
+}
+
+bool RenderContext::create(Backend requested, int width, int height) {
+    destroy();
+
+    bool created = false;
+    if (requested == BACKEND_EGL || (requested == BACKEND_AUTO && isBackendAvailable(BACKEND_EGL))) {
+        backend = BACKEND_EGL;
+        created = createEgl();
+        if (!created && requested == BACKEND_AUTO) {
+            std::cerr << "EGL context unavailable, falling back to a hidden GLFW window" << std::endl;
+            destroy();
+        }
+    }
+    if (!created && requested != BACKEND_EGL) {
+        backend = BACKEND_GLFW;
+        created = createGlfw();
+    }
+    if (!created || !initGlew()) {
+        destroy();
+        return false;
+    }
+
+    if (!framebuffer.create(width, height)) {
+        destroy();
+        return false;
+    }
+    framebuffer.bind();
+    return true;
+}
+
+bool RenderContext::createEgl() {
+#ifdef RENDER_CONTEXT_EGL
+    // Prefer Mesa's surfaceless platform, it needs neither X11 nor a DRM device
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay != nullptr) {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+        std::cerr << "Failed to initialize EGL display" << std::endl;
+        return false;
+    }
+    eglDisplay = display;
+    ++eglUsers;
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "EGL has no desktop OpenGL support" << std::endl;
+        return false;
+    }
+
+    // The avatar still uses a few fixed-function calls, so ask for a compatibility profile
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+        EGL_NONE
+    };
+    // No config and no surface: all rendering goes to our own framebuffer object
+    EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT) {
+        std::cerr << "Failed to create EGL context: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+        return false;
+    }
+    eglContext = context;
+    return makeCurrent();
+#else
+    std::cerr << "EGL backend is not available on this platform" << std::endl;
+    return false;
+#endif
+}
+
+bool RenderContext::createGlfw() {
+    if (glfwUsers == 0 && !glfwInit()) {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return false;
+    }
+    ++glfwUsers;
+
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    window = glfwCreateWindow(1, 1, "Avatar Renderer (offscreen)", nullptr, nullptr);
+    glfwDefaultWindowHints();
+    if (!window) {
+        std::cerr << "Failed to create hidden GLFW window" << std::endl;
+        if (--glfwUsers == 0) glfwTerminate();
+        return false;
+    }
+    return makeCurrent();
+}
+
+bool RenderContext::initGlew() {
+    GLenum result = glewInit();
+    // GLEW built for GLX reports a missing X display after loading the core entry points
+    if (result != GLEW_OK && !(backend == BACKEND_EGL && result == GLEW_ERROR_NO_GLX_DISPLAY)) {
+        std::cerr << "Failed to initialize GLEW: " << glewGetErrorString(result) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void RenderContext::destroy() {
+    if (eglContext == nullptr && eglDisplay == nullptr && window == nullptr) return;
+
+    if (makeCurrent()) {
+        framebuffer.destroy();
+    }
+    releaseCurrent();
+
+#ifdef RENDER_CONTEXT_EGL
+    if (eglContext != nullptr) eglDestroyContext((EGLDisplay)eglDisplay, (EGLContext)eglContext);
+    if (eglDisplay != nullptr && --eglUsers == 0) eglTerminate((EGLDisplay)eglDisplay);
+#endif
+    eglContext = nullptr;
+    eglDisplay = nullptr;
+
+    if (backend == BACKEND_GLFW && glfwUsers > 0) {
+        if (window != nullptr) glfwDestroyWindow(window);
+        window = nullptr;
+        if (--glfwUsers == 0) glfwTerminate();
+    }
+}
+
+bool RenderContext::makeCurrent() {
+#ifdef RENDER_CONTEXT_EGL
+    if (eglContext != nullptr) {
+        return eglMakeCurrent((EGLDisplay)eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, (EGLContext)eglContext) == EGL_TRUE;
+    }
+#endif
+    if (window != nullptr) {
+        glfwMakeContextCurrent(window);
+        return true;
+    }
+    return false;
+}
+
+void RenderContext::releaseCurrent() {
+#ifdef RENDER_CONTEXT_EGL
+    if (eglDisplay != nullptr) {
+        eglMakeCurrent((EGLDisplay)eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        return;
+    }
+#endif
+    if (window != nullptr) {
+        glfwMakeContextCurrent(nullptr);
+    }
+}
+
+void RenderContext::readPixels(std::vector<unsigned char>& rgba) {
+    framebuffer.readPixels(rgba);
+}
+
+RenderContext::Backend RenderContext::getBackend() const {
+    return backend;
+}
+
+Framebuffer& RenderContext::getFramebuffer() {
+    return framebuffer;
+}
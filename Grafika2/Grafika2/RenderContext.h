@@ -0,0 +1,57 @@
+#ifndef RENDER_CONTEXT_H
+#define RENDER_CONTEXT_H
+
+#include "Framebuffer.h"
+#include <string>
+#include <vector>
+
+struct GLFWwindow;
+
+// OpenGL context without a visible window, rendering into an offscreen Framebuffer.
+// EGL surfaceless needs no window system or GPU (Mesa llvmpipe works), so it runs on
+// display-less servers; the hidden GLFW window is the fallback where EGL is missing.
+// Contexts can be created on one thread and made current on another (one thread at a time).
+class RenderContext {
+public:
+    enum Backend {
+        BACKEND_AUTO,   // EGL when available, otherwise hidden GLFW
+        BACKEND_EGL,
+        BACKEND_GLFW
+    };
+
+    RenderContext();
+    ~RenderContext();
+
+    static bool parseBackend(const std::string& name, Backend& out);
+    static const char* getBackendName(Backend backend);
+    static bool isBackendAvailable(Backend backend);
+
+    // Creates the context, makes it current and binds a width x height framebuffer
+    bool create(Backend backend, int width, int height);
+    void destroy();
+
+    bool makeCurrent();
+    void releaseCurrent();
+
+    // Reads the framebuffer as top-down RGBA8
+    void readPixels(std::vector<unsigned char>& rgba);
+
+    Backend getBackend() const;
+    Framebuffer& getFramebuffer();
+
+private:
+    bool createEgl();
+    bool createGlfw();
+    bool initGlew();
+
+    Backend backend;
+    void* eglDisplay;
+    void* eglContext;
+    GLFWwindow* window;
+    Framebuffer framebuffer;
+
+    RenderContext(const RenderContext&) = delete;
+    RenderContext& operator=(const RenderContext&) = delete;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include "RenderScaler.h"
+#include <algorithm>
+
+RenderScaler::RenderScaler(int windowWidth, int windowHeight, float minScale, float maxScale, double targetFrameTime)
+    : windowWidth(windowWidth), windowHeight(windowHeight),
+      minScale(minScale), maxScale(maxScale), scale(maxScale),
+      targetFrameTime(targetFrameTime), smoothedFrameTime(0.0), framesSinceChange(0),
+      queryIndex(0), lastGpuTime(0.0) {
+    glGenQueries(QUERY_COUNT, timerQueries);
+    for (int i = 0; i < QUERY_COUNT; ++i) {
+        queryPending[i] = false;
+    }
+    allocateTarget();
+}
+
+RenderScaler::~RenderScaler() {
+    glDeleteQueries(QUERY_COUNT, timerQueries);
+}
+
+void RenderScaler::allocateTarget() {
+    int width = std::max(1, (int)(windowWidth * maxScale + 0.5f));
+    int height = std::max(1, (int)(windowHeight * maxScale + 0.5f));
+    target.create(width, height);
+}
+
+void RenderScaler::setWindowSize(int width, int height) {
+    if (width <= 0 || height <= 0) return; // Minimized window
+    if (width == windowWidth && height == windowHeight) return;
+    windowWidth = width;
+    windowHeight = height;
+    allocateTarget();
+}
+
+float RenderScaler::getScale() {
+    return scale;
+}
+
+int RenderScaler::getRenderWidth() {
+    return std::max(1, (int)(windowWidth * scale + 0.5f));
+}
+
+int RenderScaler::getRenderHeight() {
+    return std::max(1, (int)(windowHeight * scale + 0.5f));
+}
+
+void RenderScaler::beginFrame() {
+    frameStart = std::chrono::steady_clock::now();
+    collectGpuTime();
+
+    // Only start a query if the ring slot has been read back, otherwise skip GPU timing this frame
+    if (!queryPending[queryIndex]) {
+        glBeginQuery(GL_TIME_ELAPSED, timerQueries[queryIndex]);
+    }
+
+    target.bindViewport(getRenderWidth(), getRenderHeight());
+}
+
+void RenderScaler::endFrame() {
+    if (!queryPending[queryIndex]) {
+        glEndQuery(GL_TIME_ELAPSED);
+        queryPending[queryIndex] = true;
+        queryIndex = (queryIndex + 1) % QUERY_COUNT;
+    }
+
+    // Nearest filtering keeps edges sharp instead of smearing the upscaled image
+    target.blitTo(0, getRenderWidth(), getRenderHeight(), windowWidth, windowHeight, GL_NEAREST);
+    glViewport(0, 0, windowWidth, windowHeight);
+
+    std::chrono::duration<double> cpuTime = std::chrono::steady_clock::now() - frameStart;
+    adjustScale(std::max(cpuTime.count(), lastGpuTime));
+}
+
+// Reads finished timer queries without blocking; results lag a few frames behind
+void RenderScaler::collectGpuTime() {
+    for (int i = 0; i < QUERY_COUNT; ++i) {
+        if (!queryPending[i]) continue;
+
+        GLint available = 0;
+        glGetQueryObjectiv(timerQueries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(timerQueries[i], GL_QUERY_RESULT, &elapsed);
+            lastGpuTime = elapsed * 1e-9;
+            queryPending[i] = false;
+        }
+    }
+}
+
+void RenderScaler::adjustScale(double frameTime) {
+    if (smoothedFrameTime == 0.0) {
+        smoothedFrameTime = frameTime;
+    }
+    smoothedFrameTime = smoothedFrameTime * 0.9 + frameTime * 0.1;
+
+    // Wait a few frames after each change so the average reflects the new resolution
+    if (++framesSinceChange < 15) return;
+
+    float newScale = scale;
+    if (smoothedFrameTime > targetFrameTime * 0.9) {
+        newScale = std::max(minScale, scale * 0.9f);
+    }
+    else if (smoothedFrameTime < targetFrameTime * 0.6) {
+        newScale = std::min(maxScale, scale * 1.05f);
+    }
+
+    if (newScale != scale) {
+        scale = newScale;
+        framesSinceChange = 0;
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef RENDER_SCALER_H
+#define RENDER_SCALER_H
+
+#include "Framebuffer.h"
+#include <chrono>
+
+// Renders the scene into an offscreen target whose internal resolution follows the measured
+// frame time, then upscales it to the window. The target is allocated once at maxScale and
+// only the used viewport shrinks, so a scale change never reallocates GPU memory.
+class RenderScaler {
+public:
+    RenderScaler(int windowWidth, int windowHeight, float minScale, float maxScale, double targetFrameTime);
+    ~RenderScaler();
+
+    void setWindowSize(int windowWidth, int windowHeight);
+    void beginFrame();
+    void endFrame();
+
+    float getScale();
+    int getRenderWidth();
+    int getRenderHeight();
+
+private:
+    static const int QUERY_COUNT = 4;
+
+    Framebuffer target;
+    int windowWidth;
+    int windowHeight;
+    float minScale;
+    float maxScale;
+    float scale;
+    double targetFrameTime;
+    double smoothedFrameTime;
+    int framesSinceChange;
+
+    GLuint timerQueries[QUERY_COUNT];
+    bool queryPending[QUERY_COUNT];
+    int queryIndex;
+    double lastGpuTime;
+    std::chrono::steady_clock::time_point frameStart;
+
+    void allocateTarget();
+    void collectGpuTime();
+    void adjustScale(double frameTime);
+};
+
+#endif
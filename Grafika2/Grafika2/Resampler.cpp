@@ -0,0 +1,339 @@
+#include "Resampler.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RESAMPLER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+    const float PI = 3.14159265358979f;
+
+    // Weights are 14-bit fixed point, intermediates keep 5 fractional bits in 16-bit lanes,
+    // which leaves room for the negative lobes and ringing of Lanczos
+    const int WEIGHT_BITS = 14;
+    const int INTERMEDIATE_BITS = 5;
+    const int BAND_ROWS = 16;
+
+    float filterRadius(Resampler::Filter filter) {
+        return filter == Resampler::FILTER_LANCZOS3 ? 3.0f : 2.0f;
+    }
+
+    float sinc(float x) {
+        if (x == 0.0f) return 1.0f;
+        x *= PI;
+        return std::sin(x) / x;
+    }
+
+    float evaluate(Resampler::Filter filter, float x) {
+        x = std::fabs(x);
+        if (filter == Resampler::FILTER_LANCZOS3) {
+            return x < 3.0f ? sinc(x) * sinc(x / 3.0f) : 0.0f;
+        }
+
+        const float B = 1.0f / 3.0f;
+        const float C = 1.0f / 3.0f;
+        if (x < 1.0f) {
+            return ((12.0f - 9.0f * B - 6.0f * C) * x * x * x + (-18.0f + 12.0f * B + 6.0f * C) * x * x + (6.0f - 2.0f * B)) / 6.0f;
+        }
+        if (x < 2.0f) {
+            return ((-B - 6.0f * C) * x * x * x + (6.0f * B + 30.0f * C) * x * x + (-12.0f * B - 48.0f * C) * x + (8.0f * B + 24.0f * C)) / 6.0f;
+        }
+        return 0.0f;
+    }
+
+    // Weights for every target pixel along one axis, padded to the same count. Each set
+    // sums to exactly 1 << WEIGHT_BITS, so flat areas come out unchanged.
+    struct Taps {
+        int count;                  // Taps per target pixel
+        std::vector<int> first;     // First source pixel per target pixel
+        std::vector<int16_t> weights;   // count per target pixel, zero past the used ones
+    };
+
+    void computeTaps(Resampler::Filter filter, int sourceSize, int targetSize, float start, float scale, Taps& taps) {
+        // Downscaling stretches the kernel over the source so it also low-passes
+        const float stretch = std::max(1.0f, scale);
+        const float support = filterRadius(filter) * stretch;
+        taps.count = std::min(sourceSize, (int)std::ceil(support) * 2 + 1);
+        taps.first.resize(targetSize);
+        taps.weights.assign((size_t)targetSize * taps.count, 0);
+
+        std::vector<float> weights(taps.count);
+        for (int i = 0; i < targetSize; ++i) {
+            float center = start + (i + 0.5f) * scale;
+            int low = std::max(0, (int)std::floor(center - support + 0.5f));
+            int high = std::min(sourceSize - 1, (int)std::ceil(center + support - 0.5f));
+            low = std::min(low, sourceSize - 1);
+            high = std::max(high, low);
+            if (high - low + 1 > taps.count) {
+                // Keep the taps around the center when rounding asks for one more
+                int excess = high - low + 1 - taps.count;
+                low += excess / 2;
+                high = low + taps.count - 1;
+            }
+
+            std::fill(weights.begin(), weights.end(), 0.0f);
+            float sum = 0.0f;
+            for (int j = low; j <= high; ++j) {
+                weights[j - low] = evaluate(filter, (j + 0.5f - center) / stretch);
+                sum += weights[j - low];
+            }
+            if (sum == 0.0f) {
+                // Far outside the source: the nearest edge texel
+                std::fill(weights.begin(), weights.end(), 0.0f);
+                low = std::min(sourceSize - 1, std::max(0, (int)std::floor(center)));
+                weights[0] = 1.0f;
+                sum = 1.0f;
+            }
+
+            // Windows near the far edge are shifted left so every tap stays inside the row
+            int shift = std::max(0, low + taps.count - sourceSize);
+            low -= shift;
+            taps.first[i] = low;
+
+            int16_t* fixed = &taps.weights[(size_t)i * taps.count];
+            int total = 0;
+            int largest = shift;
+            for (int k = 0; k + shift < taps.count; ++k) {
+                fixed[k + shift] = (int16_t)std::lround(weights[k] / sum * (1 << WEIGHT_BITS));
+                total += fixed[k + shift];
+                if (fixed[k + shift] > fixed[largest]) largest = k + shift;
+            }
+            fixed[largest] = (int16_t)(fixed[largest] + (1 << WEIGHT_BITS) - total);
+        }
+    }
+
+    uint32_t scale255(uint32_t value, uint32_t alpha) {
+        uint32_t product = value * alpha + 128;
+        return (product + (product >> 8)) >> 8;
+    }
+
+    // Calls work(begin, end) on bands of [0, count) from up to threads threads
+    void parallelBands(int count, int threads, const std::function<void(int, int)>& work) {
+        std::atomic<int> nextBand(0);
+        const int bandCount = (count + BAND_ROWS - 1) / BAND_ROWS;
+        auto run = [&]() {
+            for (int band = nextBand++; band < bandCount; band = nextBand++) {
+                work(band * BAND_ROWS, std::min(count, (band + 1) * BAND_ROWS));
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (int i = 1; i < std::min(threads, bandCount); ++i) {
+            workers.emplace_back(run);
+        }
+        run();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // Straight to premultiplied alpha, rounded like SpriteCompositor
+    void premultiplyRow(const unsigned char* source, int width, uint32_t* out) {
+        int x = 0;
+#ifdef RESAMPLER_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i alphaLanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+        for (; x + 4 <= width; x += 4) {
+            __m128i pixels = _mm_loadu_si128((const __m128i*)(source + x * 4));
+            __m128i halves[2] = { _mm_unpacklo_epi8(pixels, zero), _mm_unpackhi_epi8(pixels, zero) };
+            for (__m128i& half : halves) {
+                __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(half, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+                __m128i product = _mm_add_epi16(_mm_mullo_epi16(half, alpha), _mm_set1_epi16(128));
+                product = _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+                half = _mm_or_si128(_mm_andnot_si128(alphaLanes, product), _mm_and_si128(alphaLanes, half));
+            }
+            _mm_storeu_si128((__m128i*)(out + x), _mm_packus_epi16(halves[0], halves[1]));
+        }
+#endif
+        for (; x < width; ++x) {
+            const unsigned char* pixel = source + x * 4;
+            uint32_t alpha = pixel[3];
+            out[x] = scale255(pixel[0], alpha) | (scale255(pixel[1], alpha) << 8) |
+                     (scale255(pixel[2], alpha) << 16) | (alpha << 24);
+        }
+    }
+
+#ifdef RESAMPLER_SSE2
+    // Two texels with their channels interleaved as 16-bit lanes (r0 r1 g0 g1 b0 b1 a0 a1),
+    // ready for _mm_madd_epi16 with a weight pair
+    __m128i interleavePair(__m128i texels) {
+        return _mm_unpacklo_epi8(_mm_unpacklo_epi8(texels, _mm_srli_si128(texels, 4)), _mm_setzero_si128());
+    }
+
+    __m128i weightPair(const int16_t* weights) {
+        return _mm_set1_epi32((int)((uint32_t)(uint16_t)weights[0] | ((uint32_t)(uint16_t)weights[1] << 16)));
+    }
+#else
+    int16_t toIntermediate(int sum) {
+        const int shift = WEIGHT_BITS - INTERMEDIATE_BITS;
+        int value = (sum + (1 << (shift - 1))) >> shift;
+        return (int16_t)std::min(32767, std::max(-32768, value));
+    }
+#endif
+
+    // One target row of the horizontal pass from one premultiplied source row
+    void filterRow(const uint32_t* source, const Taps& taps, int targetWidth, int16_t* out) {
+        const int16_t* weights = taps.weights.data();
+        for (int x = 0; x < targetWidth; ++x, weights += taps.count) {
+            const uint32_t* texels = source + taps.first[x];
+            int k = 0;
+#ifdef RESAMPLER_SSE2
+            __m128i sum = _mm_setzero_si128();
+            for (; k + 4 <= taps.count; k += 4) {
+                __m128i four = _mm_loadu_si128((const __m128i*)(texels + k));
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(interleavePair(four), weightPair(weights + k)));
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(interleavePair(_mm_srli_si128(four, 8)), weightPair(weights + k + 2)));
+            }
+            for (; k + 2 <= taps.count; k += 2) {
+                __m128i two = _mm_loadl_epi64((const __m128i*)(texels + k));
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(interleavePair(two), weightPair(weights + k)));
+            }
+            if (k < taps.count) {
+                // Odd tap count: the last weight pairs with zero, not with the next pixel's first
+                const int16_t last[2] = { weights[k], 0 };
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(interleavePair(_mm_cvtsi32_si128((int)texels[k])), weightPair(last)));
+                ++k;
+            }
+            // Same rounding and saturation as toIntermediate
+            const int shift = WEIGHT_BITS - INTERMEDIATE_BITS;
+            sum = _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(1 << (shift - 1))), shift);
+            _mm_storel_epi64((__m128i*)(out + x * 4), _mm_packs_epi32(sum, sum));
+#else
+            int channels[4] = { 0, 0, 0, 0 };
+            for (; k < taps.count; ++k) {
+                for (int c = 0; c < 4; ++c) {
+                    channels[c] += (int)((texels[k] >> (c * 8)) & 0xFF) * weights[k];
+                }
+            }
+            for (int c = 0; c < 4; ++c) {
+                out[x * 4 + c] = toIntermediate(channels[c]);
+            }
+#endif
+        }
+    }
+
+    // sum += weight * row for a whole row of intermediates, two rows at a time when given
+    void accumulateRows(const int16_t* row0, const int16_t* row1, const int16_t* weights, int count, int* sum) {
+        int i = 0;
+#ifdef RESAMPLER_SSE2
+        const __m128i pair = weightPair(weights);
+        for (; i + 8 <= count; i += 8) {
+            __m128i values0 = _mm_loadu_si128((const __m128i*)(row0 + i));
+            __m128i values1 = _mm_loadu_si128((const __m128i*)(row1 + i));
+            __m128i low = _mm_madd_epi16(_mm_unpacklo_epi16(values0, values1), pair);
+            __m128i high = _mm_madd_epi16(_mm_unpackhi_epi16(values0, values1), pair);
+            _mm_storeu_si128((__m128i*)(sum + i), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(sum + i)), low));
+            _mm_storeu_si128((__m128i*)(sum + i + 4), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(sum + i + 4)), high));
+        }
+#endif
+        for (; i < count; ++i) {
+            sum[i] += row0[i] * weights[0] + row1[i] * weights[1];
+        }
+    }
+
+    // Accumulated premultiplied channels to 8 bits: alpha is clamped to [0, 255] and the
+    // colors to [0, alpha], which keeps the result valid after ringing
+    void storeRow(const int* sum, int width, bool premultiplied, unsigned char* out) {
+        const int shift = WEIGHT_BITS + INTERMEDIATE_BITS;
+        const int half = 1 << (shift - 1);
+        for (int x = 0; x < width; ++x) {
+            const int* pixel = sum + x * 4;
+            int alpha = std::min(255, std::max(0, (pixel[3] + half) >> shift));
+            for (int c = 0; c < 3; ++c) {
+                int value = std::min(alpha, std::max(0, (pixel[c] + half) >> shift));
+                if (!premultiplied && alpha > 0 && alpha < 255) {
+                    value = (value * 255 + alpha / 2) / alpha;
+                }
+                out[x * 4 + c] = (unsigned char)value;
+            }
+            out[x * 4 + 3] = (unsigned char)alpha;
+        }
+    }
+}
+
+bool Resampler::parseFilter(const char* name, Filter& filter) {
+    if (std::strcmp(name, "mitchell") == 0) {
+        filter = FILTER_MITCHELL;
+        return true;
+    }
+    if (std::strcmp(name, "lanczos") == 0 || std::strcmp(name, "lanczos3") == 0) {
+        filter = FILTER_LANCZOS3;
+        return true;
+    }
+    return false;
+}
+
+const char* Resampler::getFilterName(Filter filter) {
+    return filter == FILTER_LANCZOS3 ? "lanczos3" : "mitchell";
+}
+
+void Resampler::resize(const unsigned char* source, int sourceWidth, int sourceHeight, ptrdiff_t sourceStride,
+                       unsigned char* target, int targetWidth, int targetHeight, ptrdiff_t targetStride,
+                       Filter filter, bool premultiplied, int threads) {
+    resample(source, sourceWidth, sourceHeight, sourceStride, target, targetWidth, targetHeight, targetStride,
+             0.0f, 0.0f, (float)sourceWidth / targetWidth, (float)sourceHeight / targetHeight, filter, premultiplied, threads);
+}
+
+void Resampler::resample(const unsigned char* source, int sourceWidth, int sourceHeight, ptrdiff_t sourceStride,
+                         unsigned char* target, int targetWidth, int targetHeight, ptrdiff_t targetStride,
+                         float sourceX, float sourceY, float scaleX, float scaleY,
+                         Filter filter, bool premultiplied, int threads) {
+    if (sourceWidth <= 0 || sourceHeight <= 0 || targetWidth <= 0 || targetHeight <= 0) return;
+    if (sourceStride == 0) sourceStride = (ptrdiff_t)sourceWidth * 4;
+    if (targetStride == 0) targetStride = (ptrdiff_t)targetWidth * 4;
+    threads = std::max(1, threads);
+
+    Taps columns;
+    Taps rows;
+    computeTaps(filter, sourceWidth, targetWidth, sourceX, scaleX, columns);
+    computeTaps(filter, sourceHeight, targetHeight, sourceY, scaleY, rows);
+
+    // Only the source rows some target row reads go through the horizontal pass
+    const int firstRow = rows.first.front();
+    const int lastRow = rows.first.back() + rows.count - 1;
+    const int rowCount = lastRow - firstRow + 1;
+    const int rowValues = targetWidth * 4;
+    std::vector<int16_t> intermediate((size_t)rowCount * rowValues);
+
+    parallelBands(rowCount, threads, [&](int begin, int end) {
+        std::vector<uint32_t> premultipliedRow(sourceWidth);
+        for (int y = begin; y < end; ++y) {
+            const unsigned char* row = source + (firstRow + y) * sourceStride;
+            const uint32_t* texels = premultipliedRow.data();
+            if (premultiplied) {
+                std::memcpy(premultipliedRow.data(), row, (size_t)sourceWidth * 4);
+            }
+            else {
+                premultiplyRow(row, sourceWidth, premultipliedRow.data());
+            }
+            filterRow(texels, columns, targetWidth, &intermediate[(size_t)y * rowValues]);
+        }
+    });
+
+    parallelBands(targetHeight, threads, [&](int begin, int end) {
+        std::vector<int> sum(rowValues);
+        for (int y = begin; y < end; ++y) {
+            std::fill(sum.begin(), sum.end(), 0);
+            const int16_t* weights = &rows.weights[(size_t)y * rows.count];
+            const int16_t* first = &intermediate[(size_t)(rows.first[y] - firstRow) * rowValues];
+            int k = 0;
+            for (; k + 2 <= rows.count; k += 2) {
+                accumulateRows(first + (size_t)k * rowValues, first + (size_t)(k + 1) * rowValues, weights + k, rowValues, sum.data());
+            }
+            if (k < rows.count) {
+                // Odd tap count: pair the last row with itself at weight zero
+                const int16_t last[2] = { weights[k], 0 };
+                accumulateRows(first + (size_t)k * rowValues, first + (size_t)k * rowValues, last, rowValues, sum.data());
+            }
+            storeRow(sum.data(), targetWidth, premultiplied, target + y * targetStride);
+        }
+    });
+}
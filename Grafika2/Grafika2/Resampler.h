@@ -0,0 +1,40 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <cstddef>
+
+// Separable high-quality resizing of 8-bit RGBA images. Filtering runs on premultiplied
+// colors so transparent pixels do not bleed dark fringes into sprite and avatar edges;
+// straight-alpha images are premultiplied on the way in and converted back on the way out.
+//
+// Weights are 14-bit fixed point. The horizontal pass writes signed 16-bit intermediates,
+// which keep the negative lobes of Lanczos, and the vertical pass accumulates two rows per
+// step. Both multiply tap pairs with SSE2 madd; the scalar fallback gives the same bits.
+// Rows are spread over threads.
+class Resampler {
+public:
+    enum Filter {
+        FILTER_MITCHELL,    // Mitchell-Netravali, B = C = 1/3: soft, no visible ringing
+        FILTER_LANCZOS3     // Sharper, slight ringing on hard edges
+    };
+
+    static bool parseFilter(const char* name, Filter& filter);
+    static const char* getFilterName(Filter filter);
+
+    // Resizes the whole image. Rows start at pixels + y * stride (0 means width * 4), so a
+    // negative stride reads or writes bottom-up buffers in place, like PngWriter.
+    static void resize(const unsigned char* source, int sourceWidth, int sourceHeight, ptrdiff_t sourceStride,
+                       unsigned char* target, int targetWidth, int targetHeight, ptrdiff_t targetStride,
+                       Filter filter, bool premultiplied, int threads = 1);
+
+    // General form: target pixel (x, y) is centered on source position
+    // (sourceX + (x + 0.5) * scaleX, sourceY + (y + 0.5) * scaleY). Used to prefilter an
+    // image straight onto a pixel grid at a sub-pixel offset; outside the source the kernel
+    // is renormalized over the texels that exist.
+    static void resample(const unsigned char* source, int sourceWidth, int sourceHeight, ptrdiff_t sourceStride,
+                         unsigned char* target, int targetWidth, int targetHeight, ptrdiff_t targetStride,
+                         float sourceX, float sourceY, float scaleX, float scaleY,
+                         Filter filter, bool premultiplied, int threads = 1);
+};
+
+#endif
@@ -0,0 +1,598 @@
+#include "Scene.h"
+#include "AvatarGeometry.h"
+#include "ImpostorCache.h"
+#include <algorithm>
+#include <cmath>
+
+SceneAvatar::SceneAvatar(Scene& scene, int index) : scene(scene), index(index), edited(false) {
+    for (int joint = 0; joint < AvatarGeometry::JOINT_COUNT; ++joint) {
+        pose[joint] = AvatarGeometry::REST_POSE[joint];
+    }
+    setTransform(0.0f, 0.0f, 1.0f);
+    depth = 0;
+    visible = true;
+    resetToDefaults();
+}
+
+void SceneAvatar::resetToDefaults() {
+    for (int color = 0; color < Avatar::COLOR_COUNT; ++color) {
+        setColor((Avatar::AvatarColor)color, Avatar::DEFAULT_COLORS[color][0], Avatar::DEFAULT_COLORS[color][1], Avatar::DEFAULT_COLORS[color][2]);
+    }
+
+    occupiedSlots = 0;
+    for (int i = 0; i < SlotRegistry::MAX_SLOTS; ++i) {
+        slotTextures[i] = 0;
+    }
+
+    const SlotRegistry& slots = scene.getSlots();
+    for (int slot = 0; slot < slots.getSlotCount(); ++slot) {
+        const std::string& defaultItem = slots.getSlot(slot).defaultItem;
+        if (!defaultItem.empty()) {
+            applySlot(slot, loadTextureCached(defaultItem));
+        }
+    }
+}
+
+void SceneAvatar::setColor(Avatar::AvatarColor color, float r, float g, float b) {
+    colors[color][0] = r;
+    colors[color][1] = g;
+    colors[color][2] = b;
+    colorsDirty = true;
+    scene.palettesDirty = true;
+    touch();
+}
+
+GLuint SceneAvatar::loadTextureCached(const std::string& filepath) {
+    return scene.getTextures().get(filepath);
+}
+
+void SceneAvatar::applySlot(int slot, GLuint texture) {
+    occupiedSlots = scene.getSlots().apply(occupiedSlots, slot);
+    slotTextures[slot] = texture;
+    touch();
+}
+
+void SceneAvatar::clearSlot(int slot) {
+    occupiedSlots &= ~(1u << slot);
+    touch();
+}
+
+void SceneAvatar::touch() {
+    revision = scene.nextRevision++;
+    markEdited();
+}
+
+void SceneAvatar::markEdited() {
+    if (edited) return;
+    edited = true;
+    scene.edited.push_back(index);
+}
+
+uint32_t SceneAvatar::getOccupiedSlots() const {
+    return occupiedSlots;
+}
+
+void SceneAvatar::setTransform(float x, float y, float scale, bool mirrored) {
+    transform[0] = mirrored ? -scale : scale;
+    transform[1] = scale;
+    transform[2] = x;
+    transform[3] = y;
+    ++scene.nextRevision;
+    scene.spatialIndex.update(index, getBounds());
+    markEdited();
+}
+
+SpatialIndex::Bounds SceneAvatar::getBounds() const {
+    const SpatialIndex::Bounds& local = isPosed() ? scene.posedBounds : scene.localBounds;
+    // A mirrored avatar swaps its left and right extent
+    const float left = transform[0] >= 0.0f ? local.minX : local.maxX;
+    const float right = transform[0] >= 0.0f ? local.maxX : local.minX;
+    return { left * transform[0] + transform[2], local.minY * transform[1] + transform[3],
+             right * transform[0] + transform[2], local.maxY * transform[1] + transform[3] };
+}
+
+void SceneAvatar::setDepth(int value) {
+    depth = value;
+    ++scene.nextRevision;
+    markEdited();
+}
+
+void SceneAvatar::setVisible(bool value) {
+    visible = value;
+    ++scene.nextRevision;
+    markEdited();
+}
+
+void SceneAvatar::setPose(float leftArm, float rightArm, float headTilt) {
+    const bool wasPosed = isPosed();
+    pose[AvatarGeometry::JOINT_LEFT_ARM] = leftArm;
+    pose[AvatarGeometry::JOINT_RIGHT_ARM] = rightArm;
+    pose[AvatarGeometry::JOINT_HEAD] = headTilt;
+    ++scene.nextRevision;
+    // The bounds cover every pose, so they only change on leaving or reaching the rest pose
+    if (isPosed() != wasPosed) scene.spatialIndex.update(index, getBounds());
+    markEdited();
+}
+
+float SceneAvatar::getPose(AvatarGeometry::Joint joint) const {
+    return pose[joint];
+}
+
+bool SceneAvatar::isPosed() const {
+    for (int joint = 0; joint < AvatarGeometry::JOINT_COUNT; ++joint) {
+        if (pose[joint] != AvatarGeometry::REST_POSE[joint]) return true;
+    }
+    return false;
+}
+
+Scene::Scene(const SlotRegistry& slots, Shader& bodyShader, Shader& spriteShader, TextureRegistry* sharedTextures)
+    : slots(slots), bodyShader(bodyShader), spriteShader(spriteShader), textures(sharedTextures != nullptr ? sharedTextures : &ownTextures),
+      spatialIndex({ -1.0f, -1.0f, 1.0f, 1.0f }), impostors(nullptr), nextRevision(0), paletteBuffer(0), paletteCapacity(0),
+      palettesDirty(false) {
+    stats = { 0, 0, 0, 0, 0, 0 };
+    setupGeometry();
+    computeLocalBounds();
+
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    const GLsizeiptr paletteSize = Avatar::COLOR_COUNT * 4 * sizeof(float);
+    paletteStride = (paletteSize + alignment - 1) / alignment * alignment;
+    glGenBuffers(1, &paletteBuffer);
+
+    bodyTransformLocation = glGetUniformLocation(bodyShader.getID(), "viewTransform");
+    bodyColorLocation = glGetUniformLocation(bodyShader.getID(), "colorIndex");
+    spriteTransformLocation = glGetUniformLocation(spriteShader.getID(), "viewTransform");
+    spriteTextureLocation = glGetUniformLocation(spriteShader.getID(), "texture1");
+    bodyPoseLocation = glGetUniformLocation(bodyShader.getID(), "pose");
+    spritePoseLocation = glGetUniformLocation(spriteShader.getID(), "pose");
+
+    leftHandTexture = textures->get("hands/leva.png");
+    rightHandTexture = textures->get("hands/desna.png");
+}
+
+Scene::~Scene() {
+    glDeleteBuffers(1, &bodyVBO);
+    glDeleteVertexArrays(1, &bodyVAO);
+    glDeleteBuffers(1, &spriteVBO);
+    glDeleteVertexArrays(1, &spriteVAO);
+    glDeleteBuffers(1, &paletteBuffer);
+}
+
+void Scene::setupGeometry() {
+    using namespace AvatarGeometry;
+
+    // The same buffers as Avatar::setupGeometry, once for every avatar of the scene
+    glGenVertexArrays(1, &bodyVAO);
+    glGenBuffers(1, &bodyVBO);
+    glBindVertexArray(bodyVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, bodyVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(BODY_VERTICES), BODY_VERTICES.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    std::vector<float> sprites(SPRITE_VERTICES.begin(), SPRITE_VERTICES.end());
+    sprites.resize(SPRITE_VERTICES.size() + slots.getSlotCount() * SPRITE_FLOATS_PER_QUAD);
+    for (int slot = 0; slot < slots.getSlotCount(); ++slot) {
+        writeSpriteQuad(slots.getSlot(slot).anchor, &sprites[SPRITE_VERTICES.size() + slot * SPRITE_FLOATS_PER_QUAD]);
+    }
+
+    glGenVertexArrays(1, &spriteVAO);
+    glGenBuffers(1, &spriteVBO);
+    glBindVertexArray(spriteVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, spriteVBO);
+    glBufferData(GL_ARRAY_BUFFER, sprites.size() * sizeof(float), sprites.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void Scene::computeLocalBounds() {
+    using namespace AvatarGeometry;
+    localBounds = { 0.0f, 0.0f, 0.0f, 0.0f };
+    auto add = [&](float x, float y) {
+        localBounds.minX = std::min(localBounds.minX, x);
+        localBounds.minY = std::min(localBounds.minY, y);
+        localBounds.maxX = std::max(localBounds.maxX, x);
+        localBounds.maxY = std::max(localBounds.maxY, y);
+    };
+    for (size_t i = 0; i < BODY_VERTICES.size(); i += 2) {
+        add(BODY_VERTICES[i], BODY_VERTICES[i + 1]);
+    }
+    for (size_t i = 0; i < SPRITE_VERTICES.size(); i += 4) {
+        add(SPRITE_VERTICES[i], SPRITE_VERTICES[i + 1]);
+    }
+    // Item anchors: the pants reach below the feet
+    for (int slot = 0; slot < slots.getSlotCount(); ++slot) {
+        const Rect& anchor = slots.getSlot(slot).anchor;
+        add(anchor.centerX - anchor.width * 0.5f, anchor.centerY - anchor.height * 0.5f);
+        add(anchor.centerX + anchor.width * 0.5f, anchor.centerY + anchor.height * 0.5f);
+    }
+
+    // Any pose: each joint's parts can sweep a disc about its pivot, bounded by a square
+    float reach[JOINT_COUNT] = {};
+    auto extend = [&](Joint joint, float x, float y) {
+        reach[joint] = std::max(reach[joint], std::hypot(x - JOINT_PIVOTS[joint].x, y - JOINT_PIVOTS[joint].y));
+    };
+    auto extendRange = [&](Joint joint, const MeshRange& range) {
+        for (int i = range.first; i < range.first + range.count; ++i) {
+            extend(joint, BODY_VERTICES[i * 2], BODY_VERTICES[i * 2 + 1]);
+        }
+    };
+    auto extendRect = [&](Joint joint, const Rect& rect) {
+        for (int corner = 0; corner < 4; ++corner) {
+            extend(joint, rect.centerX + rect.width * ((corner & 1) ? 0.5f : -0.5f),
+                   rect.centerY + rect.height * ((corner & 2) ? 0.5f : -0.5f));
+        }
+    };
+    extendRange(JOINT_LEFT_ARM, LEFT_ARM);
+    extendRect(JOINT_LEFT_ARM, LEFT_HAND_RECT);
+    extendRange(JOINT_RIGHT_ARM, RIGHT_ARM);
+    extendRect(JOINT_RIGHT_ARM, RIGHT_HAND_RECT);
+    extendRange(JOINT_HEAD, HEAD);
+    for (int slot = 0; slot < slots.getSlotCount(); ++slot) {
+        if (slots.getSlot(slot).followsHead) extendRect(JOINT_HEAD, slots.getSlot(slot).anchor);
+    }
+    posedBounds = localBounds;
+    for (int joint = 0; joint < JOINT_COUNT; ++joint) {
+        posedBounds.minX = std::min(posedBounds.minX, JOINT_PIVOTS[joint].x - reach[joint]);
+        posedBounds.minY = std::min(posedBounds.minY, JOINT_PIVOTS[joint].y - reach[joint]);
+        posedBounds.maxX = std::max(posedBounds.maxX, JOINT_PIVOTS[joint].x + reach[joint]);
+        posedBounds.maxY = std::max(posedBounds.maxY, JOINT_PIVOTS[joint].y + reach[joint]);
+    }
+}
+
+SceneAvatar& Scene::addAvatar() {
+    avatars.emplace_back(*this, (int)avatars.size());
+    palettesDirty = true;
+    ++nextRevision;
+    return avatars.back();
+}
+
+SceneAvatar& Scene::getAvatar(int index) {
+    return avatars[index];
+}
+
+int Scene::getAvatarCount() const {
+    return (int)avatars.size();
+}
+
+void Scene::clear() {
+    avatars.clear();
+    edited.clear();
+    items.clear();
+    spatialIndex.clear();
+    ++nextRevision;
+}
+
+TextureRegistry& Scene::getTextures() {
+    return *textures;
+}
+
+const SlotRegistry& Scene::getSlots() const {
+    return slots;
+}
+
+uint32_t Scene::getRevision() const {
+    return nextRevision;
+}
+
+SpatialIndex::Bounds Scene::getAvatarBounds(int avatar) const {
+    return avatars[avatar].getBounds();
+}
+
+int Scene::pick(float x, float y) const {
+    std::vector<int> found;
+    spatialIndex.queryPoint(x, y, found);
+    int best = -1;
+    for (int i : found) {
+        const SceneAvatar& avatar = avatars[i];
+        if (!avatar.visible) continue;
+        // Equal depths do not overlap, the tie only keeps the answer deterministic
+        if (best < 0 || avatar.depth > avatars[best].depth || (avatar.depth == avatars[best].depth && i > best)) best = i;
+    }
+    return best;
+}
+
+int Scene::pickSlot(int index, float x, float y) const {
+    const SceneAvatar& avatar = avatars[index];
+    const AlphaMask* masks[SlotRegistry::MAX_SLOTS] = {};
+    for (int slot = 0; slot < slots.getSlotCount(); ++slot) {
+        if ((avatar.occupiedSlots & (1u << slot)) != 0) masks[slot] = textures->getMask(avatar.slotTextures[slot]);
+    }
+    // Back into the avatar's own space; a mirrored avatar has a negative x scale
+    const float localX = (x - avatar.transform[2]) / avatar.transform[0];
+    const float localY = (y - avatar.transform[3]) / avatar.transform[1];
+    const float tilt = AvatarGeometry::jointRotation(AvatarGeometry::JOINT_HEAD, avatar.pose[AvatarGeometry::JOINT_HEAD]);
+    if (tilt == 0.0f) return slots.pickSlot(avatar.occupiedSlots, masks, localX, localY);
+
+    // Items on the tilted head are tested with the point turned back about the neck, the
+    // rest as they are; where both hit, the one drawn later is on top
+    const AvatarGeometry::Vec2& pivot = AvatarGeometry::JOINT_PIVOTS[AvatarGeometry::JOINT_HEAD];
+    const float c = std::cos(tilt), s = std::sin(tilt);
+    const float dx = localX - pivot.x, dy = localY - pivot.y;
+    const uint32_t headMask = slots.getHeadMask();
+    const int onHead = slots.pickSlot(avatar.occupiedSlots & headMask, masks, pivot.x + c * dx + s * dy, pivot.y - s * dx + c * dy);
+    const int offHead = slots.pickSlot(avatar.occupiedSlots & ~headMask, masks, localX, localY);
+    if (onHead < 0 || offHead < 0) return onHead >= 0 ? onHead : offHead;
+    const std::vector<int>& drawOrder = slots.getDrawOrder();
+    const auto onHeadOrder = std::find(drawOrder.begin(), drawOrder.end(), onHead);
+    const auto offHeadOrder = std::find(drawOrder.begin(), drawOrder.end(), offHead);
+    return onHeadOrder > offHeadOrder ? onHead : offHead;
+}
+
+void Scene::select(const SpatialIndex::Bounds& rect, std::vector<int>& out) const {
+    spatialIndex.queryRect(rect, out);
+    out.erase(std::remove_if(out.begin(), out.end(), [&](int i) { return !avatars[i].visible; }), out.end());
+    std::sort(out.begin(), out.end());
+}
+
+const Scene::DrawStats& Scene::getStats() const {
+    return stats;
+}
+
+void Scene::setImpostors(ImpostorCache* cache) {
+    impostors = cache;
+}
+
+void Scene::uploadPalettes() {
+    if (!palettesDirty) return;
+    palettesDirty = false;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, paletteBuffer);
+    const int count = (int)avatars.size();
+    bool reallocated = false;
+    if (count > paletteCapacity) {
+        paletteCapacity = std::max(count, paletteCapacity * 2);
+        glBufferData(GL_UNIFORM_BUFFER, paletteCapacity * paletteStride, nullptr, GL_DYNAMIC_DRAW);
+        reallocated = true;
+    }
+    // std140: one vec4 per palette entry, as Avatar::uploadColors
+    for (int i = 0; i < count; ++i) {
+        SceneAvatar& avatar = avatars[i];
+        if (!avatar.colorsDirty && !reallocated) continue;
+        float palette[Avatar::COLOR_COUNT * 4];
+        for (int color = 0; color < Avatar::COLOR_COUNT; ++color) {
+            palette[color * 4] = avatar.colors[color][0];
+            palette[color * 4 + 1] = avatar.colors[color][1];
+            palette[color * 4 + 2] = avatar.colors[color][2];
+            palette[color * 4 + 3] = 1.0f;
+        }
+        glBufferSubData(GL_UNIFORM_BUFFER, i * paletteStride, sizeof(palette), palette);
+        avatar.colorsDirty = false;
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void Scene::appendItems(int index) {
+    const std::vector<int>& drawOrder = slots.getDrawOrder();
+    const SceneAvatar& avatar = avatars[index];
+    for (int step = STEP_NECK; step < STEP_FIRST_SLOT; ++step) {
+        GLuint texture = step == STEP_LEFT_HAND ? leftHandTexture : (step == STEP_RIGHT_HAND ? rightHandTexture : 0);
+        items.push_back({ avatar.depth, step, texture, index, -1 });
+    }
+    for (int order = 0; order < (int)drawOrder.size(); ++order) {
+        int slot = drawOrder[order];
+        if ((avatar.occupiedSlots & (1u << slot)) == 0 || avatar.slotTextures[slot] == 0) continue;
+        items.push_back({ avatar.depth, STEP_FIRST_SLOT + order, avatar.slotTextures[slot], index, -1 });
+    }
+}
+
+void Scene::requestLevels(int index, float pixelsX, float pixelsY) {
+    using namespace AvatarGeometry;
+    const SceneAvatar& avatar = avatars[index];
+    textures->request(leftHandTexture, LEFT_HAND_RECT.width * pixelsX, LEFT_HAND_RECT.height * pixelsY);
+    textures->request(rightHandTexture, RIGHT_HAND_RECT.width * pixelsX, RIGHT_HAND_RECT.height * pixelsY);
+    for (int slot = 0; slot < slots.getSlotCount(); ++slot) {
+        if ((avatar.occupiedSlots & (1u << slot)) == 0) continue;
+        const Rect& anchor = slots.getSlot(slot).anchor;
+        textures->request(avatar.slotTextures[slot], anchor.width * pixelsX, anchor.height * pixelsY);
+    }
+}
+
+void Scene::draw(const float* viewTransform) {
+    static const float identity[4] = { 1.0f, 1.0f, 0.0f, 0.0f };
+    if (viewTransform == nullptr) viewTransform = identity;
+    stats = { 0, 0, 0, 0, 0, 0 };
+    uploadPalettes();
+
+    // The scene NDC rectangle the target shows
+    const float left = (-1.0f - viewTransform[2]) / viewTransform[0];
+    const float right = (1.0f - viewTransform[2]) / viewTransform[0];
+    const float bottom = (-1.0f - viewTransform[3]) / viewTransform[1];
+    const float top = (1.0f - viewTransform[3]) / viewTransform[1];
+    select({ std::min(left, right), std::min(bottom, top), std::max(left, right), std::max(bottom, top) }, inView);
+    if (impostors != nullptr) {
+        impostors->update(viewTransform, inView);
+    }
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    items.clear();
+    for (int i : inView) {
+        const int cell = impostors != nullptr ? impostors->getCell(i) : -1;
+        if (cell >= 0) {
+            items.push_back({ avatars[i].depth, STEP_IMPOSTOR, impostors->getTexture(), i, cell });
+            ++stats.impostors;
+        }
+        else {
+            appendItems(i);
+            const float* transform = avatars[i].transform;
+            requestLevels(i, std::fabs(transform[0] * viewTransform[0]) * viewport[2] * 0.5f,
+                          std::fabs(transform[1] * viewTransform[1]) * viewport[3] * 0.5f);
+        }
+    }
+    textures->stream();
+    stats.pendingTextures = textures->getPendingCount();
+    // Painter's order between depths and between the layers of one avatar; inside a layer
+    // the avatars wearing the same texture end up next to each other
+    std::sort(items.begin(), items.end(), [](const DrawItem& a, const DrawItem& b) {
+        if (a.depth != b.depth) return a.depth < b.depth;
+        if (a.step != b.step) return a.step < b.step;
+        if (a.texture != b.texture) return a.texture < b.texture;
+        return a.avatar < b.avatar;
+    });
+    drawItems(viewTransform, false);
+}
+
+void Scene::drawItems(const float* viewTransform, bool isolated) {
+    using namespace AvatarGeometry;
+    static const float identity[4] = { 1.0f, 1.0f, 0.0f, 0.0f };
+    const std::vector<int>& drawOrder = slots.getDrawOrder();
+
+    // Impostor cells hold premultiplied color; rendering one writes it that way, and the
+    // coverage is accumulated in alpha instead of alpha times itself
+    glEnable(GL_BLEND);
+    if (isolated) {
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    }
+    else {
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+    glActiveTexture(GL_TEXTURE0);
+    glUseProgram(spriteShader.getID());
+    glUniform1i(spriteTextureLocation, 0);
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    GLuint program = 0;
+    GLuint vao = 0;
+    GLuint texture = 0;
+    int paletteAvatar = -1;
+    int transformAvatar = -1;
+    bool premultiplied = false;
+    // The pose uniform of each program: rotation (cosine, sine) about a pivot, as in the
+    // shaders. Joints at rest use the identity itself, so rest poses draw bit for bit as before.
+    static const float restPose[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+    float bodyPose[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+    float spritePose[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+    auto setPose = [&](bool body, const SceneAvatar& avatar, int joint) {
+        float value[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+        if (joint >= 0 && avatar.pose[joint] != REST_POSE[joint]) {
+            const float rotation = jointRotation((Joint)joint, avatar.pose[joint]);
+            value[0] = std::cos(rotation);
+            value[1] = std::sin(rotation);
+            value[2] = JOINT_PIVOTS[joint].x;
+            value[3] = JOINT_PIVOTS[joint].y;
+        }
+        float* current = body ? bodyPose : spritePose;
+        if (std::equal(value, value + 4, current)) return;
+        std::copy(value, value + 4, current);
+        glUniform4fv(body ? bodyPoseLocation : spritePoseLocation, 1, value);
+    };
+    for (const DrawItem& item : items) {
+        const bool body = item.texture == 0;
+        Shader& shader = body ? bodyShader : spriteShader;
+        if (shader.getID() != program) {
+            program = shader.getID();
+            glUseProgram(program);
+            transformAvatar = -1;   // Each program keeps its own uniform values
+            ++stats.programChanges;
+        }
+        const GLuint itemVAO = body ? bodyVAO : (item.step == STEP_IMPOSTOR ? impostors->getVAO() : spriteVAO);
+        if (itemVAO != vao) {
+            glBindVertexArray(itemVAO);
+            vao = itemVAO;
+        }
+        if (item.avatar != transformAvatar) {
+            const float* local = isolated ? identity : avatars[item.avatar].transform;
+            const float combined[4] = {
+                local[0] * viewTransform[0], local[1] * viewTransform[1],
+                local[2] * viewTransform[0] + viewTransform[2], local[3] * viewTransform[1] + viewTransform[3]
+            };
+            glUniform4fv(body ? bodyTransformLocation : spriteTransformLocation, 1, combined);
+            transformAvatar = item.avatar;
+        }
+        if (!isolated && premultiplied != (item.step == STEP_IMPOSTOR)) {
+            premultiplied = item.step == STEP_IMPOSTOR;
+            glBlendFunc(premultiplied ? GL_ONE : GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        }
+
+        if (body) {
+            if (item.avatar != paletteAvatar) {
+                glBindBufferRange(GL_UNIFORM_BUFFER, Avatar::COLOR_BLOCK_BINDING, paletteBuffer, item.avatar * paletteStride,
+                                  Avatar::COLOR_COUNT * 4 * sizeof(float));
+                paletteAvatar = item.avatar;
+            }
+            MeshRange range;
+            Avatar::AvatarColor color = Avatar::COLOR_SKIN;
+            switch (item.step) {
+            case STEP_NECK: range = NECK; break;
+            case STEP_HEAD: {
+                // Radius in pixels along the head's larger semi-axis
+                const float* local = isolated ? identity : avatars[item.avatar].transform;
+                const float radius = std::max(HEAD_A * std::fabs(local[0] * viewTransform[0]) * viewport[2],
+                                              HEAD_B * std::fabs(local[1] * viewTransform[1]) * viewport[3]) * 0.5f;
+                range = HEAD_LEVELS[tessellationLevel(radius, HEAD_VERTICES, HEAD_LEVEL_COUNT)];
+                color = Avatar::COLOR_FACE;
+                break;
+            }
+            case STEP_TORSO_AND_ARMS: range = { TORSO.first, RIGHT_ARM.first + RIGHT_ARM.count - TORSO.first, false }; break;
+            default: range = { LEFT_LEG.first, RIGHT_LEG.first + RIGHT_LEG.count - LEFT_LEG.first, false }; break;
+            }
+            glUniform1i(bodyColorLocation, color);
+            const SceneAvatar& avatar = avatars[item.avatar];
+            if (item.step == STEP_TORSO_AND_ARMS &&
+                (avatar.pose[JOINT_LEFT_ARM] != REST_POSE[JOINT_LEFT_ARM] || avatar.pose[JOINT_RIGHT_ARM] != REST_POSE[JOINT_RIGHT_ARM])) {
+                // Posed arms turn apart from the torso, so the merged range splits in three
+                const MeshRange parts[3] = { TORSO, LEFT_ARM, RIGHT_ARM };
+                const int joints[3] = { -1, JOINT_LEFT_ARM, JOINT_RIGHT_ARM };
+                for (int part = 0; part < 3; ++part) {
+                    setPose(true, avatar, joints[part]);
+                    glDrawArrays(GL_TRIANGLES, parts[part].first, parts[part].count);
+                }
+                stats.drawCalls += 2;
+            }
+            else {
+                setPose(true, avatar, item.step == STEP_HEAD ? JOINT_HEAD : -1);
+                glDrawArrays(range.fan ? GL_TRIANGLE_FAN : GL_TRIANGLES, range.first, range.count);
+            }
+            stats.vertices += range.count;
+        }
+        else {
+            if (item.texture != texture) {
+                glBindTexture(GL_TEXTURE_2D, item.texture);
+                texture = item.texture;
+                ++stats.textureBinds;
+            }
+            int firstVertex;
+            int joint = -1;
+            if (item.step == STEP_IMPOSTOR) firstVertex = item.cell * SPRITE_VERTICES_PER_QUAD;
+            else if (item.step == STEP_LEFT_HAND) {
+                firstVertex = spriteFirstVertex(SPRITE_LEFT_HAND);
+                joint = JOINT_LEFT_ARM;
+            }
+            else if (item.step == STEP_RIGHT_HAND) {
+                firstVertex = spriteFirstVertex(SPRITE_RIGHT_HAND);
+                joint = JOINT_RIGHT_ARM;
+            }
+            else {
+                const int slot = drawOrder[item.step - STEP_FIRST_SLOT];
+                firstVertex = (SPRITE_COUNT + slot) * SPRITE_VERTICES_PER_QUAD;
+                if (slots.getSlot(slot).followsHead) joint = JOINT_HEAD;
+            }
+            setPose(false, avatars[item.avatar], joint);
+            glDrawArrays(GL_TRIANGLES, firstVertex, SPRITE_VERTICES_PER_QUAD);
+            stats.vertices += SPRITE_VERTICES_PER_QUAD;
+        }
+        ++stats.drawCalls;
+    }
+    // The shaders are shared with Avatar, which draws unposed
+    if (!std::equal(bodyPose, bodyPose + 4, restPose)) {
+        glUseProgram(bodyShader.getID());
+        glUniform4fv(bodyPoseLocation, 1, restPose);
+    }
+    if (!std::equal(spritePose, spritePose + 4, restPose)) {
+        glUseProgram(spriteShader.getID());
+        glUniform4fv(spritePoseLocation, 1, restPose);
+    }
+
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDisable(GL_BLEND);
+}
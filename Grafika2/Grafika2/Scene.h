@@ -0,0 +1,199 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "Avatar.h"
+#include "Shader.h"
+#include "SlotRegistry.h"
+#include "SpatialIndex.h"
+#include "TextureRegistry.h"
+#include <GL/glew.h>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+class ImpostorCache;
+class Scene;
+
+// One character of a Scene: colors, wardrobe and placement only, with the setter interface
+// of Avatar (so AvatarDescription applies to it). Geometry, textures and shaders belong to
+// the scene, so an extra avatar costs a couple of hundred bytes instead of a texture set.
+class SceneAvatar {
+public:
+    SceneAvatar(Scene& scene, int index);
+
+    void resetToDefaults();
+    void setColor(Avatar::AvatarColor color, float r, float g, float b);
+
+    // Texture from the scene's registry, shared with every other avatar wearing the item
+    GLuint loadTextureCached(const std::string& filepath);
+    void applySlot(int slot, GLuint texture);
+    void clearSlot(int slot);
+    uint32_t getOccupiedSlots() const;
+
+    // The avatar's own NDC space is scaled by scale, mirrored horizontally if asked, and
+    // centered on (x, y) in scene NDC
+    void setTransform(float x, float y, float scale, bool mirrored = false);
+    // Avatars are painted in increasing depth; avatars of equal depth must not overlap,
+    // because their layers are interleaved to share state
+    void setDepth(int depth);
+    void setVisible(bool visible);
+    // Joint angles as in AvatarGeometry: the arms' below the horizontal, the head's tilt
+    // counterclockwise. AvatarGeometry::REST_POSE is the pose of a new avatar.
+    void setPose(float leftArm, float rightArm, float headTilt);
+    float getPose(AvatarGeometry::Joint joint) const;
+
+private:
+    friend class Scene;
+    friend class CrowdRenderer;
+    friend class ImpostorCache;
+    friend class StoryboardFile;
+    friend class SceneHistory;
+    friend class Animation;
+
+    void touch();
+    void markEdited();
+    SpatialIndex::Bounds getBounds() const;
+    bool isPosed() const;
+
+    Scene& scene;
+    int index;              // In the scene, and id in its SpatialIndex
+    float colors[Avatar::COLOR_COUNT][3];
+    GLuint slotTextures[SlotRegistry::MAX_SLOTS];
+    uint32_t occupiedSlots;
+    float transform[4];     // NDC scale (x, y) and offset (z, w), as viewTransform in the shaders
+    int depth;
+    bool visible;
+    float pose[AvatarGeometry::JOINT_COUNT];
+    bool colorsDirty;
+    uint32_t revision;      // Changes with every color or slot change, unique in the scene
+    bool edited;            // Listed in Scene::edited
+};
+
+// Many avatars drawn together. All of them share one body and sprite buffer, one
+// TextureRegistry and the two avatar shaders; per-avatar palettes live side by side in one
+// uniform buffer and are bound by range. draw() lists every layer of every avatar in view,
+// sorts the list by depth, then layer, then texture, and walks it changing only the state
+// that differs from the previous layer. Avatar bounds are kept in a SpatialIndex, updated
+// as avatars move, so culling, picking and selection only visit avatars nearby.
+// Detail follows the size on screen: heads use the coarsest tessellation that stays within
+// a quarter pixel, and each item texture is streamed down to the mip level its quad needs.
+// Posed joints are drawn through the shaders' pose rotation, one layer at a time; an avatar
+// in the rest pose costs nothing extra.
+class Scene {
+public:
+    // Counters of the last draw()
+    struct DrawStats {
+        int drawCalls;
+        int programChanges;
+        int textureBinds;
+        int impostors;      // Avatars drawn as one quad from the impostor atlas
+        int vertices;
+        int pendingTextures;    // Still short of the detail this draw asked for, see TextureRegistry
+    };
+
+    // Scenes given a TextureRegistry share its textures (it must outlive them); null keeps
+    // a registry of the scene's own
+    Scene(const SlotRegistry& slots, Shader& bodyShader, Shader& spriteShader, TextureRegistry* sharedTextures = nullptr);
+    ~Scene();
+
+    // References stay valid until clear()
+    SceneAvatar& addAvatar();
+    SceneAvatar& getAvatar(int index);
+    int getAvatarCount() const;
+    void clear();
+
+    // viewTransform maps scene NDC onto the target (null for identity), as for tiles. Only
+    // avatars whose bounds reach the view are drawn.
+    void draw(const float* viewTransform = nullptr);
+    const DrawStats& getStats() const;
+
+    // Small avatars are drawn from this cache (null, the default, draws every avatar in full).
+    // The cache must be built for this scene and outlive its use here.
+    void setImpostors(ImpostorCache* cache);
+
+    TextureRegistry& getTextures();
+    const SlotRegistry& getSlots() const;
+    // Changes whenever an avatar is added, removed, restyled or moved, so renderings of the
+    // scene can be cached
+    uint32_t getRevision() const;
+
+    // Topmost visible avatar (highest depth) whose bounds contain the scene NDC point, -1 if none
+    int pick(float x, float y) const;
+    // Worn item of avatar under the scene NDC point, topmost layer first; -1 if none
+    int pickSlot(int avatar, float x, float y) const;
+    // Visible avatars whose bounds intersect rect (scene NDC), in index order
+    void select(const SpatialIndex::Bounds& rect, std::vector<int>& out) const;
+    // Scene NDC rectangle an avatar can draw into: its space plus sprites that reach past it
+    SpatialIndex::Bounds getAvatarBounds(int index) const;
+
+private:
+    friend class SceneAvatar;
+    friend class CrowdRenderer;
+    friend class ImpostorCache;
+    friend class StoryboardFile;
+    friend class SceneHistory;
+
+    // Layers of one avatar in Avatar::draw / drawSlots order; body parts of one color
+    // that follow each other in the mesh are merged. An impostor replaces all of them.
+    enum Step {
+        STEP_IMPOSTOR,
+        STEP_NECK,
+        STEP_HEAD,
+        STEP_TORSO_AND_ARMS,
+        STEP_LEFT_HAND,
+        STEP_RIGHT_HAND,
+        STEP_LEGS,
+        STEP_FIRST_SLOT    // Followed by one step per slot in draw order
+    };
+
+    struct DrawItem {
+        int depth;
+        int step;
+        GLuint texture;     // 0 for body parts
+        int avatar;
+        int cell;           // Impostor atlas cell, -1 for layers
+    };
+
+    void setupGeometry();
+    void computeLocalBounds();
+    void uploadPalettes();
+    void appendItems(int avatar);
+    // Asks the textures for the levels avatar's items need when its NDC unit spans
+    // pixelsX x pixelsY pixels
+    void requestLevels(int avatar, float pixelsX, float pixelsY);
+    // Draws the sorted items. isolated is for rendering one avatar into an impostor cell: its
+    // space fills the viewport and color is written premultiplied with exact coverage.
+    void drawItems(const float* viewTransform, bool isolated);
+
+    const SlotRegistry& slots;
+    Shader& bodyShader;
+    Shader& spriteShader;
+    TextureRegistry ownTextures;
+    TextureRegistry* textures;
+    std::deque<SceneAvatar> avatars;
+    std::vector<DrawItem> items;
+    std::vector<int> inView;
+    std::vector<int> edited;    // Avatars changed since SceneHistory last looked, in no order
+    SpatialIndex spatialIndex;
+    SpatialIndex::Bounds localBounds;   // What an avatar covers in its own NDC space
+    SpatialIndex::Bounds posedBounds;   // The same in any pose: posable parts swept all round
+    DrawStats stats;
+    ImpostorCache* impostors;
+    uint32_t nextRevision;      // Also the scene's revision, see getRevision()
+
+    GLuint bodyVAO, bodyVBO;
+    GLuint spriteVAO, spriteVBO;
+    GLuint paletteBuffer;
+    int paletteCapacity;        // Avatars the palette buffer holds
+    GLsizeiptr paletteStride;   // Palette size rounded up to the uniform buffer offset alignment
+    bool palettesDirty;
+    GLint bodyTransformLocation, bodyColorLocation, bodyPoseLocation;
+    GLint spriteTransformLocation, spriteTextureLocation, spritePoseLocation;
+    GLuint leftHandTexture, rightHandTexture;
+
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+};
+
+#endif
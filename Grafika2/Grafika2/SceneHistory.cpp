@@ -0,0 +1,162 @@
+#include "SceneHistory.h"
+#include "Scene.h"
+#include <algorithm>
+#include <cstring>
+
+SceneHistory::SceneHistory(Scene& scene, size_t budget) : scene(scene), current(0), budget(budget), bytes(0) {
+    reset();
+}
+
+void SceneHistory::reset() {
+    State state;
+    for (int i = 0; i < scene.getAvatarCount(); ++i) {
+        state = state.push_back(capture(i));
+    }
+    steps.clear();
+    steps.push_back({ state, 0 });
+    current = 0;
+    bytes = 0;
+    clearEdits();
+}
+
+std::shared_ptr<const SceneHistory::Snapshot> SceneHistory::capture(int index) const {
+    const SceneAvatar& avatar = scene.avatars[index];
+    std::shared_ptr<Snapshot> snapshot = std::make_shared<Snapshot>();
+    // Zeroed first, so snapshots compare with memcmp
+    std::memset(snapshot.get(), 0, sizeof(Snapshot));
+    std::memcpy(snapshot->colors, avatar.colors, sizeof(snapshot->colors));
+    std::memcpy(snapshot->slotTextures, avatar.slotTextures, sizeof(snapshot->slotTextures));
+    snapshot->occupiedSlots = avatar.occupiedSlots;
+    std::memcpy(snapshot->transform, avatar.transform, sizeof(snapshot->transform));
+    snapshot->depth = avatar.depth;
+    snapshot->visible = avatar.visible;
+    std::memcpy(snapshot->pose, avatar.pose, sizeof(snapshot->pose));
+    return snapshot;
+}
+
+void SceneHistory::restore(int index, const Snapshot* snapshot) {
+    SceneAvatar& avatar = scene.avatars[index];
+    if (snapshot == nullptr) {
+        avatar.setVisible(false);
+        return;
+    }
+    for (int color = 0; color < Avatar::COLOR_COUNT; ++color) {
+        avatar.setColor((Avatar::AvatarColor)color, snapshot->colors[color][0], snapshot->colors[color][1], snapshot->colors[color][2]);
+    }
+    // The occupancy is restored as it was, not re-derived through the conflict masks
+    std::memcpy(avatar.slotTextures, snapshot->slotTextures, sizeof(avatar.slotTextures));
+    avatar.occupiedSlots = snapshot->occupiedSlots;
+    avatar.touch();
+    // setTransform keeps the scale in y and mirrors by negating x
+    avatar.setTransform(snapshot->transform[2], snapshot->transform[3], snapshot->transform[1], snapshot->transform[0] < 0.0f);
+    avatar.setDepth(snapshot->depth);
+    avatar.setVisible(snapshot->visible);
+    using namespace AvatarGeometry;
+    avatar.setPose(snapshot->pose[JOINT_LEFT_ARM], snapshot->pose[JOINT_RIGHT_ARM], snapshot->pose[JOINT_HEAD]);
+}
+
+void SceneHistory::clearEdits() {
+    for (int index : scene.edited) {
+        scene.avatars[index].edited = false;
+    }
+    scene.edited.clear();
+}
+
+bool SceneHistory::commit() {
+    const State& previous = steps[current].state;
+    State state = previous;
+    size_t allocated = 0;
+    std::sort(scene.edited.begin(), scene.edited.end());
+    for (int index : scene.edited) {
+        if ((size_t)index >= previous.size()) break;
+        std::shared_ptr<const Snapshot> snapshot = capture(index);
+        if (std::memcmp(snapshot.get(), previous.get(index).get(), sizeof(Snapshot)) == 0) continue;
+        allocated += state.getPathBytes() + sizeof(Snapshot);
+        state = state.set(index, snapshot);
+    }
+    // Avatars the step does not have yet, edited or not (a hidden one may be past the end).
+    // Undo hides avatars added after the step it goes to; those are not new until edited,
+    // or redo would commit them as a step of their own and lose the steps after it.
+    int end = scene.getAvatarCount();
+    while (end > (int)previous.size() && !scene.avatars[end - 1].visible && !scene.avatars[end - 1].edited) --end;
+    for (int index = (int)previous.size(); index < end; ++index) {
+        allocated += state.getPathBytes() + sizeof(Snapshot);
+        state = state.push_back(capture(index));
+    }
+    clearEdits();
+    if (allocated == 0) return false;
+
+    while (steps.size() > current + 1) {
+        bytes -= steps.back().bytes;
+        steps.pop_back();
+    }
+    steps.push_back({ state, allocated });
+    bytes += allocated;
+    ++current;
+    trim();
+    return true;
+}
+
+void SceneHistory::trim() {
+    // The current step always stays
+    while (bytes > budget && current > 0) {
+        bytes -= steps[1].bytes;
+        steps[1].bytes = 0;
+        steps.pop_front();
+        --current;
+    }
+}
+
+void SceneHistory::moveTo(size_t step) {
+    const State& from = steps[current].state;
+    const State& to = steps[step].state;
+    to.diff(from, [&](size_t index) {
+        if (index >= (size_t)scene.getAvatarCount()) return;
+        const Snapshot* target = index < to.size() ? to.get(index).get() : nullptr;
+        const Snapshot* shown = index < from.size() ? from.get(index).get() : nullptr;
+        // Leaves are compared as a whole, most of their snapshots are the same ones
+        if (target != shown) restore((int)index, target);
+    });
+    // The scene now matches the step
+    clearEdits();
+    current = step;
+}
+
+bool SceneHistory::undo() {
+    commit();
+    if (current == 0) return false;
+    moveTo(current - 1);
+    return true;
+}
+
+bool SceneHistory::redo() {
+    commit();
+    if (current + 1 >= steps.size()) return false;
+    moveTo(current + 1);
+    return true;
+}
+
+bool SceneHistory::canUndo() const {
+    return current > 0 || !scene.edited.empty();
+}
+
+bool SceneHistory::canRedo() const {
+    return current + 1 < steps.size() && scene.edited.empty();
+}
+
+int SceneHistory::getStepCount() const {
+    return (int)steps.size();
+}
+
+int SceneHistory::getCurrentStep() const {
+    return (int)current;
+}
+
+size_t SceneHistory::getBytes() const {
+    return bytes;
+}
+
+void SceneHistory::setBudget(size_t value) {
+    budget = value;
+    trim();
+}
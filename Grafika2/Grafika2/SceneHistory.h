@@ -0,0 +1,78 @@
+#ifndef SCENE_HISTORY_H
+#define SCENE_HISTORY_H
+
+#include "Avatar.h"
+#include "PersistentVector.h"
+#include "SlotRegistry.h"
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+
+class Scene;
+
+// Undo and redo for the avatars of a Scene. Each step is a PersistentVector of immutable
+// avatar snapshots: a commit snapshots only the avatars edited since the step before and
+// shares everything else with it, so a step costs memory in proportion to its edits. Undo
+// and redo switch to another step's vector and write back only the avatars whose snapshots
+// differ. Steps are kept within a memory budget, the oldest being forgotten first.
+// Scene::clear() invalidates the history; reset() starts it over.
+class SceneHistory {
+public:
+    SceneHistory(Scene& scene, size_t budget = (size_t)16 << 20);
+
+    // Makes the scene as it is now the only step
+    void reset();
+    // Records edits since the current step as a new step, dropping the steps redo would have
+    // gone to. False (and no step) if nothing changed.
+    bool commit();
+    // Edits not committed yet are committed first, so redo can bring them back. Scenes cannot
+    // lose avatars: those added after the step undone to are hidden instead.
+    bool undo();
+    bool redo();
+    bool canUndo() const;
+    bool canRedo() const;
+
+    int getStepCount() const;
+    int getCurrentStep() const;
+    // Bytes of history on top of one full snapshot of the scene, at most the budget once
+    // more than one step is kept
+    size_t getBytes() const;
+    void setBudget(size_t bytes);
+
+private:
+    struct Snapshot {
+        float colors[Avatar::COLOR_COUNT][3];
+        GLuint slotTextures[SlotRegistry::MAX_SLOTS];
+        uint32_t occupiedSlots;
+        float transform[4];
+        int depth;
+        bool visible;
+        float pose[AvatarGeometry::JOINT_COUNT];
+    };
+
+    typedef PersistentVector<std::shared_ptr<const Snapshot>> State;
+
+    struct Step {
+        State state;
+        size_t bytes;       // Allocated by the commit that made it; 0 for the oldest step
+    };
+
+    std::shared_ptr<const Snapshot> capture(int index) const;
+    void restore(int index, const Snapshot* snapshot);
+    void moveTo(size_t step);
+    void clearEdits();
+    void trim();
+
+    Scene& scene;
+    std::deque<Step> steps;
+    size_t current;
+    size_t budget;
+    size_t bytes;
+
+    SceneHistory(const SceneHistory&) = delete;
+    SceneHistory& operator=(const SceneHistory&) = delete;
+};
+
+#endif
@@ -42,8 +42,12 @@ GLuint Shader::getID() {
     return programID;
 }
 
-void Shader::setVec3(const std::string& name, float x, float y, float z) {
-    glUniform3f(glGetUniformLocation(programID, name.c_str()), x, y, z);
+void Shader::setVec3(const char* name, float x, float y, float z) {
+    glUniform3f(glGetUniformLocation(programID, name), x, y, z);
+}
+
+void Shader::setVec4(const char* name, const float* value) {
+    glUniform4fv(glGetUniformLocation(programID, name), 1, value);
 }
 
 std::string Shader::readFile(const std::string& filePath) {
@@ -72,11 +76,18 @@ void Shader::checkCompileErrors(GLuint shader, const std::string& type) {
     }
 }
 
-void Shader::setInt(const std::string& name, int value) {
-    glUniform1i(glGetUniformLocation(programID, name.c_str()), value);
+void Shader::setInt(const char* name, int value) {
+    glUniform1i(glGetUniformLocation(programID, name), value);
 }
 
 
-void Shader::setBool(const std::string& name, bool value) {
-    glUniform1i(glGetUniformLocation(programID, name.c_str()), value);
+void Shader::setBool(const char* name, bool value) {
+    glUniform1i(glGetUniformLocation(programID, name), value);
 };
+
+void Shader::setUniformBlockBinding(const char* name, GLuint binding) {
+    GLuint blockIndex = glGetUniformBlockIndex(programID, name);
+    if (blockIndex != GL_INVALID_INDEX) {
+        glUniformBlockBinding(programID, blockIndex, binding);
+    }
+}
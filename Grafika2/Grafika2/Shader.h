@@ -8,10 +8,13 @@ class Shader {
 public:
     Shader(const std::string& vertexPath, const std::string& fragmentPath);
     void use();
-    void setVec3(const std::string& name, float x, float y, float z);
+    void setVec3(const char* name, float x, float y, float z);
+    void setVec4(const char* name, const float* value);
     GLuint getID();
-    void setInt(const std::string& name, int value);
-    void setBool(const std::string& name, bool value);
+    void setInt(const char* name, int value);
+    void setBool(const char* name, bool value);
+    // Binds a named uniform block to a GL_UNIFORM_BUFFER binding point, no-op if the shader lacks it
+    void setUniformBlockBinding(const char* name, GLuint binding);
 private:
     GLuint programID;
     std::string readFile(const std::string& filePath);
@@ -0,0 +1,168 @@
+#include "SlotRegistry.h"
+#include "AlphaMask.h"
+#include "Json.h"
+#include <algorithm>
+#include <iostream>
+
+SlotRegistry::SlotRegistry() : headMask(0) {
+    for (int i = 0; i < MAX_SLOTS; ++i) {
+        conflictMasks[i] = 0;
+    }
+}
+
+bool SlotRegistry::load(const std::string& configPath) {
+    JsonValue config;
+    std::string error;
+    if (!JsonValue::parseFile(configPath, config, error)) {
+        std::cerr << "Failed to read " << configPath << ": " << error << std::endl;
+        return false;
+    }
+
+    const JsonValue* slotList = config.find("slots");
+    if (slotList == nullptr || !slotList->isArray()) {
+        std::cerr << configPath << ": missing \"slots\" array" << std::endl;
+        return false;
+    }
+    if (slotList->size() > MAX_SLOTS) {
+        std::cerr << configPath << ": at most " << MAX_SLOTS << " slots are supported" << std::endl;
+        return false;
+    }
+
+    slots.clear();
+    for (const JsonValue& entry : slotList->getItems()) {
+        SlotDefinition slot;
+        const JsonValue* name = entry.find("name");
+        if (name == nullptr || name->asString().empty()) {
+            std::cerr << configPath << ": slot without a name" << std::endl;
+            return false;
+        }
+        slot.name = name->asString();
+
+        const JsonValue* folder = entry.find("folder");
+        slot.folder = folder ? folder->asString() : slot.name;
+        const JsonValue* button = entry.find("button");
+        slot.button = button ? button->asString() : "Buttons/" + slot.name + ".png";
+        const JsonValue* defaultItem = entry.find("default");
+        slot.defaultItem = defaultItem ? defaultItem->asString() : "";
+        const JsonValue* layer = entry.find("layer");
+        slot.layer = layer ? (int)layer->asNumber() : 0;
+        const JsonValue* menu = entry.find("menu");
+        slot.inMenu = menu ? menu->asBool(true) : true;
+        // follows: the joint the item turns with; only the head has items on it
+        const JsonValue* follows = entry.find("follows");
+        if (follows != nullptr && follows->asString() != "head") {
+            std::cerr << configPath << ": slot " << slot.name << " follows unknown joint \"" << follows->asString() << "\"" << std::endl;
+            return false;
+        }
+        slot.followsHead = follows != nullptr;
+
+        // anchor: [centerX, centerY, width, height]
+        const JsonValue* anchor = entry.find("anchor");
+        if (anchor == nullptr || !anchor->isArray() || anchor->size() != 4) {
+            std::cerr << configPath << ": slot " << slot.name << " needs an anchor [x, y, width, height]" << std::endl;
+            return false;
+        }
+        slot.anchor = { (float)(*anchor)[0].asNumber(), (float)(*anchor)[1].asNumber(),
+                        (float)(*anchor)[2].asNumber(), (float)(*anchor)[3].asNumber() };
+        slots.push_back(slot);
+    }
+
+    // Conflicts are resolved by name once, then only the bitmasks are used
+    headMask = 0;
+    for (int i = 0; i < MAX_SLOTS; ++i) {
+        conflictMasks[i] = 0;
+    }
+    for (int i = 0; i < (int)slots.size(); ++i) {
+        if (slots[i].followsHead) headMask |= 1u << i;
+    }
+    for (int i = 0; i < (int)slots.size(); ++i) {
+        const JsonValue* conflicts = slotList->getItems()[i].find("conflicts");
+        if (conflicts == nullptr) continue;
+
+        for (const JsonValue& other : conflicts->getItems()) {
+            int j = findSlot(other.asString());
+            if (j < 0 || j == i) {
+                std::cerr << configPath << ": slot " << slots[i].name << " has invalid conflict \"" << other.asString() << "\"" << std::endl;
+                return false;
+            }
+            // Exclusivity is symmetric even if only one side declares it
+            conflictMasks[i] |= 1u << j;
+            conflictMasks[j] |= 1u << i;
+        }
+    }
+
+    drawOrder.clear();
+    menuSlots.clear();
+    for (int i = 0; i < (int)slots.size(); ++i) {
+        drawOrder.push_back(i);
+        if (slots[i].inMenu) menuSlots.push_back(i);
+    }
+    std::stable_sort(drawOrder.begin(), drawOrder.end(), [this](int a, int b) {
+        return slots[a].layer < slots[b].layer;
+    });
+
+    if (!isValidOutfit(getDefaultOutfit())) {
+        std::cerr << configPath << ": default items conflict with each other" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int SlotRegistry::getSlotCount() const {
+    return (int)slots.size();
+}
+
+const SlotDefinition& SlotRegistry::getSlot(int slot) const {
+    return slots[slot];
+}
+
+int SlotRegistry::findSlot(const std::string& name) const {
+    for (int i = 0; i < (int)slots.size(); ++i) {
+        if (slots[i].name == name) return i;
+    }
+    return -1;
+}
+
+const std::vector<int>& SlotRegistry::getDrawOrder() const {
+    return drawOrder;
+}
+
+const std::vector<int>& SlotRegistry::getMenuSlots() const {
+    return menuSlots;
+}
+
+bool SlotRegistry::isValidOutfit(uint32_t occupied) const {
+    uint32_t remaining = occupied;
+    while (remaining != 0) {
+        int slot = 0;
+        while (((remaining >> slot) & 1u) == 0) ++slot;
+        if (occupied & conflictMasks[slot]) return false;
+        remaining &= remaining - 1; // Clear lowest set bit
+    }
+    return true;
+}
+
+int SlotRegistry::pickSlot(uint32_t occupied, const AlphaMask* const* masks, float x, float y) const {
+    for (auto it = drawOrder.rbegin(); it != drawOrder.rend(); ++it) {
+        const int slot = *it;
+        if ((occupied & (1u << slot)) == 0 || masks[slot] == nullptr) continue;
+        // Item images span their anchor rectangle, as in writeSpriteQuad
+        const AvatarGeometry::Rect& anchor = slots[slot].anchor;
+        const float u = (x - anchor.centerX) / anchor.width + 0.5f;
+        const float v = (y - anchor.centerY) / anchor.height + 0.5f;
+        if (masks[slot]->test(u, v)) return slot;
+    }
+    return -1;
+}
+
+uint32_t SlotRegistry::getDefaultOutfit() const {
+    uint32_t occupied = 0;
+    for (int i = 0; i < (int)slots.size(); ++i) {
+        if (!slots[i].defaultItem.empty()) occupied |= 1u << i;
+    }
+    return occupied;
+}
+
+uint32_t SlotRegistry::getHeadMask() const {
+    return headMask;
+}
@@ -0,0 +1,71 @@
+#ifndef SLOT_REGISTRY_H
+#define SLOT_REGISTRY_H
+
+#include "AvatarGeometry.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class AlphaMask;
+
+// One wardrobe category ("Lips", "T-shirts", ...) as declared in avatar_options.json
+struct SlotDefinition {
+    std::string name;
+    std::string folder;        // Item images are cycled from this folder
+    std::string button;        // Menu button image
+    std::string defaultItem;   // Empty means the slot starts unoccupied
+    int layer;                 // Lower layers are drawn first
+    AvatarGeometry::Rect anchor;
+    bool inMenu;
+    bool followsHead;          // Turns with the head when a pose tilts it
+};
+
+// Wardrobe slots loaded once from the config. Slots are addressed by index and conflicts
+// are compiled into bitmasks, so applying an item or validating an outfit is integer work
+// only. Shared by the interactive menu and bulk avatar generation.
+class SlotRegistry {
+public:
+    static const int MAX_SLOTS = 32;
+
+    SlotRegistry();
+
+    bool load(const std::string& configPath);
+
+    int getSlotCount() const;
+    const SlotDefinition& getSlot(int slot) const;
+    int findSlot(const std::string& name) const;
+
+    // Slot indices sorted by layer (stable, so equal layers keep file order)
+    const std::vector<int>& getDrawOrder() const;
+    // Slot indices shown in the menu, in file order
+    const std::vector<int>& getMenuSlots() const;
+
+    uint32_t getConflictMask(int slot) const {
+        return conflictMasks[slot];
+    }
+
+    // Occupancy after putting an item in slot: conflicting slots are cleared
+    uint32_t apply(uint32_t occupied, int slot) const {
+        return (occupied & ~conflictMasks[slot]) | (1u << slot);
+    }
+
+    bool isValidOutfit(uint32_t occupied) const;
+
+    // Topmost occupied slot whose item is opaque at (x, y) in the avatar's own NDC space,
+    // testing layers from the top down; -1 if the point misses every item. masks[slot] is
+    // the coverage of the image worn in slot (null counts as transparent).
+    int pickSlot(uint32_t occupied, const AlphaMask* const* masks, float x, float y) const;
+
+    uint32_t getDefaultOutfit() const;
+    // Slots whose items follow the head
+    uint32_t getHeadMask() const;
+
+private:
+    std::vector<SlotDefinition> slots;
+    uint32_t conflictMasks[MAX_SLOTS];
+    uint32_t headMask;
+    std::vector<int> drawOrder;
+    std::vector<int> menuSlots;
+};
+
+#endif
@@ -0,0 +1,189 @@
+#include "SoftwareAvatar.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+SoftwareAvatar::SoftwareAvatar(const SlotRegistry& slots) : slots(slots) {
+    using namespace AvatarGeometry;
+
+    sprites.assign(SPRITE_VERTICES.begin(), SPRITE_VERTICES.end());
+    sprites.resize(SPRITE_VERTICES.size() + slots.getSlotCount() * SPRITE_FLOATS_PER_QUAD);
+    for (int slot = 0; slot < slots.getSlotCount(); ++slot) {
+        writeSpriteQuad(slots.getSlot(slot).anchor, &sprites[SPRITE_VERTICES.size() + slot * SPRITE_FLOATS_PER_QUAD]);
+    }
+
+    leftHandImage = loadTextureCached("hands/leva.png");
+    rightHandImage = loadTextureCached("hands/desna.png");
+    bodyMaskWidth = 0;
+    bodyMaskHeight = 0;
+
+    resetToDefaults();
+}
+
+void SoftwareAvatar::resetToDefaults() {
+    for (int color = 0; color < Avatar::COLOR_COUNT; ++color) {
+        setColor((Avatar::AvatarColor)color, Avatar::DEFAULT_COLORS[color][0], Avatar::DEFAULT_COLORS[color][1], Avatar::DEFAULT_COLORS[color][2]);
+    }
+
+    occupiedSlots = 0;
+    for (int i = 0; i < SlotRegistry::MAX_SLOTS; ++i) {
+        slotImages[i] = nullptr;
+    }
+
+    for (int slot = 0; slot < slots.getSlotCount(); ++slot) {
+        const std::string& defaultItem = slots.getSlot(slot).defaultItem;
+        if (!defaultItem.empty()) {
+            applySlot(slot, loadTextureCached(defaultItem));
+        }
+    }
+}
+
+void SoftwareAvatar::setColor(Avatar::AvatarColor color, float r, float g, float b) {
+    colors[color][0] = r;
+    colors[color][1] = g;
+    colors[color][2] = b;
+}
+
+const DecodedImage* SoftwareAvatar::loadTextureCached(const std::string& filepath) {
+    // ImageStore already keeps every file decoded once per process
+    const DecodedImage* image = ImageStore::shared().get(filepath);
+    if (image == nullptr) {
+        std::cerr << "Failed to load texture: " << filepath << std::endl;
+    }
+    return image;
+}
+
+void SoftwareAvatar::applySlot(int slot, const DecodedImage* image) {
+    occupiedSlots = slots.apply(occupiedSlots, slot);
+    slotImages[slot] = image;
+}
+
+void SoftwareAvatar::clearSlot(int slot) {
+    occupiedSlots &= ~(1u << slot);
+}
+
+uint32_t SoftwareAvatar::getOccupiedSlots() const {
+    return occupiedSlots;
+}
+
+void SoftwareAvatar::drawBodyPart(SoftwareRasterizer& target, const AvatarGeometry::MeshRange& range, Avatar::AvatarColor color) {
+    target.fillTriangles(AvatarGeometry::BODY_VERTICES.data(), range.first, range.count, range.fan, colors[color]);
+}
+
+void SoftwareAvatar::drawSprite(SoftwareRasterizer& target, const DecodedImage* image, int firstVertex) {
+    if (image == nullptr) return;
+    target.drawTextured(*image, sprites.data(), firstVertex, AvatarGeometry::SPRITE_VERTICES_PER_QUAD);
+}
+
+void SoftwareAvatar::draw(SoftwareRasterizer& target) {
+    using namespace AvatarGeometry;
+
+    drawBodyPart(target, NECK, Avatar::COLOR_SKIN);
+    drawBodyPart(target, HEAD, Avatar::COLOR_FACE);
+    drawBodyPart(target, TORSO, Avatar::COLOR_SKIN);
+    drawBodyPart(target, LEFT_ARM, Avatar::COLOR_SKIN);
+    drawBodyPart(target, RIGHT_ARM, Avatar::COLOR_SKIN);
+    drawSprite(target, leftHandImage, spriteFirstVertex(SPRITE_LEFT_HAND));
+    drawSprite(target, rightHandImage, spriteFirstVertex(SPRITE_RIGHT_HAND));
+    drawBodyPart(target, LEFT_LEG, Avatar::COLOR_SKIN);
+    drawBodyPart(target, RIGHT_LEG, Avatar::COLOR_SKIN);
+}
+
+void SoftwareAvatar::drawSlots(SoftwareRasterizer& target) {
+    const int firstSlotVertex = AvatarGeometry::SPRITE_COUNT * AvatarGeometry::SPRITE_VERTICES_PER_QUAD;
+
+    for (int slot : slots.getDrawOrder()) {
+        if ((occupiedSlots & (1u << slot)) == 0) continue;
+        drawSprite(target, slotImages[slot], firstSlotVertex + slot * AvatarGeometry::SPRITE_VERTICES_PER_QUAD);
+    }
+}
+
+void SoftwareAvatar::updateBodyMasks(SpriteCompositor& target) {
+    using namespace AvatarGeometry;
+
+    const int width = target.getWidth();
+    const int height = target.getHeight();
+    if (bodyMaskWidth == width && bodyMaskHeight == height) return;
+
+    for (const BodyMask& mask : bodyMasks) {
+        target.releaseImage(mask.image);
+    }
+    bodyMasks.clear();
+    bodyMaskWidth = width;
+    bodyMaskHeight = height;
+
+    // Same parts and order as draw(); the hands go on top of the arms there and nothing
+    // solid overlaps them, so they can follow all masks
+    struct MaskParts {
+        std::vector<MeshRange> ranges;
+        Avatar::AvatarColor color;
+    };
+    const MaskParts parts[] = {
+        { { NECK }, Avatar::COLOR_SKIN },
+        { { HEAD }, Avatar::COLOR_FACE },
+        { { TORSO, LEFT_ARM, RIGHT_ARM, LEFT_LEG, RIGHT_LEG }, Avatar::COLOR_SKIN },
+    };
+    const float white[3] = { 1.0f, 1.0f, 1.0f };
+
+    SoftwareRasterizer maskTarget;
+    if (!maskTarget.create(width, height)) return;
+    for (const MaskParts& part : parts) {
+        maskTarget.clear();
+        for (const MeshRange& range : part.ranges) {
+            maskTarget.fillTriangles(BODY_VERTICES.data(), range.first, range.count, range.fan, white);
+        }
+        maskTarget.flush();
+
+        // Bounds of the covered pixels, rows counted from the bottom
+        auto rowAt = [&](int y) { return maskTarget.getPixels() + (ptrdiff_t)(height - 1 - y) * maskTarget.getStride(); };
+        int minX = width, minY = height, maxX = -1, maxY = -1;
+        for (int y = 0; y < height; ++y) {
+            const unsigned char* row = rowAt(y);
+            for (int x = 0; x < width; ++x) {
+                if (row[x * 4 + 3] == 0) continue;
+                minX = std::min(minX, x);
+                maxX = std::max(maxX, x);
+                minY = std::min(minY, y);
+                maxY = std::max(maxY, y);
+            }
+        }
+        if (maxX < 0) continue;
+
+        BodyMask mask;
+        mask.x = minX;
+        mask.y = minY;
+        mask.color = part.color;
+        mask.image.width = maxX - minX + 1;
+        mask.image.height = maxY - minY + 1;
+        mask.image.channels = 4;
+        mask.image.pixels.resize((size_t)mask.image.width * mask.image.height * 4);
+        for (int y = 0; y < mask.image.height; ++y) {
+            std::memcpy(&mask.image.pixels[(size_t)y * mask.image.width * 4], rowAt(minY + y) + minX * 4, (size_t)mask.image.width * 4);
+        }
+        bodyMasks.push_back(std::move(mask));
+    }
+}
+
+void SoftwareAvatar::addSpriteLayer(SpriteCompositor& target, const DecodedImage* image, const AvatarGeometry::Rect& rect) {
+    if (image == nullptr) return;
+
+    // NDC rectangle to pixels, y up like the compositor
+    float scaleX = target.getWidth() * 0.5f;
+    float scaleY = target.getHeight() * 0.5f;
+    target.addLayer(*image, (rect.centerX - rect.width * 0.5f + 1.0f) * scaleX, (rect.centerY - rect.height * 0.5f + 1.0f) * scaleY,
+                    rect.width * scaleX, rect.height * scaleY);
+}
+
+void SoftwareAvatar::addLayers(SpriteCompositor& target) {
+    updateBodyMasks(target);
+    for (const BodyMask& mask : bodyMasks) {
+        target.addLayer(mask.image, (float)mask.x, (float)mask.y, (float)mask.image.width, (float)mask.image.height, colors[mask.color]);
+    }
+    addSpriteLayer(target, leftHandImage, AvatarGeometry::LEFT_HAND_RECT);
+    addSpriteLayer(target, rightHandImage, AvatarGeometry::RIGHT_HAND_RECT);
+
+    for (int slot : slots.getDrawOrder()) {
+        if ((occupiedSlots & (1u << slot)) == 0) continue;
+        addSpriteLayer(target, slotImages[slot], slots.getSlot(slot).anchor);
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef SOFTWARE_AVATAR_H
+#define SOFTWARE_AVATAR_H
+
+#include "Avatar.h"
+#include "ImageStore.h"
+#include "SlotRegistry.h"
+#include "SoftwareRasterizer.h"
+#include "SpriteCompositor.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// CPU counterpart of Avatar: the same state, setters and draw order, drawn through a
+// SoftwareRasterizer instead of GL, so it needs no context. Items are decoded images
+// from ImageStore instead of texture names.
+class SoftwareAvatar {
+public:
+    SoftwareAvatar(const SlotRegistry& slots);
+
+    void resetToDefaults();
+    void setColor(Avatar::AvatarColor color, float r, float g, float b);
+
+    // Same as Avatar::draw followed by Avatar::drawSlots
+    void draw(SoftwareRasterizer& target);
+    void drawSlots(SoftwareRasterizer& target);
+
+    // Layers for SpriteCompositor: the solid body as white masks rendered once per size and
+    // tinted with the skin and face colors, then the hands and slot items as scaled sprites
+    void addLayers(SpriteCompositor& target);
+
+    const DecodedImage* loadTextureCached(const std::string& filepath);
+    void applySlot(int slot, const DecodedImage* image);
+    void clearSlot(int slot);
+    uint32_t getOccupiedSlots() const;
+
+private:
+    const SlotRegistry& slots;
+    float colors[Avatar::COLOR_COUNT][3];
+    const DecodedImage* slotImages[SlotRegistry::MAX_SLOTS];
+    uint32_t occupiedSlots;
+    const DecodedImage* leftHandImage;
+    const DecodedImage* rightHandImage;
+    std::vector<float> sprites;     // Same x/y/u/v quads as Avatar's sprite buffer
+
+    // Body parts of one color in draw order, cropped to the pixels they cover
+    struct BodyMask {
+        DecodedImage image;
+        int x;
+        int y;
+        Avatar::AvatarColor color;
+    };
+    std::vector<BodyMask> bodyMasks;
+    int bodyMaskWidth;
+    int bodyMaskHeight;
+
+    void drawBodyPart(SoftwareRasterizer& target, const AvatarGeometry::MeshRange& range, Avatar::AvatarColor color);
+    void drawSprite(SoftwareRasterizer& target, const DecodedImage* image, int firstVertex);
+    void updateBodyMasks(SpriteCompositor& target);
+    void addSpriteLayer(SpriteCompositor& target, const DecodedImage* image, const AvatarGeometry::Rect& rect);
+};
+
+#endif
@@ -0,0 +1,542 @@
+#include "SoftwareRasterizer.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFTWARE_RASTERIZER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+    uint32_t packColor(const unsigned char rgba[4]) {
+        uint32_t packed;
+        std::memcpy(&packed, rgba, 4);
+        return packed;
+    }
+
+    // Sprite coordinates stay in [0, 1], so the division is only needed off the fast path
+    int wrap(int coordinate, int size) {
+        if (coordinate >= 0 && coordinate < size) return coordinate;
+        if (coordinate == -1) return size - 1;
+        int wrapped = coordinate % size;
+        return wrapped < 0 ? wrapped + size : wrapped;
+    }
+
+    int floorToInt(float value) {
+        int truncated = (int)value;
+        return truncated - (value < (float)truncated ? 1 : 0);
+    }
+
+#ifdef SOFTWARE_RASTERIZER_SSE2
+    // One RGBA texel as floats in [0, 255], and an interpolation weight
+    typedef __m128 Color4;
+    typedef __m128 Weight;
+
+    Weight toWeight(float t) {
+        return _mm_set1_ps(t);
+    }
+
+    __m128 unpackTexel(uint32_t texel) {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i wide = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)texel), zero);
+        return _mm_cvtepi32_ps(_mm_unpacklo_epi16(wide, zero));
+    }
+
+    uint32_t packTexel(__m128 rgba) {
+        __m128i integer = _mm_cvtps_epi32(rgba);
+        integer = _mm_packs_epi32(integer, integer);
+        return (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(integer, integer));
+    }
+
+    __m128 lerp(__m128 a, __m128 b, __m128 t) {
+        return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+    }
+
+    // Two pixels of 16-bit channels: (source * alpha + target * (255 - alpha)) / 255, rounded
+    __m128i blendPair(__m128i source, __m128i target) {
+        __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(source, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        __m128i inverse = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+        __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(source, alpha), _mm_mullo_epi16(target, inverse)), _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(sum, _mm_srli_epi16(sum, 8)), 8);
+    }
+
+    // GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA on all four channels of four pixels
+    __m128i blendOver(__m128i source, __m128i target) {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i low = blendPair(_mm_unpacklo_epi8(source, zero), _mm_unpacklo_epi8(target, zero));
+        __m128i high = blendPair(_mm_unpackhi_epi8(source, zero), _mm_unpackhi_epi8(target, zero));
+        return _mm_packus_epi16(low, high);
+    }
+#else
+    struct Color4 {
+        float c[4];
+    };
+    typedef float Weight;
+
+    Weight toWeight(float t) {
+        return t;
+    }
+
+    Color4 unpackTexel(uint32_t texel) {
+        Color4 out;
+        for (int i = 0; i < 4; ++i) {
+            out.c[i] = (float)((texel >> (i * 8)) & 0xFF);
+        }
+        return out;
+    }
+
+    uint32_t packTexel(const Color4& rgba) {
+        uint32_t packed = 0;
+        for (int i = 0; i < 4; ++i) {
+            float value = std::min(255.0f, std::max(0.0f, rgba.c[i]));
+            packed |= (uint32_t)(value + 0.5f) << (i * 8);
+        }
+        return packed;
+    }
+
+    Color4 lerp(const Color4& a, const Color4& b, float t) {
+        Color4 out;
+        for (int i = 0; i < 4; ++i) {
+            out.c[i] = a.c[i] + (b.c[i] - a.c[i]) * t;
+        }
+        return out;
+    }
+
+    // GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA on all four channels, rounded like the vector path
+    uint32_t blendOver(uint32_t source, uint32_t target) {
+        uint32_t alpha = source >> 24;
+        if (alpha == 0) return target;
+        uint32_t out = 0;
+        for (int i = 0; i < 32; i += 8) {
+            uint32_t sum = ((source >> i) & 0xFF) * alpha + ((target >> i) & 0xFF) * (255 - alpha) + 128;
+            out |= ((sum + (sum >> 8)) >> 8) << i;
+        }
+        return out;
+    }
+#endif
+
+    // Bilinear lookup with GL_REPEAT addressing, texel centers at .5 like GL
+    template <typename Level>
+    Color4 sampleBilinear(const Level& level, float u, float v) {
+        float s = u * level.width - 0.5f;
+        float t = v * level.height - 0.5f;
+        int s0 = floorToInt(s);
+        int t0 = floorToInt(t);
+        int x0 = wrap(s0, level.width);
+        int y0 = wrap(t0, level.height);
+        int x1 = x0 + 1 == level.width ? 0 : x0 + 1;
+        int y1 = y0 + 1 == level.height ? 0 : y0 + 1;
+
+        const uint32_t* row0 = &level.texels[(size_t)y0 * level.width];
+        const uint32_t* row1 = &level.texels[(size_t)y1 * level.width];
+        Weight fs = toWeight(s - s0);
+        Weight ft = toWeight(t - t0);
+        return lerp(lerp(unpackTexel(row0[x0]), unpackTexel(row0[x1]), fs),
+                    lerp(unpackTexel(row1[x0]), unpackTexel(row1[x1]), fs), ft);
+    }
+}
+
+SoftwareRasterizer::SoftwareRasterizer()
+    : width(0), height(0), rowPixels(0), threads(1), tilesX(0), tilesY(0), layerBytes(0) {}
+
+bool SoftwareRasterizer::create(int targetWidth, int targetHeight, int threadCount) {
+    if (targetWidth <= 0 || targetHeight <= 0) return false;
+
+    width = targetWidth;
+    height = targetHeight;
+    rowPixels = (width + 3) & ~3;
+    threads = std::max(1, threadCount);
+    tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    pixels.assign((size_t)rowPixels * height, 0);
+    bins.assign((size_t)tilesX * tilesY, std::vector<uint32_t>());
+    triangles.clear();
+    layers.clear();
+    layerBytes = 0;
+    return true;
+}
+
+void SoftwareRasterizer::clear() {
+    std::fill(pixels.begin(), pixels.end(), 0u);
+    triangles.clear();
+
+    // Layers are only referenced by recorded triangles, so the cache can be dropped here
+    if (layerBytes > MAX_LAYER_BYTES) {
+        layers.clear();
+        layerBytes = 0;
+    }
+}
+
+const SoftwareRasterizer::Texture* SoftwareRasterizer::getTexture(const DecodedImage& image) {
+    auto found = textures.find(&image);
+    if (found != textures.end()) {
+        return found->second.get();
+    }
+
+    std::unique_ptr<Texture> texture(new Texture());
+    MipLevel base;
+    base.width = image.width;
+    base.height = image.height;
+    base.texels.resize((size_t)image.width * image.height);
+    for (size_t i = 0; i < base.texels.size(); ++i) {
+        const unsigned char* source = &image.pixels[i * image.channels];
+        unsigned char rgba[4] = { source[0], source[1], source[2], image.channels == 4 ? source[3] : (unsigned char)255 };
+        base.texels[i] = packColor(rgba);
+    }
+    texture->levels.push_back(std::move(base));
+
+    // Down to 1x1 like glGenerateMipmap; each texel filters the previous level at its center,
+    // which is the 2x2 box for even sizes
+    while (texture->levels.back().width > 1 || texture->levels.back().height > 1) {
+        const MipLevel& source = texture->levels.back();
+        MipLevel level;
+        level.width = std::max(1, source.width / 2);
+        level.height = std::max(1, source.height / 2);
+        level.texels.resize((size_t)level.width * level.height);
+        for (int y = 0; y < level.height; ++y) {
+            for (int x = 0; x < level.width; ++x) {
+                // Clamped rather than wrapped, so edges do not bleed into the smaller levels
+                float s = std::min((x + 0.5f) * source.width / level.width - 0.5f, source.width - 1.0f);
+                float t = std::min((y + 0.5f) * source.height / level.height - 0.5f, source.height - 1.0f);
+                int x0 = (int)s;
+                int y0 = (int)t;
+                int x1 = std::min(x0 + 1, source.width - 1);
+                int y1 = std::min(y0 + 1, source.height - 1);
+                float fs = s - x0;
+                float ft = t - y0;
+
+                unsigned char rgba[4];
+                for (int c = 0; c < 4; ++c) {
+                    auto channel = [&](int tx, int ty) {
+                        return (float)((source.texels[(size_t)ty * source.width + tx] >> (c * 8)) & 0xFF);
+                    };
+                    float top = channel(x0, y0) + (channel(x1, y0) - channel(x0, y0)) * fs;
+                    float bottom = channel(x0, y1) + (channel(x1, y1) - channel(x0, y1)) * fs;
+                    rgba[c] = (unsigned char)(top + (bottom - top) * ft + 0.5f);
+                }
+                level.texels[(size_t)y * level.width + x] = packColor(rgba);
+            }
+        }
+        texture->levels.push_back(std::move(level));
+    }
+
+    const Texture* result = texture.get();
+    textures[&image] = std::move(texture);
+    return result;
+}
+
+bool SoftwareRasterizer::LayerKey::operator<(const LayerKey& other) const {
+    if (texture != other.texture) return texture < other.texture;
+    return std::memcmp(planes, other.planes, sizeof(planes)) < 0;
+}
+
+const SoftwareRasterizer::SampledLayer* SoftwareRasterizer::getLayer(const Texture* texture, const float* uPlane, const float* vPlane,
+                                                                    int minX, int minY, int maxX, int maxY) {
+    LayerKey key;
+    key.texture = texture;
+    std::memcpy(key.planes, uPlane, 3 * sizeof(float));
+    std::memcpy(key.planes + 3, vPlane, 3 * sizeof(float));
+
+    std::unique_ptr<SampledLayer>& layer = layers[key];
+    if (layer) {
+        int layerMaxX = layer->minX + layer->rowTexels - 1;
+        int layerMaxY = layer->minY + (int)(layer->texels.size() / layer->rowTexels) - 1;
+        if (minX >= layer->minX && minY >= layer->minY && maxX <= layerMaxX && maxY <= layerMaxY) {
+            return layer.get();
+        }
+        // Another triangle of the same mapping reaches further; resample the union in place,
+        // earlier triangles keep their pointer and see the same texels
+        minX = std::min(minX, layer->minX);
+        minY = std::min(minY, layer->minY);
+        maxX = std::max(maxX, layerMaxX);
+        maxY = std::max(maxY, layerMaxY);
+        layerBytes -= layer->texels.size() * sizeof(uint32_t);
+    }
+    else {
+        layer.reset(new SampledLayer());
+    }
+
+    // Texture coordinates are affine in window space, so the footprint (and with it the
+    // mip level) is constant over the mapping
+    const MipLevel& base = texture->levels[0];
+    float dudx = uPlane[0] * base.width, dvdx = vPlane[0] * base.height;
+    float dudy = uPlane[1] * base.width, dvdy = vPlane[1] * base.height;
+    float rho = std::max(std::sqrt(dudx * dudx + dvdx * dvdx), std::sqrt(dudy * dudy + dvdy * dvdy));
+    float lambda = rho > 0.0f ? std::log2(rho) : 0.0f;
+    int level = 0;
+    float levelBlend = 0.0f;
+    if (lambda > 0.0f) {
+        int maxLevel = (int)texture->levels.size() - 1;
+        float d = std::min(lambda, (float)maxLevel);
+        level = (int)d;
+        levelBlend = level < maxLevel ? d - level : 0.0f;
+    }
+    const MipLevel& level0 = texture->levels[level];
+    const MipLevel* level1 = levelBlend > 0.0f ? &texture->levels[level + 1] : nullptr;
+
+    layer->minX = minX & ~3;
+    layer->minY = minY;
+    layer->rowTexels = ((maxX + 1 - layer->minX) + 3) & ~3;
+    layer->texels.resize((size_t)layer->rowTexels * (maxY + 1 - minY));
+    for (int py = minY; py <= maxY; ++py) {
+        uint32_t* row = &layer->texels[(size_t)(py - minY) * layer->rowTexels];
+        const float centerY = py + 0.5f;
+        for (int i = 0; i < layer->rowTexels; ++i) {
+            const float centerX = layer->minX + i + 0.5f;
+            float u = uPlane[0] * centerX + uPlane[1] * centerY + uPlane[2];
+            float v = vPlane[0] * centerX + vPlane[1] * centerY + vPlane[2];
+            Color4 texel = sampleBilinear(level0, u, v);
+            if (level1 != nullptr) {
+                texel = lerp(texel, sampleBilinear(*level1, u, v), toWeight(levelBlend));
+            }
+            row[i] = packTexel(texel);
+        }
+    }
+    layerBytes += layer->texels.size() * sizeof(uint32_t);
+    return layer.get();
+}
+
+void SoftwareRasterizer::addTriangle(const float* x, const float* y, const float* u, const float* v,
+                                     uint32_t solidColor, const Texture* texture) {
+    // Counter-clockwise order (y up) so inside is positive on every edge
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area == 0.0f || !std::isfinite(area)) return;
+    int order[3] = { 0, 1, 2 };
+    if (area < 0.0f) {
+        std::swap(order[1], order[2]);
+        area = -area;
+    }
+
+    Triangle triangle;
+    triangle.color = solidColor;
+    triangle.layer = nullptr;
+
+    float minX = x[0], maxX = x[0], minY = y[0], maxY = y[0];
+    for (int i = 1; i < 3; ++i) {
+        minX = std::min(minX, x[i]); maxX = std::max(maxX, x[i]);
+        minY = std::min(minY, y[i]); maxY = std::max(maxY, y[i]);
+    }
+    // Pixels whose center (p + 0.5) lies in the bounds
+    triangle.minX = std::max(0, (int)std::ceil(minX - 0.5f));
+    triangle.minY = std::max(0, (int)std::ceil(minY - 0.5f));
+    triangle.maxX = std::min(width - 1, (int)std::floor(maxX - 0.5f));
+    triangle.maxY = std::min(height - 1, (int)std::floor(maxY - 0.5f));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) return;
+
+    // Edge e runs from vertex e + 1 to e + 2 and is zero on it, so E_e / area is the
+    // barycentric weight of vertex e
+    for (int e = 0; e < 3; ++e) {
+        int from = order[(e + 1) % 3];
+        int to = order[(e + 2) % 3];
+        float dx = x[to] - x[from];
+        float dy = y[to] - y[from];
+        triangle.edgeA[e] = -dy;
+        triangle.edgeB[e] = dx;
+        triangle.edgeC[e] = dy * x[from] - dx * y[from];
+        triangle.topLeft[e] = dy < 0.0f || (dy == 0.0f && dx < 0.0f);
+    }
+
+    if (texture != nullptr) {
+        float uPlane[3] = { 0.0f, 0.0f, 0.0f };
+        float vPlane[3] = { 0.0f, 0.0f, 0.0f };
+        for (int e = 0; e < 3; ++e) {
+            const float edge[3] = { triangle.edgeA[e] / area, triangle.edgeB[e] / area, triangle.edgeC[e] / area };
+            for (int k = 0; k < 3; ++k) {
+                uPlane[k] += edge[k] * u[order[e]];
+                vPlane[k] += edge[k] * v[order[e]];
+            }
+        }
+        triangle.layer = getLayer(texture, uPlane, vPlane, triangle.minX, triangle.minY, triangle.maxX, triangle.maxY);
+    }
+
+    triangles.push_back(triangle);
+}
+
+void SoftwareRasterizer::fillTriangles(const float* positions, int first, int count, bool fan, const float rgb[3]) {
+    unsigned char rgba[4];
+    for (int i = 0; i < 3; ++i) {
+        rgba[i] = (unsigned char)(std::min(1.0f, std::max(0.0f, rgb[i])) * 255.0f + 0.5f);
+    }
+    rgba[3] = 255;
+    uint32_t solid = packColor(rgba);
+
+    auto toWindow = [&](int vertex, float& x, float& y) {
+        x = (positions[vertex * 2] + 1.0f) * 0.5f * width;
+        y = (positions[vertex * 2 + 1] + 1.0f) * 0.5f * height;
+    };
+
+    float x[3], y[3];
+    if (fan) {
+        for (int i = 1; i + 1 < count; ++i) {
+            toWindow(first, x[0], y[0]);
+            toWindow(first + i, x[1], y[1]);
+            toWindow(first + i + 1, x[2], y[2]);
+            addTriangle(x, y, nullptr, nullptr, solid, nullptr);
+        }
+    }
+    else {
+        for (int i = 0; i + 2 < count; i += 3) {
+            for (int k = 0; k < 3; ++k) {
+                toWindow(first + i + k, x[k], y[k]);
+            }
+            addTriangle(x, y, nullptr, nullptr, solid, nullptr);
+        }
+    }
+}
+
+void SoftwareRasterizer::drawTextured(const DecodedImage& image, const float* vertices, int first, int count) {
+    if (image.width <= 0 || image.height <= 0) return;
+    const Texture* texture = getTexture(image);
+
+    float x[3], y[3], u[3], v[3];
+    for (int i = 0; i + 2 < count; i += 3) {
+        for (int k = 0; k < 3; ++k) {
+            const float* vertex = &vertices[(first + i + k) * 4];
+            x[k] = (vertex[0] + 1.0f) * 0.5f * width;
+            y[k] = (vertex[1] + 1.0f) * 0.5f * height;
+            u[k] = vertex[2];
+            v[k] = vertex[3];
+        }
+        addTriangle(x, y, u, v, 0, texture);
+    }
+}
+
+void SoftwareRasterizer::rasterizeTile(int tile) {
+    const int tileMinX = (tile % tilesX) * TILE_SIZE;
+    const int tileMinY = (tile / tilesX) * TILE_SIZE;
+    const int tileMaxX = std::min(width, tileMinX + TILE_SIZE) - 1;
+    const int tileMaxY = std::min(height, tileMinY + TILE_SIZE) - 1;
+
+    for (uint32_t index : bins[tile]) {
+        const Triangle& triangle = triangles[index];
+        const SampledLayer* layer = triangle.layer;
+        const int minX = std::max(triangle.minX, tileMinX);
+        const int maxX = std::min(triangle.maxX, tileMaxX);
+        const int minY = std::max(triangle.minY, tileMinY);
+        const int maxY = std::min(triangle.maxY, tileMaxY);
+        const int startX = minX & ~3;   // Vector loops run on groups of four aligned to the row
+
+#ifdef SOFTWARE_RASTERIZER_SSE2
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+        const __m128 rangeMin = _mm_set1_ps((float)minX + 0.5f);
+        const __m128 rangeMax = _mm_set1_ps((float)maxX + 0.5f);
+        const __m128i solid = _mm_set1_epi32((int)triangle.color);
+        __m128 edgeStep[3], topLeft[3];
+        for (int e = 0; e < 3; ++e) {
+            edgeStep[e] = _mm_set1_ps(triangle.edgeA[e] * 4.0f);
+            topLeft[e] = _mm_castsi128_ps(_mm_set1_epi32(triangle.topLeft[e] ? -1 : 0));
+        }
+
+        for (int py = minY; py <= maxY; ++py) {
+            uint32_t* row = &pixels[(size_t)py * rowPixels];
+            const uint32_t* layerRow = layer ? &layer->texels[(size_t)(py - layer->minY) * layer->rowTexels] : nullptr;
+            const float centerY = py + 0.5f;
+            __m128 centerX = _mm_add_ps(_mm_set1_ps((float)startX), laneOffsets);
+            __m128 edge[3];
+            for (int e = 0; e < 3; ++e) {
+                edge[e] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edgeA[e]), centerX),
+                                     _mm_set1_ps(triangle.edgeB[e] * centerY + triangle.edgeC[e]));
+            }
+
+            for (int px = startX; px <= maxX; px += 4) {
+                __m128 inside = _mm_and_ps(_mm_cmpge_ps(centerX, rangeMin), _mm_cmple_ps(centerX, rangeMax));
+                for (int e = 0; e < 3; ++e) {
+                    __m128 onEdge = _mm_and_ps(_mm_cmpeq_ps(edge[e], zero), topLeft[e]);
+                    inside = _mm_and_ps(inside, _mm_or_ps(_mm_cmpgt_ps(edge[e], zero), onEdge));
+                    edge[e] = _mm_add_ps(edge[e], edgeStep[e]);
+                }
+                centerX = _mm_add_ps(centerX, _mm_set1_ps(4.0f));
+                if (_mm_movemask_ps(inside) == 0) continue;
+
+                __m128i mask = _mm_castps_si128(inside);
+                __m128i* target = (__m128i*)&row[px];
+                __m128i current = _mm_loadu_si128(target);
+                __m128i color = solid;
+                if (layer != nullptr) {
+                    color = _mm_loadu_si128((const __m128i*)&layerRow[px - layer->minX]);
+                    // Fully transparent texels leave the target as is
+                    mask = _mm_andnot_si128(_mm_cmpeq_epi32(_mm_srli_epi32(color, 24), _mm_setzero_si128()), mask);
+                    if (_mm_movemask_epi8(mask) == 0) continue;
+                    color = blendOver(color, current);
+                }
+                _mm_storeu_si128(target, _mm_or_si128(_mm_and_si128(mask, color), _mm_andnot_si128(mask, current)));
+            }
+        }
+#else
+        for (int py = minY; py <= maxY; ++py) {
+            uint32_t* row = &pixels[(size_t)py * rowPixels];
+            const uint32_t* layerRow = layer ? &layer->texels[(size_t)(py - layer->minY) * layer->rowTexels] : nullptr;
+            const float centerY = py + 0.5f;
+            for (int px = minX; px <= maxX; ++px) {
+                const float centerX = px + 0.5f;
+                bool inside = true;
+                for (int e = 0; e < 3 && inside; ++e) {
+                    float value = triangle.edgeA[e] * centerX + triangle.edgeB[e] * centerY + triangle.edgeC[e];
+                    inside = value > 0.0f || (value == 0.0f && triangle.topLeft[e]);
+                }
+                if (inside) {
+                    row[px] = layer ? blendOver(layerRow[px - layer->minX], row[px]) : triangle.color;
+                }
+            }
+        }
+        (void)startX;
+#endif
+    }
+}
+
+void SoftwareRasterizer::flush() {
+    if (triangles.empty()) return;
+
+    for (auto& bin : bins) {
+        bin.clear();
+    }
+    for (uint32_t i = 0; i < (uint32_t)triangles.size(); ++i) {
+        const Triangle& triangle = triangles[i];
+        for (int ty = triangle.minY / TILE_SIZE; ty <= triangle.maxY / TILE_SIZE; ++ty) {
+            for (int tx = triangle.minX / TILE_SIZE; tx <= triangle.maxX / TILE_SIZE; ++tx) {
+                bins[ty * tilesX + tx].push_back(i);
+            }
+        }
+    }
+
+    // Tiles own disjoint pixels, so threads only share the counter
+    std::atomic<int> nextTile(0);
+    const int tileCount = tilesX * tilesY;
+    auto work = [&]() {
+        for (int tile = nextTile++; tile < tileCount; tile = nextTile++) {
+            if (!bins[tile].empty()) {
+                rasterizeTile(tile);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < std::min(threads, tileCount); ++i) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    triangles.clear();
+}
+
+const unsigned char* SoftwareRasterizer::getPixels() const {
+    return (const unsigned char*)&pixels[(size_t)(height - 1) * rowPixels];
+}
+
+ptrdiff_t SoftwareRasterizer::getStride() const {
+    return -(ptrdiff_t)rowPixels * 4;
+}
+
+int SoftwareRasterizer::getWidth() const {
+    return width;
+}
+
+int SoftwareRasterizer::getHeight() const {
+    return height;
+}
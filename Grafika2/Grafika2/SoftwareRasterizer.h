@@ -0,0 +1,116 @@
+#ifndef SOFTWARE_RASTERIZER_H
+#define SOFTWARE_RASTERIZER_H
+
+#include "ImageStore.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// CPU implementation of the few primitives an avatar is made of: solid triangles and fans,
+// and alpha-blended textured quads with trilinear filtering. Follows the GL path closely
+// (NDC positions, pixel centers at .5, GL_SRC_ALPHA blending, mipmaps, GL_REPEAT) so the
+// images match the GL renderer within rounding, without needing any GL context.
+//
+// Draws are recorded, binned into 64x64 tiles and rasterized by flush(); tiles are
+// independent, so they are spread over threads. Coverage tests, fills and blending run
+// four pixels at a time with SSE2; textures are filtered once per mapping (see SampledLayer).
+class SoftwareRasterizer {
+public:
+    SoftwareRasterizer();
+
+    // threads is the number of threads flush() uses, including the calling one
+    bool create(int width, int height, int threads = 1);
+
+    // Starts a frame: transparent black, pending draws are dropped
+    void clear();
+
+    // Triangles (or one fan) from an x/y position array, in NDC; color components are
+    // clamped to [0, 1] like the GL color buffer does
+    void fillTriangles(const float* positions, int first, int count, bool fan, const float color[3]);
+
+    // Triangles with x/y/u/v vertices, textured from image (rows bottom-up, as uploaded to GL)
+    void drawTextured(const DecodedImage& image, const float* vertices, int first, int count);
+
+    // Rasterizes everything recorded since clear()
+    void flush();
+
+    // RGBA8 pixels. Rows are stored bottom-up like a GL framebuffer: getPixels() is the top
+    // row and getStride() is negative, the same layout ReadbackQueue hands out.
+    const unsigned char* getPixels() const;
+    ptrdiff_t getStride() const;
+    int getWidth() const;
+    int getHeight() const;
+
+private:
+    static const int TILE_SIZE = 64;
+    static const size_t MAX_LAYER_BYTES = 64 * 1024 * 1024;
+
+    struct MipLevel {
+        int width;
+        int height;
+        std::vector<uint32_t> texels;   // RGBA8, straight alpha
+    };
+
+    struct Texture {
+        std::vector<MipLevel> levels;
+    };
+
+    // A texture filtered onto the target pixel grid for one mapping (texture and u/v planes).
+    // Sprites come back at the same place from frame to frame, so trilinear filtering runs
+    // once per item and anchor and drawing is only blending. Rows start at a multiple of
+    // four pixels and have a multiple of four texels, like the target.
+    struct SampledLayer {
+        int minX;
+        int minY;
+        int rowTexels;
+        std::vector<uint32_t> texels;
+    };
+
+    struct LayerKey {
+        const Texture* texture;
+        float planes[6];
+
+        bool operator<(const LayerKey& other) const;
+    };
+
+    // Set up once when recorded: E = a * x + b * y + c per edge, inside where all E > 0
+    // (E == 0 counts only on top-left edges, so shared edges are drawn once)
+    struct Triangle {
+        float edgeA[3];
+        float edgeB[3];
+        float edgeC[3];
+        bool topLeft[3];
+        uint32_t color;                 // Solid color when layer is null
+        const SampledLayer* layer;
+        int minX, minY, maxX, maxY;     // Covered pixel range, inclusive
+    };
+
+    const Texture* getTexture(const DecodedImage& image);
+    const SampledLayer* getLayer(const Texture* texture, const float* uPlane, const float* vPlane,
+                                 int minX, int minY, int maxX, int maxY);
+    // Window coordinates (y up); u and v are ignored without a texture
+    void addTriangle(const float* x, const float* y, const float* u, const float* v, uint32_t solidColor, const Texture* texture);
+    void rasterizeTile(int tile);
+
+    int width;
+    int height;
+    int rowPixels;              // Row length rounded up to four pixels for the vector loops
+    int threads;
+    int tilesX;
+    int tilesY;
+    std::vector<uint32_t> pixels;  // rowPixels * height, bottom row first
+    std::vector<Triangle> triangles;
+    std::vector<std::vector<uint32_t>> bins;   // Triangle indices per tile, in draw order
+    // Mip chains are built once per image and kept like the GL path keeps its textures
+    std::unordered_map<const DecodedImage*, std::unique_ptr<Texture>> textures;
+    std::map<LayerKey, std::unique_ptr<SampledLayer>> layers;
+    size_t layerBytes;
+
+    SoftwareRasterizer(const SoftwareRasterizer&) = delete;
+    SoftwareRasterizer& operator=(const SoftwareRasterizer&) = delete;
+};
+
+#endif
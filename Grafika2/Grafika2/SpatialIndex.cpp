@@ -0,0 +1,173 @@
+#include "SpatialIndex.h"
+#include <algorithm>
+#include <cmath>
+
+SpatialIndex::SpatialIndex(const Bounds& world, int maxDepth) : world(world), maxDepth(std::max(0, maxDepth)), count(0) {
+    clear();
+}
+
+void SpatialIndex::clear() {
+    nodes.clear();
+    Node root;
+    root.centerX = (world.minX + world.maxX) * 0.5f;
+    root.centerY = (world.minY + world.maxY) * 0.5f;
+    root.half = std::max(world.maxX - world.minX, world.maxY - world.minY) * 0.5f;
+    root.parent = -1;
+    root.children[0] = root.children[1] = root.children[2] = root.children[3] = -1;
+    root.count = 0;
+    nodes.push_back(root);
+    entries.clear();
+    count = 0;
+}
+
+bool SpatialIndex::contains(int id) const {
+    return id >= 0 && id < (int)entries.size() && entries[id].node >= 0;
+}
+
+int SpatialIndex::getCount() const {
+    return count;
+}
+
+bool SpatialIndex::fits(const Node& node, const Bounds& bounds) const {
+    const float centerX = (bounds.minX + bounds.maxX) * 0.5f;
+    const float centerY = (bounds.minY + bounds.maxY) * 0.5f;
+    return std::abs(centerX - node.centerX) <= node.half && std::abs(centerY - node.centerY) <= node.half &&
+           bounds.maxX - bounds.minX <= 2.0f * node.half && bounds.maxY - bounds.minY <= 2.0f * node.half;
+}
+
+int SpatialIndex::findNode(const Bounds& bounds) {
+    if (!fits(nodes[0], bounds)) return 0;
+    const float centerX = (bounds.minX + bounds.maxX) * 0.5f;
+    const float centerY = (bounds.minY + bounds.maxY) * 0.5f;
+    const float extent = std::max(bounds.maxX - bounds.minX, bounds.maxY - bounds.minY);
+    int index = 0;
+    for (int depth = 0; depth < maxDepth; ++depth) {
+        const float childHalf = nodes[index].half * 0.5f;
+        if (extent > 2.0f * childHalf) break;
+        const int quadrant = (centerX >= nodes[index].centerX ? 1 : 0) + (centerY >= nodes[index].centerY ? 2 : 0);
+        int child = nodes[index].children[quadrant];
+        if (child < 0) {
+            Node node;
+            node.centerX = nodes[index].centerX + ((quadrant & 1) ? childHalf : -childHalf);
+            node.centerY = nodes[index].centerY + ((quadrant & 2) ? childHalf : -childHalf);
+            node.half = childHalf;
+            node.parent = index;
+            node.children[0] = node.children[1] = node.children[2] = node.children[3] = -1;
+            node.count = 0;
+            child = (int)nodes.size();
+            nodes.push_back(node);  // May move nodes, so only indices are kept
+            nodes[index].children[quadrant] = child;
+        }
+        index = child;
+    }
+    return index;
+}
+
+void SpatialIndex::link(int id, int node) {
+    Entry& entry = entries[id];
+    entry.node = node;
+    entry.slot = (int)nodes[node].objects.size();
+    nodes[node].objects.push_back(id);
+    for (int n = node; n >= 0; n = nodes[n].parent) {
+        ++nodes[n].count;
+    }
+    ++count;
+}
+
+void SpatialIndex::unlink(int id) {
+    Entry& entry = entries[id];
+    std::vector<int>& objects = nodes[entry.node].objects;
+    // Swap with the last object of the node so removal is O(1)
+    const int last = objects.back();
+    objects[entry.slot] = last;
+    entries[last].slot = entry.slot;
+    objects.pop_back();
+    for (int n = entry.node; n >= 0; n = nodes[n].parent) {
+        --nodes[n].count;
+    }
+    entry.node = -1;
+    --count;
+}
+
+void SpatialIndex::insert(int id, const Bounds& bounds) {
+    if (id >= (int)entries.size()) {
+        entries.resize(id + 1, Entry{ Bounds{ 0.0f, 0.0f, 0.0f, 0.0f }, -1, 0 });
+    }
+    if (entries[id].node >= 0) unlink(id);
+    entries[id].bounds = bounds;
+    link(id, findNode(bounds));
+}
+
+void SpatialIndex::update(int id, const Bounds& bounds) {
+    if (!contains(id)) {
+        insert(id, bounds);
+        return;
+    }
+    Entry& entry = entries[id];
+    entry.bounds = bounds;
+    // Still inside its node's loose bounds: nothing to move. It may sit shallower than a fresh
+    // insert would put it, which only costs queries a few extra tests.
+    if (entry.node != 0 && fits(nodes[entry.node], bounds)) return;
+    unlink(id);
+    link(id, findNode(bounds));
+}
+
+void SpatialIndex::remove(int id) {
+    if (contains(id)) unlink(id);
+}
+
+void SpatialIndex::collect(int node, std::vector<int>& out) const {
+    const size_t base = stack.size();
+    stack.push_back(node);
+    while (stack.size() > base) {
+        const Node& current = nodes[stack.back()];
+        stack.pop_back();
+        if (current.count == 0) continue;
+        out.insert(out.end(), current.objects.begin(), current.objects.end());
+        for (int child : current.children) {
+            if (child >= 0) stack.push_back(child);
+        }
+    }
+}
+
+template <typename Overlaps, typename Inside, typename Test>
+void SpatialIndex::query(const Overlaps& overlaps, const Inside& inside, const Test& test, std::vector<int>& out) const {
+    out.clear();
+    stack.clear();
+    stack.push_back(0);
+    while (!stack.empty()) {
+        const int index = stack.back();
+        stack.pop_back();
+        const Node& node = nodes[index];
+        if (node.count == 0) continue;
+        // Everything below lies within the cell grown by half a cell on each side; the root
+        // also holds objects outside the world, so it is always searched
+        const Bounds loose = { node.centerX - 2.0f * node.half, node.centerY - 2.0f * node.half,
+                               node.centerX + 2.0f * node.half, node.centerY + 2.0f * node.half };
+        if (index != 0) {
+            if (!overlaps(loose)) continue;
+            if (inside(loose)) {
+                collect(index, out);
+                continue;
+            }
+        }
+        for (int id : node.objects) {
+            if (test(entries[id].bounds)) out.push_back(id);
+        }
+        for (int child : node.children) {
+            if (child >= 0) stack.push_back(child);
+        }
+    }
+}
+
+void SpatialIndex::queryPoint(float x, float y, std::vector<int>& out) const {
+    query([&](const Bounds& loose) { return loose.contains(x, y); },
+          [](const Bounds&) { return false; },
+          [&](const Bounds& bounds) { return bounds.contains(x, y); }, out);
+}
+
+void SpatialIndex::queryRect(const Bounds& rect, std::vector<int>& out) const {
+    query([&](const Bounds& loose) { return loose.intersects(rect); },
+          [&](const Bounds& loose) { return loose.minX >= rect.minX && loose.maxX <= rect.maxX && loose.minY >= rect.minY && loose.maxY <= rect.maxY; },
+          [&](const Bounds& bounds) { return bounds.intersects(rect); }, out);
+}
@@ -0,0 +1,76 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include <vector>
+
+// Axis-aligned rectangles by integer id, for picking, rectangle selection and culling
+// without visiting every object. A loose quadtree: an object lives in the deepest node
+// whose cell contains its center and is at least as large as the object, and a node's
+// objects may reach half a cell past its edges, so objects never straddle nodes and moving
+// one is at most a remove and an insert (usually neither, when it stays in its node).
+// Queries skip empty subtrees and take whole subtrees lying inside the query without
+// testing them. Objects outside the world bounds are kept in the root.
+class SpatialIndex {
+public:
+    struct Bounds {
+        float minX, minY, maxX, maxY;
+
+        bool contains(float x, float y) const {
+            return x >= minX && x <= maxX && y >= minY && y <= maxY;
+        }
+        bool intersects(const Bounds& other) const {
+            return minX <= other.maxX && maxX >= other.minX && minY <= other.maxY && maxY >= other.minY;
+        }
+    };
+
+    // world should cover where objects usually are; maxDepth limits the tree to
+    // 4^maxDepth leaves
+    SpatialIndex(const Bounds& world, int maxDepth = 10);
+
+    // ids are small non-negative integers (indices into the caller's own arrays)
+    void insert(int id, const Bounds& bounds);
+    // Inserts id if it is not in the index yet
+    void update(int id, const Bounds& bounds);
+    void remove(int id);
+    void clear();
+    bool contains(int id) const;
+    int getCount() const;
+
+    // Ids whose bounds contain (x, y) or intersect rect, in no particular order; out is
+    // cleared first
+    void queryPoint(float x, float y, std::vector<int>& out) const;
+    void queryRect(const Bounds& rect, std::vector<int>& out) const;
+
+private:
+    struct Node {
+        float centerX, centerY;
+        float half;             // Half the cell size; objects reach up to half past the cell
+        int parent;
+        int children[4];        // -1 until something is inserted there
+        int count;              // Objects in this node and below
+        std::vector<int> objects;
+    };
+
+    struct Entry {
+        Bounds bounds;
+        int node;               // -1 when the id is not in the index
+        int slot;               // Position in the node's objects
+    };
+
+    bool fits(const Node& node, const Bounds& bounds) const;
+    int findNode(const Bounds& bounds);
+    void link(int id, int node);
+    void unlink(int id);
+    void collect(int node, std::vector<int>& out) const;
+    template <typename Overlaps, typename Inside, typename Test>
+    void query(const Overlaps& overlaps, const Inside& inside, const Test& test, std::vector<int>& out) const;
+
+    Bounds world;
+    int maxDepth;
+    std::vector<Node> nodes;    // nodes[0] is the root
+    std::vector<Entry> entries; // By id
+    int count;
+    mutable std::vector<int> stack;
+};
+
+#endif
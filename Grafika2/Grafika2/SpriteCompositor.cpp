@@ -0,0 +1,472 @@
+#include "SpriteCompositor.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SPRITE_COMPOSITOR_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+    // value * alpha / 255, rounded
+    uint32_t scale255(uint32_t value, uint32_t alpha) {
+        uint32_t product = value * alpha + 128;
+        return (product + (product >> 8)) >> 8;
+    }
+
+    uint32_t premultiply(const unsigned char* source, int channels) {
+        uint32_t alpha = channels == 4 ? source[3] : 255;
+        return scale255(source[0], alpha) | (scale255(source[1], alpha) << 8) |
+               (scale255(source[2], alpha) << 16) | (alpha << 24);
+    }
+
+    uint32_t unpremultiply(uint32_t pixel) {
+        uint32_t alpha = pixel >> 24;
+        if (alpha == 255) return pixel;
+        if (alpha == 0) return 0;
+        uint32_t out = alpha << 24;
+        for (int i = 0; i < 24; i += 8) {
+            uint32_t value = ((pixel >> i) & 0xFF) * 255 + alpha / 2;
+            out |= std::min(255u, value / alpha) << i;
+        }
+        return out;
+    }
+
+    int floorToInt(float value) {
+        int truncated = (int)value;
+        return truncated - (value < (float)truncated ? 1 : 0);
+    }
+
+    // 0-256 fixed point, the precision the 16-bit lanes allow without overflow
+    uint16_t toWeight(float fraction) {
+        return (uint16_t)std::min(256, std::max(0, (int)(fraction * 256.0f + 0.5f)));
+    }
+
+#ifdef SPRITE_COMPOSITOR_SSE2
+    // One texel from the pair (left, right) on top and the pair below, as 16-bit channels;
+    // bilinear weights are 0-256, so every intermediate fits an unsigned 16-bit lane
+    __m128i sampleBilinear(const uint32_t* row0, const uint32_t* row1, __m128i rowWeights0, __m128i rowWeights1, uint16_t columnWeight) {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i top = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)row0), zero);
+        __m128i bottom = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)row1), zero);
+        __m128i pair = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(top, rowWeights0), _mm_mullo_epi16(bottom, rowWeights1)), _mm_set1_epi16(128));
+        pair = _mm_srli_epi16(pair, 8);
+
+        short left = (short)(256 - columnWeight);
+        short right = (short)columnWeight;
+        __m128i weighted = _mm_mullo_epi16(pair, _mm_set_epi16(right, right, right, right, left, left, left, left));
+        __m128i sum = _mm_add_epi16(_mm_add_epi16(weighted, _mm_srli_si128(weighted, 8)), _mm_set1_epi16(128));
+        return _mm_srli_epi16(sum, 8);
+    }
+
+    __m128i unpackTexel(uint32_t texel) {
+        return _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)texel), _mm_setzero_si128());
+    }
+
+    uint32_t packTexel(__m128i color) {
+        return (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(color, color));
+    }
+
+    // Channels times tint / 255, rounded; the tint's alpha is 255, so premultiplication holds
+    __m128i applyTint(__m128i color, __m128i tint) {
+        __m128i product = _mm_add_epi16(_mm_mullo_epi16(color, tint), _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+    }
+
+    // Premultiplied alpha-over of one pixel: source + target * (255 - source alpha) / 255
+    uint32_t blendOver(__m128i source, uint32_t target) {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i destination = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)target), zero);
+        __m128i inverse = _mm_sub_epi16(_mm_set1_epi16(255), _mm_shufflelo_epi16(source, _MM_SHUFFLE(3, 3, 3, 3)));
+        __m128i product = _mm_add_epi16(_mm_mullo_epi16(destination, inverse), _mm_set1_epi16(128));
+        product = _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+        return packTexel(_mm_add_epi16(source, product));
+    }
+#else
+    uint32_t lerpChannel(uint32_t a, uint32_t b, uint32_t weight) {
+        return (a * (256 - weight) + b * weight + 128) >> 8;
+    }
+
+    // Same arithmetic and rounding as the vector path
+    uint32_t sampleBilinear(const uint32_t* row0, const uint32_t* row1, uint32_t rowWeight, uint32_t columnWeight) {
+        uint32_t out = 0;
+        for (int i = 0; i < 32; i += 8) {
+            uint32_t left = lerpChannel((row0[0] >> i) & 0xFF, (row1[0] >> i) & 0xFF, rowWeight);
+            uint32_t right = lerpChannel((row0[1] >> i) & 0xFF, (row1[1] >> i) & 0xFF, rowWeight);
+            out |= lerpChannel(left, right, columnWeight) << i;
+        }
+        return out;
+    }
+
+    uint32_t unpackTexel(uint32_t texel) {
+        return texel;
+    }
+
+    uint32_t packTexel(uint32_t color) {
+        return color;
+    }
+
+    uint32_t applyTint(uint32_t color, uint32_t tint) {
+        uint32_t out = 0;
+        for (int i = 0; i < 32; i += 8) {
+            out |= scale255((color >> i) & 0xFF, (tint >> i) & 0xFF) << i;
+        }
+        return out;
+    }
+
+    uint32_t blendOver(uint32_t source, uint32_t target) {
+        uint32_t inverse = 255 - (source >> 24);
+        uint32_t out = 0;
+        for (int i = 0; i < 32; i += 8) {
+            out |= std::min(255u, ((source >> i) & 0xFF) + scale255((target >> i) & 0xFF, inverse)) << i;
+        }
+        return out;
+    }
+#endif
+}
+
+SpriteCompositor::SpriteCompositor()
+    : width(0), height(0), threads(1), resampling(false), filter(Resampler::FILTER_LANCZOS3), resampledBytes(0) {}
+
+bool SpriteCompositor::create(int targetWidth, int targetHeight, int threadCount) {
+    if (targetWidth <= 0 || targetHeight <= 0) return false;
+
+    width = targetWidth;
+    height = targetHeight;
+    threads = std::max(1, threadCount);
+    pixels.assign((size_t)width * height, 0);
+    layers.clear();
+    return true;
+}
+
+void SpriteCompositor::clear() {
+    layers.clear();
+
+    // Prefiltered layers are only referenced by recorded layers, so they can go here
+    if (resampledBytes > MAX_RESAMPLED_BYTES) {
+        resampled.clear();
+        resampledBytes = 0;
+    }
+}
+
+SpriteCompositor::Image* SpriteCompositor::getImage(const DecodedImage& image) {
+    auto found = images.find(&image);
+    if (found != images.end()) {
+        return found->second.get();
+    }
+
+    std::unique_ptr<Image> prepared(new Image());
+    Level base;
+    base.width = image.width;
+    base.height = image.height;
+    base.rowTexels = image.width + 1;
+    base.texels.resize((size_t)base.rowTexels * base.height);
+    for (int y = 0; y < image.height; ++y) {
+        uint32_t* row = &base.texels[(size_t)y * base.rowTexels];
+        for (int x = 0; x < image.width; ++x) {
+            row[x] = premultiply(&image.pixels[((size_t)y * image.width + x) * image.channels], image.channels);
+        }
+        row[image.width] = row[image.width - 1];
+    }
+    prepared->levels.push_back(std::move(base));
+
+    Image* result = prepared.get();
+    images[&image] = std::move(prepared);
+    return result;
+}
+
+const SpriteCompositor::Level* SpriteCompositor::getLevel(Image* image, float layerWidth, float layerHeight) {
+    // Smallest level that is still at least as large as the layer, so bilinear filtering
+    // never skips texels
+    size_t index = 0;
+    for (;;) {
+        const Level& current = image->levels[index];
+        int nextWidth = std::max(1, current.width / 2);
+        int nextHeight = std::max(1, current.height / 2);
+        if ((current.width == 1 && current.height == 1) || nextWidth < layerWidth || nextHeight < layerHeight) {
+            return &current;
+        }
+        if (index + 1 < image->levels.size()) {
+            ++index;
+            continue;
+        }
+
+        // 2x2 box of premultiplied texels, so transparent texels do not darken the edges;
+        // the last row and column are repeated for odd sizes
+        Level level;
+        level.width = nextWidth;
+        level.height = nextHeight;
+        level.rowTexels = level.width + 1;
+        level.texels.resize((size_t)level.rowTexels * level.height);
+        for (int y = 0; y < level.height; ++y) {
+            const uint32_t* top = &current.texels[(size_t)std::min(y * 2, current.height - 1) * current.rowTexels];
+            const uint32_t* bottom = &current.texels[(size_t)std::min(y * 2 + 1, current.height - 1) * current.rowTexels];
+            uint32_t* row = &level.texels[(size_t)y * level.rowTexels];
+            for (int x = 0; x < level.width; ++x) {
+                int x0 = std::min(x * 2, current.width - 1);
+                int x1 = std::min(x * 2 + 1, current.width - 1);
+                uint32_t out = 0;
+                for (int i = 0; i < 32; i += 8) {
+                    uint32_t sum = ((top[x0] >> i) & 0xFF) + ((top[x1] >> i) & 0xFF) +
+                                   ((bottom[x0] >> i) & 0xFF) + ((bottom[x1] >> i) & 0xFF) + 2;
+                    out |= (sum >> 2) << i;
+                }
+                row[x] = out;
+            }
+            row[level.width] = row[level.width - 1];
+        }
+        image->levels.push_back(std::move(level));
+        ++index;
+    }
+}
+
+void SpriteCompositor::addLayer(const DecodedImage& image, float x, float y, float layerWidth, float layerHeight, const float* tint) {
+    if (image.width <= 0 || image.height <= 0 || image.pixels.empty()) return;
+    if (layerWidth <= 0.0f || layerHeight <= 0.0f) return;
+
+    Layer layer;
+    layer.tinted = tint != nullptr;
+    layer.tint = 0xFF000000u;
+    for (int i = 0; i < 3 && layer.tinted; ++i) {
+        // Rounded like the GL color buffer rounds a solid color
+        layer.tint |= (uint32_t)(std::min(1.0f, std::max(0.0f, tint[i])) * 255.0f + 0.5f) << (i * 8);
+    }
+    layer.minX = std::max(0, (int)std::ceil(x - 0.5f));
+    layer.maxX = std::min(width - 1, (int)std::ceil(x + layerWidth - 0.5f) - 1);
+    layer.minY = std::max(0, (int)std::ceil(y - 0.5f));
+    layer.maxY = std::min(height - 1, (int)std::ceil(y + layerHeight - 0.5f) - 1);
+    if (layer.minX > layer.maxX || layer.minY > layer.maxY) return;
+
+    Image* prepared = getImage(image);
+    if (resampling && (image.width > layerWidth || image.height > layerHeight)) {
+        // Prefiltered onto exactly the pixels the layer covers, then drawn one to one
+        layer.level = getResampled(image, prepared, x, y, layerWidth, layerHeight);
+        x = std::ceil(x - 0.5f);
+        y = std::ceil(y - 0.5f);
+        layerWidth = (float)layer.level->width;
+        layerHeight = (float)layer.level->height;
+    }
+    else {
+        layer.level = getLevel(prepared, layerWidth, layerHeight);
+    }
+
+    // Pixel centers map to texel centers; outside the outer texel centers the edge is
+    // clamped, which the padding texel turns into a plain weight of zero
+    const Level& level = *layer.level;
+    float columnScale = level.width / layerWidth;
+    layer.columns.resize(layer.maxX - layer.minX + 1);
+    layer.columnWeights.resize(layer.columns.size());
+    for (int px = layer.minX; px <= layer.maxX; ++px) {
+        float s = (px + 0.5f - x) * columnScale - 0.5f;
+        int column = floorToInt(s);
+        uint16_t weight = toWeight(s - column);
+        if (column < 0) {
+            column = 0;
+            weight = 0;
+        } else if (column >= level.width - 1) {
+            column = level.width - 1;
+            weight = 0;
+        }
+        layer.columns[px - layer.minX] = column;
+        layer.columnWeights[px - layer.minX] = weight;
+    }
+    layer.rowScale = level.height / layerHeight;
+    layer.rowOffset = (0.5f - y) * layer.rowScale - 0.5f;
+
+    // Unscaled layers at whole pixel offsets, like a full-frame base image, skip filtering
+    layer.exact = layer.rowScale == 1.0f && layer.rowOffset == std::floor(layer.rowOffset) &&
+                  layer.minY + layer.rowOffset >= 0.0f && layer.maxY + layer.rowOffset <= level.height - 1;
+    for (size_t i = 0; i < layer.columns.size() && layer.exact; ++i) {
+        layer.exact = layer.columns[i] == layer.columns[0] + (int)i && layer.columnWeights[i] == 0;
+    }
+    layers.push_back(std::move(layer));
+}
+
+const SpriteCompositor::Level* SpriteCompositor::getResampled(const DecodedImage& image, Image* prepared, float x, float y,
+                                                              float layerWidth, float layerHeight) {
+    ResampledKey key = { &image, x, y, layerWidth, layerHeight };
+    auto found = resampled.find(key);
+    if (found != resampled.end()) {
+        return found->second.get();
+    }
+
+    const int left = (int)std::ceil(x - 0.5f);
+    const int bottom = (int)std::ceil(y - 0.5f);
+    std::unique_ptr<Level> level(new Level());
+    level->width = std::max(1, (int)std::ceil(x + layerWidth - 0.5f) - left);
+    level->height = std::max(1, (int)std::ceil(y + layerHeight - 0.5f) - bottom);
+    level->rowTexels = level->width + 1;
+    level->texels.resize((size_t)level->rowTexels * level->height);
+
+    // Starting from a level two to four times the layer size costs a fraction of the
+    // full image and looks the same after the kernel
+    const Level* source = getLevel(prepared, layerWidth * 2.0f, layerHeight * 2.0f);
+    float scaleX = source->width / layerWidth;
+    float scaleY = source->height / layerHeight;
+    Resampler::resample((const unsigned char*)source->texels.data(), source->width, source->height, (ptrdiff_t)source->rowTexels * 4,
+                        (unsigned char*)level->texels.data(), level->width, level->height, (ptrdiff_t)level->rowTexels * 4,
+                        (left - x) * scaleX, (bottom - y) * scaleY, scaleX, scaleY, filter, true, threads);
+    for (int row = 0; row < level->height; ++row) {
+        uint32_t* texels = &level->texels[(size_t)row * level->rowTexels];
+        texels[level->width] = texels[level->width - 1];
+    }
+
+    const Level* result = level.get();
+    resampledBytes += level->texels.size() * sizeof(uint32_t);
+    resampled[key] = std::move(level);
+    return result;
+}
+
+void SpriteCompositor::setResampling(Resampler::Filter resampleFilter) {
+    resampling = true;
+    filter = resampleFilter;
+    resampled.clear();
+    resampledBytes = 0;
+}
+
+void SpriteCompositor::releaseImage(const DecodedImage& image) {
+    images.erase(&image);
+    for (auto it = resampled.begin(); it != resampled.end();) {
+        if (it->first.image == &image) {
+            resampledBytes -= it->second->texels.size() * sizeof(uint32_t);
+            it = resampled.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+bool SpriteCompositor::ResampledKey::operator<(const ResampledKey& other) const {
+    if (image != other.image) return image < other.image;
+    if (x != other.x) return x < other.x;
+    if (y != other.y) return y < other.y;
+    if (width != other.width) return width < other.width;
+    return height < other.height;
+}
+
+void SpriteCompositor::composeRow(int py) {
+    uint32_t* row = &pixels[(size_t)py * width];
+    std::fill(row, row + width, 0u);
+
+    for (const Layer& layer : layers) {
+        if (py < layer.minY || py > layer.maxY) continue;
+
+        const Level& level = *layer.level;
+        float t = py * layer.rowScale + layer.rowOffset;
+        int row0 = floorToInt(t);
+        uint16_t rowWeight = toWeight(t - row0);
+        int row1 = row0 + 1;
+        if (row0 < 0) {
+            row0 = row1 = 0;
+        } else if (row1 >= level.height) {
+            row0 = row1 = level.height - 1;
+        }
+        const uint32_t* source0 = &level.texels[(size_t)row0 * level.rowTexels];
+        const uint32_t* source1 = &level.texels[(size_t)row1 * level.rowTexels];
+        const int count = layer.maxX - layer.minX + 1;
+        uint32_t* target = row + layer.minX;
+#ifdef SPRITE_COMPOSITOR_SSE2
+        const __m128i tint = unpackTexel(layer.tint);
+#else
+        const uint32_t tint = layer.tint;
+#endif
+
+        if (layer.exact) {
+            const uint32_t* source = source0 + layer.columns[0];
+            for (int i = 0; i < count; ++i) {
+                uint32_t alpha = source[i] >> 24;
+                if (alpha == 0) continue;
+                if (!layer.tinted && alpha == 255) {
+                    target[i] = source[i];
+                    continue;
+                }
+
+                auto color = unpackTexel(source[i]);
+                if (layer.tinted) {
+                    color = applyTint(color, tint);
+                }
+                target[i] = alpha == 255 ? packTexel(color) : blendOver(color, target[i]);
+            }
+            continue;
+        }
+
+#ifdef SPRITE_COMPOSITOR_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i rowWeights0 = _mm_set1_epi16((short)(256 - rowWeight));
+        const __m128i rowWeights1 = _mm_set1_epi16((short)rowWeight);
+        for (int i = 0; i < count; ++i) {
+            const uint32_t* top = source0 + layer.columns[i];
+            const uint32_t* bottom = source1 + layer.columns[i];
+            // Sprites are mostly empty around the item; premultiplied, empty is all zero
+            __m128i any = _mm_or_si128(_mm_loadl_epi64((const __m128i*)top), _mm_loadl_epi64((const __m128i*)bottom));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(any, zero)) == 0xFFFF) continue;
+
+            __m128i color = sampleBilinear(top, bottom, rowWeights0, rowWeights1, layer.columnWeights[i]);
+            if (layer.tinted) {
+                color = applyTint(color, tint);
+            }
+            target[i] = blendOver(color, target[i]);
+        }
+#else
+        for (int i = 0; i < count; ++i) {
+            const uint32_t* top = source0 + layer.columns[i];
+            const uint32_t* bottom = source1 + layer.columns[i];
+            if ((top[0] | top[1] | bottom[0] | bottom[1]) == 0) continue;
+
+            uint32_t color = sampleBilinear(top, bottom, rowWeight, layer.columnWeights[i]);
+            if (layer.tinted) {
+                color = applyTint(color, tint);
+            }
+            target[i] = blendOver(color, target[i]);
+        }
+#endif
+    }
+
+    for (int px = 0; px < width; ++px) {
+        row[px] = unpremultiply(row[px]);
+    }
+}
+
+void SpriteCompositor::flush() {
+    // Rows only read layers and write themselves, so threads share just the counter
+    std::atomic<int> nextBand(0);
+    const int bandCount = (height + BAND_ROWS - 1) / BAND_ROWS;
+    auto work = [&]() {
+        for (int band = nextBand++; band < bandCount; band = nextBand++) {
+            int end = std::min(height, (band + 1) * BAND_ROWS);
+            for (int py = band * BAND_ROWS; py < end; ++py) {
+                composeRow(py);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < std::min(threads, bandCount); ++i) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    layers.clear();
+}
+
+const unsigned char* SpriteCompositor::getPixels() const {
+    return (const unsigned char*)&pixels[(size_t)(height - 1) * width];
+}
+
+ptrdiff_t SpriteCompositor::getStride() const {
+    return -(ptrdiff_t)width * 4;
+}
+
+int SpriteCompositor::getWidth() const {
+    return width;
+}
+
+int SpriteCompositor::getHeight() const {
+    return height;
+}
@@ -0,0 +1,116 @@
+#ifndef SPRITE_COMPOSITOR_H
+#define SPRITE_COMPOSITOR_H
+
+#include "ImageStore.h"
+#include "Resampler.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Stacks RGBA images into one picture on the CPU: each layer is an image scaled into a
+// rectangle, blended with premultiplied alpha-over in the order it was added. Meant for
+// thumbnails made of sprite layers, with no GL context involved.
+//
+// Images are premultiplied and mipmapped once, then every layer is scaled bilinearly
+// from the level closest above its size, so strong reductions do not alias. Rows are
+// independent and composed in bands on up to N threads; filtering and blending use SSE2
+// on 16-bit channels, with a scalar fallback.
+//
+// Coordinates are pixels with the origin at the bottom-left, the same orientation as
+// DecodedImage rows and the GL framebuffer.
+class SpriteCompositor {
+public:
+    SpriteCompositor();
+
+    // threads is the number of threads flush() uses, including the calling one
+    bool create(int width, int height, int threads = 1);
+
+    // Starts a new picture: removes all layers, the image cache stays
+    void clear();
+
+    // image is drawn into [x, x + width) x [y, y + height); pixels whose center lies in the
+    // rectangle are covered. The image must stay valid until flush(). A tint (RGB in [0, 1])
+    // multiplies the color channels, so one white mask can be drawn in any color.
+    void addLayer(const DecodedImage& image, float x, float y, float width, float height, const float* tint = nullptr);
+
+    // Prepared copies are kept per image address; call this when an image's pixels change
+    // or before it is destroyed
+    void releaseImage(const DecodedImage& image);
+
+    // Downscaled layers are then prefiltered with filter onto the pixels they cover, once
+    // per image and placement, instead of sampled bilinearly from the mip levels
+    void setResampling(Resampler::Filter filter);
+
+    // Composes all layers onto a transparent background; the result has straight alpha
+    void flush();
+
+    // RGBA8 pixels, bottom row first in memory: getPixels() is the top row and getStride()
+    // is negative, as with SoftwareRasterizer and ReadbackQueue
+    const unsigned char* getPixels() const;
+    ptrdiff_t getStride() const;
+    int getWidth() const;
+    int getHeight() const;
+
+private:
+    static const int BAND_ROWS = 16;
+    static const size_t MAX_RESAMPLED_BYTES = 64 * 1024 * 1024;
+
+    // Premultiplied RGBA8; every row has one extra texel repeating the last one, so a
+    // bilinear pair can always be read with one 64-bit load
+    struct Level {
+        int width;
+        int height;
+        int rowTexels;
+        std::vector<uint32_t> texels;
+    };
+
+    // Levels are halved only as far as some layer needed; a deque keeps their addresses
+    struct Image {
+        std::deque<Level> levels;
+    };
+
+    struct Layer {
+        const Level* level;
+        int minX, maxX;                 // Covered pixels, inclusive
+        int minY, maxY;
+        float rowScale;                 // Source rows per target row
+        float rowOffset;                // Source row (texel centers) of target row 0
+        std::vector<int> columns;       // Left source texel per covered pixel
+        std::vector<uint16_t> columnWeights;   // Weight of the right texel, 0-256
+        bool exact;                     // Texels land on pixels one to one, no filtering
+        bool tinted;
+        uint32_t tint;                  // RGBA8 multiplier, alpha 255
+    };
+
+    struct ResampledKey {
+        const DecodedImage* image;
+        float x, y, width, height;
+
+        bool operator<(const ResampledKey& other) const;
+    };
+
+    Image* getImage(const DecodedImage& image);
+    const Level* getLevel(Image* image, float layerWidth, float layerHeight);
+    const Level* getResampled(const DecodedImage& image, Image* prepared, float x, float y, float layerWidth, float layerHeight);
+    void composeRow(int y);
+
+    int width;
+    int height;
+    int threads;
+    std::vector<uint32_t> pixels;
+    std::vector<Layer> layers;
+    std::unordered_map<const DecodedImage*, std::unique_ptr<Image>> images;
+    bool resampling;
+    Resampler::Filter filter;
+    std::map<ResampledKey, std::unique_ptr<Level>> resampled;
+    size_t resampledBytes;
+
+    SpriteCompositor(const SpriteCompositor&) = delete;
+    SpriteCompositor& operator=(const SpriteCompositor&) = delete;
+};
+
+#endif
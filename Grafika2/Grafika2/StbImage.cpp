@@ -0,0 +1,3 @@
+// The single translation unit that compiles stb_image, shared by every target
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
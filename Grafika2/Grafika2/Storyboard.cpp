@@ -0,0 +1,311 @@
+#include "Storyboard.h"
+#include "AvatarGeometry.h"
+#include <algorithm>
+#include <cmath>
+
+Storyboard::Storyboard(const SlotRegistry& slots, Shader& bodyShader, Shader& spriteShader)
+    : slots(slots), bodyShader(bodyShader), spriteShader(spriteShader), file(slots), columns(0), panelWidth(320), panelHeight(240),
+      gutter(16), budget((size_t)256 << 20), historyBudget((size_t)1 << 20), cachedBytes(0), drawIndex(0), framebuffer(0) {
+    stats = { 0, 0, 0, 0, 0 };
+    setPanelColor(1.0f, 1.0f, 1.0f);
+    glGenFramebuffers(1, &framebuffer);
+
+    // One quad over the whole NDC square, placed on each panel by viewTransform
+    using namespace AvatarGeometry;
+    float quad[SPRITE_FLOATS_PER_QUAD];
+    writeSpriteQuad({ 0.0f, 0.0f, 2.0f, 2.0f }, quad);
+    glGenVertexArrays(1, &quadVAO);
+    glGenBuffers(1, &quadVBO);
+    glBindVertexArray(quadVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    transformLocation = glGetUniformLocation(spriteShader.getID(), "viewTransform");
+    textureLocation = glGetUniformLocation(spriteShader.getID(), "texture1");
+}
+
+Storyboard::~Storyboard() {
+    clear();
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteVertexArrays(1, &quadVAO);
+    glDeleteBuffers(1, &quadVBO);
+}
+
+void Storyboard::setLayout(int columnCount, int width, int height, int gutterSize) {
+    for (int i = 0; i < (int)panels.size(); ++i) {
+        releaseTexture(i);
+    }
+    columns = columnCount;
+    panelWidth = std::max(1, width);
+    panelHeight = std::max(1, height);
+    gutter = std::max(0, gutterSize);
+}
+
+void Storyboard::setPanelColor(float r, float g, float b) {
+    panelColor[0] = r;
+    panelColor[1] = g;
+    panelColor[2] = b;
+    // Cached panels show the old color
+    for (int i = 0; i < (int)panels.size(); ++i) {
+        releaseTexture(i);
+    }
+}
+
+void Storyboard::setCacheBudget(size_t bytes) {
+    budget = bytes;
+    trimCache();
+}
+
+Scene& Storyboard::addPanel() {
+    Panel panel;
+    panel.scene.reset(new Scene(slots, bodyShader, spriteShader, &textures));
+    panel.filePanel = -1;
+    panel.savedRevision = 0;
+    panel.texture = 0;
+    panel.revision = 0;
+    panel.lastDrawn = 0;
+    createHistory(panel);
+    panels.push_back(std::move(panel));
+    return *panels.back().scene;
+}
+
+Scene& Storyboard::getPanel(int index) {
+    if (!panels[index].scene) loadPanel(index);
+    return *panels[index].scene;
+}
+
+SceneHistory& Storyboard::getHistory(int index) {
+    if (!panels[index].scene) loadPanel(index);
+    return *panels[index].history;
+}
+
+void Storyboard::setHistoryBudget(size_t bytes) {
+    historyBudget = bytes;
+    for (Panel& panel : panels) {
+        if (panel.history) panel.history->setBudget(bytes);
+    }
+}
+
+void Storyboard::createHistory(Panel& panel) {
+    panel.history.reset(new SceneHistory(*panel.scene, historyBudget));
+}
+
+int Storyboard::getPanelCount() const {
+    return (int)panels.size();
+}
+
+TextureRegistry& Storyboard::getTextures() {
+    return textures;
+}
+
+void Storyboard::clear() {
+    for (int i = 0; i < (int)panels.size(); ++i) {
+        releaseTexture(i);
+    }
+    panels.clear();
+    file.close();
+}
+
+bool Storyboard::open(const std::string& path) {
+    clear();
+    if (!file.open(path)) return false;
+    const StoryboardFile::Layout& layout = file.getLayout();
+    setLayout(layout.columns, layout.panelWidth, layout.panelHeight, layout.gutter);
+    setPanelColor(layout.panelColor[0], layout.panelColor[1], layout.panelColor[2]);
+    // Placeholders only, nothing of a panel is read before it is needed
+    panels.resize(file.getPanelCount());
+    for (int i = 0; i < (int)panels.size(); ++i) {
+        panels[i].filePanel = i;
+        panels[i].savedRevision = 0;
+        panels[i].texture = 0;
+        panels[i].revision = 0;
+        panels[i].lastDrawn = 0;
+    }
+    return true;
+}
+
+bool Storyboard::save(const std::string& path) {
+    // Panels never read cannot have changed
+    std::vector<StoryboardFile::PanelSource> sources(panels.size());
+    for (size_t i = 0; i < panels.size(); ++i) {
+        const Panel& panel = panels[i];
+        const bool changed = panel.filePanel < 0 || (panel.scene && panel.scene->getRevision() != panel.savedRevision);
+        sources[i].scene = changed ? panel.scene.get() : nullptr;
+        sources[i].filePanel = panel.filePanel;
+    }
+    const StoryboardFile::Layout layout = { columns, panelWidth, panelHeight, gutter, { panelColor[0], panelColor[1], panelColor[2] } };
+    if (!file.save(path, layout, sources, textures)) return false;
+    for (int i = 0; i < (int)panels.size(); ++i) {
+        panels[i].filePanel = i;
+        if (panels[i].scene) panels[i].savedRevision = panels[i].scene->getRevision();
+    }
+    return true;
+}
+
+void Storyboard::loadPanel(int index) {
+    Panel& panel = panels[index];
+    panel.scene.reset(new Scene(slots, bodyShader, spriteShader, &textures));
+    // A damaged panel is reported and stays empty
+    file.readPanel(panel.filePanel, *panel.scene);
+    panel.savedRevision = panel.scene->getRevision();
+    // What was read is the first step, not an edit
+    createHistory(panel);
+    ++stats.loadedPanels;
+}
+
+int Storyboard::getColumns() const {
+    return columns > 0 ? columns : std::max(1, (int)panels.size());
+}
+
+int Storyboard::getBoardWidth() const {
+    const int count = std::min(getColumns(), (int)panels.size());
+    return count > 0 ? count * (panelWidth + gutter) - gutter : 0;
+}
+
+int Storyboard::getBoardHeight() const {
+    const int rows = ((int)panels.size() + getColumns() - 1) / getColumns();
+    return rows > 0 ? rows * (panelHeight + gutter) - gutter : 0;
+}
+
+const Storyboard::DrawStats& Storyboard::getStats() const {
+    return stats;
+}
+
+void Storyboard::releaseTexture(int index) {
+    Panel& panel = panels[index];
+    if (panel.texture == 0) return;
+    glDeleteTextures(1, &panel.texture);
+    panel.texture = 0;
+    recent.erase(panel.position);
+    // With mipmaps, a third more than the base level
+    cachedBytes -= (size_t)panelWidth * panelHeight * 4 * 4 / 3;
+}
+
+void Storyboard::trimCache() {
+    // Panels shown by the last draw stay, whatever the budget
+    while (cachedBytes > budget && !recent.empty() && panels[recent.back()].lastDrawn != drawIndex) {
+        releaseTexture(recent.back());
+    }
+}
+
+void Storyboard::renderPanel(int index) {
+    Panel& panel = panels[index];
+    if (panel.texture == 0) {
+        glGenTextures(1, &panel.texture);
+        glBindTexture(GL_TEXTURE_2D, panel.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, panelWidth, panelHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        recent.push_front(index);
+        panel.position = recent.begin();
+        cachedBytes += (size_t)panelWidth * panelHeight * 4 * 4 / 3;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, panel.texture, 0);
+    glViewport(0, 0, panelWidth, panelHeight);
+    glClearColor(panelColor[0], panelColor[1], panelColor[2], 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    panel.scene->draw();
+    // Blending sprites leaves alpha below 1 at their edges; the panel is opaque
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_TRUE);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+    glBindTexture(GL_TEXTURE_2D, panel.texture);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    // Items still short of detail leave the panel stale, so it is rendered again next draw
+    panel.revision = panel.scene->getRevision();
+    if (panel.scene->getStats().pendingTextures > 0) --panel.revision;
+    ++stats.renderedPanels;
+}
+
+void Storyboard::draw(float x, float y, float width, float height) {
+    ++drawIndex;
+    stats = { 0, 0, 0, 0, 0 };
+    if (panels.empty() || width <= 0.0f || height <= 0.0f) return;
+
+    // Rows and columns that can intersect the view, straight from the layout
+    const int columnCount = getColumns();
+    const int rowCount = ((int)panels.size() + columnCount - 1) / columnCount;
+    const float strideX = (float)(panelWidth + gutter);
+    const float strideY = (float)(panelHeight + gutter);
+    const int firstColumn = std::max(0, (int)std::floor(x / strideX));
+    const int lastColumn = std::min(columnCount - 1, (int)std::floor((x + width) / strideX));
+    const int firstRow = std::max(0, (int)std::floor(y / strideY));
+    const int lastRow = std::min(rowCount - 1, (int)std::floor((y + height) / strideY));
+
+    visible.clear();
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int column = firstColumn; column <= lastColumn; ++column) {
+            const int index = row * columnCount + column;
+            if (index >= (int)panels.size()) break;
+            const float left = column * strideX;
+            const float top = row * strideY;
+            // The view may only reach into the gutter after the panel
+            if (left >= x + width || left + panelWidth <= x || top >= y + height || top + panelHeight <= y) continue;
+            visible.push_back(index);
+        }
+    }
+    stats.visiblePanels = (int)visible.size();
+
+    // Stale or missing textures first, so the panel quads are drawn without target switches
+    bool rendering = false;
+    GLint previousFramebuffer = 0;
+    GLint viewport[4];
+    GLfloat clearColor[4];
+    for (int index : visible) {
+        Panel& panel = panels[index];
+        panel.lastDrawn = drawIndex;
+        if (!panel.scene) loadPanel(index);
+        if (panel.texture != 0) {
+            recent.splice(recent.begin(), recent, panel.position);
+            if (panel.revision == panel.scene->getRevision()) continue;
+        }
+        if (!rendering) {
+            rendering = true;
+            glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+            glGetIntegerv(GL_VIEWPORT, viewport);
+            glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+        }
+        renderPanel(index);
+    }
+    if (rendering) {
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    }
+    trimCache();
+
+    // Panels are opaque: no blending
+    glUseProgram(spriteShader.getID());
+    glUniform1i(textureLocation, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(quadVAO);
+    for (int index : visible) {
+        const int row = index / columnCount;
+        const int column = index % columnCount;
+        const float transform[4] = {
+            panelWidth / width, panelHeight / height,
+            -1.0f + (2.0f * (column * strideX - x) + panelWidth) / width,
+            1.0f - (2.0f * (row * strideY - y) + panelHeight) / height
+        };
+        glUniform4fv(transformLocation, 1, transform);
+        glBindTexture(GL_TEXTURE_2D, panels[index].texture);
+        glDrawArrays(GL_TRIANGLES, 0, AvatarGeometry::SPRITE_VERTICES_PER_QUAD);
+    }
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+
+    stats.cachedPanels = (int)recent.size();
+    stats.cachedBytes = cachedBytes;
+}
@@ -0,0 +1,127 @@
+#ifndef STORYBOARD_H
+#define STORYBOARD_H
+
+#include "Scene.h"
+#include "SceneHistory.h"
+#include "Shader.h"
+#include "SlotRegistry.h"
+#include "StoryboardFile.h"
+#include "TextureRegistry.h"
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <vector>
+
+// Panels of a storyboard, each one a Scene, laid out as a grid (or a single strip) on a
+// board measured in pixels from its top-left corner. draw() shows one rectangle of the
+// board: only the panels intersecting it are touched, found from the grid arithmetic
+// rather than a scan. Each panel keeps its last rendering in a texture of its own and is
+// re-rendered only when its scene's revision changes, so scrolling costs one textured quad
+// per visible panel. Panel textures are kept within a memory budget, the least recently
+// shown ones being dropped first; panels on screen are kept even past it.
+// A board opened from a StoryboardFile reads each panel's scene from the mapped file the
+// first time the panel is drawn or asked for, and saving writes only the panels changed since.
+// Each panel's scene has a SceneHistory of its own from the time the scene is made or read.
+class Storyboard {
+public:
+    // Counters of the last draw()
+    struct DrawStats {
+        int visiblePanels;
+        int renderedPanels;     // Panels whose texture had to be (re)rendered
+        int cachedPanels;
+        size_t cachedBytes;
+        int loadedPanels;       // Panels read from the file
+    };
+
+    // All panel scenes share one TextureRegistry and the two avatar shaders
+    Storyboard(const SlotRegistry& slots, Shader& bodyShader, Shader& spriteShader);
+    ~Storyboard();
+
+    // Panels of panelWidth x panelHeight pixels, gutter pixels apart, filling rows of columns
+    // panels; columns <= 0 puts every panel in one horizontal strip. Drops the cached textures.
+    void setLayout(int columns, int panelWidth, int panelHeight, int gutter);
+    // Panels are opaque, cleared to this color before their scene is drawn. Drops the cached
+    // textures.
+    void setPanelColor(float r, float g, float b);
+    // Bytes of panel textures kept for reuse (RGBA8, 4 bytes a pixel)
+    void setCacheBudget(size_t bytes);
+
+    // References stay valid until clear()
+    Scene& addPanel();
+    // Reads the panel first if it is still in the file
+    Scene& getPanel(int index);
+    // Undo and redo of the panel's scene, reading the panel first like getPanel(). Clearing
+    // a panel's scene invalidates its history; reset() it too.
+    SceneHistory& getHistory(int index);
+    // Bytes each panel's history keeps at most
+    void setHistoryBudget(size_t bytes);
+    int getPanelCount() const;
+    void clear();
+    // Item textures of every panel; with an upload budget, panels drawn before their items
+    // reach full detail are rendered again on later draws as the detail streams in
+    TextureRegistry& getTextures();
+
+    // Replaces the board with the one in path, layout and panel color included. Panels are
+    // read when first needed, so opening a board costs the same whatever its size.
+    bool open(const std::string& path);
+    // Saves the board; to the file it was opened from or last saved to, only panels added
+    // or changed since are written
+    bool save(const std::string& path);
+
+    int getBoardWidth() const;
+    int getBoardHeight() const;
+
+    // Draws the board rectangle at (x, y), width x height board pixels, into the current
+    // viewport, which it fills. Not const: panels are rendered on demand.
+    void draw(float x, float y, float width, float height);
+    const DrawStats& getStats() const;
+
+private:
+    struct Panel {
+        std::unique_ptr<Scene> scene;   // Null until read from the file
+        std::unique_ptr<SceneHistory> history;  // Of scene, made along with it
+        int filePanel;                  // Panel in the file, -1 if the panel is new
+        uint32_t savedRevision;         // Scene revision when read or saved
+        GLuint texture;             // 0 while not cached
+        uint32_t revision;          // Scene revision the texture shows
+        uint64_t lastDrawn;         // draw() the panel was last visible in
+        std::list<int>::iterator position;
+    };
+
+    void loadPanel(int index);
+    void createHistory(Panel& panel);
+    void renderPanel(int index);
+    void releaseTexture(int index);
+    void trimCache();
+    int getColumns() const;
+
+    const SlotRegistry& slots;
+    Shader& bodyShader;
+    Shader& spriteShader;
+    TextureRegistry textures;
+    StoryboardFile file;
+    std::vector<Panel> panels;
+    std::list<int> recent;          // Cached panels, most recently shown first
+    std::vector<int> visible;       // Panels of the current draw
+    int columns;
+    int panelWidth;
+    int panelHeight;
+    int gutter;
+    float panelColor[3];
+    size_t budget;
+    size_t historyBudget;
+    size_t cachedBytes;
+    uint64_t drawIndex;
+    DrawStats stats;
+
+    GLuint framebuffer;             // Panel textures are attached in turn
+    GLuint quadVAO, quadVBO;
+    GLint transformLocation, textureLocation;
+
+    Storyboard(const Storyboard&) = delete;
+    Storyboard& operator=(const Storyboard&) = delete;
+};
+
+#endif
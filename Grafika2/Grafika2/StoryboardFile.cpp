@@ -0,0 +1,421 @@
+#include "StoryboardFile.h"
+#include "Scene.h"
+#include "TextureRegistry.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    const char MAGIC[8] = { 'A', 'V', 'B', 'O', 'A', 'R', 'D', '\0' };
+    const size_t HEADER_SIZE = 64;
+    const size_t DIRECTORY_FIXED_SIZE = 48;
+    const size_t TABLE_ENTRY_SIZE = 16;
+    const size_t PANEL_HEADER_SIZE = 8;
+    const size_t AVATAR_FIXED_SIZE = 48;
+    const uint16_t NO_ASSET = 0xFFFF;
+    const float COLOR_SCALE = 4096.0f;     // Colors are 4.12 fixed point, avatar palettes go past 1
+    const uint16_t FLAG_MIRRORED = 1;
+    const uint16_t FLAG_VISIBLE = 2;
+
+    // Fields are stored in host order, which is little-endian on every platform built for
+    template <typename T>
+    T get(const unsigned char* data) {
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    void put(unsigned char* data, T value) {
+        std::memcpy(data, &value, sizeof(T));
+    }
+
+    size_t getAvatarSize(size_t slotCount) {
+        return (AVATAR_FIXED_SIZE + 2 * slotCount + 3) & ~(size_t)3;
+    }
+
+    // Length-prefixed strings at the end of the directory
+    bool readString(const unsigned char* data, size_t size, size_t& position, std::string& out) {
+        if (size - position < 2) return false;
+        const size_t length = get<uint16_t>(data + position);
+        if (size - position - 2 < length) return false;
+        out.assign((const char*)data + position + 2, length);
+        position += 2 + length;
+        return true;
+    }
+
+    void writeString(const std::string& text, std::vector<unsigned char>& out) {
+        const uint16_t length = (uint16_t)std::min(text.size(), (size_t)0xFFFF);
+        out.resize(out.size() + 2);
+        put<uint16_t>(&out[out.size() - 2], length);
+        out.insert(out.end(), text.begin(), text.begin() + length);
+    }
+
+    void encodeHeader(uint64_t directoryOffset, uint64_t directorySize, unsigned char* out) {
+        std::memset(out, 0, HEADER_SIZE);
+        std::memcpy(out, MAGIC, sizeof(MAGIC));
+        put<uint32_t>(out + 8, StoryboardFile::VERSION);
+        put<uint32_t>(out + 12, (uint32_t)HEADER_SIZE);
+        put<uint64_t>(out + 16, directoryOffset);
+        put<uint64_t>(out + 24, directorySize);
+    }
+}
+
+StoryboardFile::StoryboardFile(const SlotRegistry& slots) : slots(slots) {
+    close();
+}
+
+bool StoryboardFile::open(const std::string& requestedPath) {
+    const std::string filePath = requestedPath;    // May be getPath(), which close() clears
+    close();
+    if (!file.open(filePath)) return false;
+    const unsigned char* data = file.getData();
+    const size_t size = file.getSize();
+    if (size < HEADER_SIZE || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+        std::cerr << filePath << " is not a storyboard file" << std::endl;
+        close();
+        return false;
+    }
+    const uint32_t version = get<uint32_t>(data + 8);
+    if (version != VERSION || get<uint32_t>(data + 12) != HEADER_SIZE) {
+        std::cerr << filePath << ": unsupported storyboard version " << version << std::endl;
+        close();
+        return false;
+    }
+    const uint64_t directoryOffset = get<uint64_t>(data + 16);
+    directorySize = get<uint64_t>(data + 24);
+    if (directoryOffset < HEADER_SIZE || directorySize < DIRECTORY_FIXED_SIZE || directoryOffset > size ||
+        directorySize > size - directoryOffset) {
+        std::cerr << filePath << ": directory out of bounds" << std::endl;
+        close();
+        return false;
+    }
+
+    const unsigned char* directory = data + directoryOffset;
+    const uint32_t count = get<uint32_t>(directory);
+    layout.columns = get<int32_t>(directory + 4);
+    layout.panelWidth = get<int32_t>(directory + 8);
+    layout.panelHeight = get<int32_t>(directory + 12);
+    layout.gutter = get<int32_t>(directory + 16);
+    for (int i = 0; i < 3; ++i) {
+        layout.panelColor[i] = get<float>(directory + 20 + i * 4);
+    }
+    const uint32_t slotCount = get<uint32_t>(directory + 32);
+    const uint32_t assetCount = get<uint32_t>(directory + 36);
+    recordBytes = get<uint64_t>(directory + 40);
+
+    // The table is left in the mapping; only the strings are read now
+    bool valid = count <= (directorySize - DIRECTORY_FIXED_SIZE) / TABLE_ENTRY_SIZE;
+    size_t position = DIRECTORY_FIXED_SIZE + (size_t)count * TABLE_ENTRY_SIZE;
+    slotNames.resize(valid ? slotCount : 0);
+    for (size_t i = 0; valid && i < slotNames.size(); ++i) {
+        valid = readString(directory, (size_t)directorySize, position, slotNames[i]);
+    }
+    assets.resize(valid ? assetCount : 0);
+    for (size_t i = 0; valid && i < assets.size(); ++i) {
+        valid = readString(directory, (size_t)directorySize, position, assets[i]);
+    }
+    if (!valid) {
+        std::cerr << filePath << ": damaged directory" << std::endl;
+        close();
+        return false;
+    }
+    panelCount = (int)count;
+    tableOffset = (size_t)directoryOffset + DIRECTORY_FIXED_SIZE;
+    path = filePath;
+
+    slotMap.assign(slotNames.size(), -1);
+    for (size_t i = 0; i < slotNames.size(); ++i) {
+        slotMap[i] = slots.findSlot(slotNames[i]);
+        if (slotMap[i] >= 0) fileSlots[slotMap[i]] = (int)i;
+    }
+    return true;
+}
+
+void StoryboardFile::close() {
+    file.close();
+    path.clear();
+    layout = { 0, 320, 240, 16, { 1.0f, 1.0f, 1.0f } };
+    panelCount = 0;
+    tableOffset = 0;
+    directorySize = 0;
+    recordBytes = 0;
+    slotNames.clear();
+    assets.clear();
+    slotMap.clear();
+    fileSlots.assign(slots.getSlotCount(), -1);
+}
+
+bool StoryboardFile::isOpen() const {
+    return file.isOpen();
+}
+
+const std::string& StoryboardFile::getPath() const {
+    return path;
+}
+
+const StoryboardFile::Layout& StoryboardFile::getLayout() const {
+    return layout;
+}
+
+int StoryboardFile::getPanelCount() const {
+    return panelCount;
+}
+
+size_t StoryboardFile::getFileSize() const {
+    return file.getSize();
+}
+
+size_t StoryboardFile::getDeadBytes() const {
+    return isOpen() ? file.getSize() - (size_t)(HEADER_SIZE + recordBytes + directorySize) : 0;
+}
+
+StoryboardFile::TableEntry StoryboardFile::getEntry(int panel) const {
+    const unsigned char* entry = file.getData() + tableOffset + (size_t)panel * TABLE_ENTRY_SIZE;
+    return { get<uint64_t>(entry), get<uint32_t>(entry + 8), get<uint32_t>(entry + 12) };
+}
+
+bool StoryboardFile::readPanel(int panel, Scene& scene) const {
+    if (panel < 0 || panel >= panelCount) return false;
+    const TableEntry entry = getEntry(panel);
+    const size_t size = file.getSize();
+    const unsigned char* record = file.getData() + entry.offset;
+    bool valid = entry.size >= PANEL_HEADER_SIZE && entry.offset <= size && entry.size <= size - entry.offset &&
+                 get<uint32_t>(record) == entry.avatarCount && get<uint32_t>(record + 4) <= slotNames.size();
+    const size_t slotCount = valid ? get<uint32_t>(record + 4) : 0;
+    const size_t avatarSize = getAvatarSize(slotCount);
+    valid = valid && (entry.size - PANEL_HEADER_SIZE) / avatarSize == entry.avatarCount &&
+            (entry.size - PANEL_HEADER_SIZE) % avatarSize == 0;
+    for (uint32_t i = 0; valid && i < entry.avatarCount; ++i) {
+        const unsigned char* assetIds = record + PANEL_HEADER_SIZE + i * avatarSize + AVATAR_FIXED_SIZE;
+        for (size_t slot = 0; slot < slotCount; ++slot) {
+            const uint16_t id = get<uint16_t>(assetIds + slot * 2);
+            if (id != NO_ASSET && id >= assets.size()) valid = false;
+        }
+    }
+    if (!valid) {
+        std::cerr << path << ": panel " << panel << " is damaged" << std::endl;
+        return false;
+    }
+
+    for (uint32_t i = 0; i < entry.avatarCount; ++i) {
+        const unsigned char* data = record + PANEL_HEADER_SIZE + i * avatarSize;
+        SceneAvatar& avatar = scene.addAvatar();
+        for (size_t slot = 0; slot < slotCount; ++slot) {
+            if (slotMap[slot] >= 0) avatar.clearSlot(slotMap[slot]);
+        }
+        for (size_t slot = 0; slot < slotCount; ++slot) {
+            const uint16_t id = get<uint16_t>(data + AVATAR_FIXED_SIZE + slot * 2);
+            if (id != NO_ASSET && slotMap[slot] >= 0) avatar.applySlot(slotMap[slot], avatar.loadTextureCached(assets[id]));
+        }
+        for (int color = 0; color < Avatar::COLOR_COUNT; ++color) {
+            const unsigned char* channels = data + 18 + color * 6;
+            avatar.setColor((Avatar::AvatarColor)color, get<uint16_t>(channels) / COLOR_SCALE, get<uint16_t>(channels + 2) / COLOR_SCALE,
+                            get<uint16_t>(channels + 4) / COLOR_SCALE);
+        }
+        const uint16_t flags = get<uint16_t>(data + 16);
+        avatar.setTransform(get<float>(data), get<float>(data + 4), get<float>(data + 8), (flags & FLAG_MIRRORED) != 0);
+        avatar.setDepth(get<int32_t>(data + 12));
+        avatar.setVisible((flags & FLAG_VISIBLE) != 0);
+    }
+    return true;
+}
+
+int StoryboardFile::getAssetId(GLuint texture) {
+    auto known = texturePaths.find(texture);
+    if (known == texturePaths.end()) return -1;
+    auto found = assetIds.find(known->second);
+    if (found != assetIds.end()) return found->second;
+    if (assets.size() >= NO_ASSET) return -1;
+    assets.push_back(known->second);
+    assetIds[known->second] = (int)assets.size() - 1;
+    return (int)assets.size() - 1;
+}
+
+void StoryboardFile::encodePanel(const Scene& scene, std::vector<unsigned char>& out) {
+    const size_t slotCount = slotNames.size();
+    const size_t avatarSize = getAvatarSize(slotCount);
+    const int count = scene.getAvatarCount();
+    const size_t start = out.size();
+    out.resize(start + PANEL_HEADER_SIZE + count * avatarSize, 0);
+    put<uint32_t>(&out[start], (uint32_t)count);
+    put<uint32_t>(&out[start + 4], (uint32_t)slotCount);
+    for (int i = 0; i < count; ++i) {
+        const SceneAvatar& avatar = scene.avatars[i];
+        unsigned char* data = &out[start + PANEL_HEADER_SIZE + i * avatarSize];
+        // setTransform keeps the scale in y and mirrors by negating x
+        put<float>(data, avatar.transform[2]);
+        put<float>(data + 4, avatar.transform[3]);
+        put<float>(data + 8, avatar.transform[1]);
+        put<int32_t>(data + 12, avatar.depth);
+        put<uint16_t>(data + 16, (uint16_t)((avatar.transform[0] < 0.0f ? FLAG_MIRRORED : 0) | (avatar.visible ? FLAG_VISIBLE : 0)));
+        for (int color = 0; color < Avatar::COLOR_COUNT; ++color) {
+            for (int channel = 0; channel < 3; ++channel) {
+                const float value = std::round(avatar.colors[color][channel] * COLOR_SCALE);
+                put<uint16_t>(data + 18 + color * 6 + channel * 2, (uint16_t)std::min(65535.0f, std::max(0.0f, value)));
+            }
+        }
+        for (size_t slot = 0; slot < slotCount; ++slot) {
+            int id = -1;
+            if (slotMap[slot] >= 0 && (avatar.occupiedSlots & (1u << slotMap[slot])) != 0) {
+                id = getAssetId(avatar.slotTextures[slotMap[slot]]);
+            }
+            put<uint16_t>(data + AVATAR_FIXED_SIZE + slot * 2, id >= 0 ? (uint16_t)id : NO_ASSET);
+        }
+    }
+}
+
+void StoryboardFile::encodeDirectory(const Layout& newLayout, const std::vector<TableEntry>& table, std::vector<unsigned char>& out) const {
+    out.assign(DIRECTORY_FIXED_SIZE + table.size() * TABLE_ENTRY_SIZE, 0);
+    put<uint32_t>(&out[0], (uint32_t)table.size());
+    put<int32_t>(&out[4], newLayout.columns);
+    put<int32_t>(&out[8], newLayout.panelWidth);
+    put<int32_t>(&out[12], newLayout.panelHeight);
+    put<int32_t>(&out[16], newLayout.gutter);
+    for (int i = 0; i < 3; ++i) {
+        put<float>(&out[20 + i * 4], newLayout.panelColor[i]);
+    }
+    put<uint32_t>(&out[32], (uint32_t)slotNames.size());
+    put<uint32_t>(&out[36], (uint32_t)assets.size());
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < table.size(); ++i) {
+        unsigned char* entry = &out[DIRECTORY_FIXED_SIZE + i * TABLE_ENTRY_SIZE];
+        put<uint64_t>(entry, table[i].offset);
+        put<uint32_t>(entry + 8, table[i].size);
+        put<uint32_t>(entry + 12, table[i].avatarCount);
+        bytes += table[i].size;
+    }
+    put<uint64_t>(&out[40], bytes);
+    for (const std::string& name : slotNames) {
+        writeString(name, out);
+    }
+    for (const std::string& asset : assets) {
+        writeString(asset, out);
+    }
+}
+
+bool StoryboardFile::save(const std::string& target, const Layout& newLayout, const std::vector<PanelSource>& panels,
+                          const TextureRegistry& textures) {
+    texturePaths.clear();
+    for (const auto& entry : textures.getEntries()) {
+        if (entry.second != 0) texturePaths[entry.second] = entry.first;
+    }
+    assetIds.clear();
+    for (size_t i = 0; i < assets.size(); ++i) {
+        assetIds[assets[i]] = (int)i;
+    }
+    // Slots new to the file go after the ones it has, so existing records keep their meaning
+    for (int slot = 0; slot < slots.getSlotCount(); ++slot) {
+        if (fileSlots[slot] >= 0) continue;
+        fileSlots[slot] = (int)slotNames.size();
+        slotNames.push_back(slots.getSlot(slot).name);
+        slotMap.push_back(slot);
+    }
+
+    // Changed panels are encoded up front, kept ones are referred to where they are
+    std::vector<unsigned char> records;
+    std::vector<TableEntry> table(panels.size());
+    uint64_t keptBytes = 0;
+    for (size_t i = 0; i < panels.size(); ++i) {
+        if (panels[i].scene != nullptr) {
+            const size_t start = records.size();
+            encodePanel(*panels[i].scene, records);
+            table[i] = { start, (uint32_t)(records.size() - start), (uint32_t)panels[i].scene->getAvatarCount() };
+            continue;
+        }
+        if (panels[i].filePanel < 0 || panels[i].filePanel >= panelCount) {
+            std::cerr << "Storyboard panel " << i << " has neither a scene nor a panel in " << path << std::endl;
+            return false;
+        }
+        table[i] = getEntry(panels[i].filePanel);
+        keptBytes += table[i].size;
+    }
+
+    std::vector<unsigned char> directory;
+    encodeDirectory(newLayout, table, directory);
+    bool append = false;
+    if (isOpen() && target == path) {
+        // Everything but the header, the records in use and the new directory is dead
+        const uint64_t total = file.getSize() + records.size() + directory.size();
+        const uint64_t live = HEADER_SIZE + keptBytes + records.size() + directory.size();
+        append = (total - live) * 2 <= total;
+    }
+
+    unsigned char header[HEADER_SIZE];
+    if (append) {
+        const uint64_t base = file.getSize();
+        for (size_t i = 0; i < panels.size(); ++i) {
+            if (panels[i].scene != nullptr) table[i].offset += base;
+        }
+        encodeDirectory(newLayout, table, directory);
+        std::fstream out(target, std::ios::in | std::ios::out | std::ios::binary);
+        if (!out) {
+            std::cerr << "Failed to open " << target << " for writing" << std::endl;
+            return false;
+        }
+        out.seekp((std::streamoff)base);
+        out.write((const char*)records.data(), records.size());
+        out.write((const char*)directory.data(), directory.size());
+        // The new directory is complete on disk before the header points at it
+        out.flush();
+        encodeHeader(base + records.size(), directory.size(), header);
+        out.seekp(0);
+        out.write((const char*)header, HEADER_SIZE);
+        out.flush();
+        if (!out) {
+            std::cerr << "Failed to append to " << target << std::endl;
+            return false;
+        }
+        out.close();
+        return open(target);
+    }
+
+    // Rewritten next to the target and moved over it, so a failed save loses nothing
+    const std::string temporary = target + ".tmp";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to open " << temporary << " for writing" << std::endl;
+        return false;
+    }
+    std::memset(header, 0, HEADER_SIZE);
+    out.write((const char*)header, HEADER_SIZE);
+    uint64_t offset = HEADER_SIZE;
+    for (size_t i = 0; i < panels.size() && out; ++i) {
+        if (panels[i].scene == nullptr && (table[i].offset > file.getSize() || table[i].size > file.getSize() - table[i].offset)) {
+            std::cerr << path << ": panel " << panels[i].filePanel << " is damaged" << std::endl;
+            out.close();
+            std::filesystem::remove(temporary);
+            return false;
+        }
+        const unsigned char* source = panels[i].scene != nullptr ? records.data() + table[i].offset : file.getData() + table[i].offset;
+        out.write((const char*)source, table[i].size);
+        table[i].offset = offset;
+        offset += table[i].size;
+    }
+    encodeDirectory(newLayout, table, directory);
+    out.write((const char*)directory.data(), directory.size());
+    encodeHeader(offset, directory.size(), header);
+    out.seekp(0);
+    out.write((const char*)header, HEADER_SIZE);
+    out.close();
+    if (!out) {
+        std::cerr << "Failed to write " << temporary << std::endl;
+        std::filesystem::remove(temporary);
+        return false;
+    }
+    // Windows cannot replace a mapped file
+    file.close();
+    std::error_code error;
+    std::filesystem::rename(temporary, target, error);
+    if (error) {
+        std::cerr << "Failed to replace " << target << ": " << error.message() << std::endl;
+        std::filesystem::remove(temporary, error);
+        const std::string previous = path;
+        if (!previous.empty()) open(previous);     // The previous file is still there
+        return false;
+    }
+    return open(target);
+}
@@ -0,0 +1,105 @@
+#ifndef STORYBOARD_FILE_H
+#define STORYBOARD_FILE_H
+
+#include "MappedFile.h"
+#include "SlotRegistry.h"
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Scene;
+class TextureRegistry;
+
+// Storyboards on disk, in a versioned little-endian binary format:
+//   header (64 bytes): magic "AVBOARD\0", version, header size, offset and size of the
+//     current directory
+//   panel records, each its avatar count and slot count followed by one fixed-size record per
+//     avatar: placement, depth, flags, colors as 16-bit fixed point and one asset id per slot
+//   directory: board layout, the panel table (offset, size and avatar count of each panel's
+//     record), then the slot names and asset paths the avatar records refer to by index
+// Both string lists only grow, so a record stays valid for as long as it is in the file.
+// A save appends the records of changed panels and a new directory, and only then points
+// the header at it, so an interrupted save leaves the previous one readable. Superseded
+// records and directories stay behind until over half of the file is dead; that save
+// rewrites the file compacted instead.
+// The file is read through a mapping. Opening reads the header and the directory's strings
+// only; a panel's table entry and record are touched when that panel is read.
+class StoryboardFile {
+public:
+    static const uint32_t VERSION = 1;
+
+    struct Layout {
+        int columns;
+        int panelWidth;
+        int panelHeight;
+        int gutter;
+        float panelColor[3];
+    };
+
+    // A panel to save: its scene, or null to keep panel filePanel of the open file unchanged
+    struct PanelSource {
+        const Scene* scene;
+        int filePanel;
+    };
+
+    // Slots are matched to the file's by name, so the config may change between saves
+    StoryboardFile(const SlotRegistry& slots);
+
+    bool open(const std::string& requestedPath);
+    void close();
+    bool isOpen() const;
+    const std::string& getPath() const;
+
+    const Layout& getLayout() const;
+    int getPanelCount() const;
+    // Adds the panel's avatars to scene, loading their items through the scene's textures.
+    // Slots the file does not know keep their defaults. False if the record is damaged.
+    bool readPanel(int panel, Scene& scene) const;
+
+    // Writes panels in this order and reopens path, so panel i is then the file's panel i.
+    // Appends when path is the open file and the result stays at least half live; rewrites
+    // it otherwise. Slot items are saved by the path they were loaded from in textures.
+    bool save(const std::string& path, const Layout& layout, const std::vector<PanelSource>& panels,
+              const TextureRegistry& textures);
+
+    size_t getFileSize() const;
+    // Bytes of superseded records and directories
+    size_t getDeadBytes() const;
+
+private:
+    struct TableEntry {
+        uint64_t offset;
+        uint32_t size;
+        uint32_t avatarCount;
+    };
+
+    TableEntry getEntry(int panel) const;
+    int getAssetId(GLuint texture);
+    void encodePanel(const Scene& scene, std::vector<unsigned char>& out);
+    void encodeDirectory(const Layout& layout, const std::vector<TableEntry>& table, std::vector<unsigned char>& out) const;
+
+    const SlotRegistry& slots;
+    MappedFile file;
+    std::string path;
+    Layout layout;
+    int panelCount;
+    size_t tableOffset;             // Of the panel table in the mapping
+    uint64_t directorySize;
+    uint64_t recordBytes;           // Of the records the directory refers to
+    std::vector<std::string> slotNames;
+    std::vector<std::string> assets;
+    std::vector<int> slotMap;       // File slot to registry slot, -1 if unknown
+    std::vector<int> fileSlots;     // Registry slot to file slot
+
+    // Used while saving
+    std::unordered_map<std::string, int> assetIds;
+    std::unordered_map<GLuint, std::string> texturePaths;
+
+    StoryboardFile(const StoryboardFile&) = delete;
+    StoryboardFile& operator=(const StoryboardFile&) = delete;
+};
+
+#endif
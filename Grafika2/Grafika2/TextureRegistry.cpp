@@ -0,0 +1,177 @@
+#include "TextureRegistry.h"
+#include "ImageStore.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+static size_t getLevelBytes(const DecodedImage& image, int level) {
+    return (size_t)image.getLevelWidth(level) * image.getLevelHeight(level) * image.channels;
+}
+
+TextureRegistry::TextureRegistry() : uploadBudget(0), residentBytes(0), fullBytes(0) {
+}
+
+TextureRegistry::~TextureRegistry() {
+    clear();
+}
+
+GLuint TextureRegistry::get(const std::string& path) {
+    auto found = textures.find(path);
+    if (found != textures.end()) {
+        return found->second;
+    }
+
+    GLuint texture = 0;
+    const DecodedImage* image = ImageStore::shared().get(path);
+    if (image != nullptr) {
+        // Coarsest levels first: down from the first one within PREVIEW_SIZE both ways
+        const int levelCount = image->getLevelCount();
+        int preview = 0;
+        while (preview + 1 < levelCount &&
+               (image->getLevelWidth(preview) > PREVIEW_SIZE || image->getLevelHeight(preview) > PREVIEW_SIZE)) {
+            ++preview;
+        }
+        glGenTextures(1, &texture);
+        if (streams.size() <= texture) streams.resize(texture + 1, { nullptr, 0, 0, false });
+        Stream& stream = streams[texture];
+        stream = { image, levelCount, preview, false };
+
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+        for (int level = levelCount - 1; level >= preview; --level) {
+            uploadLevel(stream, level);
+        }
+        // Same sampling as Avatar::loadTexture
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        for (int level = 0; level < levelCount; ++level) {
+            fullBytes += getLevelBytes(*image, level);
+        }
+    }
+    else {
+        std::cerr << "Failed to load texture: " << path << std::endl;
+    }
+    // Failures are cached too, so a missing file is not retried every frame
+    textures[path] = texture;
+    return texture;
+}
+
+void TextureRegistry::clear() {
+    for (const auto& entry : textures) {
+        if (entry.second != 0) glDeleteTextures(1, &entry.second);
+    }
+    textures.clear();
+    streams.clear();
+    pendingTextures.clear();
+    residentBytes = 0;
+    fullBytes = 0;
+}
+
+// Expects the texture bound and the unpack alignment at 1
+void TextureRegistry::uploadLevel(Stream& stream, int level) {
+    const DecodedImage& image = *stream.image;
+    const GLenum format = (image.channels == 4) ? GL_RGBA : GL_RGB;
+    glTexImage2D(GL_TEXTURE_2D, level, format, image.getLevelWidth(level), image.getLevelHeight(level), 0, format,
+                 GL_UNSIGNED_BYTE, image.getLevelPixels(level));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    stream.baseLevel = level;
+    residentBytes += getLevelBytes(image, level);
+}
+
+TextureRegistry::Stream* TextureRegistry::find(GLuint texture) {
+    return texture < streams.size() && streams[texture].image != nullptr ? &streams[texture] : nullptr;
+}
+
+const TextureRegistry::Stream* TextureRegistry::find(GLuint texture) const {
+    return texture < streams.size() && streams[texture].image != nullptr ? &streams[texture] : nullptr;
+}
+
+void TextureRegistry::request(GLuint texture, float pixelWidth, float pixelHeight) {
+    Stream* stream = find(texture);
+    if (stream == nullptr || pixelWidth <= 0.0f || pixelHeight <= 0.0f) return;
+
+    // Trilinear filtering reads level floor(log2(texels per pixel)) and the one after it,
+    // the ratio taken along the more minified axis
+    const float ratio = std::max(stream->image->width / pixelWidth, stream->image->height / pixelHeight);
+    const int level = ratio < 2.0f ? 0 : std::min(std::ilogb(ratio), stream->image->getLevelCount() - 1);
+    if (level >= stream->wantedLevel) return;
+    stream->wantedLevel = level;
+    if (!stream->pending && stream->wantedLevel < stream->baseLevel) {
+        stream->pending = true;
+        pendingTextures.push_back(texture);
+    }
+}
+
+bool TextureRegistry::stream() {
+    if (pendingTextures.empty()) return true;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    size_t uploaded = 0;
+    bool budgetLeft = true;
+    while (budgetLeft && !pendingTextures.empty()) {
+        size_t kept = 0;
+        for (GLuint texture : pendingTextures) {
+            Stream& stream = streams[texture];
+            if (budgetLeft) {
+                const int level = stream.baseLevel - 1;
+                const size_t bytes = getLevelBytes(*stream.image, level);
+                if (uploadBudget != 0 && uploaded != 0 && uploaded + bytes > uploadBudget) {
+                    budgetLeft = false;
+                }
+                else {
+                    glBindTexture(GL_TEXTURE_2D, texture);
+                    uploadLevel(stream, level);
+                    uploaded += bytes;
+                }
+            }
+            if (stream.baseLevel > stream.wantedLevel) {
+                pendingTextures[kept++] = texture;
+            }
+            else {
+                stream.pending = false;
+            }
+        }
+        pendingTextures.resize(kept);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return pendingTextures.empty();
+}
+
+void TextureRegistry::streamAll() {
+    const size_t budget = uploadBudget;
+    uploadBudget = 0;
+    stream();
+    uploadBudget = budget;
+}
+
+void TextureRegistry::setUploadBudget(size_t bytes) {
+    uploadBudget = bytes;
+}
+
+int TextureRegistry::getPendingCount() const {
+    return (int)pendingTextures.size();
+}
+
+size_t TextureRegistry::getTextureCount() const {
+    return textures.size();
+}
+
+const std::unordered_map<std::string, GLuint>& TextureRegistry::getEntries() const {
+    return textures;
+}
+
+const AlphaMask* TextureRegistry::getMask(GLuint texture) const {
+    const Stream* stream = find(texture);
+    return stream != nullptr ? &stream->image->mask : nullptr;
+}
+
+size_t TextureRegistry::getResidentBytes() const {
+    return residentBytes;
+}
+
+size_t TextureRegistry::getFullBytes() const {
+    return fullBytes;
+}
@@ -0,0 +1,75 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include "AlphaMask.h"
+#include <GL/glew.h>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct DecodedImage;
+
+// Textures of one GL context, by file path. Each file is uploaded once (from the decoded
+// copy in ImageStore) however many avatars wear it, and deleted with the registry.
+// Textures are streamed by level of detail: a new texture holds only the mip levels of at
+// most PREVIEW_SIZE texels, and finer levels are uploaded once a draw asks for them with
+// request(). A texture only ever seen small never occupies more than the levels it needs;
+// until a finer level arrives, sampling magnifies the finest one present.
+class TextureRegistry {
+public:
+    static const int PREVIEW_SIZE = 32;
+
+    TextureRegistry();
+    ~TextureRegistry();
+
+    // Uploads path on first use; 0 if it cannot be loaded (reported once)
+    GLuint get(const std::string& path);
+    void clear();
+
+    // The texture is about to be drawn pixelWidth x pixelHeight pixels large: makes sure the
+    // next stream() brings it to the coarsest level that still has a texel per pixel
+    void request(GLuint texture, float pixelWidth, float pixelHeight);
+    // Uploads requested levels, coarse ones first and one level of each texture per round,
+    // within the upload budget; false while levels are still pending
+    bool stream();
+    // Uploads every requested level now, whatever the budget
+    void streamAll();
+    // Bytes stream() uploads per call, at least one level; 0 (the default) uploads everything
+    void setUploadBudget(size_t bytes);
+    int getPendingCount() const;
+
+    size_t getTextureCount() const;
+    // Path to texture, failed loads included as 0
+    const std::unordered_map<std::string, GLuint>& getEntries() const;
+    // Coverage of the image a texture was uploaded from, null for textures not made here
+    const AlphaMask* getMask(GLuint texture) const;
+    // Texture memory of the levels uploaded, and of every texture with all its levels
+    size_t getResidentBytes() const;
+    size_t getFullBytes() const;
+
+private:
+    // Per texture name; names are small integers, so a vector beats hashing per request
+    struct Stream {
+        const DecodedImage* image;  // Owned by ImageStore, null for names not made here
+        int baseLevel;              // Finest level uploaded
+        int wantedLevel;            // Finest level requested
+        bool pending;               // Listed in pendingTextures
+    };
+
+    void uploadLevel(Stream& stream, int level);
+    Stream* find(GLuint texture);
+    const Stream* find(GLuint texture) const;
+
+    std::unordered_map<std::string, GLuint> textures;
+    std::vector<Stream> streams;
+    std::vector<GLuint> pendingTextures;
+    size_t uploadBudget;
+    size_t residentBytes;
+    size_t fullBytes;
+
+    TextureRegistry(const TextureRegistry&) = delete;
+    TextureRegistry& operator=(const TextureRegistry&) = delete;
+};
+
+#endif
@@ -0,0 +1,78 @@
+#include "TiledRenderer.h"
+#include "PngWriter.h"
+#include "ReadbackQueue.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+int TiledRenderer::getMaxTileSize() {
+    GLint renderbufferSize = 0, textureSize = 0;
+    GLint viewportSize[2] = { 0, 0 };
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &renderbufferSize);
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &textureSize);
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, viewportSize);
+    return std::min(std::min(renderbufferSize, textureSize), std::min(viewportSize[0], viewportSize[1]));
+}
+
+bool TiledRenderer::render(Framebuffer& target, int width, int height, const DrawFunction& draw, PngStripWriter& writer) {
+    const int tileWidth = target.getWidth();
+    const int tileHeight = target.getHeight();
+    if (width <= 0 || height <= 0 || tileWidth <= 0 || tileHeight <= 0) return false;
+    const int columns = (width + tileWidth - 1) / tileWidth;
+    const int bands = (height + tileHeight - 1) / tileHeight;
+
+    // One tile row of the image, top-down; filled and encoded on the readback thread only
+    std::vector<unsigned char> band((size_t)width * tileHeight * 4);
+    const ptrdiff_t bandStride = (ptrdiff_t)width * 4;
+    int tilesInBand = 0;
+    bool written = true;
+
+    // A ring one band deep plus one: the next band renders while the last tile of this one
+    // holds its buffer during encoding
+    ReadbackQueue readback;
+    bool created = readback.create(tileWidth, tileHeight, columns + 1, [&](const ReadbackImage& image) {
+        const int column = (int)(image.id % columns);
+        const int bandIndex = (int)(image.id / columns);
+        const int x = column * tileWidth;
+        const int rows = std::min(tileHeight, height - bandIndex * tileHeight);
+        const size_t rowBytes = (size_t)std::min(tileWidth, width - x) * 4;
+        for (int y = 0; y < rows; ++y) {
+            std::memcpy(band.data() + y * bandStride + (size_t)x * 4, image.pixels + y * image.stride, rowBytes);
+        }
+        if (++tilesInBand == columns) {
+            tilesInBand = 0;
+            written = writer.writeRows(band.data(), rows, bandStride) && written;
+        }
+    });
+    if (!created) {
+        std::cerr << "Failed to create tile readback (" << tileWidth << "x" << tileHeight << ")" << std::endl;
+        return false;
+    }
+
+    for (int bandIndex = 0; bandIndex < bands; ++bandIndex) {
+        for (int column = 0; column < columns; ++column) {
+            Tile tile;
+            tile.x = column * tileWidth;
+            tile.y = bandIndex * tileHeight;
+            tile.width = std::min(tileWidth, width - tile.x);
+            tile.height = std::min(tileHeight, height - tile.y);
+
+            // The tile's lower-left corner in GL pixels of the whole image; the last band
+            // keeps its top edge on the image and hangs below it
+            const float left = (float)tile.x;
+            const float bottom = (float)(height - tile.y - tileHeight);
+            tile.viewTransform[0] = (float)width / tileWidth;
+            tile.viewTransform[1] = (float)height / tileHeight;
+            tile.viewTransform[2] = (width - 2.0f * left) / tileWidth - 1.0f;
+            tile.viewTransform[3] = (height - 2.0f * bottom) / tileHeight - 1.0f;
+
+            target.bind();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            draw(tile);
+            readback.submit(target.getID(), (uint64_t)bandIndex * columns + column);
+        }
+    }
+    readback.destroy();
+    return written;
+}
@@ -0,0 +1,35 @@
+#ifndef TILED_RENDERER_H
+#define TILED_RENDERER_H
+
+#include "Framebuffer.h"
+#include <functional>
+
+class PngStripWriter;
+
+// Renders images larger than any framebuffer (print posters of tens of thousands of pixels)
+// as a grid of tiles. Each tile draws the whole scene through a view transform that maps the
+// image's NDC onto the tile, is read back asynchronously through a ReadbackQueue and copied
+// into a band of one tile row. Finished bands are streamed to a PngStripWriter on the
+// readback thread while the GL thread renders the next band, so memory stays at about two
+// bands whatever the image size.
+class TiledRenderer {
+public:
+    struct Tile {
+        int x;                  // Top-left corner in the image, rows counted from the top
+        int y;
+        int width;              // Part of the tile inside the image
+        int height;
+        float viewTransform[4]; // NDC scale (x, y) and offset (z, w) for the vertex shaders
+    };
+    typedef std::function<void(const Tile&)> DrawFunction;
+
+    // Largest square tile the current context can render into
+    static int getMaxTileSize();
+
+    // Renders width x height on the current context, tiles the size of target, and writes the
+    // rows to writer, which must be open for an image of this size. draw is called with
+    // target bound and cleared.
+    static bool render(Framebuffer& target, int width, int height, const DrawFunction& draw, PngStripWriter& writer);
+};
+
+#endif
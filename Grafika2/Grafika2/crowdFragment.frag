@@ -0,0 +1,21 @@
+#version 330 core
+
+in vec2 texCoords;
+in vec4 color;
+flat in float layer;
+
+out vec4 outCol;
+
+uniform sampler2DArray items;   // Every item image, one layer each
+uniform bool textured;
+
+void main()
+{
+    if (textured) {
+        outCol = texture(items, vec3(texCoords, layer));
+        // Empty texels must not write depth, or they would hide the avatars behind them
+        if (outCol.a < 1.0 / 255.0) discard;
+    } else {
+        outCol = color;
+    }
+}
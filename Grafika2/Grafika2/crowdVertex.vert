@@ -0,0 +1,34 @@
+#version 330 core
+
+// Instanced avatars (CrowdRenderer): one draw per avatar layer covers every avatar
+layout(location = 0) in vec2 inPos;         // Body or sprite vertex in the avatar's NDC space
+layout(location = 1) in vec2 inTex;         // Sprite passes only
+layout(location = 2) in vec4 inTransform;   // Per avatar: NDC scale (xy) and offset (zw)
+layout(location = 3) in float inDepth;      // Per avatar: avatars in front have smaller values
+layout(location = 4) in vec4 inColor;       // Per avatar: palette entry of this body pass
+layout(location = 5) in uint inLayer;       // Per avatar: texture array layer of this sprite pass
+layout(location = 6) in vec2 inRotation;    // Per avatar: (cosine, sine) of this pass's joint
+
+uniform vec4 viewTransform = vec4(1.0, 1.0, 0.0, 0.0); // NDC scale (xy) and offset (zw), set for tiled renders
+uniform bool textured;
+uniform vec2 pivot;             // Of this pass's joint, as the pose uniform of vertex.vert
+uniform vec2 layerScales[128];  // Part of each layer the item fills, it keeps its aspect ratio
+
+out vec2 texCoords;
+out vec4 color;
+flat out float layer;
+
+void main()
+{
+    if (textured && inLayer == 0xFFFFu) {
+        // Slot not worn: outside the clip volume, nothing is rasterized
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+        return;
+    }
+    vec2 posed = pivot + mat2(inRotation.x, inRotation.y, -inRotation.y, inRotation.x) * (inPos - pivot);
+    vec2 position = posed * inTransform.xy + inTransform.zw;
+    gl_Position = vec4(position * viewTransform.xy + viewTransform.zw, inDepth, 1.0);
+    texCoords = textured ? inTex * layerScales[inLayer] : inTex;
+    color = inColor;
+    layer = float(inLayer);
+}
@@ -1,12 +1,18 @@
 #version 330 core
 
 // Inputs from vertex shader
-in vec4 chCol;        // Color from vertex shader
 in vec2 texCoords;    // Texture coordinates from vertex shader
 
 // Outputs to framebuffer
 out vec4 outCol;
 
+// Per-avatar colors, indexed by Avatar::AvatarColor
+layout(std140) uniform AvatarColors {
+    vec4 palette[5];
+};
+uniform int colorIndex;  // Palette entry, or -1 for flatColor
+uniform vec3 flatColor;  // Used by UI geometry that is not part of an avatar
+
 // Texture sampler
 uniform sampler2D texture1; 
 uniform bool useTexture; // Uniform to determine if texture is used
@@ -15,7 +21,9 @@ void main()
 {
     if (useTexture) {
         outCol = texture(texture1, texCoords); // Sample from texture
+    } else if (colorIndex >= 0) {
+        outCol = palette[colorIndex]; // Avatar color from the uniform block
     } else {
-        outCol = chCol; // Use vertex color
+        outCol = vec4(flatColor, 1.0);
     }
 }
@@ -3,8 +3,11 @@
 layout(location = 0) in vec2 inPos;     // Vertex position
 layout(location = 1) in vec2 inTexCoord; // Texture coordinates
 out vec2 TexCoord;                     // Pass to fragment shader
+uniform vec4 viewTransform = vec4(1.0, 1.0, 0.0, 0.0); // NDC scale (xy) and offset (zw), set for tiled renders
+uniform vec4 pose = vec4(1.0, 0.0, 0.0, 0.0); // Rotation (cosine, sine) about the pivot zw, for posed joints
 
 void main() {
-    gl_Position = vec4(inPos, 0.0, 1.0);
+    vec2 posed = pose.zw + mat2(pose.x, pose.y, -pose.y, pose.x) * (inPos - pose.zw);
+    gl_Position = vec4(posed * viewTransform.xy + viewTransform.zw, 0.0, 1.0);
     TexCoord = inTexCoord; // Pass texture coordinates to the fragment shader
 }
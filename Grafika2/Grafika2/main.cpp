@@ -1,15 +1,43 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "Shader.h"
+#include "Animation.h"
 #include "Avatar.h"
+#include "AvatarDescription.h"
+#include "CrowdRenderer.h"
 #include "Menu.h"
+#include "RenderScaler.h"
+#include "SlotRegistry.h"
+#include "FrameArena.h"
+#include "ImpostorCache.h"
+#include "AllocationTracker.h"
+#include "RenderContext.h"
+#include "PngWriter.h"
+#include "QoiWriter.h"
+#include "Resampler.h"
+#include "Scene.h"
+#include "Storyboard.h"
+#include "TiledRenderer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 #include <thread>  // Za std::this_thread::sleep_for
 #include <chrono>  // Za std::chrono::milliseconds
 
-float scrollOffset = 0.0f; // Initial scroll offset
+float scrollOffset = 1.0f; // Zoom of the avatar view, 0.1 to 2.0 with the mouse wheel
+int framebufferWidth = 1200;
+int framebufferHeight = 1000;
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
+    framebufferWidth = width;
+    framebufferHeight = height;
 }
 
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
@@ -28,12 +56,384 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 
         Menu* menu = (Menu*)glfwGetWindowUserPointer(window);
         if (menu) {
-            menu->handleMouseClick(mouseX, mouseY, windowWidth, windowHeight);
+            menu->handleMouseClick(mouseX, mouseY, windowWidth, windowHeight, scrollOffset);
         }
     }
 }
 
-int main() {
+// Ctrl+Z undoes the last item change, Ctrl+Y (or Ctrl+Shift+Z) redoes it
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (action == GLFW_RELEASE || (mods & GLFW_MOD_CONTROL) == 0) return;
+    Menu* menu = (Menu*)glfwGetWindowUserPointer(window);
+    if (!menu) return;
+    if (key == GLFW_KEY_Z && (mods & GLFW_MOD_SHIFT) == 0) {
+        menu->undo();
+    }
+    else if (key == GLFW_KEY_Y || key == GLFW_KEY_Z) {
+        menu->redo();
+    }
+}
+
+// How the headless modes draw a --scene file
+struct SceneOptions {
+    std::string path;       // Avatar descriptions as for AvatarBatch, drawn as one Scene; empty for the default avatar
+    bool instanced;         // Through CrowdRenderer
+    int impostorSize;       // Avatars at most this many pixels wide and tall come from an ImpostorCache; 0 for none
+    int storyboardColumns;  // One Storyboard panel per avatar instead, in rows of this many; 0 for none
+    std::string boardPath;  // A storyboard saved earlier, drawn instead of a scene file
+    std::string savePath;   // Where to save the storyboard once loaded; empty for nowhere
+    double animateSeconds;  // The wave is played this long before drawing; negative for no animation
+
+    SceneOptions() : instanced(false), impostorSize(0), storyboardColumns(0), animateSeconds(-1.0) {}
+};
+
+// The motion of --animate: the arms wave up and down and the head sways, a wave a second,
+// starting phase seconds into it. Keys cover the clock from 0 to seconds.
+void keyWave(Animation& animation, int avatar, double phase, double seconds) {
+    using namespace AvatarGeometry;
+    const double halfWave = 0.5;
+    for (int key = 0; key * halfWave <= seconds + phase + halfWave; ++key) {
+        const double time = key * halfWave - phase;
+        const bool raised = key % 2 == 1;
+        animation.addKey(avatar, Animation::CHANNEL_LEFT_ARM, time, raised ? ARM_ANGLE - 1.2f : ARM_ANGLE);
+        animation.addKey(avatar, Animation::CHANNEL_RIGHT_ARM, time, raised ? ARM_ANGLE - 1.6f : ARM_ANGLE);
+        animation.addKey(avatar, Animation::CHANNEL_HEAD_TILT, time, raised ? 0.08f : -0.08f);
+    }
+}
+
+// What the headless modes draw: the default avatar, or every avatar of a --scene file on a
+// grid that fills the view, one depth per row, optionally instanced or with small avatars
+// as impostors, or as a storyboard of 4:3 panels as wide as the view, one avatar each, or a
+// storyboard file. With --animate the avatars are drawn where the wave has taken them.
+// Needs a current context.
+class HeadlessContent {
+public:
+    HeadlessContent() : avatarShader("vertex.vert", "fragment.frag"), hairShader("hairVertex.vert", "hairFragment.frag") {
+        avatarShader.setUniformBlockBinding("AvatarColors", Avatar::COLOR_BLOCK_BINDING);
+    }
+
+    // width is the width of the whole image, which storyboard panels are sized to fill
+    bool load(const SceneOptions& options, int width) {
+        if (!slotRegistry.load("avatar_options.json")) {
+            return false;
+        }
+        if (!options.boardPath.empty()) {
+            storyboard.reset(new Storyboard(slotRegistry, avatarShader, hairShader));
+            if (!storyboard->open(options.boardPath) || (!options.savePath.empty() && !storyboard->save(options.savePath))) {
+                return false;
+            }
+            animate(options.animateSeconds);
+            return true;
+        }
+        if (options.path.empty()) {
+            avatar.reset(new Avatar(slotRegistry));
+            return true;
+        }
+
+        std::vector<AvatarDescription> descriptions;
+        if (!AvatarDescription::loadList(options.path, slotRegistry, descriptions)) {
+            return false;
+        }
+        if (options.storyboardColumns > 0) {
+            const int gutter = 8;
+            const int panelWidth = std::max(1, (width - gutter * (options.storyboardColumns - 1)) / options.storyboardColumns);
+            storyboard.reset(new Storyboard(slotRegistry, avatarShader, hairShader));
+            storyboard->setLayout(options.storyboardColumns, panelWidth, panelWidth * 3 / 4, gutter);
+            for (const AvatarDescription& description : descriptions) {
+                SceneAvatar& panelAvatar = storyboard->addPanel().addAvatar();
+                description.applyTo(panelAvatar);
+                panelAvatar.setTransform(0.0f, 0.0f, 0.9f);
+            }
+            if (!options.savePath.empty() && !storyboard->save(options.savePath)) {
+                return false;
+            }
+            animate(options.animateSeconds);
+            return true;
+        }
+        scene.reset(new Scene(slotRegistry, avatarShader, hairShader));
+        const int count = (int)descriptions.size();
+        const int columns = std::max(1, (int)std::ceil(std::sqrt((double)count)));
+        const int rows = std::max(1, (count + columns - 1) / columns);
+        const float scale = 1.0f / std::max(columns, rows);
+        for (int i = 0; i < count; ++i) {
+            const int row = i / columns;
+            const int column = i % columns;
+            SceneAvatar& sceneAvatar = scene->addAvatar();
+            descriptions[i].applyTo(sceneAvatar);
+            sceneAvatar.setTransform(-1.0f + (2.0f * column + 1.0f) / columns, 1.0f - (2.0f * row + 1.0f) / rows, scale);
+            sceneAvatar.setDepth(row);
+        }
+        if (options.instanced) {
+            crowd.reset(new CrowdRenderer(*scene));
+        }
+        else if (options.impostorSize > 0) {
+            // Cells at twice the largest impostor, so mipmapping has detail to filter down
+            impostors.reset(new ImpostorCache(*scene, options.impostorSize, std::max(64, options.impostorSize * 2)));
+            scene->setImpostors(impostors.get());
+        }
+        animate(options.animateSeconds);
+        return true;
+    }
+
+    // viewTransform maps the view onto the target (null for identity), as for tiles
+    void draw(int width, int height, const float* viewTransform) {
+        if (storyboard) {
+            // The part of the board (pixels from its top-left corner) the view shows
+            static const float identity[4] = { 1.0f, 1.0f, 0.0f, 0.0f };
+            const float* view = viewTransform != nullptr ? viewTransform : identity;
+            storyboard->draw((1.0f - (1.0f + view[2]) / view[0]) * 0.5f * width, (1.0f - (1.0f - view[3]) / view[1]) * 0.5f * height,
+                             width / view[0], height / view[1]);
+            return;
+        }
+        if (crowd) {
+            crowd->draw(viewTransform);
+            return;
+        }
+        if (scene) {
+            scene->draw(viewTransform);
+            return;
+        }
+        if (viewTransform != nullptr) {
+            avatarShader.use();
+            avatarShader.setVec4("viewTransform", viewTransform);
+            hairShader.use();
+            hairShader.setVec4("viewTransform", viewTransform);
+        }
+        avatar->draw(avatarShader, hairShader, width, height, scrollOffset);
+        avatar->drawSlots(hairShader);
+    }
+
+private:
+    // Plays the wave for seconds as a window's loop would: each frame advances the clocks by
+    // the frame's time and applies the state between their last two steps. Frames of 1/24 s
+    // fall between the 60 Hz steps, so what is drawn is interpolated. Each avatar (or panel)
+    // waves a quarter wave after the one before.
+    void animate(double seconds) {
+        if (seconds < 0.0) return;
+        if (scene) {
+            animations.emplace_back(new Animation(*scene));
+            for (int i = 0; i < scene->getAvatarCount(); ++i) {
+                keyWave(*animations.back(), i, std::fmod(i * 0.25, 1.0), seconds);
+            }
+        }
+        else {
+            for (int panel = 0; panel < storyboard->getPanelCount(); ++panel) {
+                Scene& panelScene = storyboard->getPanel(panel);
+                animations.emplace_back(new Animation(panelScene));
+                for (int i = 0; i < panelScene.getAvatarCount(); ++i) {
+                    keyWave(*animations.back(), i, std::fmod(panel * 0.25, 1.0), seconds);
+                }
+            }
+        }
+
+        const double frameSeconds = 1.0 / 24.0;
+        const int frames = (int)std::ceil(seconds / frameSeconds);
+        for (int frame = 0; frame <= frames; ++frame) {
+            const double elapsed = frame > 0 ? std::min(frameSeconds, seconds - (frame - 1) * frameSeconds) : 0.0;
+            for (const std::unique_ptr<Animation>& animation : animations) {
+                animation->update(elapsed);
+                animation->apply();
+            }
+        }
+    }
+
+    Shader avatarShader;
+    Shader hairShader;
+    SlotRegistry slotRegistry;
+    std::unique_ptr<Avatar> avatar;
+    std::unique_ptr<Scene> scene;
+    std::unique_ptr<CrowdRenderer> crowd;
+    std::unique_ptr<ImpostorCache> impostors;
+    std::unique_ptr<Storyboard> storyboard;
+    std::vector<std::unique_ptr<Animation>> animations;    // Of the scene or each panel
+};
+
+// Renders the default avatar (or a scene) once into an offscreen context and saves it, no
+// window needed. With supersample > 1 it renders that many times larger and filters down
+// with Lanczos.
+int renderHeadless(RenderContext::Backend backend, int width, int height, int supersample, const SceneOptions& sceneOptions,
+                   const std::string& outputPath) {
+    const int renderWidth = width * supersample;
+    const int renderHeight = height * supersample;
+    RenderContext context;
+    if (!context.create(backend, renderWidth, renderHeight)) {
+        std::cerr << "Failed to create " << RenderContext::getBackendName(backend) << " render context" << std::endl;
+        return -1;
+    }
+
+    std::vector<unsigned char> pixels;
+    {
+        HeadlessContent content;
+        if (!content.load(sceneOptions, renderWidth)) {
+            return -1;
+        }
+        context.getFramebuffer().bind();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        content.draw(renderWidth, renderHeight, nullptr);
+        context.readPixels(pixels);
+    }
+    if (supersample > 1) {
+        std::vector<unsigned char> resized((size_t)width * height * 4);
+        Resampler::resize(pixels.data(), renderWidth, renderHeight, 0, resized.data(), width, height, 0, Resampler::FILTER_LANCZOS3, false);
+        pixels.swap(resized);
+    }
+
+    // .qoi for a fast lossless intermediate, PNG otherwise
+    bool qoi = outputPath.size() >= 4 && outputPath.compare(outputPath.size() - 4, 4, ".qoi") == 0;
+    bool written = qoi ? QoiWriter::write(outputPath, pixels.data(), width, height)
+                       : PngWriter::write(outputPath, pixels.data(), width, height);
+    if (!written) {
+        return -1;
+    }
+    std::cout << "Wrote " << outputPath << " (" << width << "x" << height << ", "
+              << RenderContext::getBackendName(context.getBackend()) << ")" << std::endl;
+    return 0;
+}
+
+// Renders the default avatar (or a scene) as a poster too large for one framebuffer: tile by
+// tile, with the rows streamed into a PNG as each band of tiles finishes
+int renderPoster(RenderContext::Backend backend, int width, int height, int tileWidth, int tileHeight,
+                 const SceneOptions& sceneOptions, const std::string& outputPath) {
+    tileWidth = std::min(tileWidth, width);
+    tileHeight = std::min(tileHeight, height);
+    RenderContext context;
+    if (!context.create(backend, tileWidth, tileHeight)) {
+        std::cerr << "Failed to create " << RenderContext::getBackendName(backend) << " render context" << std::endl;
+        return -1;
+    }
+    const int maxTileSize = TiledRenderer::getMaxTileSize();
+    if (tileWidth > maxTileSize || tileHeight > maxTileSize) {
+        tileWidth = std::min(tileWidth, maxTileSize);
+        tileHeight = std::min(tileHeight, maxTileSize);
+        if (!context.getFramebuffer().create(tileWidth, tileHeight)) {
+            return -1;
+        }
+    }
+
+    PngOptions options;
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+    PngStripWriter writer;
+    if (!writer.open(outputPath, width, height, options)) {
+        return -1;
+    }
+    bool rendered;
+    {
+        HeadlessContent content;
+        if (!content.load(sceneOptions, width)) {
+            return -1;
+        }
+        rendered = TiledRenderer::render(context.getFramebuffer(), width, height, [&](const TiledRenderer::Tile& tile) {
+            content.draw(width, height, tile.viewTransform);
+        }, writer);
+    }
+    if (!writer.close() || !rendered) {
+        return -1;
+    }
+    std::cout << "Wrote " << outputPath << " (" << width << "x" << height << " in " << tileWidth << "x" << tileHeight << " tiles, "
+              << RenderContext::getBackendName(context.getBackend()) << ")" << std::endl;
+    return 0;
+}
+
+// Sizes past this on either side, or any size with --tile, render as a tiled poster (PNG only)
+const int POSTER_THRESHOLD = 8192;
+
+// Usage: Grafika2 [--headless[=auto|egl|glfw]] [--size WIDTHxHEIGHT] [--supersample N] [--tile WIDTHxHEIGHT]
+//                 [--scene avatars.json [--instanced | --impostors PIXELS | --storyboard COLUMNS]]
+//                 [--board board.avb] [--save-board board.avb] [--animate SECONDS]
+//                 [--output avatar.png|avatar.qoi]
+int main(int argc, char** argv) {
+    bool headless = false;
+    RenderContext::Backend backend = RenderContext::BACKEND_AUTO;
+    int headlessWidth = 600;
+    int headlessHeight = 500;
+    int supersample = 1;
+    int tileWidth = 0;      // 0 until --tile: tiles of 4096x256 if the size needs them
+    int tileHeight = 0;
+    SceneOptions sceneOptions;
+    std::string outputPath = "avatar.png";
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--headless", 10) == 0) {
+            headless = true;
+            if (argv[i][10] == '=' && !RenderContext::parseBackend(argv[i] + 11, backend)) {
+                std::cerr << "Unknown backend " << argv[i] + 11 << " (expected auto, egl or glfw)" << std::endl;
+                return -1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            if (std::sscanf(argv[++i], "%dx%d", &headlessWidth, &headlessHeight) != 2 || headlessWidth <= 0 || headlessHeight <= 0) {
+                std::cerr << "Invalid size " << argv[i] << std::endl;
+                return -1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--supersample") == 0 && i + 1 < argc) {
+            supersample = std::atoi(argv[++i]);
+            if (supersample <= 0 || supersample > 8) {
+                std::cerr << "Invalid supersampling factor " << argv[i] << " (expected 1-8)" << std::endl;
+                return -1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--tile") == 0 && i + 1 < argc) {
+            if (std::sscanf(argv[++i], "%dx%d", &tileWidth, &tileHeight) != 2 || tileWidth <= 0 || tileHeight <= 0) {
+                std::cerr << "Invalid tile size " << argv[i] << std::endl;
+                return -1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+            sceneOptions.path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--instanced") == 0) {
+            sceneOptions.instanced = true;
+        }
+        else if (std::strcmp(argv[i], "--impostors") == 0 && i + 1 < argc) {
+            sceneOptions.impostorSize = std::atoi(argv[++i]);
+            if (sceneOptions.impostorSize <= 0) {
+                std::cerr << "Invalid impostor size " << argv[i] << std::endl;
+                return -1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--storyboard") == 0 && i + 1 < argc) {
+            sceneOptions.storyboardColumns = std::atoi(argv[++i]);
+            if (sceneOptions.storyboardColumns <= 0) {
+                std::cerr << "Invalid storyboard column count " << argv[i] << std::endl;
+                return -1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--board") == 0 && i + 1 < argc) {
+            sceneOptions.boardPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--save-board") == 0 && i + 1 < argc) {
+            sceneOptions.savePath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--animate") == 0 && i + 1 < argc) {
+            sceneOptions.animateSeconds = std::atof(argv[++i]);
+            if (!(sceneOptions.animateSeconds >= 0.0 && sceneOptions.animateSeconds <= 600.0)) {
+                std::cerr << "Invalid animation time " << argv[i] << " (expected 0-600 seconds)" << std::endl;
+                return -1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        }
+        else {
+            std::cerr << "Unknown argument " << argv[i] << std::endl;
+            return -1;
+        }
+    }
+    if (sceneOptions.animateSeconds >= 0.0 && sceneOptions.path.empty() && sceneOptions.boardPath.empty()) {
+        std::cerr << "--animate needs --scene or --board" << std::endl;
+        return -1;
+    }
+    if (headless && (tileWidth > 0 || headlessWidth > POSTER_THRESHOLD || headlessHeight > POSTER_THRESHOLD)) {
+        if (supersample > 1 || (outputPath.size() >= 4 && outputPath.compare(outputPath.size() - 4, 4, ".qoi") == 0)) {
+            std::cerr << "Tiled posters are written as PNG without supersampling" << std::endl;
+            return -1;
+        }
+        return renderPoster(backend, headlessWidth, headlessHeight, tileWidth > 0 ? tileWidth : 4096, tileHeight > 0 ? tileHeight : 256, sceneOptions, outputPath);
+    }
+    if (headless) {
+        return renderHeadless(backend, headlessWidth, headlessHeight, supersample, sceneOptions, outputPath);
+    }
+
     if (!glfwInit()) return -1;
 
     GLFWwindow* window = glfwCreateWindow(1200, 1000, "Avatar Renderer", nullptr, nullptr);
@@ -46,41 +446,72 @@ int main() {
     glewInit();
 
     glViewport(0, 0, 1200, 1000);
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetKeyCallback(window, key_callback);
 
     Shader avatarShader("vertex.vert", "fragment.frag");
     Shader hairShader("hairVertex.vert", "hairFragment.frag");
-    Avatar avatar;  // Ensure this is initialized before usage
+    avatarShader.setUniformBlockBinding("AvatarColors", Avatar::COLOR_BLOCK_BINDING);
+    SlotRegistry slotRegistry;
+    if (!slotRegistry.load("avatar_options.json")) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return -1;
+    }
+    Avatar avatar(slotRegistry);  // Ensure this is initialized before usage
 
     // Instantiate the Menu after avatar is initialized
-    Menu menu(avatarShader, hairShader, avatar);
+    Menu menu(avatarShader, hairShader, avatar, slotRegistry);
     glfwSetWindowUserPointer(window, &menu);
 
     const double targetFPS = 60.0;           // Ciljani FPS
     const double frameTime = 1.0 / targetFPS; // Trajanje svakog frame-ausekundama
 
+    const float minRenderScale = 0.5f;       // Lowest internal resolution relative to the window
+    const float maxRenderScale = 1.0f;
+
+    // Avatar is drawn offscreen at an adaptive resolution, the menu stays at native resolution
+    RenderScaler renderScaler(framebufferWidth, framebufferHeight, minRenderScale, maxRenderScale, frameTime);
+
+    // Textures and arena growth happen in the first frames, after that a frame must not touch the heap
+    AllocationTracker allocationTracker(3);
+
     while (!glfwWindowShouldClose(window)) {
         double startTime = glfwGetTime(); // Poetak iteracije petlje
 
+        allocationTracker.beginFrame();
+        renderScaler.setWindowSize(framebufferWidth, framebufferHeight);
+        renderScaler.beginFrame();
+
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // Zoom about the window center; the menu below is drawn unzoomed
+        const float zoom[4] = { scrollOffset, scrollOffset, 0.0f, 0.0f };
+        const float identity[4] = { 1.0f, 1.0f, 0.0f, 0.0f };
         avatarShader.use();
+        avatarShader.setVec4("viewTransform", zoom);
         hairShader.use();
+        hairShader.setVec4("viewTransform", zoom);
 
-        avatar.draw(avatarShader, hairShader, 1200, 1000, scrollOffset);
-
-        float color[] = { 1.0, 0.1, 0.1 };
+        avatar.draw(avatarShader, hairShader, (float)renderScaler.getRenderWidth(), (float)renderScaler.getRenderHeight(), scrollOffset);
 
+        // Garments, face and hair in the layer order from avatar_options.json
+        avatar.drawSlots(hairShader);
 
-        avatar.drawDress(avatarShader, hairShader, color, "ts");
-        avatar.drawPants(avatarShader, hairShader, color, "ts");
-        avatar.drawTshirt(avatarShader, hairShader, color, "ts");
-        avatar.drawFace(hairShader);
+        renderScaler.endFrame();
+        avatarShader.use();
+        avatarShader.setVec4("viewTransform", identity);
+        hairShader.use();
+        hairShader.setVec4("viewTransform", identity);
 
         // Render the menu after the avatar has been rendered
         menu.render(-0.95f, 0.8f, 0.4f, 0.05f);
 
+        FrameArena::forThread().reset();
+        allocationTracker.endFrame();
+
         glfwSwapBuffers(window);
         glfwPollEvents();
         double endTime = glfwGetTime();          // Kraj iteracije petlje
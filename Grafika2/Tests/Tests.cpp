@@ -0,0 +1,235 @@
+#include <GL/glew.h>
+#include "Animation.h"
+#include "Json.h"
+#include "RenderContext.h"
+#include "Resampler.h"
+#include "Scene.h"
+#include "SceneHistory.h"
+#include "Shader.h"
+#include "SlotRegistry.h"
+#include "Storyboard.h"
+#include <cstdio>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+// Regression checks, most of which need a GL context. Run from the Grafika2 folder (shaders and
+// avatar_options.json are loaded from the working directory); the exit code is the
+// number of failed checks.
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+            ++failures; \
+        } \
+    } while (0)
+
+// Undo hides an avatar added after the step it goes back to; redo must show it again
+// instead of committing the hidden avatar as a new step
+static void testUndoRedoAddedAvatar(const SlotRegistry& slots, Shader& bodyShader, Shader& spriteShader) {
+    Scene scene(slots, bodyShader, spriteShader);
+    scene.addAvatar().setTransform(-0.5f, 0.0f, 0.5f);
+    SceneHistory history(scene);
+
+    scene.addAvatar().setTransform(0.5f, 0.0f, 0.5f);
+    CHECK(history.commit());
+    CHECK(history.getStepCount() == 2);
+
+    CHECK(history.undo());
+    CHECK(history.getCurrentStep() == 0);
+    CHECK(scene.pick(0.5f, 0.0f) == -1);
+    CHECK(history.canRedo());
+
+    CHECK(history.redo());
+    CHECK(history.getStepCount() == 2);
+    CHECK(history.getCurrentStep() == 1);
+    CHECK(scene.pick(0.5f, 0.0f) == 1);
+    CHECK(!history.canRedo());
+    CHECK(!history.commit());
+}
+
+// Editing after such an undo starts a new branch that keeps the avatar hidden
+static void testEditAfterUndoingAdd(const SlotRegistry& slots, Shader& bodyShader, Shader& spriteShader) {
+    Scene scene(slots, bodyShader, spriteShader);
+    scene.addAvatar().setTransform(-0.5f, 0.0f, 0.5f);
+    SceneHistory history(scene);
+
+    scene.addAvatar().setTransform(0.5f, 0.0f, 0.5f);
+    CHECK(history.commit());
+    CHECK(history.undo());
+
+    scene.getAvatar(0).setColor(Avatar::COLOR_SKIN, 1.0f, 0.0f, 0.0f);
+    CHECK(history.commit());
+    CHECK(history.getStepCount() == 2);
+    CHECK(!history.canRedo());
+    CHECK(scene.pick(0.5f, 0.0f) == -1);
+
+    CHECK(history.undo());
+    CHECK(history.redo());
+    CHECK(scene.pick(0.5f, 0.0f) == -1);
+}
+
+// Numbers follow the JSON grammar whatever strtod would take, and \u escapes take four hex digits
+static void testJsonGrammar() {
+    JsonValue value;
+    std::string error;
+    CHECK(JsonValue::parse("[0, -1.5, 2e3, 1E-2, 10]", value, error));
+    CHECK(value.size() == 5 && value[1].asNumber() == -1.5 && value[2].asNumber() == 2000.0 &&
+          value[3].asNumber() == 0.01 && value[4].asNumber() == 10.0);
+    const char* invalid[] = { "nan", "inf", "-inf", "0x1F", "+1", "01", "1.", ".5", "1e", "1e+", "-", "1e999" };
+    for (const char* text : invalid) CHECK(!JsonValue::parse(text, value, error));
+
+    CHECK(JsonValue::parse("\"\\u00e9\\u0041\"", value, error));
+    CHECK(value.asString() == "\xC3\xA9" "A");
+    CHECK(!JsonValue::parse("\"\\u12zz\"", value, error));
+    CHECK(!JsonValue::parse("\"\\u12\"", value, error));
+}
+
+// A flat image stays flat through both filters at any scale: odd and even tap counts,
+// 1-pixel sources and downscales far past the kernel's width
+static void testResampleFlat() {
+    const int sizes[][4] = {
+        { 1, 1, 7, 5 }, { 1, 9, 3, 2 }, { 2, 2, 5, 5 }, { 5, 3, 2, 1 },
+        { 7, 7, 3, 3 }, { 13, 11, 4, 6 }, { 31, 4, 9, 4 }, { 4000, 3, 1, 1 }, { 3, 2000, 2, 1 }
+    };
+    const unsigned char color[4] = { 200, 100, 50, 128 };
+    for (const int* size : sizes) {
+        std::vector<unsigned char> source((size_t)size[0] * size[1] * 4);
+        for (size_t i = 0; i < source.size(); ++i) source[i] = color[i % 4];
+        for (int filter = Resampler::FILTER_MITCHELL; filter <= Resampler::FILTER_LANCZOS3; ++filter) {
+            std::vector<unsigned char> target((size_t)size[2] * size[3] * 4);
+            Resampler::resize(source.data(), size[0], size[1], 0, target.data(), size[2], size[3], 0,
+                              (Resampler::Filter)filter, false);
+            bool flat = true;
+            for (size_t i = 0; i < target.size(); ++i) flat = flat && std::abs(target[i] - color[i % 4]) <= 2;
+            CHECK(flat);
+        }
+    }
+}
+
+// Each panel undoes on its own history, panels read from a file included
+static void testStoryboardHistory(const SlotRegistry& slots, Shader& bodyShader, Shader& spriteShader) {
+    const std::string path = (std::filesystem::temp_directory_path() / "Tests.board").string();
+    {
+        Storyboard board(slots, bodyShader, spriteShader);
+        board.addPanel();
+        board.addPanel().addAvatar().setTransform(0.0f, 0.0f, 0.5f);
+        CHECK(board.save(path));
+    }
+
+    Storyboard board(slots, bodyShader, spriteShader);
+    CHECK(board.open(path));
+    CHECK(board.getPanelCount() == 2);
+    Scene& panel = board.getPanel(1);
+    CHECK(!board.getHistory(1).canUndo());
+    const uint32_t revision = panel.getRevision();
+
+    panel.getAvatar(0).setVisible(false);
+    CHECK(board.getHistory(1).commit());
+    CHECK(panel.pick(0.0f, 0.0f) == -1);
+    CHECK(!board.getHistory(0).canUndo());
+
+    CHECK(board.getHistory(1).undo());
+    CHECK(panel.pick(0.0f, 0.0f) == 0);
+    CHECK(panel.getRevision() != revision);
+    CHECK(board.getHistory(1).redo());
+    CHECK(panel.pick(0.0f, 0.0f) == -1);
+    board.clear();
+    std::remove(path.c_str());
+}
+
+// Steps of 1/8 s keep the clock exact. apply() writes the state between the last two steps
+// by the alpha: after 0.5625 s the steps are at 0.375 and 0.5 and the alpha is 0.5, so a
+// channel keyed from 0 to 1 over a second shows 0.4375.
+static void testAnimationInterpolation(const SlotRegistry& slots, Shader& bodyShader, Shader& spriteShader) {
+    Scene scene(slots, bodyShader, spriteShader);
+    scene.addAvatar();
+    Animation animation(scene, 0.125);
+    animation.addKey(0, Animation::CHANNEL_LEFT_ARM, 0.0, 0.0f);
+    animation.addKey(0, Animation::CHANNEL_LEFT_ARM, 1.0, 1.0f);
+    animation.addKey(0, Animation::CHANNEL_LEFT_ARM, 2.0, 0.0f);
+    CHECK(animation.getAnimatedCount() == 1);
+
+    CHECK(animation.update(0.5625) == 4);
+    CHECK(animation.getTime() == 0.5 && animation.getAlpha() == 0.5f);
+    animation.apply();
+    CHECK(std::fabs(scene.getAvatar(0).getPose(AvatarGeometry::JOINT_LEFT_ARM) - 0.4375f) < 1e-6f);
+    // Channels without keys stay as they were
+    CHECK(scene.getAvatar(0).getPose(AvatarGeometry::JOINT_RIGHT_ARM) == AvatarGeometry::REST_POSE[AvatarGeometry::JOINT_RIGHT_ARM]);
+
+    // Into the next segment, on the way back down: steps at 1.375 and 1.5, alpha 0
+    CHECK(animation.update(0.9375) == 8);
+    CHECK(animation.getTime() == 1.5 && animation.getAlpha() == 0.0f);
+    animation.apply();
+    CHECK(std::fabs(scene.getAvatar(0).getPose(AvatarGeometry::JOINT_LEFT_ARM) - 0.625f) < 1e-6f);
+}
+
+// A swap happens on the first step at or past its time, not before
+static void testAnimationSlotSwap(const SlotRegistry& slots, Shader& bodyShader, Shader& spriteShader) {
+    Scene scene(slots, bodyShader, spriteShader);
+    SceneAvatar& avatar = scene.addAvatar();
+    const int lips = slots.findSlot("Lips");
+    CHECK(lips >= 0 && (avatar.getOccupiedSlots() & (1u << lips)) != 0);
+    if (lips < 0) return;
+
+    Animation animation(scene, 0.125);
+    animation.addSlotSwap(0, lips, 0.375, 0);
+    animation.addSlotSwap(0, lips, 0.75, avatar.loadTextureCached("Lips/lips2.png"));
+    CHECK(animation.update(0.25) == 2);
+    CHECK((avatar.getOccupiedSlots() & (1u << lips)) != 0);
+    CHECK(animation.update(0.125) == 1);
+    CHECK((avatar.getOccupiedSlots() & (1u << lips)) == 0);
+    CHECK(animation.update(0.25) == 2);
+    CHECK((avatar.getOccupiedSlots() & (1u << lips)) == 0);
+    CHECK(animation.update(0.125) == 1);
+    CHECK((avatar.getOccupiedSlots() & (1u << lips)) != 0);
+}
+
+// A long stall takes MAX_STEPS steps and drops the rest, so the animation pauses
+static void testAnimationStall(const SlotRegistry& slots, Shader& bodyShader, Shader& spriteShader) {
+    Scene scene(slots, bodyShader, spriteShader);
+    scene.addAvatar();
+    Animation animation(scene, 0.125);
+    animation.addKey(0, Animation::CHANNEL_HEAD_TILT, 0.0, 0.0f);
+    animation.addKey(0, Animation::CHANNEL_HEAD_TILT, 10.0, 10.0f);
+
+    CHECK(animation.update(10.0) == Animation::MAX_STEPS);
+    CHECK(animation.getTime() == Animation::MAX_STEPS * 0.125);
+    CHECK(animation.getAlpha() == 0.0f);
+    // The state of the step before the last, as after any update that ends on a step
+    animation.apply();
+    CHECK(std::fabs(scene.getAvatar(0).getPose(AvatarGeometry::JOINT_HEAD) - (Animation::MAX_STEPS - 1) * 0.125f) < 1e-5f);
+    CHECK(animation.update(0.0625) == 0);
+    CHECK(animation.update(0.0625) == 1);
+}
+
+int main() {
+    testJsonGrammar();
+    testResampleFlat();
+
+    RenderContext context;
+    if (!context.create(RenderContext::BACKEND_AUTO, 64, 64)) {
+        std::cerr << "No GL context for the tests" << std::endl;
+        return -1;
+    }
+    SlotRegistry slots;
+    if (!slots.load("avatar_options.json")) return -1;
+    Shader bodyShader("vertex.vert", "fragment.frag");
+    Shader spriteShader("hairVertex.vert", "hairFragment.frag");
+    bodyShader.setUniformBlockBinding("AvatarColors", Avatar::COLOR_BLOCK_BINDING);
+
+    testUndoRedoAddedAvatar(slots, bodyShader, spriteShader);
+    testEditAfterUndoingAdd(slots, bodyShader, spriteShader);
+    testStoryboardHistory(slots, bodyShader, spriteShader);
+    testAnimationInterpolation(slots, bodyShader, spriteShader);
+    testAnimationSlotSwap(slots, bodyShader, spriteShader);
+    testAnimationStall(slots, bodyShader, spriteShader);
+
+    if (failures == 0) std::cout << "All tests passed" << std::endl;
+    return failures;
+}